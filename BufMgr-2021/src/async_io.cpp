@@ -0,0 +1,413 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "async_io.h"
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define BADGERDB_HAVE_IO_URING 1
+#endif
+#endif
+
+namespace badgerdb {
+
+//----------------------------------------
+// IoBatch
+//----------------------------------------
+
+IoBatch *IoCompletionQueue::pop() {
+  std::unique_lock<std::mutex> guard(latch);
+  ready.wait(guard, [this]() { return !completed.empty(); });
+  IoBatch *batch = completed.front();
+  completed.pop_front();
+  return batch;
+}
+
+IoBatch *IoCompletionQueue::tryPop() {
+  std::lock_guard<std::mutex> guard(latch);
+  if (completed.empty()) {
+    return nullptr;
+  }
+  IoBatch *batch = completed.front();
+  completed.pop_front();
+  return batch;
+}
+
+void IoCompletionQueue::push(IoBatch *batch) {
+  // Signal under the latch: once pop() returns, the owner may destroy the
+  // queue, so it must not be touched after the latch is released
+  std::lock_guard<std::mutex> guard(latch);
+  completed.push_back(batch);
+  ready.notify_one();
+}
+
+void IoBatch::addRead(const int fd, const std::uint64_t offset, char *buffer,
+                      const std::size_t length) {
+  Request request = {fd, offset, buffer, length, 0, this};
+  requests.push_back(request);
+}
+
+void IoBatch::wait() {
+  std::unique_lock<std::mutex> guard(latch);
+  done.wait(guard, [this]() { return pending == 0; });
+}
+
+void IoBatch::submitted(const std::size_t count) {
+  std::lock_guard<std::mutex> guard(latch);
+  pending += count;
+}
+
+void IoBatch::complete(Request &request, const long result) {
+  request.result = result;
+  IoCompletionQueue *queue = nullptr;
+  {
+    std::lock_guard<std::mutex> guard(latch);
+    if (--pending == 0) {
+      done.notify_all();
+      queue = completions;
+    }
+  }
+  // The owner may destroy the batch once it has popped it from the queue
+  if (queue != nullptr) queue->push(this);
+}
+
+//----------------------------------------
+// IoEngine
+//----------------------------------------
+
+std::unique_ptr<IoEngine> IoEngine::create(const IoEngineType type,
+                                           const std::uint32_t queueDepth) {
+  const std::uint32_t depth = std::max(queueDepth, 1u);
+  switch (type) {
+    case IoEngineType::NONE:
+      return nullptr;
+    case IoEngineType::IO_URING: {
+      std::unique_ptr<IoUringEngine> ring(new IoUringEngine(depth));
+      if (ring->isReady()) {
+        return std::move(ring);
+      }
+      // No io_uring on this system
+      return std::unique_ptr<IoEngine>(new ThreadPoolIoEngine(depth));
+    }
+    case IoEngineType::THREAD_POOL:
+    default:
+      return std::unique_ptr<IoEngine>(new ThreadPoolIoEngine(depth));
+  }
+}
+
+//----------------------------------------
+// Thread pool
+//----------------------------------------
+
+ThreadPoolIoEngine::ThreadPoolIoEngine(const std::uint32_t numThreads)
+    : stopping(false) {
+  for (std::uint32_t i = 0; i < numThreads; i++) {
+    threads.emplace_back(&ThreadPoolIoEngine::run, this);
+  }
+}
+
+ThreadPoolIoEngine::~ThreadPoolIoEngine() {
+  {
+    std::lock_guard<std::mutex> guard(latch);
+    stopping = true;
+  }
+  work.notify_all();
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+void ThreadPoolIoEngine::submit(IoBatch &batch) {
+  batch.submitted(batch.requests.size());
+  {
+    std::lock_guard<std::mutex> guard(latch);
+    for (IoBatch::Request &request : batch.requests) {
+      queue.push_back(&request);
+    }
+  }
+  work.notify_all();
+}
+
+void ThreadPoolIoEngine::run() {
+  while (true) {
+    IoBatch::Request *request;
+    {
+      std::unique_lock<std::mutex> guard(latch);
+      work.wait(guard, [this]() { return stopping || !queue.empty(); });
+      if (queue.empty()) {
+        return;
+      }
+      request = queue.front();
+      queue.pop_front();
+    }
+
+    // Short transfers are continued until the request is done or hits the
+    // end of the file
+    long transferred = 0;
+    while (transferred < static_cast<long>(request->length)) {
+      const ssize_t n = pread(request->fd, request->buffer + transferred,
+                              request->length - transferred,
+                              request->offset + transferred);
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        transferred = -errno;
+        break;
+      }
+      if (n == 0) break;
+      transferred += n;
+    }
+    request->batch->complete(*request, transferred);
+  }
+}
+
+//----------------------------------------
+// io_uring
+//----------------------------------------
+
+#if defined(BADGERDB_HAVE_IO_URING)
+
+namespace {
+
+int ringEnter(const int ringFd, const unsigned toSubmit,
+              const unsigned minComplete, const unsigned flags) {
+  return syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags,
+                 nullptr, 0);
+}
+
+}  // namespace
+
+IoUringEngine::IoUringEngine(const std::uint32_t queueDepth)
+    : ringFd(-1),
+      sqRing(MAP_FAILED),
+      sqRingSize(0),
+      cqRing(MAP_FAILED),
+      cqRingSize(0),
+      sqEntries(MAP_FAILED),
+      sqEntriesSize(0),
+      inFlight(0),
+      stopping(false) {
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  const int fd = syscall(__NR_io_uring_setup, queueDepth, &params);
+  if (fd < 0) {
+    return;
+  }
+
+  sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (singleMap) {
+    sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+  }
+  sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  cqRing = singleMap || sqRing == MAP_FAILED
+               ? sqRing
+               : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+  sqEntriesSize = params.sq_entries * sizeof(io_uring_sqe);
+  if (cqRing != MAP_FAILED) {
+    sqEntries = mmap(nullptr, sqEntriesSize, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  }
+  if (sqEntries == MAP_FAILED) {
+    if (cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+    if (sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+    sqRing = cqRing = MAP_FAILED;
+    close(fd);
+    return;
+  }
+
+  char *sq = static_cast<char *>(sqRing);
+  char *cq = static_cast<char *>(cqRing);
+  sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqEntries = cq + params.cq_off.cqes;
+  sqSize = params.sq_entries;
+  cqSize = params.cq_entries;
+
+  ringFd = fd;
+  reaper = std::thread(&IoUringEngine::reap, this);
+}
+
+IoUringEngine::~IoUringEngine() {
+  if (ringFd < 0) {
+    return;
+  }
+
+  // A request without a batch tells the completion thread to stop once
+  // everything before it has completed
+  {
+    std::unique_lock<std::mutex> guard(submitLatch);
+    drained.wait(guard, [this]() { return inFlight < cqSize; });
+    pushEntry(nullptr);
+    inFlight++;
+    submitEntries(1);
+  }
+  reaper.join();
+
+  munmap(sqEntries, sqEntriesSize);
+  if (cqRing != sqRing) munmap(cqRing, cqRingSize);
+  munmap(sqRing, sqRingSize);
+  close(ringFd);
+}
+
+void IoUringEngine::pushEntry(const IoBatch::Request *request) {
+  const unsigned tail = *sqTail;
+  const unsigned index = tail & *sqMask;
+  io_uring_sqe *entry = static_cast<io_uring_sqe *>(sqEntries) + index;
+  std::memset(entry, 0, sizeof(*entry));
+  if (request == nullptr) {
+    entry->opcode = IORING_OP_NOP;
+  } else {
+    entry->opcode = IORING_OP_READ;
+    entry->fd = request->fd;
+    entry->off = request->offset;
+    entry->addr = reinterpret_cast<std::uint64_t>(request->buffer);
+    entry->len = request->length;
+  }
+  entry->user_data = reinterpret_cast<std::uint64_t>(request);
+  sqArray[index] = index;
+  __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+}
+
+void IoUringEngine::submitEntries(unsigned toSubmit) {
+  while (toSubmit > 0) {
+    const int ret = ringEnter(ringFd, toSubmit, 0, 0);
+    if (ret < 0) {
+      if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+        std::this_thread::yield();
+        continue;
+      }
+      failEntries(errno);
+      return;
+    }
+    toSubmit -= std::min<unsigned>(ret, toSubmit);
+  }
+}
+
+void IoUringEngine::failEntries(const int error) {
+  // Without a polling thread the kernel only consumes entries inside
+  // io_uring_enter, which runs under submitLatch, so the entries between
+  // head and tail are ours to take back
+  const unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+  const unsigned tail = *sqTail;
+  for (unsigned i = head; i != tail; i++) {
+    const io_uring_sqe *entry =
+        static_cast<io_uring_sqe *>(sqEntries) + sqArray[i & *sqMask];
+    IoBatch::Request *request =
+        reinterpret_cast<IoBatch::Request *>(entry->user_data);
+    if (request == nullptr) {
+      stopping = true;
+    } else {
+      request->batch->complete(*request, -error);
+    }
+  }
+  __atomic_store_n(sqTail, head, __ATOMIC_RELEASE);
+  inFlight -= tail - head;
+  drained.notify_all();
+}
+
+void IoUringEngine::submit(IoBatch &batch) {
+  batch.submitted(batch.requests.size());
+
+  std::unique_lock<std::mutex> guard(submitLatch);
+  unsigned queued = 0;
+  for (IoBatch::Request &request : batch.requests) {
+    if (inFlight >= cqSize) {
+      // The completion queue could overflow; let the kernel have what we
+      // queued and wait for completions
+      submitEntries(queued);
+      queued = 0;
+      drained.wait(guard, [this]() { return inFlight < cqSize; });
+    }
+    if (*sqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) == sqSize) {
+      submitEntries(queued);
+      queued = 0;
+    }
+    pushEntry(&request);
+    queued++;
+    inFlight++;
+  }
+  submitEntries(queued);
+}
+
+void IoUringEngine::reap() {
+  bool stop = false;
+  while (!stop) {
+    if (ringEnter(ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+        errno != EINTR) {
+      std::this_thread::yield();
+    }
+
+    // Taking the submission latch orders the submitter's writes to the
+    // requests before their completion, which the ring alone does not show
+    // to the compiler or to race detectors
+    std::unique_lock<std::mutex> guard(submitLatch);
+    stop = stopping;
+    unsigned head = *cqHead;
+    unsigned reaped = 0;
+    while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+      const io_uring_cqe *entry =
+          static_cast<io_uring_cqe *>(cqEntries) + (head & *cqMask);
+      IoBatch::Request *request =
+          reinterpret_cast<IoBatch::Request *>(entry->user_data);
+      const long result = entry->res;
+      head++;
+      __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+      reaped++;
+
+      if (request == nullptr) {
+        stop = true;
+      } else {
+        request->batch->complete(*request, result);
+      }
+    }
+
+    inFlight -= reaped;
+    guard.unlock();
+    if (reaped > 0) {
+      drained.notify_all();
+    }
+  }
+}
+
+#else
+
+IoUringEngine::IoUringEngine(const std::uint32_t)
+    : ringFd(-1), inFlight(0), stopping(false) {}
+
+IoUringEngine::~IoUringEngine() {}
+
+void IoUringEngine::pushEntry(const IoBatch::Request *) {}
+
+void IoUringEngine::submit(IoBatch &) {}
+
+void IoUringEngine::submitEntries(unsigned) {}
+
+void IoUringEngine::failEntries(const int) {}
+
+void IoUringEngine::reap() {}
+
+#endif
+
+}  // namespace badgerdb
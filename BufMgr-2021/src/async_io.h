@@ -0,0 +1,359 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace badgerdb {
+
+/**
+ * @brief Engines that asynchronous page I/O can be issued through
+ */
+enum class IoEngineType {
+  /**
+   * No engine; all I/O is synchronous
+   */
+  NONE,
+
+  /**
+   * A pool of threads that issue blocking pread() calls
+   */
+  THREAD_POOL,
+
+  /**
+   * Linux io_uring.  Falls back to THREAD_POOL where it is not available.
+   */
+  IO_URING
+};
+
+class IoBatch;
+
+/**
+ * @brief Collects batches as they complete, so that a single thread can wait
+ * for whichever of many batches completes first
+ */
+class IoCompletionQueue {
+ public:
+  /**
+   * Blocks until a batch that notifies this queue has completed and returns
+   * it.  Batches are returned in the order they completed.
+   */
+  IoBatch* pop();
+
+  /**
+   * Returns the next completed batch, or null if none has completed.
+   */
+  IoBatch* tryPop();
+
+ private:
+  friend class IoBatch;
+
+  /**
+   * Adds a completed batch; called by the batch.
+   */
+  void push(IoBatch* batch);
+
+  /**
+   * Completed batches not popped yet
+   */
+  std::deque<IoBatch*> completed;
+
+  /**
+   * Latch and condition protecting completed
+   */
+  std::mutex latch;
+  std::condition_variable ready;
+};
+
+/**
+ * @brief A group of page reads that is submitted to an IoEngine at once
+ *
+ * The requests of a batch may complete in any order.  Requests must not be
+ * added once the batch has been submitted, and the buffers of the requests
+ * must stay valid until wait() returns.
+ */
+class IoBatch {
+ public:
+  /**
+   * Constructor of IoBatch class
+   */
+  IoBatch() : pending(0), completions(nullptr) {}
+
+  IoBatch(const IoBatch&) = delete;
+  IoBatch& operator=(const IoBatch&) = delete;
+
+  /**
+   * Waits for outstanding requests so that no completion outlives the batch.
+   */
+  ~IoBatch() { wait(); }
+
+  /**
+   * Adds a read of length bytes at offset of fd into buffer.
+   */
+  void addRead(const int fd, const std::uint64_t offset, char* buffer,
+               const std::size_t length);
+
+  /**
+   * Returns the number of requests in the batch.
+   */
+  std::size_t size() const { return requests.size(); }
+
+  /**
+   * Returns the outcome of a completed request.
+   *
+   * @param i Index of the request, in the order it was added
+   * @return  Number of bytes transferred, or a negated errno value
+   */
+  long result(const std::size_t i) const { return requests[i].result; }
+
+  /**
+   * Blocks until every submitted request of the batch has completed.
+   */
+  void wait();
+
+  /**
+   * Has the batch added to a completion queue once every submitted request
+   * of it has completed.  Must be called before the batch is submitted.
+   *
+   * @param queue Queue to add the batch to
+   */
+  void notify(IoCompletionQueue& queue) { completions = &queue; }
+
+ private:
+  friend class ThreadPoolIoEngine;
+  friend class IoUringEngine;
+
+  /**
+   * A single read
+   */
+  struct Request {
+    int fd;
+    std::uint64_t offset;
+    char* buffer;
+    std::size_t length;
+    long result;
+    IoBatch* batch;
+  };
+
+  /**
+   * Marks the given number of requests as submitted.
+   */
+  void submitted(const std::size_t count);
+
+  /**
+   * Records the outcome of a request; called by the engine.
+   */
+  void complete(Request& request, const long result);
+
+  /**
+   * Requests of the batch
+   */
+  std::vector<Request> requests;
+
+  /**
+   * Number of submitted requests that have not completed yet
+   */
+  std::size_t pending;
+
+  /**
+   * Latch and condition protecting pending
+   */
+  std::mutex latch;
+  std::condition_variable done;
+
+  /**
+   * Queue to add the batch to on completion, or null
+   */
+  IoCompletionQueue* completions;
+};
+
+/**
+ * @brief Issues the requests of IoBatch objects, many at a time and
+ * completing them out of order
+ *
+ * All methods may be called concurrently.
+ */
+class IoEngine {
+ public:
+  virtual ~IoEngine() {}
+
+  /**
+   * Creates an engine of the given type.
+   *
+   * @param type        Engine to create
+   * @param queueDepth  Maximum number of requests in flight
+   * @return  The new engine, or nullptr for IoEngineType::NONE.
+   */
+  static std::unique_ptr<IoEngine> create(const IoEngineType type,
+                                          const std::uint32_t queueDepth);
+
+  /**
+   * Submits every request of a batch and returns without waiting for them
+   * to complete.
+   *
+   * @param batch Batch to submit
+   */
+  virtual void submit(IoBatch& batch) = 0;
+};
+
+/**
+ * @brief Engine running blocking system calls on a pool of threads
+ */
+class ThreadPoolIoEngine : public IoEngine {
+ public:
+  /**
+   * @param numThreads  Number of I/O threads, i.e. requests in flight
+   */
+  explicit ThreadPoolIoEngine(const std::uint32_t numThreads);
+  ~ThreadPoolIoEngine();
+
+  void submit(IoBatch& batch) override;
+
+ private:
+  /**
+   * Body of each I/O thread
+   */
+  void run();
+
+  /**
+   * Requests waiting for a thread
+   */
+  std::deque<IoBatch::Request*> queue;
+
+  /**
+   * Set when the engine shuts down
+   */
+  bool stopping;
+
+  /**
+   * Latch and condition protecting queue and stopping
+   */
+  std::mutex latch;
+  std::condition_variable work;
+
+  /**
+   * The I/O threads
+   */
+  std::vector<std::thread> threads;
+};
+
+/**
+ * @brief Engine submitting requests to an io_uring instance
+ *
+ * Submissions are serialized on a latch; a completion thread reaps the
+ * completion queue and completes the requests.
+ */
+class IoUringEngine : public IoEngine {
+ public:
+  /**
+   * Sets up the ring.  Check isReady() before use.
+   *
+   * @param queueDepth  Number of submission queue entries
+   */
+  explicit IoUringEngine(const std::uint32_t queueDepth);
+  ~IoUringEngine();
+
+  /**
+   * Returns true if the ring could be set up.
+   */
+  bool isReady() const { return ringFd >= 0; }
+
+  void submit(IoBatch& batch) override;
+
+ private:
+  /**
+   * Body of the completion thread
+   */
+  void reap();
+
+  /**
+   * Writes one submission queue entry; the caller holds submitLatch.
+   */
+  void pushEntry(const IoBatch::Request* request);
+
+  /**
+   * Hands queued entries to the kernel, retrying while it is busy.  Entries
+   * the kernel refuses are completed with the error; the caller holds
+   * submitLatch.
+   *
+   * @param toSubmit  Number of entries queued since the last submission
+   */
+  void submitEntries(unsigned toSubmit);
+
+  /**
+   * Completes every entry still in the submission queue with -error.
+   */
+  void failEntries(const int error);
+
+  /**
+   * File descriptor of the ring
+   */
+  int ringFd;
+
+  /**
+   * Mappings of the submission queue, completion queue and entry arrays
+   */
+  void* sqRing;
+  std::size_t sqRingSize;
+  void* cqRing;
+  std::size_t cqRingSize;
+  void* sqEntries;
+  std::size_t sqEntriesSize;
+
+  /**
+   * Fields of the shared rings
+   */
+  unsigned* sqHead;
+  unsigned* sqTail;
+  unsigned* sqMask;
+  unsigned* sqArray;
+  unsigned* cqHead;
+  unsigned* cqTail;
+  unsigned* cqMask;
+  void* cqEntries;
+
+  /**
+   * Number of submission and completion queue entries
+   */
+  unsigned sqSize;
+  unsigned cqSize;
+
+  /**
+   * Requests in flight; kept below cqSize so that the completion queue
+   * cannot overflow
+   */
+  unsigned inFlight;
+
+  /**
+   * Set when the entry that stops the completion thread could not be
+   * submitted
+   */
+  bool stopping;
+
+  /**
+   * Latch serializing submissions, and the condition signalled when requests
+   * complete
+   */
+  std::mutex submitLatch;
+  std::condition_variable drained;
+
+  /**
+   * The completion thread
+   */
+  std::thread reaper;
+};
+
+}  // namespace badgerdb
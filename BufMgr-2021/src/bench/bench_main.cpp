@@ -0,0 +1,412 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+/**
+ * Benchmark driver for BufMgr.  Runs every combination of the selected
+ * workloads, replacement policies, pool sizes and thread counts against one
+ * data file and prints a row per combination with throughput, latency
+ * percentiles and hit rate.  Every option has the form --name=value; lists
+ * are comma separated.
+ *
+ *   --workloads   uniform, zipf, scan, mixed             (all four)
+ *   --policies    clock, lru-k, 2q                       (all three)
+ *   --frames      buffer pool sizes in frames            (256,1024,3072)
+ *   --threads     thread counts                          (1,4)
+ *   --pages       pages in the data file                 (4096)
+ *   --ops         measured operations per thread         (100000)
+ *   --writes      fraction of operations that dirty the page (0.1)
+ *   --zipf        Zipf skew of the hot-set workloads     (0.99)
+ *   --scan-share  fraction of scan operations in mixed   (0.5)
+ *   --seed        random seed                            (1)
+ *   --numa        NUMA partitions of the buffer pool     (0, off)
+ *   --victim-mb   megabytes of compressed victim cache   (0, off)
+ *   --file        name of the data file                  (bench.db)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer.h"
+#include "exceptions/file_not_found_exception.h"
+#include "file.h"
+#include "page.h"
+
+using namespace badgerdb;
+
+namespace {
+
+enum class Workload { UNIFORM, ZIPF, SCAN, MIXED };
+
+struct Config {
+  std::vector<Workload> workloads = {Workload::UNIFORM, Workload::ZIPF,
+                                     Workload::SCAN, Workload::MIXED};
+  std::vector<ReplacementPolicyType> policies = {
+      ReplacementPolicyType::CLOCK, ReplacementPolicyType::LRU_K,
+      ReplacementPolicyType::TWO_Q};
+  std::vector<std::uint32_t> frames = {256, 1024, 3072};
+  std::vector<std::uint32_t> threads = {1, 4};
+  std::uint32_t pages = 4096;
+  std::uint64_t ops = 100000;
+  double writes = 0.1;
+  double zipf = 0.99;
+  double scanShare = 0.5;
+  std::uint64_t seed = 1;
+  std::uint32_t numaNodes = 0;
+  std::uint32_t victimMb = 0;
+  std::string file = "bench.db";
+};
+
+const char* workloadName(const Workload workload) {
+  switch (workload) {
+    case Workload::UNIFORM:
+      return "uniform";
+    case Workload::ZIPF:
+      return "zipf";
+    case Workload::SCAN:
+      return "scan";
+    case Workload::MIXED:
+      return "mixed";
+  }
+  return "?";
+}
+
+const char* policyName(const ReplacementPolicyType policy) {
+  switch (policy) {
+    case ReplacementPolicyType::CLOCK:
+      return "clock";
+    case ReplacementPolicyType::LRU_K:
+      return "lru-k";
+    case ReplacementPolicyType::TWO_Q:
+      return "2q";
+  }
+  return "?";
+}
+
+std::vector<std::string> splitList(const std::string& value) {
+  std::vector<std::string> items;
+  std::stringstream stream(value);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) items.push_back(item);
+  }
+  if (items.empty()) throw std::invalid_argument("empty list: " + value);
+  return items;
+}
+
+std::vector<std::uint32_t> parseCounts(const std::string& value) {
+  std::vector<std::uint32_t> counts;
+  for (const std::string& item : splitList(value)) {
+    counts.push_back(static_cast<std::uint32_t>(std::stoul(item)));
+    if (counts.back() == 0) throw std::invalid_argument("zero in " + value);
+  }
+  return counts;
+}
+
+Config parseArgs(int argc, char* argv[]) {
+  Config config;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const std::size_t eq = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos) {
+      throw std::invalid_argument("expected --name=value: " + arg);
+    }
+    const std::string name = arg.substr(2, eq - 2);
+    const std::string value = arg.substr(eq + 1);
+    if (name == "workloads") {
+      config.workloads.clear();
+      for (const std::string& item : splitList(value)) {
+        if (item == "uniform") {
+          config.workloads.push_back(Workload::UNIFORM);
+        } else if (item == "zipf") {
+          config.workloads.push_back(Workload::ZIPF);
+        } else if (item == "scan") {
+          config.workloads.push_back(Workload::SCAN);
+        } else if (item == "mixed") {
+          config.workloads.push_back(Workload::MIXED);
+        } else {
+          throw std::invalid_argument("unknown workload: " + item);
+        }
+      }
+    } else if (name == "policies") {
+      config.policies.clear();
+      for (const std::string& item : splitList(value)) {
+        if (item == "clock") {
+          config.policies.push_back(ReplacementPolicyType::CLOCK);
+        } else if (item == "lru-k") {
+          config.policies.push_back(ReplacementPolicyType::LRU_K);
+        } else if (item == "2q") {
+          config.policies.push_back(ReplacementPolicyType::TWO_Q);
+        } else {
+          throw std::invalid_argument("unknown policy: " + item);
+        }
+      }
+    } else if (name == "frames") {
+      config.frames = parseCounts(value);
+    } else if (name == "threads") {
+      config.threads = parseCounts(value);
+    } else if (name == "pages") {
+      config.pages = parseCounts(value).front();
+    } else if (name == "ops") {
+      config.ops = std::stoull(value);
+    } else if (name == "writes") {
+      config.writes = std::stod(value);
+    } else if (name == "zipf") {
+      config.zipf = std::stod(value);
+    } else if (name == "scan-share") {
+      config.scanShare = std::stod(value);
+    } else if (name == "seed") {
+      config.seed = std::stoull(value);
+    } else if (name == "numa") {
+      config.numaNodes = static_cast<std::uint32_t>(std::stoul(value));
+    } else if (name == "victim-mb") {
+      config.victimMb = static_cast<std::uint32_t>(std::stoul(value));
+    } else if (name == "file") {
+      config.file = value;
+    } else {
+      throw std::invalid_argument("unknown option: " + name);
+    }
+  }
+  return config;
+}
+
+/**
+ * Draws page numbers from a Zipf distribution over the pages of the file.
+ * Ranks are mapped to pages through a fixed permutation so that the hot set
+ * is spread over the file instead of sitting at its start.
+ */
+class ZipfPages {
+ public:
+  ZipfPages(const std::uint32_t pages, const double skew,
+            const std::uint64_t seed)
+      : cdf(pages), pageOfRank(pages) {
+    double sum = 0;
+    for (std::uint32_t rank = 0; rank < pages; rank++) {
+      sum += 1.0 / std::pow(rank + 1.0, skew);
+      cdf[rank] = sum;
+    }
+    for (double& value : cdf) value /= sum;
+    for (std::uint32_t rank = 0; rank < pages; rank++) {
+      pageOfRank[rank] = rank + 1;
+    }
+    std::mt19937_64 random(seed);
+    std::shuffle(pageOfRank.begin(), pageOfRank.end(), random);
+  }
+
+  PageId next(std::mt19937_64& random) const {
+    const double u = std::uniform_real_distribution<double>(0, 1)(random);
+    std::size_t rank = std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+    return pageOfRank[std::min(rank, cdf.size() - 1)];
+  }
+
+ private:
+  std::vector<double> cdf;
+  std::vector<PageId> pageOfRank;
+};
+
+/**
+ * State of one benchmark thread, kept across the warm-up and measured runs
+ */
+struct Worker {
+  std::mt19937_64 random;
+  PageId scanCursor;
+  std::vector<std::uint64_t> latencies;
+  std::uint64_t sink;
+};
+
+PageId nextPage(const Config& config, const Workload workload,
+                const ZipfPages& zipf, Worker& worker) {
+  std::uniform_real_distribution<double> coin(0, 1);
+  Workload kind = workload;
+  if (kind == Workload::MIXED) {
+    kind = coin(worker.random) < config.scanShare ? Workload::SCAN
+                                                  : Workload::ZIPF;
+  }
+  switch (kind) {
+    case Workload::SCAN:
+      worker.scanCursor = worker.scanCursor % config.pages + 1;
+      return worker.scanCursor;
+    case Workload::ZIPF:
+      return zipf.next(worker.random);
+    default:
+      return std::uniform_int_distribution<PageId>(1, config.pages)(
+          worker.random);
+  }
+}
+
+void runOps(BufMgr& bufMgr, File& file, const Config& config,
+            const Workload workload, const ZipfPages& zipf, Worker& worker,
+            const std::uint64_t ops, const bool measure) {
+  std::uniform_real_distribution<double> coin(0, 1);
+  for (std::uint64_t i = 0; i < ops; i++) {
+    const PageId pageNo = nextPage(config, workload, zipf, worker);
+    const bool write = coin(worker.random) < config.writes;
+    const auto start = std::chrono::steady_clock::now();
+    {
+      PageGuard page = bufMgr.readPage(file, pageNo);
+      worker.sink += page->getFreeSpace();
+      if (write) page.markDirty();
+    }
+    if (measure) {
+      worker.latencies.push_back(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::steady_clock::now() - start)
+              .count());
+    }
+  }
+}
+
+/**
+ * Runs ops operations on each of the workers, one thread per worker.
+ *
+ * @return  Wall clock time of the run in seconds.
+ */
+double runWorkers(BufMgr& bufMgr, File& file, const Config& config,
+                  const Workload workload, const ZipfPages& zipf,
+                  std::vector<Worker>& workers, const std::uint64_t ops,
+                  const bool measure) {
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (Worker& worker : workers) {
+    threads.emplace_back([&, ops, measure]() {
+      runOps(bufMgr, file, config, workload, zipf, worker, ops, measure);
+    });
+  }
+  for (std::thread& thread : threads) thread.join();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+double percentileMicros(std::vector<std::uint64_t>& latencies,
+                        const double fraction) {
+  if (latencies.empty()) return 0;
+  std::size_t rank = static_cast<std::size_t>(fraction * latencies.size());
+  rank = std::min(rank, latencies.size() - 1);
+  std::nth_element(latencies.begin(), latencies.begin() + rank,
+                   latencies.end());
+  return latencies[rank] / 1000.0;
+}
+
+void runOne(File& file, const Config& config, const ZipfPages& zipf,
+            const Workload workload, const ReplacementPolicyType policy,
+            const std::uint32_t frames, const std::uint32_t numThreads) {
+  BufMgrOptions options;
+  options.replacementPolicy = policy;
+  options.hashPartitions = numThreads > 1 ? 16 : 1;
+  options.numaNodes = config.numaNodes;
+  options.victimCacheBytes = std::size_t(config.victimMb) << 20;
+  BufMgr bufMgr(frames, options);
+
+  std::vector<Worker> workers(numThreads);
+  for (std::uint32_t t = 0; t < numThreads; t++) {
+    workers[t].random.seed(config.seed * 1000003 + t);
+    workers[t].scanCursor =
+        static_cast<PageId>(std::uint64_t(config.pages) * t / numThreads);
+    workers[t].latencies.reserve(config.ops);
+    workers[t].sink = 0;
+  }
+
+  runWorkers(bufMgr, file, config, workload, zipf, workers,
+             std::max<std::uint64_t>(config.ops / 10, frames), false);
+  bufMgr.clearBufStats();
+  const double seconds = runWorkers(bufMgr, file, config, workload, zipf,
+                                    workers, config.ops, true);
+  const BufStats stats = bufMgr.getBufStats();
+
+  std::vector<std::uint64_t> latencies;
+  latencies.reserve(config.ops * numThreads);
+  for (const Worker& worker : workers) {
+    latencies.insert(latencies.end(), worker.latencies.begin(),
+                     worker.latencies.end());
+  }
+  const double throughput = latencies.size() / seconds;
+  const double p50 = percentileMicros(latencies, 0.5);
+  const double p99 = percentileMicros(latencies, 0.99);
+  const double p999 = percentileMicros(latencies, 0.999);
+  const double hitRate =
+      stats.accesses == 0 ? 0 : 100.0 * stats.hits / stats.accesses;
+
+  std::printf("%-8s %-6s %7u %7u %12.0f %9.2f %9.2f %9.2f %7.2f\n",
+              workloadName(workload), policyName(policy), frames, numThreads,
+              throughput, p50, p99, p999, hitRate);
+  std::fflush(stdout);
+}
+
+/**
+ * Creates the data file with one small record on every page.
+ */
+void createDataFile(const Config& config) {
+  try {
+    File::remove(config.file);
+  } catch (const FileNotFoundException&) {
+  }
+  File file = File::create(config.file);
+  BufMgr loader(64);
+  const std::string record = "badgerdb benchmark record";
+  for (std::uint32_t done = 0; done < config.pages;) {
+    const std::uint32_t count = std::min<std::uint32_t>(32, config.pages - done);
+    PageId firstPageNo;
+    std::vector<Page*> pages;
+    loader.allocPages(file, count, firstPageNo, pages);
+    for (std::uint32_t i = 0; i < count; i++) {
+      pages[i]->insertRecord(record);
+      loader.unPinPage(file, firstPageNo + i, true);
+    }
+    loader.flushFile(file);
+    done += count;
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Config config;
+  try {
+    config = parseArgs(argc, argv);
+  } catch (const std::exception& e) {
+    std::cerr << "bench: " << e.what() << "\n";
+    return 2;
+  }
+
+  createDataFile(config);
+  {
+    File file = File::open(config.file);
+    const ZipfPages zipf(config.pages, config.zipf, config.seed);
+    std::printf("pages=%u ops=%llu writes=%.2f zipf=%.2f scan-share=%.2f "
+                "seed=%llu page-size=%u\n",
+                config.pages, static_cast<unsigned long long>(config.ops),
+                config.writes, config.zipf, config.scanShare,
+                static_cast<unsigned long long>(config.seed),
+                static_cast<unsigned>(Page::SIZE));
+    std::printf("%-8s %-6s %7s %7s %12s %9s %9s %9s %7s\n", "workload",
+                "policy", "frames", "threads", "ops/s", "p50(us)", "p99(us)",
+                "p999(us)", "hit%");
+    for (const Workload workload : config.workloads) {
+      for (const ReplacementPolicyType policy : config.policies) {
+        for (const std::uint32_t frames : config.frames) {
+          for (const std::uint32_t threads : config.threads) {
+            runOne(file, config, zipf, workload, policy, frames, threads);
+          }
+        }
+      }
+    }
+  }
+  File::remove(config.file);
+  return 0;
+}
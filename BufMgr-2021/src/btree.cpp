@@ -0,0 +1,691 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "btree.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "exceptions/bad_index_info_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Identifies the first page of an index file
+ */
+const char INDEX_MAGIC[16] = "badgerdb-btree1";
+
+/**
+ * Contents of the first page of an index file
+ */
+struct IndexMeta {
+  char magic[16];
+  std::uint8_t keyType;
+  std::uint8_t reserved[3];
+  std::uint32_t keyLength;
+  PageId root;
+  std::uint32_t height;
+  std::uint64_t entries;
+};
+
+/**
+ * Start of every node.  A leaf holds count entries after the header and
+ * chains to the next leaf.  An inner node holds its first child after the
+ * header, followed by count pairs of a key and the child to its right; the
+ * key is the first entry of that child's subtree.
+ */
+struct NodeHeader {
+  /**
+   * Distance from the leaves; 0 for a leaf
+   */
+  std::uint16_t level;
+
+  /**
+   * Number of entries of a leaf or keys of an inner node
+   */
+  std::uint16_t count;
+
+  /**
+   * Next leaf in key order, or Page::INVALID_NUMBER
+   */
+  PageId next;
+};
+
+const std::size_t NODE_HEADER = sizeof(NodeHeader);
+
+/**
+ * Percentage of a node bulkLoad() fills
+ */
+const std::uint32_t BULK_LOAD_FILL = 90;
+
+NodeHeader readNode(const char *data) {
+  NodeHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  return header;
+}
+
+void writeNode(char *data, const NodeHeader &header) {
+  std::memcpy(data, &header, sizeof(header));
+}
+
+char *leafEntry(char *data, const std::uint32_t i, const std::uint32_t size) {
+  return data + NODE_HEADER + std::size_t(i) * size;
+}
+
+const char *leafEntry(const char *data, const std::uint32_t i,
+                      const std::uint32_t size) {
+  return data + NODE_HEADER + std::size_t(i) * size;
+}
+
+std::size_t innerKeyOffset(const std::uint32_t i, const std::uint32_t size) {
+  return NODE_HEADER + sizeof(PageId) +
+         std::size_t(i) * (size + sizeof(PageId));
+}
+
+std::size_t innerChildOffset(const std::uint32_t i, const std::uint32_t size) {
+  return i == 0 ? NODE_HEADER : innerKeyOffset(i - 1, size) + size;
+}
+
+PageId innerChild(const char *data, const std::uint32_t i,
+                  const std::uint32_t size) {
+  PageId child;
+  std::memcpy(&child, data + innerChildOffset(i, size), sizeof(child));
+  return child;
+}
+
+void setInnerChild(char *data, const std::uint32_t i, const std::uint32_t size,
+                   const PageId child) {
+  std::memcpy(data + innerChildOffset(i, size), &child, sizeof(child));
+}
+
+/**
+ * Returns the position of the first entry of a leaf not less than the given
+ * one.
+ */
+std::uint32_t leafLowerBound(const char *data, const std::uint32_t count,
+                             const std::string &entry,
+                             const std::uint32_t size) {
+  std::uint32_t low = 0;
+  std::uint32_t high = count;
+  while (low < high) {
+    const std::uint32_t mid = (low + high) / 2;
+    if (std::memcmp(leafEntry(data, mid, size), entry.data(), size) < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+/**
+ * Returns the child of an inner node whose subtree holds the given entry:
+ * the number of keys not greater than it.
+ */
+std::uint32_t innerChildIndex(const char *data, const std::uint32_t count,
+                              const std::string &entry,
+                              const std::uint32_t size) {
+  std::uint32_t low = 0;
+  std::uint32_t high = count;
+  while (low < high) {
+    const std::uint32_t mid = (low + high) / 2;
+    if (std::memcmp(data + innerKeyOffset(mid, size), entry.data(), size) <=
+        0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+}  // namespace
+
+const PageId BTreeIndex::META_PAGE;
+const std::uint32_t BTreeIndex::RECORD_ID_SIZE;
+
+BTreeIterator::BTreeIterator()
+    : bufMgr(nullptr),
+      file(nullptr),
+      keyLength(0),
+      leafNo(Page::INVALID_NUMBER),
+      position(0) {}
+
+BTreeIterator::BTreeIterator(BufMgr *bufMgr, File *file,
+                             const std::uint32_t keyLength, PageGuard &&leaf,
+                             const std::uint32_t position)
+    : bufMgr(bufMgr),
+      file(file),
+      keyLength(keyLength),
+      leaf(std::move(leaf)),
+      leafNo(this->leaf->page_number()),
+      position(position) {
+  settle();
+}
+
+RecordId BTreeIterator::operator*() const {
+  const unsigned char *id =
+      reinterpret_cast<const unsigned char *>(entry() + keyLength);
+  RecordId recordId;
+  recordId.page_number = PageId(id[0]) << 24 | PageId(id[1]) << 16 |
+                         PageId(id[2]) << 8 | PageId(id[3]);
+  recordId.slot_number = SlotId(id[4] << 8 | id[5]);
+  return recordId;
+}
+
+std::int64_t BTreeIterator::intKey() const {
+  const unsigned char *key = reinterpret_cast<const unsigned char *>(entry());
+  std::uint64_t value = 0;
+  for (int i = 0; i < 8; i++) {
+    value = value << 8 | key[i];
+  }
+  return static_cast<std::int64_t>(value ^ (std::uint64_t(1) << 63));
+}
+
+std::string BTreeIterator::stringKey() const {
+  std::string key(entry(), keyLength);
+  key.erase(key.find_last_not_of('\0') + 1);
+  return key;
+}
+
+BTreeIterator &BTreeIterator::operator++() {
+  if (leaf) {
+    position++;
+    settle();
+  }
+  return *this;
+}
+
+void BTreeIterator::settle() {
+  while (leaf) {
+    const NodeHeader header = readNode(BTreeIndex::nodeData(*leaf));
+    if (position < header.count) return;
+    leaf.release();
+    position = 0;
+    leafNo = header.next;
+    if (leafNo != Page::INVALID_NUMBER) {
+      leaf = bufMgr->readPage(*file, leafNo);
+    }
+  }
+}
+
+const char *BTreeIterator::entry() const {
+  return leafEntry(BTreeIndex::nodeData(*leaf), position,
+                   keyLength + BTreeIndex::RECORD_ID_SIZE);
+}
+
+BTreeIndex::BTreeIndex(BufMgr &bufMgr, File &file,
+                       const IndexKeyType keyType,
+                       const std::uint32_t keyLength)
+    : bufMgr(&bufMgr),
+      file(&file),
+      keyType_(keyType),
+      keyLength_(keyLength),
+      entrySize(keyLength + RECORD_ID_SIZE),
+      leafCapacity((Page::DATA_SIZE - NODE_HEADER) / entrySize),
+      innerCapacity((Page::DATA_SIZE - NODE_HEADER - sizeof(PageId)) /
+                    (entrySize + sizeof(PageId))),
+      root(Page::INVALID_NUMBER),
+      height_(0),
+      entries(0) {}
+
+BTreeIndex BTreeIndex::create(BufMgr &bufMgr, File &file,
+                              const IndexKeyType keyType,
+                              const std::uint32_t keyLength) {
+  if (file.num_pages() != 1) {
+    throw BadIndexInfoException("file '" + file.filename() +
+                                "' is not empty");
+  }
+  BTreeIndex index(bufMgr, file, keyType,
+                   keyType == IndexKeyType::INTEGER ? 8 : keyLength);
+  if (index.keyLength_ == 0 || index.innerCapacity < 4) {
+    throw BadIndexInfoException("keys of " + std::to_string(keyLength) +
+                                " bytes do not fit four to a node");
+  }
+
+  PageGuard meta = bufMgr.allocPage(file);
+  PageGuard leaf = bufMgr.allocPage(file);
+  writeNode(nodeData(*leaf), NodeHeader{0, 0, Page::INVALID_NUMBER});
+  leaf.markDirty();
+  index.root = leaf->page_number();
+  index.height_ = 1;
+  meta.release();
+  index.writeMeta();
+  return index;
+}
+
+BTreeIndex BTreeIndex::open(BufMgr &bufMgr, File &file) {
+  if (file.num_pages() <= META_PAGE) {
+    throw BadIndexInfoException("file '" + file.filename() +
+                                "' does not hold an index");
+  }
+  IndexMeta meta;
+  {
+    PageGuard page = bufMgr.readPage(file, META_PAGE);
+    std::memcpy(&meta, nodeData(*page), sizeof(meta));
+  }
+  if (std::memcmp(meta.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) {
+    throw BadIndexInfoException("file '" + file.filename() +
+                                "' does not hold an index");
+  }
+
+  BTreeIndex index(bufMgr, file, static_cast<IndexKeyType>(meta.keyType),
+                   meta.keyLength);
+  index.root = meta.root;
+  index.height_ = meta.height;
+  index.entries = meta.entries;
+  return index;
+}
+
+bool BTreeIndex::insertEntry(const std::int64_t key,
+                             const RecordId &recordId) {
+  return insertEncoded(encodeEntry(encodeKey(key), recordId));
+}
+
+bool BTreeIndex::insertEntry(const std::string &key,
+                             const RecordId &recordId) {
+  return insertEncoded(encodeEntry(encodeKey(key), recordId));
+}
+
+bool BTreeIndex::removeEntry(const std::int64_t key,
+                             const RecordId &recordId) {
+  return removeEncoded(encodeEntry(encodeKey(key), recordId));
+}
+
+bool BTreeIndex::removeEntry(const std::string &key,
+                             const RecordId &recordId) {
+  return removeEncoded(encodeEntry(encodeKey(key), recordId));
+}
+
+std::vector<RecordId> BTreeIndex::lookup(const std::int64_t key) const {
+  return lookupEncoded(encodeKey(key));
+}
+
+std::vector<RecordId> BTreeIndex::lookup(const std::string &key) const {
+  return lookupEncoded(encodeKey(key));
+}
+
+void BTreeIndex::bulkLoad(
+    const std::vector<std::pair<std::int64_t, RecordId>> &sorted) {
+  std::vector<std::string> encoded;
+  encoded.reserve(sorted.size());
+  for (const std::pair<std::int64_t, RecordId> &entry : sorted) {
+    encoded.push_back(encodeEntry(encodeKey(entry.first), entry.second));
+  }
+  bulkLoadEncoded(encoded);
+}
+
+void BTreeIndex::bulkLoad(
+    const std::vector<std::pair<std::string, RecordId>> &sorted) {
+  std::vector<std::string> encoded;
+  encoded.reserve(sorted.size());
+  for (const std::pair<std::string, RecordId> &entry : sorted) {
+    encoded.push_back(encodeEntry(encodeKey(entry.first), entry.second));
+  }
+  bulkLoadEncoded(encoded);
+}
+
+BTreeIterator BTreeIndex::begin() const {
+  return seek(std::string(entrySize, '\0'));
+}
+
+BTreeIterator BTreeIndex::lowerBound(const std::int64_t key) const {
+  return seek(encodeKey(key) + std::string(RECORD_ID_SIZE, '\0'));
+}
+
+BTreeIterator BTreeIndex::lowerBound(const std::string &key) const {
+  return seek(encodeKey(key) + std::string(RECORD_ID_SIZE, '\0'));
+}
+
+BTreeIterator BTreeIndex::upperBound(const std::int64_t key) const {
+  // Past every record ID of the key
+  return seek(encodeKey(key) + std::string(RECORD_ID_SIZE, '\xff'));
+}
+
+BTreeIterator BTreeIndex::upperBound(const std::string &key) const {
+  return seek(encodeKey(key) + std::string(RECORD_ID_SIZE, '\xff'));
+}
+
+std::string BTreeIndex::encodeKey(const std::int64_t key) const {
+  if (keyType_ != IndexKeyType::INTEGER) {
+    throw BadIndexInfoException("integer key for an index of strings");
+  }
+  // Flipping the sign bit orders negative keys first
+  const std::uint64_t value =
+      static_cast<std::uint64_t>(key) ^ (std::uint64_t(1) << 63);
+  std::string encoded(8, '\0');
+  for (int i = 0; i < 8; i++) {
+    encoded[i] = static_cast<char>(value >> (56 - 8 * i));
+  }
+  return encoded;
+}
+
+std::string BTreeIndex::encodeKey(const std::string &key) const {
+  if (keyType_ != IndexKeyType::STRING) {
+    throw BadIndexInfoException("string key for an index of integers");
+  }
+  if (key.size() > keyLength_) {
+    throw BadIndexInfoException("key longer than " +
+                                std::to_string(keyLength_) + " bytes");
+  }
+  std::string encoded(key);
+  encoded.resize(keyLength_, '\0');
+  return encoded;
+}
+
+std::string BTreeIndex::encodeEntry(const std::string &key,
+                                    const RecordId &recordId) const {
+  std::string entry(key);
+  entry.push_back(static_cast<char>(recordId.page_number >> 24));
+  entry.push_back(static_cast<char>(recordId.page_number >> 16));
+  entry.push_back(static_cast<char>(recordId.page_number >> 8));
+  entry.push_back(static_cast<char>(recordId.page_number));
+  entry.push_back(static_cast<char>(recordId.slot_number >> 8));
+  entry.push_back(static_cast<char>(recordId.slot_number));
+  return entry;
+}
+
+bool BTreeIndex::insertEncoded(const std::string &entry) {
+  std::string splitEntry;
+  PageId splitNo = Page::INVALID_NUMBER;
+  if (!insertInto(root, entry, splitEntry, splitNo)) return false;
+
+  if (splitNo != Page::INVALID_NUMBER) {
+    // The root was split; grow the tree by a level
+    PageGuard newRoot = bufMgr->allocPage(*file);
+    char *data = nodeData(*newRoot);
+    writeNode(data, NodeHeader{static_cast<std::uint16_t>(height_), 1,
+                               Page::INVALID_NUMBER});
+    setInnerChild(data, 0, entrySize, root);
+    std::memcpy(data + innerKeyOffset(0, entrySize), splitEntry.data(),
+                entrySize);
+    setInnerChild(data, 1, entrySize, splitNo);
+    newRoot.markDirty();
+    root = newRoot->page_number();
+    height_++;
+  }
+  entries++;
+  writeMeta();
+  return true;
+}
+
+bool BTreeIndex::removeEncoded(const std::string &entry) {
+  PageGuard leaf = findLeaf(entry);
+  char *data = nodeData(*leaf);
+  NodeHeader header = readNode(data);
+  const std::uint32_t position =
+      leafLowerBound(data, header.count, entry, entrySize);
+  if (position == header.count ||
+      std::memcmp(leafEntry(data, position, entrySize), entry.data(),
+                  entrySize) != 0) {
+    return false;
+  }
+
+  std::memmove(leafEntry(data, position, entrySize),
+               leafEntry(data, position + 1, entrySize),
+               std::size_t(header.count - position - 1) * entrySize);
+  header.count--;
+  writeNode(data, header);
+  leaf.markDirty();
+  leaf.release();
+  entries--;
+  writeMeta();
+  return true;
+}
+
+bool BTreeIndex::insertInto(const PageId nodeNo, const std::string &entry,
+                            std::string &splitEntry, PageId &splitNo) {
+  PageGuard node = bufMgr->readPage(*file, nodeNo);
+  char *data = nodeData(*node);
+  NodeHeader header = readNode(data);
+
+  if (header.level == 0) {
+    const std::uint32_t position =
+        leafLowerBound(data, header.count, entry, entrySize);
+    if (position < header.count &&
+        std::memcmp(leafEntry(data, position, entrySize), entry.data(),
+                    entrySize) == 0) {
+      return false;
+    }
+
+    if (header.count < leafCapacity) {
+      std::memmove(leafEntry(data, position + 1, entrySize),
+                   leafEntry(data, position, entrySize),
+                   std::size_t(header.count - position) * entrySize);
+      std::memcpy(leafEntry(data, position, entrySize), entry.data(),
+                  entrySize);
+      header.count++;
+      writeNode(data, header);
+      node.markDirty();
+      return true;
+    }
+
+    // Split the full leaf, moving the upper half to a new right sibling
+    std::string all(leafEntry(data, 0, entrySize),
+                    std::size_t(header.count) * entrySize);
+    all.insert(std::size_t(position) * entrySize, entry);
+    const std::uint32_t total = header.count + 1;
+    const std::uint32_t leftCount = total / 2;
+
+    PageGuard right = bufMgr->allocPage(*file);
+    char *rightData = nodeData(*right);
+    writeNode(rightData,
+              NodeHeader{0, static_cast<std::uint16_t>(total - leftCount),
+                         header.next});
+    std::memcpy(leafEntry(rightData, 0, entrySize),
+                all.data() + std::size_t(leftCount) * entrySize,
+                std::size_t(total - leftCount) * entrySize);
+    right.markDirty();
+
+    std::memcpy(leafEntry(data, 0, entrySize), all.data(),
+                std::size_t(leftCount) * entrySize);
+    writeNode(data, NodeHeader{0, static_cast<std::uint16_t>(leftCount),
+                               right->page_number()});
+    node.markDirty();
+
+    splitEntry.assign(all, std::size_t(leftCount) * entrySize, entrySize);
+    splitNo = right->page_number();
+    return true;
+  }
+
+  // Only the path being split is kept pinned while the subtree changes
+  const std::uint32_t childIndex =
+      innerChildIndex(data, header.count, entry, entrySize);
+  const PageId childNo = innerChild(data, childIndex, entrySize);
+  node.release();
+  std::string childSplitEntry;
+  PageId childSplitNo = Page::INVALID_NUMBER;
+  if (!insertInto(childNo, entry, childSplitEntry, childSplitNo)) {
+    return false;
+  }
+  if (childSplitNo == Page::INVALID_NUMBER) return true;
+
+  node = bufMgr->readPage(*file, nodeNo);
+  data = nodeData(*node);
+  node.markDirty();
+  const std::size_t pairSize = entrySize + sizeof(PageId);
+  if (header.count < innerCapacity) {
+    char *pair = data + innerKeyOffset(childIndex, entrySize);
+    std::memmove(pair + pairSize, pair,
+                 std::size_t(header.count - childIndex) * pairSize);
+    std::memcpy(pair, childSplitEntry.data(), entrySize);
+    setInnerChild(data, childIndex + 1, entrySize, childSplitNo);
+    header.count++;
+    writeNode(data, header);
+    return true;
+  }
+
+  // Split the full inner node; the middle key moves up to the parent
+  std::string keys;
+  std::vector<PageId> children;
+  for (std::uint32_t i = 0; i < header.count; i++) {
+    keys.append(data + innerKeyOffset(i, entrySize), entrySize);
+  }
+  for (std::uint32_t i = 0; i <= header.count; i++) {
+    children.push_back(innerChild(data, i, entrySize));
+  }
+  keys.insert(std::size_t(childIndex) * entrySize, childSplitEntry);
+  children.insert(children.begin() + childIndex + 1, childSplitNo);
+  const std::uint32_t total = header.count + 1;
+  const std::uint32_t middle = total / 2;
+
+  PageGuard right = bufMgr->allocPage(*file);
+  char *rightData = nodeData(*right);
+  writeNode(rightData,
+            NodeHeader{header.level,
+                       static_cast<std::uint16_t>(total - middle - 1),
+                       Page::INVALID_NUMBER});
+  for (std::uint32_t i = middle + 1; i <= total; i++) {
+    setInnerChild(rightData, i - middle - 1, entrySize, children[i]);
+  }
+  for (std::uint32_t i = middle + 1; i < total; i++) {
+    std::memcpy(rightData + innerKeyOffset(i - middle - 1, entrySize),
+                keys.data() + std::size_t(i) * entrySize, entrySize);
+  }
+  right.markDirty();
+
+  writeNode(data, NodeHeader{header.level, static_cast<std::uint16_t>(middle),
+                             Page::INVALID_NUMBER});
+  for (std::uint32_t i = 0; i <= middle; i++) {
+    setInnerChild(data, i, entrySize, children[i]);
+  }
+  for (std::uint32_t i = 0; i < middle; i++) {
+    std::memcpy(data + innerKeyOffset(i, entrySize),
+                keys.data() + std::size_t(i) * entrySize, entrySize);
+  }
+
+  splitEntry.assign(keys, std::size_t(middle) * entrySize, entrySize);
+  splitNo = right->page_number();
+  return true;
+}
+
+PageGuard BTreeIndex::findLeaf(const std::string &entry) const {
+  PageGuard node = bufMgr->readPage(*file, root);
+  while (true) {
+    const char *data = nodeData(*node);
+    const NodeHeader header = readNode(data);
+    if (header.level == 0) return node;
+    const PageId childNo = innerChild(
+        data, innerChildIndex(data, header.count, entry, entrySize),
+        entrySize);
+    node.release();
+    node = bufMgr->readPage(*file, childNo);
+  }
+}
+
+BTreeIterator BTreeIndex::seek(const std::string &entry) const {
+  PageGuard leaf = findLeaf(entry);
+  const char *data = nodeData(*leaf);
+  const std::uint32_t position =
+      leafLowerBound(data, readNode(data).count, entry, entrySize);
+  return BTreeIterator(bufMgr, file, keyLength_, std::move(leaf), position);
+}
+
+std::vector<RecordId> BTreeIndex::lookupEncoded(const std::string &key) const {
+  std::vector<RecordId> recordIds;
+  for (BTreeIterator iter = seek(key + std::string(RECORD_ID_SIZE, '\0'));
+       iter != end() && std::memcmp(iter.entry(), key.data(), keyLength_) == 0;
+       ++iter) {
+    recordIds.push_back(*iter);
+  }
+  return recordIds;
+}
+
+void BTreeIndex::bulkLoadEncoded(std::vector<std::string> &sorted) {
+  if (entries != 0) {
+    throw BadIndexInfoException("bulk load into an index that is not empty");
+  }
+  for (std::size_t i = 1; i < sorted.size(); i++) {
+    if (sorted[i].compare(0, keyLength_, sorted[i - 1], 0, keyLength_) < 0) {
+      throw BadIndexInfoException("bulk load input is not sorted by key");
+    }
+  }
+  // Only entries with the same key can still be out of order
+  if (!std::is_sorted(sorted.begin(), sorted.end())) {
+    std::sort(sorted.begin(), sorted.end());
+  }
+  sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+  if (sorted.empty()) return;
+
+  // Fill the leaves from left to right, starting with the empty root, and
+  // remember the first entry of each for the level above
+  std::vector<std::pair<std::string, PageId>> level;
+  const std::size_t perLeaf =
+      std::max<std::size_t>(1, leafCapacity * BULK_LOAD_FILL / 100);
+  PageGuard previous;
+  for (std::size_t first = 0; first < sorted.size(); first += perLeaf) {
+    PageGuard leaf = first == 0 ? bufMgr->readPage(*file, root)
+                                : bufMgr->allocPage(*file);
+    const std::size_t count = std::min(perLeaf, sorted.size() - first);
+    char *data = nodeData(*leaf);
+    writeNode(data, NodeHeader{0, static_cast<std::uint16_t>(count),
+                               Page::INVALID_NUMBER});
+    for (std::size_t i = 0; i < count; i++) {
+      std::memcpy(leafEntry(data, i, entrySize), sorted[first + i].data(),
+                  entrySize);
+    }
+    leaf.markDirty();
+    if (previous) {
+      char *previousData = nodeData(*previous);
+      NodeHeader header = readNode(previousData);
+      header.next = leaf->page_number();
+      writeNode(previousData, header);
+    }
+    level.push_back(std::make_pair(sorted[first], leaf->page_number()));
+    previous = std::move(leaf);
+  }
+  previous.release();
+
+  // Then each level of inner nodes from the one below, up to a single root
+  const std::size_t perInner =
+      std::max<std::size_t>(2, innerCapacity * BULK_LOAD_FILL / 100 + 1);
+  std::uint16_t nodeLevel = 0;
+  while (level.size() > 1) {
+    nodeLevel++;
+    std::vector<std::pair<std::string, PageId>> above;
+    for (std::size_t first = 0; first < level.size(); first += perInner) {
+      const std::size_t children = std::min(perInner, level.size() - first);
+      PageGuard node = bufMgr->allocPage(*file);
+      char *data = nodeData(*node);
+      writeNode(data,
+                NodeHeader{nodeLevel, static_cast<std::uint16_t>(children - 1),
+                           Page::INVALID_NUMBER});
+      setInnerChild(data, 0, entrySize, level[first].second);
+      for (std::size_t i = 1; i < children; i++) {
+        std::memcpy(data + innerKeyOffset(i - 1, entrySize),
+                    level[first + i].first.data(), entrySize);
+        setInnerChild(data, i, entrySize, level[first + i].second);
+      }
+      node.markDirty();
+      above.push_back(std::make_pair(level[first].first, node->page_number()));
+    }
+    level.swap(above);
+  }
+
+  root = level.front().second;
+  height_ = nodeLevel + 1;
+  entries = sorted.size();
+  writeMeta();
+}
+
+void BTreeIndex::writeMeta() {
+  IndexMeta meta = {};
+  std::memcpy(meta.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+  meta.keyType = static_cast<std::uint8_t>(keyType_);
+  meta.keyLength = keyLength_;
+  meta.root = root;
+  meta.height = height_;
+  meta.entries = entries;
+  PageGuard page = bufMgr->readPage(*file, META_PAGE);
+  std::memcpy(nodeData(*page), &meta, sizeof(meta));
+  page.markDirty();
+}
+
+}  // namespace badgerdb
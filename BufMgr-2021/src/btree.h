@@ -0,0 +1,405 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "buffer.h"
+#include "file.h"
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Type of the keys of a B+-tree index
+ */
+enum class IndexKeyType : std::uint8_t {
+  /**
+   * Signed 64-bit integers
+   */
+  INTEGER = 1,
+
+  /**
+   * Byte strings up to a fixed length, ordered bytewise.  Shorter keys are
+   * padded with NUL bytes, so keys should not end in one.
+   */
+  STRING = 2
+};
+
+/**
+ * @brief Iterator over the entries of a B+-tree index in key order
+ *
+ * Keeps the leaf it is on pinned in the buffer manager.  Changing the index
+ * invalidates its iterators.
+ */
+class BTreeIterator {
+ public:
+  /**
+   * Constructs an iterator past the last entry.
+   */
+  BTreeIterator();
+
+  BTreeIterator(BTreeIterator&& other) = default;
+  BTreeIterator& operator=(BTreeIterator&& rhs) = default;
+
+  /**
+   * Returns the record ID of the current entry.
+   */
+  RecordId operator*() const;
+
+  /**
+   * Returns the key of the current entry of an INTEGER index.
+   */
+  std::int64_t intKey() const;
+
+  /**
+   * Returns the key of the current entry of a STRING index, without its
+   * padding.
+   */
+  std::string stringKey() const;
+
+  /**
+   * Advances the iterator to the next entry.
+   */
+  BTreeIterator& operator++();
+
+  /**
+   * Returns true if this iterator is at the same entry as the given one.
+   *
+   * @param rhs   Iterator to compare against.
+   * @return    True if other iterator is equal to this one.
+   */
+  bool operator==(const BTreeIterator& rhs) const {
+    return leafNo == rhs.leafNo && position == rhs.position;
+  }
+
+  /**
+   * Returns true if this iterator is at another entry than the given one.
+   *
+   * @param rhs   Iterator to compare against.
+   * @return    True if other iterator is not equal to this one.
+   */
+  bool operator!=(const BTreeIterator& rhs) const { return !(*this == rhs); }
+
+ private:
+  friend class BTreeIndex;
+
+  /**
+   * Constructs an iterator at the given entry of a pinned leaf and moves it
+   * on to the next leaf with entries if the position is past the end.
+   */
+  BTreeIterator(BufMgr* bufMgr, File* file, const std::uint32_t keyLength,
+                PageGuard&& leaf, const std::uint32_t position);
+
+  /**
+   * Moves on to the next leaf with entries while the position is past the
+   * last entry of the current leaf.
+   */
+  void settle();
+
+  /**
+   * Returns the current entry.
+   */
+  const char* entry() const;
+
+  /**
+   * Buffer manager and index file the leaves are read through
+   */
+  BufMgr* bufMgr;
+  File* file;
+
+  /**
+   * Length of the keys of the index in bytes
+   */
+  std::uint32_t keyLength;
+
+  /**
+   * Pin on the current leaf; empty past the last entry
+   */
+  PageGuard leaf;
+
+  /**
+   * Page number of the current leaf, or Page::INVALID_NUMBER past the last
+   * entry
+   */
+  PageId leafNo;
+
+  /**
+   * Position of the current entry in the leaf
+   */
+  std::uint32_t position;
+};
+
+/**
+ * @brief B+-tree index mapping keys to record IDs, stored in a file of its
+ * own and read through the buffer manager
+ *
+ * Point lookups and range scans read one node per level of the tree instead
+ * of every page of the indexed file.  The first page of the file holds the
+ * key type, the root and the height of the tree; every other page is a node.
+ * Leaves are chained in key order for range scans.
+ *
+ * A key may map to several record IDs; an entry is the pair of the two, and
+ * entries are ordered by key and then by record ID.  Removing entries does
+ * not merge nodes, whose space is reused by later inserts.  The changes are
+ * made to pages in the buffer pool and written back like any other pages,
+ * e.g. by BufMgr::flushFile().  An index is not safe to use from several
+ * threads at once.
+ */
+class BTreeIndex {
+ public:
+  /**
+   * Creates an empty index in an empty file.
+   *
+   * @param bufMgr     Buffer manager the nodes are read through
+   * @param file       Empty file to hold the index
+   * @param keyType    Type of the keys
+   * @param keyLength  Maximum length of STRING keys in bytes; ignored for
+   *                   INTEGER keys
+   * @return  The index
+   * @throws  BadIndexInfoException if the file is not empty or keys of the
+   * given length would not fit four to a node
+   */
+  static BTreeIndex create(BufMgr& bufMgr, File& file,
+                           const IndexKeyType keyType,
+                           const std::uint32_t keyLength = 0);
+
+  /**
+   * Opens the index held by a file.
+   *
+   * @param bufMgr  Buffer manager the nodes are read through
+   * @param file    File holding the index
+   * @return  The index
+   * @throws  BadIndexInfoException if the file does not hold an index
+   */
+  static BTreeIndex open(BufMgr& bufMgr, File& file);
+
+  /**
+   * Returns the type of the keys.
+   */
+  IndexKeyType keyType() const { return keyType_; }
+
+  /**
+   * Returns the length of the keys in bytes.
+   */
+  std::uint32_t keyLength() const { return keyLength_; }
+
+  /**
+   * Returns the number of entries.
+   */
+  std::uint64_t size() const { return entries; }
+
+  /**
+   * Returns the number of levels of the tree, which is the number of nodes a
+   * lookup reads.
+   */
+  std::uint32_t height() const { return height_; }
+
+  /**
+   * Adds an entry.
+   *
+   * @param key       Key of the entry
+   * @param recordId  Record ID the key maps to
+   * @return  False if the entry was already in the index
+   * @throws  BadIndexInfoException if the key does not match the key type
+   */
+  bool insertEntry(const std::int64_t key, const RecordId& recordId);
+  bool insertEntry(const std::string& key, const RecordId& recordId);
+
+  /**
+   * Removes an entry.
+   *
+   * @param key       Key of the entry
+   * @param recordId  Record ID the key maps to
+   * @return  False if the entry was not in the index
+   * @throws  BadIndexInfoException if the key does not match the key type
+   */
+  bool removeEntry(const std::int64_t key, const RecordId& recordId);
+  bool removeEntry(const std::string& key, const RecordId& recordId);
+
+  /**
+   * Returns the record IDs a key maps to, in order.
+   *
+   * @param key  Key to look up
+   * @return  The record IDs
+   * @throws  BadIndexInfoException if the key does not match the key type
+   */
+  std::vector<RecordId> lookup(const std::int64_t key) const;
+  std::vector<RecordId> lookup(const std::string& key) const;
+
+  /**
+   * Fills an empty index from entries sorted by key.  Builds the tree bottom
+   * up, leaving some room in every node for later inserts, which is much
+   * faster than inserting the entries one by one.  Entries with the same key
+   * may come in any order, and duplicate entries are added once.
+   *
+   * @param sorted  Entries sorted by key
+   * @throws  BadIndexInfoException if the index is not empty, the entries are
+   * not sorted or a key does not match the key type
+   */
+  void bulkLoad(const std::vector<std::pair<std::int64_t, RecordId>>& sorted);
+  void bulkLoad(const std::vector<std::pair<std::string, RecordId>>& sorted);
+
+  /**
+   * Returns an iterator at the first entry.
+   */
+  BTreeIterator begin() const;
+
+  /**
+   * Returns an iterator past the last entry.
+   */
+  BTreeIterator end() const { return BTreeIterator(); }
+
+  /**
+   * Returns an iterator at the first entry with a key not less than the
+   * given one.  Together with upperBound() it delimits a range scan.
+   *
+   * @param key  Lower bound of the keys
+   * @return  The iterator
+   * @throws  BadIndexInfoException if the key does not match the key type
+   */
+  BTreeIterator lowerBound(const std::int64_t key) const;
+  BTreeIterator lowerBound(const std::string& key) const;
+
+  /**
+   * Returns an iterator at the first entry with a key greater than the given
+   * one.
+   *
+   * @param key  Upper bound of the keys
+   * @return  The iterator
+   * @throws  BadIndexInfoException if the key does not match the key type
+   */
+  BTreeIterator upperBound(const std::int64_t key) const;
+  BTreeIterator upperBound(const std::string& key) const;
+
+ private:
+  friend class BTreeIterator;
+
+  /**
+   * Number of the page holding the key type, root and height
+   */
+  static const PageId META_PAGE = 1;
+
+  /**
+   * Bytes of an entry following its key: the page and slot number of the
+   * record ID, most significant byte first
+   */
+  static const std::uint32_t RECORD_ID_SIZE = 6;
+
+  /**
+   * Constructs an index over the given file.  See create() and open().
+   */
+  BTreeIndex(BufMgr& bufMgr, File& file, const IndexKeyType keyType,
+             const std::uint32_t keyLength);
+
+  /**
+   * Returns the node stored in a page.
+   */
+  static char* nodeData(Page& page) { return page.data_; }
+  static const char* nodeData(const Page& page) { return page.data_; }
+
+  /**
+   * Encodes a key so that encoded keys compare like the keys themselves.
+   *
+   * @throws  BadIndexInfoException if the key does not match the key type
+   */
+  std::string encodeKey(const std::int64_t key) const;
+  std::string encodeKey(const std::string& key) const;
+
+  /**
+   * Returns the entry of a key and a record ID.
+   */
+  std::string encodeEntry(const std::string& key,
+                          const RecordId& recordId) const;
+
+  /**
+   * Adds or removes an encoded entry.
+   */
+  bool insertEncoded(const std::string& entry);
+  bool removeEncoded(const std::string& entry);
+
+  /**
+   * Adds an encoded entry to the subtree of the given node.  If the node
+   * had to be split, returns the first entry of the new right node and its
+   * page number.
+   *
+   * @return  False if the entry was already in the index
+   */
+  bool insertInto(const PageId nodeNo, const std::string& entry,
+                  std::string& splitEntry, PageId& splitNo);
+
+  /**
+   * Pins the leaf that holds or would hold an encoded entry.
+   */
+  PageGuard findLeaf(const std::string& entry) const;
+
+  /**
+   * Returns an iterator at the first entry not less than an encoded entry.
+   */
+  BTreeIterator seek(const std::string& entry) const;
+
+  /**
+   * Returns the record IDs of the entries with an encoded key.
+   */
+  std::vector<RecordId> lookupEncoded(const std::string& key) const;
+
+  /**
+   * Builds the tree from encoded entries sorted by key.
+   */
+  void bulkLoadEncoded(std::vector<std::string>& entries);
+
+  /**
+   * Writes the root, height and number of entries to the first page.
+   */
+  void writeMeta();
+
+  /**
+   * Buffer manager the nodes are read through, and the index file
+   */
+  BufMgr* bufMgr;
+  File* file;
+
+  /**
+   * Type and length of the keys
+   */
+  IndexKeyType keyType_;
+  std::uint32_t keyLength_;
+
+  /**
+   * Length of an entry: its key followed by its record ID
+   */
+  std::uint32_t entrySize;
+
+  /**
+   * Maximum number of entries in a leaf and of keys in an inner node
+   */
+  std::uint32_t leafCapacity;
+  std::uint32_t innerCapacity;
+
+  /**
+   * Page number of the root node
+   */
+  PageId root;
+
+  /**
+   * Number of levels of the tree
+   */
+  std::uint32_t height_;
+
+  /**
+   * Number of entries
+   */
+  std::uint64_t entries;
+};
+
+}  // namespace badgerdb
@@ -8,85 +8,300 @@
 
 #include "bufHashTbl.h"
 
-#include <functional>
 #include <iostream>
 #include <memory>
 
 #include "buffer.h"
 #include "exceptions/hash_already_present_exception.h"
 #include "exceptions/hash_not_found_exception.h"
-#include "exceptions/hash_table_exception.h"
 
 namespace badgerdb {
 
-int BufHashTbl::hash(const File& file, const PageId pageNo) {
-  auto hash =
-      std::hash<std::string>{}(file.filename()) ^ std::hash<PageId>{}(pageNo);
-  return hash % HTSIZE;
+const PageId BufHashTbl::TOMBSTONE;
+const std::size_t BufHashTbl::REHASH_STEP;
+
+std::uint64_t BufHashTbl::hash(const FileId fileId, const PageId pageNo) {
+  // 64-bit finalizer of MurmurHash3 over the packed (file id, page) key
+  std::uint64_t hash = (static_cast<std::uint64_t>(fileId) << 32) | pageNo;
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+std::size_t BufHashTbl::partitionSize(const int htSize,
+                                      const std::size_t numPartitions) {
+  // Give every partition at least twice its share of the entries so that
+  // probe sequences stay short, rounded up to a power of two for masking
+  const std::size_t share = htSize / numPartitions + 1;
+  std::size_t size = 1;
+  while (size < 2 * share) size <<= 1;
+  return size;
+}
+
+BufHashTbl::BufHashTbl(int htSize, int numPartitions)
+    : HTSIZE(htSize), partitions(numPartitions > 0 ? numPartitions : 1) {
+  const std::size_t size = partitionSize(HTSIZE, partitions.size());
+  for (Partition& partition : partitions) {
+    partition.ht.assign(size,
+                        hashBucket{File::INVALID_ID, Page::INVALID_NUMBER, 0});
+    partition.used = 0;
+    partition.drained = 0;
+    partition.readers.store(0, std::memory_order_relaxed);
+    publish(partition);
+  }
+}
+
+void BufHashTbl::reserve(const int htSize) {
+  const std::size_t size = partitionSize(htSize, partitions.size());
+  for (Partition& part : partitions) {
+    std::lock_guard<std::mutex> partitionGuard(part.latch);
+    if (part.ht.size() < size) startRehash(part, size);
+  }
+  if (htSize > HTSIZE) HTSIZE = htSize;
+}
+
+void BufHashTbl::publish(Partition& part) {
+  // Both tables are published at once, so a lookup never applies a mask to a
+  // table other than the one it belongs to
+  std::unique_ptr<Partition::Tables> tables(new Partition::Tables{
+      part.ht.data(), part.ht.size() - 1,
+      part.draining.empty() ? nullptr : part.draining.data(),
+      part.draining.empty() ? 0 : part.draining.size() - 1});
+  part.tables.store(tables.get(), std::memory_order_seq_cst);
+  part.published.push_back(std::move(tables));
+  reclaim(part);
+}
+
+void BufHashTbl::reclaim(Partition& part) {
+  if (part.published.size() == 1 && part.retired.empty()) return;
+  // A lookup counts itself before it loads the tables, so one that is not
+  // counted yet will load the current ones
+  if (part.readers.load(std::memory_order_seq_cst) != 0) return;
+  part.published.erase(part.published.begin(), part.published.end() - 1);
+  part.retired.clear();
 }
 
-BufHashTbl::BufHashTbl(int htSize) : HTSIZE(htSize), ht(htSize) {
-  // allocate an array of pointers to hashBuckets
+void BufHashTbl::startRehash(Partition& part, const std::size_t size) {
+  rehashStep(part, part.draining.size());
+
+  // Moving the vector keeps its buckets where lookups without the latch may
+  // be probing them
+  part.draining = std::move(part.ht);
+  part.ht.assign(size, hashBucket{File::INVALID_ID, Page::INVALID_NUMBER, 0});
+  part.drained = 0;
+  publish(part);
+}
+
+void BufHashTbl::rehashStep(Partition& part, std::size_t count) {
+  if (part.draining.empty()) return;
+  const std::size_t mask = part.ht.size() - 1;
+
+  for (; count > 0 && part.drained < part.draining.size();
+       count--, part.drained++) {
+    // Empty buckets and tombstones have no file
+    const hashBucket& tmpBuc = part.draining[part.drained];
+    if (tmpBuc.fileId == File::INVALID_ID) continue;
+    std::size_t index = hash(tmpBuc.fileId, tmpBuc.pageNo) & mask;
+    while (part.ht[index].pageNo != Page::INVALID_NUMBER)
+      index = (index + 1) & mask;
+    part.ht[index] = tmpBuc;
+  }
+
+  if (part.drained == part.draining.size()) {
+    part.retired.push_back(std::move(part.draining));
+    part.draining.clear();
+    part.drained = 0;
+    publish(part);
+  } else {
+    reclaim(part);
+  }
 }
 
 void BufHashTbl::insert(const File& file, const PageId pageNo,
                         const FrameId frameNo) {
-  int index = hash(file, pageNo);
-
-  std::shared_ptr<hashBucket> tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-      throw HashAlreadyPresentException(tmpBuc->file.filename(), tmpBuc->pageNo,
-                                        tmpBuc->frameNo);
-    tmpBuc = tmpBuc->next;
+  const std::uint64_t hashValue = hash(file.id(), pageNo);
+  Partition& part = partition(hashValue);
+
+  // Partitions are sized for an even spread of pages; one that receives more
+  // than its share grows instead of letting its probe sequences get long
+  if ((part.used + 1) * 4 > part.ht.size() * 3) {
+    startRehash(part, part.ht.size() * 2);
+  }
+
+  if (!part.draining.empty()) {
+    // Entries still waiting to be moved count as present
+    const std::size_t drainingMask = part.draining.size() - 1;
+    for (std::size_t index = hashValue & drainingMask;
+         part.draining[index].pageNo != Page::INVALID_NUMBER;
+         index = (index + 1) & drainingMask) {
+      const hashBucket& tmpBuc = part.draining[index];
+      if (tmpBuc.fileId == file.id() && tmpBuc.pageNo == pageNo)
+        throw HashAlreadyPresentException(file.filename(), tmpBuc.pageNo,
+                                          tmpBuc.frameNo);
+    }
   }
 
-  tmpBuc = std::make_shared<hashBucket>();
-  if (!tmpBuc) throw HashTableException();
+  const std::size_t mask = part.ht.size() - 1;
+  std::size_t index = hashValue & mask;
+  while (part.ht[index].pageNo != Page::INVALID_NUMBER) {
+    const hashBucket& tmpBuc = part.ht[index];
+    if (tmpBuc.fileId == file.id() && tmpBuc.pageNo == pageNo)
+      throw HashAlreadyPresentException(file.filename(), tmpBuc.pageNo,
+                                        tmpBuc.frameNo);
+    index = (index + 1) & mask;
+  }
 
-  tmpBuc->file = file;
-  tmpBuc->pageNo = pageNo;
-  tmpBuc->frameNo = frameNo;
-  tmpBuc->next = ht[index];
-  ht[index] = tmpBuc;
+  part.ht[index] = hashBucket{file.id(), pageNo, frameNo};
+  ++part.used;
+  rehashStep(part, REHASH_STEP);
 }
 
 void BufHashTbl::lookup(const File& file, const PageId pageNo,
                         FrameId& frameNo) {
-  int index = hash(file, pageNo);
-  std::shared_ptr<hashBucket> tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo) {
-      frameNo = tmpBuc->frameNo;  // return frameNo by reference
-      return;
+  if (!tryLookup(file, pageNo, frameNo))
+    throw HashNotFoundException(file.filename(), pageNo);
+}
+
+bool BufHashTbl::tryLookup(const FileId fileId, const PageId pageNo,
+                           FrameId& frameNo) {
+  const std::uint64_t hashValue = hash(fileId, pageNo);
+  Partition& part = partition(hashValue);
+  const std::size_t mask = part.ht.size() - 1;
+
+  for (std::size_t index = hashValue & mask;
+       part.ht[index].pageNo != Page::INVALID_NUMBER;
+       index = (index + 1) & mask) {
+    const hashBucket& tmpBuc = part.ht[index];
+    if (tmpBuc.fileId == fileId && tmpBuc.pageNo == pageNo) {
+      frameNo = tmpBuc.frameNo;  // return frameNo by reference
+      return true;
+    }
+  }
+
+  // Not moved over yet
+  if (!part.draining.empty()) {
+    const std::size_t drainingMask = part.draining.size() - 1;
+    for (std::size_t index = hashValue & drainingMask;
+         part.draining[index].pageNo != Page::INVALID_NUMBER;
+         index = (index + 1) & drainingMask) {
+      const hashBucket& tmpBuc = part.draining[index];
+      if (tmpBuc.fileId == fileId && tmpBuc.pageNo == pageNo) {
+        frameNo = tmpBuc.frameNo;
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+namespace {
+
+/**
+ * Probes one table for an entry without the partition latch.
+ */
+bool probeOptimistic(const hashBucket* buckets, const std::size_t mask,
+                     const std::uint64_t hashValue, const FileId fileId,
+                     const PageId pageNo, FrameId& frameNo) {
+  // Entries shifted by a concurrent removal could keep a probe going, so stop
+  // after one pass over the table
+  std::size_t index = hashValue & mask;
+  for (std::size_t probes = 0; probes <= mask; probes++) {
+    const hashBucket& tmpBuc = buckets[index];
+    const PageId bucketPageNo = tmpBuc.pageNo.load(std::memory_order_relaxed);
+    if (bucketPageNo == Page::INVALID_NUMBER) return false;
+    if (bucketPageNo == pageNo &&
+        tmpBuc.fileId.load(std::memory_order_relaxed) == fileId) {
+      frameNo = tmpBuc.frameNo.load(std::memory_order_relaxed);
+      return true;
     }
-    tmpBuc = tmpBuc->next;
+    index = (index + 1) & mask;
   }
+  return false;
+}
+
+}  // namespace
 
-  throw HashNotFoundException(file.filename(), pageNo);
+bool BufHashTbl::tryLookupOptimistic(const FileId fileId, const PageId pageNo,
+                                     FrameId& frameNo) {
+  const std::uint64_t hashValue = hash(fileId, pageNo);
+  Partition& part = partition(hashValue);
+  // Keeps the tables from being reclaimed while they are probed
+  part.readers.fetch_add(1, std::memory_order_seq_cst);
+  const Partition::Tables* tables =
+      part.tables.load(std::memory_order_seq_cst);
+  const bool found =
+      probeOptimistic(tables->buckets, tables->mask, hashValue, fileId,
+                      pageNo, frameNo) ||
+      (tables->drainingBuckets != nullptr &&
+       probeOptimistic(tables->drainingBuckets, tables->drainingMask,
+                       hashValue, fileId, pageNo, frameNo));
+  part.readers.fetch_sub(1, std::memory_order_release);
+  return found;
 }
 
 void BufHashTbl::remove(const File& file, const PageId pageNo) {
-  int index = hash(file, pageNo);
-  std::shared_ptr<hashBucket> tmpBuc = ht[index];
-  std::shared_ptr<hashBucket> prevBuc;
-
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo) {
-      if (prevBuc)
-        prevBuc->next = tmpBuc->next;
-      else
-        ht[index] = tmpBuc->next;
-
-      tmpBuc.reset();
-      return;
-    } else {
-      prevBuc = tmpBuc;
-      tmpBuc = tmpBuc->next;
+  if (!tryRemove(file, pageNo))
+    throw HashNotFoundException(file.filename(), pageNo);
+}
+
+bool BufHashTbl::tryRemove(const FileId fileId, const PageId pageNo) {
+  const std::uint64_t hashValue = hash(fileId, pageNo);
+  Partition& part = partition(hashValue);
+
+  // An entry that has not been moved yet only lives in the draining table;
+  // one that has been moved is in both
+  bool found = false;
+  if (!part.draining.empty()) {
+    const std::size_t drainingMask = part.draining.size() - 1;
+    for (std::size_t index = hashValue & drainingMask;
+         part.draining[index].pageNo != Page::INVALID_NUMBER;
+         index = (index + 1) & drainingMask) {
+      if (part.draining[index].fileId == fileId &&
+          part.draining[index].pageNo == pageNo) {
+        part.draining[index] = hashBucket{File::INVALID_ID, TOMBSTONE, 0};
+        found = true;
+        break;
+      }
+    }
+  }
+  if (removeFrom(part.ht, hashValue, fileId, pageNo)) found = true;
+  if (!found) return false;
+
+  --part.used;
+  rehashStep(part, REHASH_STEP);
+  return true;
+}
+
+bool BufHashTbl::removeFrom(std::vector<hashBucket>& ht,
+                            const std::uint64_t hashValue,
+                            const FileId fileId, const PageId pageNo) {
+  const std::size_t mask = ht.size() - 1;
+
+  std::size_t index = hashValue & mask;
+  while (ht[index].fileId != fileId || ht[index].pageNo != pageNo) {
+    if (ht[index].pageNo == Page::INVALID_NUMBER) return false;
+    index = (index + 1) & mask;
+  }
+
+  // Shift later entries of the probe sequence back into the hole unless
+  // their home bucket lies between the hole and their current position
+  std::size_t hole = index;
+  for (std::size_t next = (hole + 1) & mask;
+       ht[next].pageNo != Page::INVALID_NUMBER; next = (next + 1) & mask) {
+    const hashBucket& tmpBuc = ht[next];
+    const std::size_t home = hash(tmpBuc.fileId, tmpBuc.pageNo) & mask;
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      ht[hole] = tmpBuc;
+      hole = next;
     }
   }
 
-  throw HashNotFoundException(file.filename(), pageNo);
+  ht[hole] = hashBucket{File::INVALID_ID, Page::INVALID_NUMBER, 0};
+  return true;
 }
 
 }  // namespace badgerdb
@@ -8,6 +8,11 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include "file.h"
@@ -16,59 +21,276 @@ namespace badgerdb {
 
 /**
  * @brief Declarations for buffer pool hash table
+ *
+ * A bucket is one slot of the open-addressed table.  A slot whose pageNo is
+ * Page::INVALID_NUMBER is empty.  The fields are atomic so that
+ * BufHashTbl::tryLookupOptimistic() can read them without the latch; buckets
+ * are copied with relaxed accesses, which cost the same as plain ones.
  */
 struct hashBucket {
   /**
-   * pointer a file object (more on this below)
+   * identifier of the open file the page belongs to
    */
-  File file;
+  std::atomic<FileId> fileId;
 
   /**
    * page number within a file
    */
-  PageId pageNo;
+  std::atomic<PageId> pageNo;
 
   /**
    * frame number of page in the buffer pool
    */
-  FrameId frameNo;
+  std::atomic<FrameId> frameNo;
 
-  /**
-   * Next node in the hash table
-   */
-  std::shared_ptr<hashBucket> next;
+  hashBucket(const FileId fileId, const PageId pageNo, const FrameId frameNo)
+      : fileId(fileId), pageNo(pageNo), frameNo(frameNo) {}
+
+  hashBucket(const hashBucket& other)
+      : fileId(other.fileId.load(std::memory_order_relaxed)),
+        pageNo(other.pageNo.load(std::memory_order_relaxed)),
+        frameNo(other.frameNo.load(std::memory_order_relaxed)) {}
+
+  hashBucket& operator=(const hashBucket& other) {
+    fileId.store(other.fileId.load(std::memory_order_relaxed),
+                 std::memory_order_relaxed);
+    pageNo.store(other.pageNo.load(std::memory_order_relaxed),
+                 std::memory_order_relaxed);
+    frameNo.store(other.frameNo.load(std::memory_order_relaxed),
+                  std::memory_order_relaxed);
+    return *this;
+  }
 };
 
 /**
  * @brief Hash table class to keep track of pages in the buffer pool
  *
- * @warning This class is not threadsafe.
+ * Entries are kept in flat, linearly probed arrays of buckets, keyed by the
+ * identifier of the file and the page number.  Removal shifts the following
+ * entries of the probe sequence back, so no tombstones are left behind.
+ *
+ * A partition that runs out of room is rehashed into a table twice the size
+ * a few buckets at a time: every insert and remove moves some entries of the
+ * old table over, and lookups look in both tables until all have moved.  No
+ * single operation pays for rehashing the whole partition.
+ *
+ * The buckets are split into a number of partitions, each guarded by its own
+ * latch.  The insert, lookup and remove methods do not acquire any latch
+ * themselves; callers that share the table between threads hold the latch
+ * returned by latch() for the (file, pageNo) they operate on.
+ *
+ * @warning This class is not threadsafe unless callers hold partition latches.
  */
 class BufHashTbl {
  private:
+  /**
+   * @brief Independently latched slice of the hash table buckets
+   */
+  struct Partition {
+    /**
+     * Latch protecting the buckets of this partition
+     */
+    std::mutex latch;
+
+    /**
+     * Buckets of this partition; the size is a power of two
+     */
+    std::vector<hashBucket> ht;
+
+    /**
+     * Number of entries in the partition, including those that are still
+     * in draining
+     */
+    std::uint32_t used;
+
+    /**
+     * Table that is being rehashed into ht, or empty.  Entries before
+     * drained have been copied; removed entries are overwritten with
+     * tombstones so that they are neither found nor copied.
+     */
+    std::vector<hashBucket> draining;
+    std::size_t drained;
+
+    /**
+     * Tables as seen by lookups that do not take the latch
+     */
+    struct Tables {
+      const hashBucket* buckets;
+      std::size_t mask;
+      const hashBucket* drainingBuckets;
+      std::size_t drainingMask;
+    };
+
+    /**
+     * The current Tables, and the Tables published and tables drained since
+     * the partition was last seen without such lookups.  They are freed by
+     * reclaim() once no lookup can still be probing them.  Tables only ever
+     * double, so the drained tables hold fewer buckets than ht.
+     */
+    std::atomic<const Tables*> tables;
+    std::vector<std::unique_ptr<Tables>> published;
+    std::vector<std::vector<hashBucket>> retired;
+
+    /**
+     * Number of lookups without the latch probing the partition
+     */
+    std::atomic<std::uint32_t> readers;
+  };
+
+  /**
+   * Page number of the tombstones left in draining tables
+   */
+  static const PageId TOMBSTONE = static_cast<PageId>(-1);
+
+  /**
+   * Number of buckets of a draining table moved by every insert and remove
+   */
+  static const std::size_t REHASH_STEP = 4;
+
   /**
    *	Size of Hash Table
    */
   int HTSIZE;
+
   /**
-   * Actual Hash table object
+   * Partitions of the hash table
    */
-  std::vector<std::shared_ptr<hashBucket>> ht;
+  std::vector<Partition> partitions;
 
   /**
-   * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
+   * returns hash value computed using file and pageNo.  The partition is
+   * chosen from the upper half of the value and the bucket from the lower.
    *
-   * @param file   	File object
+   * @param fileId  Identifier of the file
    * @param pageNo  Page number in the file
    * @return  			Hash value.
    */
-  int hash(const File& file, const PageId pageNo);
+  static std::uint64_t hash(const FileId fileId, const PageId pageNo);
+
+  /**
+   * Returns the partition that a hash value belongs to
+   *
+   * @param hashValue Hash value of the entry
+   * @return  			Partition of the entry.
+   */
+  Partition& partition(const std::uint64_t hashValue) {
+    return partitions[(hashValue >> 32) % partitions.size()];
+  }
+
+  /**
+   * Returns the number of buckets each partition needs for htSize entries.
+   *
+   * @param htSize        Number of entries the table has to hold
+   * @param numPartitions Number of partitions
+   * @return  Buckets per partition, a power of two.
+   */
+  static std::size_t partitionSize(const int htSize,
+                                   const std::size_t numPartitions);
+
+  /**
+   * Replaces the buckets of a partition with an empty table of the given
+   * size and starts draining the old one into it.  A table that is still
+   * draining is finished first.  The caller holds the latch of the
+   * partition.
+   *
+   * @param part  Partition to rehash
+   * @param size  Number of buckets of the new table, a power of two
+   */
+  static void startRehash(Partition& part, const std::size_t size);
+
+  /**
+   * Moves the entries of up to count buckets of the draining table of a
+   * partition into its current table.  The caller holds the latch of the
+   * partition.
+   *
+   * @param part  Partition being rehashed
+   * @param count Number of buckets to move
+   */
+  static void rehashStep(Partition& part, const std::size_t count);
+
+  /**
+   * Deletes an entry from a table, shifting the entries after it back.
+   *
+   * @param ht        Table to delete from
+   * @param hashValue Hash value of the entry
+   * @param fileId    Identifier of the file
+   * @param pageNo    Page number in the file
+   * @return  True if the entry was in the table
+   */
+  static bool removeFrom(std::vector<hashBucket>& ht,
+                         const std::uint64_t hashValue, const FileId fileId,
+                         const PageId pageNo);
+
+  /**
+   * Makes the current buckets of a partition the ones that lookups without
+   * the latch probe.  The caller holds the latch of the partition.
+   *
+   * @param part  Partition whose buckets changed
+   */
+  static void publish(Partition& part);
+
+  /**
+   * Frees the Tables and drained tables of a partition that are no longer
+   * current if no lookup without the latch is probing the partition.  Such a
+   * lookup that starts later can only see the current Tables.  The caller
+   * holds the latch of the partition.
+   *
+   * @param part  Partition to reclaim the old tables of
+   */
+  static void reclaim(Partition& part);
 
  public:
   /**
    * Constructor of BufHashTbl class
+   *
+   * @param htSize      Maximum number of entries the table has to hold
+   * @param numPartitions Number of independently latched partitions
+   */
+  BufHashTbl(const int htSize, const int numPartitions = 1);  // constructor
+
+  /**
+   * Makes room for htSize entries.  Partitions with fewer buckets than the
+   * constructor would have given them start rehashing into larger tables;
+   * none ever shrinks.  Unlike the other methods this takes the partition
+   * latches itself, so the caller must not hold any of them.
+   *
+   * @param htSize  Number of entries the table has to hold
+   */
+  void reserve(const int htSize);
+
+  /**
+   * Returns the index of the partition that (fileId, pageNo) belongs to.
+   *
+   * @param fileId  Identifier of the file
+   * @param pageNo  Page number in the file
+   * @return  			Partition index, below the number of partitions.
+   */
+  std::size_t partitionOf(const FileId fileId, const PageId pageNo) const {
+    return (hash(fileId, pageNo) >> 32) % partitions.size();
+  }
+
+  /**
+   * Returns the latch guarding the partition that (file, pageNo) belongs to.
+   *
+   * @param file   	File object
+   * @param pageNo  Page number in the file
+   * @return  			Latch of the partition.
    */
-  BufHashTbl(const int htSize);  // constructor
+  std::mutex& latch(const File& file, const PageId pageNo) {
+    return latch(file.id(), pageNo);
+  }
+
+  /**
+   * Returns the latch guarding the partition that (fileId, pageNo) belongs
+   * to.
+   *
+   * @param fileId  Identifier of the file
+   * @param pageNo  Page number in the file
+   * @return  			Latch of the partition.
+   */
+  std::mutex& latch(const FileId fileId, const PageId pageNo) {
+    return partition(hash(fileId, pageNo)).latch;
+  }
 
   /**
    * Insert entry into hash table mapping (file, pageNo) to frameNo.
@@ -78,8 +300,6 @@ class BufHashTbl {
    * @param frameNo Frame number assigned to that page of the file
    * @throws  HashAlreadyPresentException	if the corresponding page
    * already exists in the hash table
-   * @throws  HashTableException (optional) if could not create a new bucket as
-   * running of memory
    */
   void insert(const File& file, const PageId pageNo, const FrameId frameNo);
 
@@ -95,6 +315,43 @@ class BufHashTbl {
    */
   void lookup(const File& file, const PageId pageNo, FrameId& frameNo);
 
+  /**
+   * Check if (file, pageNo) is currently in the buffer pool (ie. in
+   * the hash table) without throwing if it is not.
+   *
+   * @param file  	File object
+   * @param pageNo	Page number in the file
+   * @param frameNo Frame number reference, only set if the entry is found
+   * @return  True if the page entry is in the hash table
+   */
+  bool tryLookup(const File& file, const PageId pageNo, FrameId& frameNo) {
+    return tryLookup(file.id(), pageNo, frameNo);
+  }
+
+  /**
+   * Check if (fileId, pageNo) is currently in the buffer pool without
+   * throwing if it is not.
+   *
+   * @param fileId  Identifier of the file
+   * @param pageNo	Page number in the file
+   * @param frameNo Frame number reference, only set if the entry is found
+   * @return  True if the page entry is in the hash table
+   */
+  bool tryLookup(const FileId fileId, const PageId pageNo, FrameId& frameNo);
+
+  /**
+   * Looks up (fileId, pageNo) without the partition latch.  Entries may be
+   * inserted, moved or removed during the probe, so the result can be wrong
+   * either way; callers check the frame it names before relying on it.
+   *
+   * @param fileId  Identifier of the file
+   * @param pageNo	Page number in the file
+   * @param frameNo Frame number reference, only set if an entry is found
+   * @return  True if an entry for the page was seen
+   */
+  bool tryLookupOptimistic(const FileId fileId, const PageId pageNo,
+                           FrameId& frameNo);
+
   /**
    * Delete entry (file,pageNo) from hash table.
    *
@@ -104,6 +361,26 @@ class BufHashTbl {
    * table
    */
   void remove(const File& file, const PageId pageNo);
+
+  /**
+   * Delete entry (file,pageNo) from hash table if it is present.
+   *
+   * @param file   	File object
+   * @param pageNo  Page number in the file
+   * @return  True if the page entry was in the hash table
+   */
+  bool tryRemove(const File& file, const PageId pageNo) {
+    return tryRemove(file.id(), pageNo);
+  }
+
+  /**
+   * Delete entry (fileId, pageNo) from hash table if it is present.
+   *
+   * @param fileId  Identifier of the file
+   * @param pageNo  Page number in the file
+   * @return  True if the page entry was in the hash table
+   */
+  bool tryRemove(const FileId fileId, const PageId pageNo);
 };
 
 }  // namespace badgerdb
@@ -0,0 +1,123 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "buf_stats.h"
+
+namespace badgerdb {
+
+int LatencyHistogram::bucket(const std::uint64_t nanos) {
+  int index = 0;
+  while (index + 1 < NUM_BUCKETS && (nanos >> (index + 1)) != 0) {
+    index++;
+  }
+  return index;
+}
+
+std::uint64_t LatencyHistogram::total() const {
+  std::uint64_t sum = 0;
+  for (int i = 0; i < NUM_BUCKETS; i++) {
+    sum += counts[i];
+  }
+  return sum;
+}
+
+std::uint64_t LatencyHistogram::percentile(const double fraction) const {
+  const std::uint64_t count = total();
+  if (count == 0) {
+    return 0;
+  }
+  // Rank of the latency we are after, counting from 1
+  std::uint64_t rank = static_cast<std::uint64_t>(fraction * count);
+  if (rank < 1) rank = 1;
+  std::uint64_t seen = 0;
+  for (int i = 0; i < NUM_BUCKETS; i++) {
+    seen += counts[i];
+    if (seen >= rank) {
+      return (std::uint64_t(1) << (i + 1)) - 1;
+    }
+  }
+  return (std::uint64_t(1) << NUM_BUCKETS) - 1;
+}
+
+void LatencyHistogram::clear() {
+  for (int i = 0; i < NUM_BUCKETS; i++) {
+    counts[i] = 0;
+  }
+}
+
+void BufStats::clear() {
+  accesses = hits = misses = victimHits = diskreads = diskwrites = 0;
+  evictions = dirtyEvictions = allocations = sweepSteps = 0;
+  readMissLatency.clear();
+  writeLatency.clear();
+}
+
+BufStatsCounters::BufStatsCounters() : stripes(NUM_STRIPES) { clear(); }
+
+void BufStatsCounters::addLatency(
+    const Histogram histogram,
+    const std::chrono::steady_clock::duration latency) {
+  const std::uint64_t nanos =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count();
+  stripe()
+      .histograms[histogram][LatencyHistogram::bucket(nanos)]
+      .fetch_add(1, std::memory_order_relaxed);
+}
+
+BufStats BufStatsCounters::read() const {
+  std::uint64_t counters[NUM_COUNTERS] = {};
+  BufStats stats;
+  LatencyHistogram* histograms[NUM_HISTOGRAMS] = {&stats.readMissLatency,
+                                                  &stats.writeLatency};
+  for (const Stripe& stripe : stripes) {
+    for (int c = 0; c < NUM_COUNTERS; c++) {
+      counters[c] += stripe.counters[c].load(std::memory_order_relaxed);
+    }
+    for (int h = 0; h < NUM_HISTOGRAMS; h++) {
+      for (int i = 0; i < LatencyHistogram::NUM_BUCKETS; i++) {
+        histograms[h]->counts[i] +=
+            stripe.histograms[h][i].load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  stats.accesses = counters[ACCESSES];
+  stats.hits = counters[HITS];
+  stats.misses = counters[MISSES];
+  stats.victimHits = counters[VICTIM_HITS];
+  stats.diskreads = counters[DISK_READS];
+  stats.diskwrites = counters[DISK_WRITES];
+  stats.evictions = counters[EVICTIONS];
+  stats.dirtyEvictions = counters[DIRTY_EVICTIONS];
+  stats.allocations = counters[ALLOCATIONS];
+  stats.sweepSteps = counters[SWEEP_STEPS];
+  return stats;
+}
+
+void BufStatsCounters::clear() {
+  for (Stripe& stripe : stripes) {
+    for (int c = 0; c < NUM_COUNTERS; c++) {
+      stripe.counters[c].store(0, std::memory_order_relaxed);
+    }
+    for (int h = 0; h < NUM_HISTOGRAMS; h++) {
+      for (int i = 0; i < LatencyHistogram::NUM_BUCKETS; i++) {
+        stripe.histograms[h][i].store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+}
+
+BufStatsCounters::Stripe& BufStatsCounters::stripe() {
+  // Threads are dealt stripes in the order they first count something
+  static std::atomic<unsigned> nextStripe(0);
+  static thread_local const unsigned threadStripe =
+      nextStripe.fetch_add(1, std::memory_order_relaxed);
+  return stripes[threadStripe % NUM_STRIPES];
+}
+
+}  // namespace badgerdb
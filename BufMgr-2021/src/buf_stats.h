@@ -0,0 +1,242 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace badgerdb {
+
+/**
+ * @brief Histogram of latencies in power-of-two buckets of nanoseconds
+ */
+struct LatencyHistogram {
+  /**
+   * Number of buckets
+   */
+  static const int NUM_BUCKETS = 32;
+
+  /**
+   * counts[0] counts latencies below 2 ns and counts[i] those from 2^i up to
+   * 2^(i+1) ns.  The last bucket also counts everything longer.
+   */
+  std::uint64_t counts[NUM_BUCKETS];
+
+  /**
+   * Returns the bucket a latency falls into.
+   *
+   * @param nanos Latency in nanoseconds
+   */
+  static int bucket(const std::uint64_t nanos);
+
+  /**
+   * Returns the number of latencies recorded.
+   */
+  std::uint64_t total() const;
+
+  /**
+   * Returns an upper bound of the given quantile of the latencies, in
+   * nanoseconds, or 0 if none were recorded.
+   *
+   * @param fraction  Quantile between 0 and 1, such as 0.99
+   */
+  std::uint64_t percentile(const double fraction) const;
+
+  /**
+   * Clear all buckets
+   */
+  void clear();
+};
+
+/**
+ * @brief Class to maintain statistics of buffer usage
+ */
+struct BufStats {
+  /**
+   * Total number of accesses to buffer pool
+   */
+  std::uint64_t accesses;
+
+  /**
+   * Number of page reads that found the page in the buffer pool
+   */
+  std::uint64_t hits;
+
+  /**
+   * Number of page reads that had to load the page from disk or the victim
+   * cache
+   */
+  std::uint64_t misses;
+
+  /**
+   * Number of misses that found the page in the victim cache
+   */
+  std::uint64_t victimHits;
+
+  /**
+   * Number of pages read from disk (including allocs and prefetches)
+   */
+  std::uint64_t diskreads;
+
+  /**
+   * Number of pages written back to disk
+   */
+  std::uint64_t diskwrites;
+
+  /**
+   * Number of pages evicted from the buffer pool to make room for others
+   */
+  std::uint64_t evictions;
+
+  /**
+   * Number of evicted pages that had to be written back first
+   */
+  std::uint64_t dirtyEvictions;
+
+  /**
+   * Number of frames picked by the replacement policy
+   */
+  std::uint64_t allocations;
+
+  /**
+   * Number of frames the replacement policy looked at to pick them; with the
+   * clock policy, the steps of the clock hand
+   */
+  std::uint64_t sweepSteps;
+
+  /**
+   * Time from a readPage() miss until the page is in its frame
+   */
+  LatencyHistogram readMissLatency;
+
+  /**
+   * Time taken by each write of pages to disk
+   */
+  LatencyHistogram writeLatency;
+
+  /**
+   * Clear all values
+   */
+  void clear();
+
+  /**
+   * Returns the average number of frames looked at per allocation.
+   */
+  double sweepStepsPerAllocation() const {
+    return allocations == 0 ? 0.0 : double(sweepSteps) / allocations;
+  }
+
+  /**
+   * Constructor of BufStats class
+   */
+  BufStats() { clear(); }
+};
+
+/**
+ * @brief Buffer usage counters that threads update without sharing cache
+ * lines
+ *
+ * The counters are split into stripes, each on cache lines of its own, and a
+ * thread always updates the same stripe.  With no more threads than stripes
+ * every thread has a stripe to itself.  Reading the statistics adds up the
+ * stripes.
+ */
+class BufStatsCounters {
+ public:
+  /**
+   * Counters, named after the fields of BufStats
+   */
+  enum Counter {
+    ACCESSES,
+    HITS,
+    MISSES,
+    VICTIM_HITS,
+    DISK_READS,
+    DISK_WRITES,
+    EVICTIONS,
+    DIRTY_EVICTIONS,
+    ALLOCATIONS,
+    SWEEP_STEPS,
+    NUM_COUNTERS
+  };
+
+  /**
+   * Latency histograms, named after the fields of BufStats
+   */
+  enum Histogram { READ_MISS_LATENCY, WRITE_LATENCY, NUM_HISTOGRAMS };
+
+  /**
+   * Constructor of BufStatsCounters class
+   */
+  BufStatsCounters();
+
+  /**
+   * Adds to a counter.
+   *
+   * @param counter Counter to add to
+   * @param amount  Amount to add
+   */
+  void add(const Counter counter, const std::uint64_t amount = 1) {
+    stripe().counters[counter].fetch_add(amount, std::memory_order_relaxed);
+  }
+
+  /**
+   * Adds a latency to a histogram.
+   *
+   * @param histogram Histogram to add to
+   * @param latency   Latency to add
+   */
+  void addLatency(const Histogram histogram,
+                  const std::chrono::steady_clock::duration latency);
+
+  /**
+   * Returns the sum of all stripes.  Updates made while the stripes are read
+   * may or may not be included.
+   */
+  BufStats read() const;
+
+  /**
+   * Clear all counters
+   */
+  void clear();
+
+ private:
+  /**
+   * Number of stripes
+   */
+  static const unsigned NUM_STRIPES = 64;
+
+  /**
+   * @brief Counters updated by the threads assigned to one stripe
+   */
+  struct Stripe {
+    std::atomic<std::uint64_t> counters[NUM_COUNTERS];
+    std::atomic<std::uint64_t> histograms[NUM_HISTOGRAMS]
+                                         [LatencyHistogram::NUM_BUCKETS];
+
+    /**
+     * Keeps the counters of neighbouring stripes off each other's cache lines
+     */
+    char padding[64];
+  };
+
+  /**
+   * Returns the stripe of the calling thread.
+   */
+  Stripe& stripe();
+
+  /**
+   * The stripes
+   */
+  std::vector<Stripe> stripes;
+};
+
+}  // namespace badgerdb
@@ -23,165 +23,1390 @@
 
 #include "buffer.h"
 
+#include <stdlib.h>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <new>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <utility>
 
 #include "exceptions/bad_buffer_exception.h"
+#include "exceptions/badgerdb_exception.h"
 #include "exceptions/buffer_exceeded_exception.h"
-#include "exceptions/hash_not_found_exception.h"
+#include "exceptions/file_io_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
+#include "trace.h"
+#include "wal.h"
 
 namespace badgerdb {
 
 constexpr int HASHTABLE_SZ(int bufs) { return ((int)(bufs * 1.2) & -2) + 1; }
 
+const std::uint32_t BufferAccessStrategy::DEFAULT_RING_SIZE;
+const std::size_t BufMgr::POOL_CHUNK_SIZE;
+const std::uint32_t BufMgr::RESIZE_PIN_WAIT_MS;
+const FrameId BufferAccessStrategy::NO_FRAME;
+const FrameId BufDesc::NO_FRAME;
+
+namespace {
+
+#if BADGERDB_TRACING
+/**
+ * Frames the calling thread has looked at for the frame it is allocating
+ */
+thread_local std::uint64_t threadSweepSteps = 0;
+#endif
+
+/**
+ * Returns the number of hash table partitions to use: a multiple of the
+ * number of NUMA partitions, so that homing pages by hash gives every NUMA
+ * partition hash table partitions of its own
+ */
+std::uint32_t hashPartitionsFor(const BufMgrOptions &options) {
+  const std::uint32_t partitions = std::max(options.hashPartitions, 1u);
+  if (options.numaNodes <= 1) return partitions;
+  return (partitions + options.numaNodes - 1) / options.numaNodes *
+         options.numaNodes;
+}
+
+/**
+ * First line of a sidecar file written by BufMgr::saveResidentPages()
+ */
+const char *const WARM_CACHE_HEADER = "badgerdb-warm-cache 1";
+
+}  // namespace
+
 //----------------------------------------
 // Constructor of the class BufMgr
 //----------------------------------------
 
-BufMgr::BufMgr(std::uint32_t bufs)
+BufMgr::BufMgr(std::uint32_t bufs, const BufMgrOptions &options)
     : numBufs(bufs),
-      hashTable(HASHTABLE_SZ(bufs)),
-      bufDescTable(bufs),
-      bufPool(bufs) {
-  for (FrameId i = 0; i < bufs; i++) {
+      maxBufs(std::max(bufs, options.maxBufs)),
+      pinnedFrames(0),
+      numaNodes(std::max(options.numaNodes, 1u)),
+      numaHoming(options.numaHoming),
+      numaStripeFrames(std::max(
+          1u, std::min<std::uint32_t>(POOL_CHUNK_SIZE / Page::SIZE,
+                                      bufs / numaNodes))),
+      readAheadPages(std::min(options.readAheadPages, bufs / 4)),
+      hashTable(HASHTABLE_SZ(bufs), hashPartitionsFor(options)),
+      bufDescTable(maxBufs),
+      ioEngine(IoEngine::create(options.ioEngine, options.ioQueueDepth)),
+      warmCacheFile(options.warmCacheFile),
+      log(options.log),
+      victimCache(options.victimCacheBytes != 0
+                      ? new VictimCache(options.victimCacheBytes)
+                      : nullptr),
+      writerIntervalMs(options.writerIntervalMs),
+      writerLookahead(options.writerLookahead),
+      writerMaxPages(options.writerMaxPages),
+      checkpointIntervalMs(options.checkpointIntervalMs),
+      checkpointBatchPages(std::max(options.checkpointBatchPages, 1u)),
+      checkpointPauseMs(options.checkpointPauseMs),
+      writerStopping(false) {
+  tenants.push_back(Tenant{TenantOptions(), 0});
+  if (numaNodes > 1) {
+    replacementPolicy.reset(
+        new PartitionedPolicy(options.replacementPolicy, bufs, maxBufs,
+                              numaNodes, numaStripeFrames));
+  } else {
+    replacementPolicy =
+        ReplacementPolicy::create(options.replacementPolicy, bufs);
+  }
+  allocPoolArena(options.hugePages);
+
+  // Ask for every stripe of frames to be placed on the node of its
+  // partition before the frames are first touched
+  const NumaTopology &topology = NumaTopology::get();
+  if (numaNodes > 1 && topology.nodes() > 1) {
+    for (FrameId first = 0; first < maxBufs; first += numaStripeFrames) {
+      const FrameId count = std::min(numaStripeFrames, maxBufs - first);
+      topology.preferNode(poolArena + std::size_t(first) * Page::SIZE,
+                          std::size_t(count) * Page::SIZE,
+                          first / numaStripeFrames % numaNodes %
+                              topology.nodes());
+    }
+  }
+
+  // Every frame is a view over its slice of the arena.  Reserved frames are
+  // left untouched so that they use no memory until the pool grows.
+  bufPool.reserve(maxBufs);
+  for (FrameId i = 0; i < maxBufs; i++) {
+    char *image = poolArena + std::size_t(i) * Page::SIZE;
+    bufPool.push_back(i < bufs ? Page::view(image) : Page(image));
     bufDescTable[i].frameNo = i;
     bufDescTable[i].valid = false;
   }
 
-  clockHand = bufs - 1;
+  if (options.backgroundWriter) {
+    writerThread = std::thread(&BufMgr::runWriter, this);
+  }
+  if (checkpointIntervalMs != 0) {
+    checkpointerThread = std::thread(&BufMgr::runCheckpointer, this);
+  }
+
+  if (!warmCacheFile.empty()) {
+    try {
+      loadResidentPages(warmCacheFile);
+    } catch (...) {
+      // The pages are only a hint; those that failed to load are read on
+      // demand later
+    }
+  }
+}
+
+BufMgr::~BufMgr() {
+  {
+    std::lock_guard<std::mutex> writerGuard(writerLatch);
+    writerStopping = true;
+  }
+  writerWake.notify_all();
+  checkpointWake.notify_all();
+  if (writerThread.joinable()) writerThread.join();
+  if (checkpointerThread.joinable()) checkpointerThread.join();
+
+  if (!warmCacheFile.empty()) {
+    try {
+      saveResidentPages(warmCacheFile);
+    } catch (...) {
+      // Without the list the next manager merely starts cold
+    }
+  }
+
+  bufPool.clear();
+#if defined(__linux__)
+  if (poolArenaMapped) {
+    munmap(poolArena, poolArenaSize);
+    return;
+  }
+#endif
+  free(poolArena);
+}
+
+void BufMgr::allocPoolArena(const bool hugePages) {
+  poolArenaSize = std::size_t(maxBufs) * Page::SIZE;
+  poolArenaMapped = false;
+
+#if defined(__linux__)
+  if (hugePages && poolArenaSize > 0) {
+    // Round up to whole huge pages
+    poolArenaSize = (poolArenaSize + POOL_CHUNK_SIZE - 1) / POOL_CHUNK_SIZE *
+                    POOL_CHUNK_SIZE;
+
+    void *arena = mmap(nullptr, poolArenaSize, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (arena == MAP_FAILED) {
+      // No huge pages reserved; ask for transparent huge pages instead
+      arena = mmap(nullptr, poolArenaSize, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (arena != MAP_FAILED) madvise(arena, poolArenaSize, MADV_HUGEPAGE);
+    }
+    if (arena != MAP_FAILED) {
+      poolArena = static_cast<char *>(arena);
+      poolArenaMapped = true;
+      return;
+    }
+    poolArenaSize = std::size_t(maxBufs) * Page::SIZE;
+  }
+#endif
+
+  void *arena = nullptr;
+  if (posix_memalign(&arena, Page::ALIGNMENT, poolArenaSize) != 0) {
+    throw std::bad_alloc();
+  }
+  poolArena = static_cast<char *>(arena);
+}
+
+void BufMgr::releaseFrames(const FrameId first, const FrameId last) {
+#if defined(__linux__)
+  // A chunk that still holds a frame in use is kept whole
+  const std::size_t begin =
+      (std::size_t(first) * Page::SIZE + POOL_CHUNK_SIZE - 1) /
+      POOL_CHUNK_SIZE * POOL_CHUNK_SIZE;
+  const std::size_t end = std::min(std::size_t(last) * Page::SIZE,
+                                   poolArenaSize);
+  if (begin < end) {
+    // The mapping stays, so the frames can simply be used again once the
+    // pool grows
+    madvise(poolArena + begin, end - begin, MADV_DONTNEED);
+  }
+#else
+  (void)first;
+  (void)last;
+#endif
+}
+
+void BufMgr::resize(const std::uint32_t newBufs) {
+  if (newBufs == 0 || newBufs > maxBufs) {
+    throw BufferExceededException();
+  }
+  std::lock_guard<std::mutex> resizeGuard(resizeLatch);
+  const std::uint32_t oldBufs = numBufs;
+
+  if (newBufs >= oldBufs) {
+    hashTable.reserve(HASHTABLE_SZ(newBufs));
+    numBufs = newBufs;
+    replacementPolicy->resize(newBufs);
+    return;
+  }
+
+  // Frames past the new end are no longer handed out from here on; empty
+  // the ones that hold pages
+  numBufs = newBufs;
+  try {
+    for (FrameId i = newBufs; i < oldBufs; i++) {
+      BufDesc &bufDesc = bufDescTable[i];
+      const std::chrono::steady_clock::time_point deadline =
+          std::chrono::steady_clock::now() +
+          std::chrono::milliseconds(RESIZE_PIN_WAIT_MS);
+      while (true) {
+        {
+          std::lock_guard<std::mutex> frameGuard(bufDesc.latch);
+          if (!bufDesc.valid) break;
+          if (evictFrame(bufDesc)) {
+            replacementPolicy->recordRemoval(i);
+            break;
+          }
+          if (std::chrono::steady_clock::now() >= deadline) {
+            throw PagePinnedException(bufDesc.file->filename(),
+                                      bufDesc.pageNo, i);
+          }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+  } catch (...) {
+    numBufs = oldBufs;
+    throw;
+  }
+
+  replacementPolicy->resize(newBufs);
+  releaseFrames(newBufs, oldBufs);
+}
+
+void BufMgr::saveResidentPages(const std::string &path) {
+  // The frames in the order the policy would evict them, reversed, followed
+  // by any it did not list; then referenced frames before the others
+  std::vector<FrameId> order;
+  replacementPolicy->nextVictims(numBufs, order);
+  std::reverse(order.begin(), order.end());
+  std::vector<bool> listed(maxBufs, false);
+  for (const FrameId frameNo : order) listed[frameNo] = true;
+  for (FrameId frameNo = 0; frameNo < numBufs; frameNo++) {
+    if (!listed[frameNo]) order.push_back(frameNo);
+  }
+  std::stable_partition(order.begin(), order.end(), [this](FrameId frameNo) {
+    return bufDescTable[frameNo].refbit.load();
+  });
+
+  // Read without latches; a frame that changed hands meanwhile is skipped
+  std::vector<std::pair<FileId, PageId>> pages;
+  for (const FrameId frameNo : order) {
+    BufDesc &bufDesc = bufDescTable[frameNo];
+    const std::uint32_t version = bufDesc.version;
+    const FileId fileId = bufDesc.fileId;
+    const PageId pageNo = bufDesc.pageNo;
+    if (bufDesc.valid && bufDesc.version == version) {
+      pages.push_back(std::make_pair(fileId, pageNo));
+    }
+  }
+  std::map<FileId, std::string> filenames;
+  {
+    std::lock_guard<std::mutex> fileFramesGuard(fileFramesLatch);
+    for (const std::pair<const FileId, FileEntry> &entry : fileTable) {
+      filenames[entry.first] = entry.second.file.filename();
+    }
+  }
+
+  const std::string tmpPath = path + ".tmp";
+  {
+    std::ofstream out(tmpPath, std::ios::out | std::ios::trunc);
+    out << WARM_CACHE_HEADER << "\n";
+    for (const std::pair<FileId, PageId> &page : pages) {
+      std::map<FileId, std::string>::const_iterator filename =
+          filenames.find(page.first);
+      if (filename != filenames.end()) {
+        out << page.second << " " << filename->second << "\n";
+      }
+    }
+    out.flush();
+    if (!out) {
+      throw FileIoException(tmpPath, errno);
+    }
+  }
+  if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+    throw FileIoException(path, errno);
+  }
+}
+
+void BufMgr::loadResidentPages(const std::string &path) {
+  std::ifstream in(path);
+  std::string line;
+  if (!std::getline(in, line) || line != WARM_CACHE_HEADER) {
+    return;
+  }
+
+  // The hottest pages that fit, by file and page number
+  std::vector<std::pair<std::string, PageId>> pages;
+  while (pages.size() < numBufs && std::getline(in, line)) {
+    std::istringstream entry(line);
+    PageId pageNo;
+    std::string filename;
+    if (!(entry >> pageNo) || entry.get() != ' ' ||
+        !std::getline(entry, filename) || pageNo == Page::INVALID_NUMBER) {
+      continue;
+    }
+    pages.push_back(std::make_pair(filename, pageNo));
+  }
+  std::sort(pages.begin(), pages.end());
+
+  const std::uint32_t maxRun = std::max(numBufs / 4, 1u);
+  std::size_t fileStart = 0;
+  while (fileStart < pages.size()) {
+    std::size_t fileEnd = fileStart + 1;
+    while (fileEnd < pages.size() &&
+           pages[fileEnd].first == pages[fileStart].first) {
+      fileEnd++;
+    }
+
+    File file;
+    try {
+      file = File::open(pages[fileStart].first);
+    } catch (const BadgerDbException &) {
+      fileStart = fileEnd;
+      continue;
+    }
+    for (std::size_t runStart = fileStart; runStart < fileEnd;) {
+      std::size_t runEnd = runStart + 1;
+      while (runEnd < fileEnd && runEnd - runStart < maxRun &&
+             pages[runEnd].second == pages[runEnd - 1].second + 1) {
+        runEnd++;
+      }
+      prefetch(file, pages[runStart].second,
+               static_cast<std::uint32_t>(runEnd - runStart));
+      runStart = runEnd;
+    }
+    fileStart = fileEnd;
+  }
 }
 
 // START STUDENT ASSIGNED METHODS
 
-void BufMgr::advanceClock() {
-  // advance clock pointer
-  clockHand++;
+bool BufMgr::testAndClearReference(const FrameId frameNo) {
+  BufDesc &bufDesc = bufDescTable[frameNo];
+  // Free frames are taken regardless of their reference bit, and pages of
+  // low priority get no second chance
+  if (bufDesc.valid && bufDesc.refbit.exchange(false) &&
+      bufDesc.priority != BufferPriority::LOW) {
+    bufStats.add(BufStatsCounters::SWEEP_STEPS);
+#if BADGERDB_TRACING
+    threadSweepSteps++;
+#endif
+    return true;
+  }
+  return false;
+}
+
+bool BufMgr::tryClaim(const FrameId frameNo) {
+  if (!claimFrame(frameNo)) {
+    return false;
+  }
 
-  if (clockHand >= numBufs)
-    // Reset clockHand to first buffer
-    clockHand = 0;
+  // Pages of high priority are only given up by flushes and disposals.  The
+  // priority only changes while the frame latch is held or under
+  // setFileTenant(), which is not worth waiting for.
+  BufDesc &bufDesc = bufDescTable[frameNo];
+  if (bufDesc.valid && bufDesc.priority == BufferPriority::HIGH) {
+    bufDesc.latch.unlock();
+    return false;
+  }
+  return true;
 }
 
-void BufMgr::allocBuf(FrameId &frame) {
+bool BufMgr::claimFrame(const FrameId frameNo) {
+  BufDesc &bufDesc = bufDescTable[frameNo];
+  bufStats.add(BufStatsCounters::SWEEP_STEPS);
+#if BADGERDB_TRACING
+  threadSweepSteps++;
+#endif
+
+  // Frame is being set up or loaded by another thread
+  if (!bufDesc.latch.try_lock()) {
+    return false;
+  }
+
+  // Removed from the pool by resize()
+  if (frameNo >= numBufs) {
+    bufDesc.latch.unlock();
+    return false;
+  }
+
+  // Pinned, or a thread is still waiting on a failed load
+  if (bufDesc.pinCnt > 0) {
+    bufDesc.latch.unlock();
+    return false;
+  }
+  return true;
+}
+
+void BufMgr::allocBuf(FrameId &frame, const std::uint32_t node,
+                      const File *file) {
   // Allocate a free frame (just return the next available frame)
 
   // param frame is the variable which the return value should be in
   // throws BufferExceededException if no such buffer is found which can be
   // allocated
 
-  // The buffer that the clock is starting on. Used together with
-  // candidateSeen to determine if should throw BufferExceededException
-  FrameId startingFrame = clockHand;
+  BADGERDB_TRACE_START(traceStart);
+#if BADGERDB_TRACING
+  threadSweepSteps = 0;
+#endif
+  // With every frame pinned no sweep can find one
+  if (pinnedFrames >= numBufs) {
+    throw BufferExceededException();
+  }
+  if (file != nullptr && allocTenantBuf(*file, frame)) {
+    return;
+  }
+  while (true) {
+    // The policy returns the victim with its latch held
+    FrameId victim;
+    if (!replacementPolicy->pickVictimOn(*this, node, victim)) {
+      throw BufferExceededException();
+    }
+    BufDesc *candidate = &bufDescTable.at(victim);
+#if BADGERDB_TRACING
+    const TraceVictim victimType = !candidate->valid ? TraceVictim::FREE
+                                   : candidate->dirty ? TraceVictim::DIRTY
+                                                      : TraceVictim::CLEAN;
+#endif
+
+    // The write-back of a dirty victim happens outside of the policy latch so
+    // that other misses can keep looking in the meantime.
+    try {
+      if (!candidate->valid) {
+        bufStats.add(BufStatsCounters::ALLOCATIONS);
+        frame = candidate->frameNo;
+        BADGERDB_TRACE(TraceEvent::ALLOC_BUF, traceStart, File::INVALID_ID,
+                       Page::INVALID_NUMBER, threadSweepSteps,
+                       static_cast<std::uint8_t>(victimType));
+        return;
+      }
+      if (evictFrame(*candidate)) {
+        replacementPolicy->recordRemoval(candidate->frameNo);
+        bufStats.add(BufStatsCounters::ALLOCATIONS);
+        // Use Frame (caller needs to call "Set()" on the BufDesc for this
+        // frame)
+        frame = candidate->frameNo;
+        BADGERDB_TRACE(TraceEvent::ALLOC_BUF, traceStart, File::INVALID_ID,
+                       Page::INVALID_NUMBER, threadSweepSteps,
+                       static_cast<std::uint8_t>(victimType));
+        return;
+      }
+    } catch (...) {
+      candidate->latch.unlock();
+      throw;
+    }
 
-  // Whether a candidate has been seen since last rotation of clock hand
-  bool candidateSeen = false;
+    // Victim was pinned again while it was written back; look further
+    candidate->latch.unlock();
+  }
+}
 
-  while (true) {
-    // Advance the clock hand
-    advanceClock();
+bool BufMgr::allocTenantBuf(const File &file, FrameId &frame) {
+  TenantId tenant;
+  std::vector<FrameId> frames;
+  {
+    std::lock_guard<std::mutex> fileFramesGuard(fileFramesLatch);
+    tenant = fileTenant(file);
+    const Tenant &limits = tenants[tenant];
+    if (limits.options.maxFrames == 0 ||
+        limits.frames < limits.options.maxFrames) {
+      return false;
+    }
+    // The frames of all files of the tenant
+    for (const std::pair<const FileId, FileTenant> &assigned : fileTenants) {
+      if (assigned.second.tenant != tenant) continue;
+      std::map<FileId, FileEntry>::const_iterator entry =
+          fileTable.find(assigned.first);
+      if (entry == fileTable.end() ||
+          entry->second.file.openNumber() != assigned.second.openNumber) {
+        continue;
+      }
+      for (FrameId i = entry->second.firstFrame; i != BufDesc::NO_FRAME;
+           i = bufDescTable[i].nextFileFrame) {
+        frames.push_back(i);
+      }
+    }
+  }
 
-    if (clockHand == startingFrame) {
-      if (!candidateSeen) {
-        throw BufferExceededException();
-      } else {
-        // Reset it so that if there is no candidateSeen this time around it
-        // will throw error
-        candidateSeen = false;
+  BADGERDB_TRACE_START(traceStart);
+  // A clock over the frames of the tenant: the first round gives referenced
+  // pages a second chance
+  for (int round = 0; round < 2; round++) {
+    for (const FrameId frameNo : frames) {
+      BufDesc &bufDesc = bufDescTable[frameNo];
+      if (round == 0 && testAndClearReference(frameNo)) {
+        continue;
+      }
+      if (!claimFrame(frameNo)) {
+        continue;
+      }
+      // Claimed frames cannot be given to another file, but may have been
+      // given up since they were listed
+      if (!bufDesc.valid || bufDesc.tenant != tenant) {
+        bufDesc.latch.unlock();
+        continue;
+      }
+#if BADGERDB_TRACING
+      const TraceVictim victimType =
+          bufDesc.dirty ? TraceVictim::DIRTY : TraceVictim::CLEAN;
+#endif
+      bool evicted;
+      try {
+        evicted = evictFrame(bufDesc);
+      } catch (...) {
+        bufDesc.latch.unlock();
+        throw;
       }
+      if (!evicted) {
+        bufDesc.latch.unlock();
+        continue;
+      }
+      replacementPolicy->recordRemoval(frameNo);
+      bufStats.add(BufStatsCounters::ALLOCATIONS);
+      frame = frameNo;
+      BADGERDB_TRACE(TraceEvent::ALLOC_BUF, traceStart, file.id(),
+                     Page::INVALID_NUMBER, frames.size(),
+                     static_cast<std::uint8_t>(victimType));
+      return true;
+    }
+  }
+  throw BufferExceededException();
+}
+
+void BufMgr::allocRingBuf(BufferAccessStrategy &strategy, FrameId &frame,
+                          const File &file) {
+  strategy.current = (strategy.current + 1) % strategy.ring.size();
+  FrameId &slot = strategy.ring[strategy.current];
+
+  if (slot < numBufs) {
+    BufDesc *ringDesc = &bufDescTable.at(slot);
+    if (ringDesc->latch.try_lock()) {
+      // A set refbit means the page was referenced by someone else and now
+      // belongs to the rest of the buffer pool
+      if (ringDesc->pinCnt == 0 && !ringDesc->refbit && slot < numBufs) {
+        try {
+          if (!ringDesc->valid) {
+            frame = slot;
+            return;
+          }
+          // Scanned pages are not worth keeping
+          if (evictFrame(*ringDesc, false)) {
+            replacementPolicy->recordRemoval(slot);
+            frame = slot;
+            return;
+          }
+        } catch (...) {
+          ringDesc->latch.unlock();
+          throw;
+        }
+      }
+      ringDesc->latch.unlock();
     }
+  }
+
+  allocBuf(frame, localNode(), &file);
+  slot = frame;
+}
 
-    BufDesc *currFrameDesc = &bufDescTable.at(clockHand);
+void BufMgr::pinFrame(BufDesc &bufDesc) {
+  if (bufDesc.pinCnt++ == 0) pinnedFrames++;
+}
+
+void BufMgr::dropPin(BufDesc &bufDesc) {
+  if (--bufDesc.pinCnt == 0) pinnedFrames--;
+}
+
+void BufMgr::setFrame(BufDesc &bufDesc, const File &file,
+                      const PageId pageNo) {
+  // Claimed frames are unpinned
+  bufDesc.Set(file, pageNo);
+  pinnedFrames++;
+}
+
+void BufMgr::clearFrame(BufDesc &bufDesc) {
+  if (bufDesc.pinCnt > 0) pinnedFrames--;
+  bufDesc.clear();
+}
+
+void BufMgr::linkFileFrame(BufDesc &bufDesc, const File &file) {
+  std::lock_guard<std::mutex> fileFramesGuard(fileFramesLatch);
+  std::map<FileId, FileEntry>::iterator entry = fileTable.find(file.id());
+  bufDesc.prevFileFrame = BufDesc::NO_FRAME;
+  if (entry == fileTable.end()) {
+    // First page of the file in the pool; this is the only File copy made
+    // until its last page leaves
+    FileEntry newEntry = {file, bufDesc.frameNo};
+    entry = fileTable.emplace(file.id(), newEntry).first;
+    bufDesc.nextFileFrame = BufDesc::NO_FRAME;
+  } else {
+    bufDesc.nextFileFrame = entry->second.firstFrame;
+    bufDescTable[entry->second.firstFrame].prevFileFrame = bufDesc.frameNo;
+    entry->second.firstFrame = bufDesc.frameNo;
+  }
+  bufDesc.file = &entry->second.file;
+
+  const TenantId tenant = fileTenant(file);
+  bufDesc.tenant = tenant;
+  bufDesc.priority = tenants[tenant].options.priority;
+  tenants[tenant].frames++;
+}
+
+TenantId BufMgr::fileTenant(const File &file) {
+  std::map<FileId, FileTenant>::iterator assigned =
+      fileTenants.find(file.id());
+  if (assigned == fileTenants.end()) {
+    return 0;
+  }
+  if (assigned->second.openNumber != file.openNumber()) {
+    // Left by a closed file that had the same identifier
+    fileTenants.erase(assigned);
+    return 0;
+  }
+  return assigned->second.tenant;
+}
 
-    // Valid set?
-    if (!currFrameDesc->valid) {
-      // No: use frame and call "Set()" on the frame ("Set()" is called
-      //   by caller of this method to set the file and pageNum for the
-      //   frame)
-      frame = clockHand;
+void BufMgr::unlinkFileFrame(BufDesc &bufDesc) {
+  // Closing the last File object of the table entry may write back the file
+  // header, so it happens after the latch has been released
+  File removedFile;
+  {
+    std::lock_guard<std::mutex> fileFramesGuard(fileFramesLatch);
+    if (bufDesc.file == nullptr) {
+      // Not in any list
       return;
     }
+    if (bufDesc.prevFileFrame == BufDesc::NO_FRAME) {
+      std::map<FileId, FileEntry>::iterator entry =
+          fileTable.find(bufDesc.fileId);
+      if (bufDesc.nextFileFrame == BufDesc::NO_FRAME) {
+        removedFile = entry->second.file;
+        fileTable.erase(entry);
+      } else {
+        entry->second.firstFrame = bufDesc.nextFileFrame;
+      }
+    } else {
+      bufDescTable[bufDesc.prevFileFrame].nextFileFrame =
+          bufDesc.nextFileFrame;
+    }
+    if (bufDesc.nextFileFrame != BufDesc::NO_FRAME) {
+      bufDescTable[bufDesc.nextFileFrame].prevFileFrame =
+          bufDesc.prevFileFrame;
+    }
+    bufDesc.prevFileFrame = BufDesc::NO_FRAME;
+    bufDesc.nextFileFrame = BufDesc::NO_FRAME;
+    bufDesc.file = nullptr;
+    tenants[bufDesc.tenant].frames--;
+    bufDesc.tenant = 0;
+    bufDesc.priority = BufferPriority::NORMAL;
+  }
+  if (removedFile.isValid()) {
+    // The file stays open until removedFile goes, so its identifier cannot
+    // have been handed to another file yet
+    std::lock_guard<std::mutex> readAheadGuard(readAheadLatch);
+    readAheadState.erase(removedFile.id());
+  }
+}
 
-    // refbit set?
-    if (currFrameDesc->refbit) {
-      // Yes: clear refbit
-      currFrameDesc->refbit = false;
-
-      // This frame can be used next full rotation of clock so no
-      // exception must be thrown if full revolution done once
-      candidateSeen = true;
+std::vector<FrameId> BufMgr::framesOfFile(const File &file) {
+  std::vector<FrameId> frames;
+  std::lock_guard<std::mutex> fileFramesGuard(fileFramesLatch);
+  std::map<FileId, FileEntry>::const_iterator entry = fileTable.find(file.id());
+  if (entry != fileTable.end()) {
+    for (FrameId frameNo = entry->second.firstFrame;
+         frameNo != BufDesc::NO_FRAME;
+         frameNo = bufDescTable[frameNo].nextFileFrame) {
+      frames.push_back(frameNo);
+    }
+  }
+  return frames;
+}
 
-      // Advance Clock Pointer (continue to next iter of while loop)
-      continue;
+bool BufMgr::evictFrame(BufDesc &bufDesc, const bool keep) {
+  std::mutex &partitionLatch =
+      hashTable.latch(bufDesc.fileId, bufDesc.pageNo);
+  {
+    // Pin the victim so that it stays mapped while it is written back. Pins
+    // are only taken under the partition latch, so no one can race us here.
+    std::lock_guard<std::mutex> partitionGuard(partitionLatch);
+    if (bufDesc.pinCnt != 0) {
+      return false;
     }
+    pinFrame(bufDesc);
+  }
 
-    // page pinned?
-    if (currFrameDesc->pinCnt > 0) {
-      // Yes: Advance Clock Pointer (continue to next iter of while loop)
-      continue;
+  // dirty bit set?
+  const bool wasDirty = bufDesc.dirty.exchange(false);
+  if (wasDirty) {
+    // The background writer fell behind; have it run a round now
+    if (writerThread.joinable()) writerWake.notify_one();
+
+    // Yes: Flush page to disk
+    try {
+      writeFrame(bufDesc);
+    } catch (...) {
+      bufDesc.dirty = true;
+      dropPin(bufDesc);
+      throw;
     }
+  }
+
+  // Compressed before the latch is taken; wasted if the eviction fails
+  std::string compressed;
+  if (victimCache && keep) {
+    compressed = VictimCache::compress(bufPool.at(bufDesc.frameNo));
+  }
+
+  std::lock_guard<std::mutex> partitionGuard(partitionLatch);
+  if (bufDesc.pinCnt != 1 || bufDesc.dirty) {
+    // Someone used the page while it was being written back
+    dropPin(bufDesc);
+    return false;
+  }
+
+  // Added while the page is still in the hash table, so that a miss on it
+  // finds it in one of the two
+  if (victimCache && keep) {
+    victimCache->insert(bufDesc.fileId, bufDesc.file->filename(),
+                        bufDesc.pageNo, std::move(compressed));
+  }
 
-    // dirty bit set?
-    if (currFrameDesc->dirty) {
-      // Yes: Flush page to disk
-      Page page = bufPool.at(currFrameDesc->frameNo);
-      currFrameDesc->file.writePage(page);
-      currFrameDesc->dirty = false;
+  // If the buffer frame has a valid page in it, remove the appropriate
+  //   entry from the hash table
+  hashTable.tryRemove(bufDesc.fileId, bufDesc.pageNo);
+  unlinkFileFrame(bufDesc);
+  clearFrame(bufDesc);
+  bufStats.add(BufStatsCounters::EVICTIONS);
+  if (wasDirty) bufStats.add(BufStatsCounters::DIRTY_EVICTIONS);
+  return true;
+}
+
+void BufMgr::writeFrame(BufDesc &bufDesc) {
+  const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  const Page &page = bufPool.at(bufDesc.frameNo);
+  // Log before the page
+  if (log != nullptr) log->flush(page.lsn());
+  bufDesc.file->writePage(page);
+  bufStats.addLatency(BufStatsCounters::WRITE_LATENCY,
+                      std::chrono::steady_clock::now() - start);
+  bufStats.add(BufStatsCounters::DISK_WRITES);
+}
+
+void BufMgr::runWriter() {
+  std::unique_lock<std::mutex> writerGuard(writerLatch);
+  while (!writerStopping) {
+    writerWake.wait_for(writerGuard,
+                        std::chrono::milliseconds(writerIntervalMs));
+    if (writerStopping) break;
+
+    writerGuard.unlock();
+    try {
+      cleanVictims(writerLookahead, writerMaxPages);
+    } catch (...) {
+      // The page stays dirty and is written back when it is evicted, which
+      // reports the error to a caller
     }
+    writerGuard.lock();
+  }
+}
+
+void BufMgr::runCheckpointer() {
+  std::unique_lock<std::mutex> writerGuard(writerLatch);
+  while (!writerStopping) {
+    checkpointWake.wait_for(writerGuard,
+                            std::chrono::milliseconds(checkpointIntervalMs));
+    if (writerStopping) break;
 
+    writerGuard.unlock();
     try {
-      // If the buffer frame has a valid page in it, remove the appropriate
-      //   entry from the hash table
-      hashTable.remove(currFrameDesc->file, currFrameDesc->pageNo);
-    } catch (HashNotFoundException &e) {
+      checkpoint();
+    } catch (...) {
+      // Recovery starts at the previous checkpoint until one succeeds
     }
+    writerGuard.lock();
+  }
+}
 
-    // Use Frame (caller needs to call "Set()" on the BufDesc for this frame)
-    frame = clockHand;
-    return;
+bool BufMgr::pauseCheckpoint(const std::uint32_t ms) {
+  std::unique_lock<std::mutex> writerGuard(writerLatch);
+  checkpointWake.wait_for(writerGuard, std::chrono::milliseconds(ms),
+                          [this]() { return writerStopping; });
+  return !writerStopping;
+}
+
+Lsn BufMgr::checkpoint() {
+  // Changes up to here are on disk once the pages below have been written
+  const Lsn redoLsn = log != nullptr ? log->endLsn() : 0;
+
+  // Dirty page table.  Pinned pages are taken too, as their changes may
+  // have been logged without the frame being marked dirty yet.  A frame
+  // that changes hands meanwhile is skipped, since evicting it wrote it.
+  struct DirtyPage {
+    FrameId frameNo;
+    FileId fileId;
+    PageId pageNo;
+  };
+  std::vector<DirtyPage> pending;
+  std::set<FileId> fileIds;
+  for (FrameId frameNo = 0; frameNo < numBufs; frameNo++) {
+    BufDesc &bufDesc = bufDescTable[frameNo];
+    const std::uint32_t version = bufDesc.version;
+    const FileId fileId = bufDesc.fileId;
+    const PageId pageNo = bufDesc.pageNo;
+    if (bufDesc.valid && (bufDesc.dirty || bufDesc.pinCnt != 0) &&
+        bufDesc.version == version) {
+      pending.push_back({frameNo, fileId, pageNo});
+      fileIds.insert(fileId);
+    }
+  }
+
+  std::uint32_t written = 0;
+  while (!pending.empty()) {
+    std::vector<DirtyPage> retry;
+    for (const DirtyPage &dirtyPage : pending) {
+      BufDesc &bufDesc = bufDescTable[dirtyPage.frameNo];
+      if (!bufDesc.valid || bufDesc.fileId != dirtyPage.fileId ||
+          bufDesc.pageNo != dirtyPage.pageNo) {
+        continue;
+      }
+      if (bufDesc.pinCnt != 0) {
+        retry.push_back(dirtyPage);
+        continue;
+      }
+      if (!bufDesc.dirty) {
+        // Written since; wait for a write still in progress to end
+        std::lock_guard<std::mutex> frameGuard(bufDesc.latch);
+        continue;
+      }
+      if (!cleanFrame(bufDesc)) {
+        retry.push_back(dirtyPage);
+        continue;
+      }
+      if (++written % checkpointBatchPages == 0 &&
+          !pauseCheckpoint(checkpointPauseMs)) {
+        return 0;
+      }
+    }
+    pending.swap(retry);
+    if (!pending.empty() &&
+        !pauseCheckpoint(std::max(checkpointPauseMs, 1u))) {
+      return 0;
+    }
+  }
+
+  std::vector<File> files;
+  {
+    std::lock_guard<std::mutex> fileFramesGuard(fileFramesLatch);
+    for (const FileId fileId : fileIds) {
+      std::map<FileId, FileEntry>::iterator entry = fileTable.find(fileId);
+      if (entry != fileTable.end()) files.push_back(entry->second.file);
+    }
+  }
+  // Writing no pages with sync still syncs the file
+  for (File &file : files) {
+    file.writePages(std::vector<const Page *>(), true /* sync */);
+  }
+
+  return log != nullptr ? log->checkpoint(redoLsn) : 0;
+}
+
+std::uint32_t BufMgr::cleanVictims(const std::uint32_t lookahead,
+                                   const std::uint32_t maxPages) {
+  std::vector<FrameId> victims;
+  replacementPolicy->nextVictims(lookahead, victims);
+
+  std::uint32_t written = 0;
+  for (const FrameId frameNo : victims) {
+    if (written >= maxPages) break;
+    if (cleanFrame(bufDescTable.at(frameNo))) written++;
   }
+  return written;
 }
 
-void BufMgr::readPage(File &file, const PageId pageNo, Page *&page) {
-  FrameId frameNo;  // will be frame number
+bool BufMgr::cleanFrame(BufDesc &bufDesc) {
+  // Cheap checks first so that clean frames cost no latching
+  if (!bufDesc.valid || !bufDesc.dirty || bufDesc.pinCnt != 0) {
+    return false;
+  }
+
+  // Holding the frame latch keeps the frame from being evicted, flushed or
+  // disposed of while it is written
+  if (!bufDesc.latch.try_lock()) {
+    return false;
+  }
+  std::lock_guard<std::mutex> frameGuard(bufDesc.latch, std::adopt_lock);
+  if (!bufDesc.valid || bufDesc.pinCnt != 0 || !bufDesc.dirty.exchange(false)) {
+    return false;
+  }
+
   try {
-    // lookup sets frameNo if successful
-    hashTable.lookup(file, pageNo, frameNo);
+    writeFrame(bufDesc);
+  } catch (...) {
+    bufDesc.dirty = true;
+    throw;
+  }
+  return true;
+}
 
-    // Since the page is already in the table do what is necessary and
-    // return
+bool BufMgr::waitForFrame(BufDesc &bufDesc) {
+  if (!bufDesc.valid) {
+    // The loading thread holds the frame latch until the read completes
+    std::lock_guard<std::mutex> frameGuard(bufDesc.latch);
+  }
 
-    // Set page (this is the return value)
-    page = &bufPool.at(frameNo);
+  if (bufDesc.valid) {
+    return true;
+  }
+
+  // Loading the page failed and the frame has been unmapped again
+  dropPin(bufDesc);
+  return false;
+}
 
-    BufDesc *bufDesc = &bufDescTable.at(frameNo);
+void BufMgr::readPage(File &file, const PageId pageNo, Page *&page) {
+  readPage(file, pageNo, page, nullptr);
+}
 
-    // do what is necessary
-    bufDesc->refbit = true;
-    bufDesc->pinCnt++;
+PageGuard BufMgr::readPage(File &file, const PageId pageNo,
+                           BufferAccessStrategy *strategy) {
+  Page *page;
+  readPage(file, pageNo, page, strategy);
+  return PageGuard(this, frameOf(page), page);
+}
 
-    return;
-  } catch (HashNotFoundException &e) {
-    // page not currently in hashTable
+bool BufMgr::readPageOptimistic(
+    File &file, const PageId pageNo,
+    const std::function<void(const Page &)> &reader) {
+  FrameId frameNo;
+  if (hashTable.tryLookupOptimistic(file.id(), pageNo, frameNo)) {
+    BufDesc &bufDesc = bufDescTable.at(frameNo);
+    const std::uint32_t version =
+        bufDesc.version.load(std::memory_order_acquire);
+    const auto unchanged = [&bufDesc, version]() {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return bufDesc.pinCnt.load(std::memory_order_relaxed) == 0 &&
+             bufDesc.version.load(std::memory_order_relaxed) == version;
+    };
+    if (bufDesc.valid && bufDesc.pinCnt == 0 && bufDesc.fileId == file.id() &&
+        bufDesc.pageNo == pageNo) {
+      bool stable;
+      try {
+        reader(bufPool.at(frameNo));
+        stable = unchanged();
+      } catch (...) {
+        if (unchanged()) throw;
+        stable = false;
+      }
+      if (stable) {
+        bufStats.add(BufStatsCounters::ACCESSES);
+        bufStats.add(BufStatsCounters::HITS);
+        // Keep the page from looking cold to the clock without writing to
+        // the frame on every read
+        if (!bufDesc.refbit.load(std::memory_order_relaxed)) {
+          bufDesc.refbit = true;
+        }
+        return true;
+      }
+    }
+  }
+
+  PageGuard page = readPage(file, pageNo);
+  reader(*page);
+  return false;
+}
+
+void BufMgr::readPage(File &file, const PageId pageNo, Page *&page,
+                      BufferAccessStrategy *strategy) {
+  BADGERDB_TRACE_START(traceStart);
+  std::mutex &partitionLatch = hashTable.latch(file, pageNo);
+  bufStats.add(BufStatsCounters::ACCESSES);
+
+  while (true) {
+    FrameId frameNo;  // will be frame number
+    bool found = false;
+    {
+      std::lock_guard<std::mutex> partitionGuard(partitionLatch);
+      // tryLookup sets frameNo if successful
+      found = hashTable.tryLookup(file, pageNo, frameNo);
+      if (found) {
+        // Since the page is already in the table do what is necessary
+        BufDesc *bufDesc = &bufDescTable.at(frameNo);
+        bufDesc->refbit = true;
+        pinFrame(*bufDesc);
+      }
+    }
+
+    if (found) {
+      if (waitForFrame(bufDescTable.at(frameNo))) {
+        bufStats.add(BufStatsCounters::HITS);
+        replacementPolicy->recordAccess(frameNo);
+        // Set page (this is the return value)
+        page = &bufPool.at(frameNo);
+        readAhead(file, pageNo);
+        BADGERDB_TRACE(TraceEvent::READ_HIT, traceStart, file.id(), pageNo, 0,
+                       0);
+        return;
+      }
+      continue;
+    }
 
     // allocate a buffer frame
     // FrameID of allocated frame set to frameNo
-    allocBuf(frameNo);
+    const std::chrono::steady_clock::time_point missStart =
+        std::chrono::steady_clock::now();
+    if (strategy != nullptr) {
+      allocRingBuf(*strategy, frameNo, file);
+    } else {
+      allocBuf(frameNo, homeNode(file.id(), pageNo), &file);
+    }
+    BufDesc *frameDesc = &bufDescTable.at(frameNo);
+    {
+      std::lock_guard<std::mutex> partitionGuard(partitionLatch);
+
+      // Another thread may have brought the page in while we were looking
+      // for a frame; if so, give our frame back and retry as a hit
+      FrameId loadedFrameNo;
+      if (hashTable.tryLookup(file, pageNo, loadedFrameNo)) {
+        frameDesc->latch.unlock();
+        replacementPolicy->recordRemoval(frameNo);
+        continue;
+      }
+
+      // insert page into hashtable
+      hashTable.insert(file, pageNo, frameNo);
 
-    // read the page from disk into the buffer pool frame
-    bufPool.at(frameNo) = file.readPage(pageNo);
+      // invoke Set() on the frame to set it up properly
+      setFrame(*frameDesc, file, pageNo);
+      linkFileFrame(*frameDesc, file);
+
+      // Scanned pages start out unreferenced so that the ring can recycle
+      // them
+      if (strategy != nullptr) frameDesc->refbit = false;
+    }
+    replacementPolicy->recordLoad(frameNo, file.id(), pageNo);
+
+    bool cached = false;
+    try {
+      // read the page from the victim cache or from disk into the buffer
+      // pool frame
+      cached = victimCache && victimCache->take(file.id(), file.filename(),
+                                                pageNo, bufPool.at(frameNo));
+      if (!cached) file.readPageInto(pageNo, bufPool.at(frameNo));
+    } catch (...) {
+      abandonFrame(*frameDesc);
+      throw;
+    }
+
+    frameDesc->markValid();
+    frameDesc->latch.unlock();
+    bufStats.add(BufStatsCounters::MISSES);
+    bufStats.add(cached ? BufStatsCounters::VICTIM_HITS
+                        : BufStatsCounters::DISK_READS);
+    bufStats.addLatency(BufStatsCounters::READ_MISS_LATENCY,
+                        std::chrono::steady_clock::now() - missStart);
     page = &bufPool.at(frameNo);
+    readAhead(file, pageNo);
+    BADGERDB_TRACE(TraceEvent::READ_MISS, traceStart, file.id(), pageNo, 0,
+                   cached);
+    return;
+  }
+}
 
-    // insert page into hashtable
-    hashTable.insert(file, pageNo, frameNo);
+bool BufMgr::startRead(File &file, const PageId pageNo, IoBatch &batch,
+                       FrameId &frameNo) {
+  std::mutex &partitionLatch = hashTable.latch(file, pageNo);
+  bufStats.add(BufStatsCounters::ACCESSES);
 
-    // invoke Set() on the frame to set it up properly
+  while (true) {
+    bool found;
+    {
+      std::lock_guard<std::mutex> partitionGuard(partitionLatch);
+      found = hashTable.tryLookup(file, pageNo, frameNo);
+      if (found) {
+        BufDesc *bufDesc = &bufDescTable.at(frameNo);
+        bufDesc->refbit = true;
+        pinFrame(*bufDesc);
+      }
+    }
+    if (found) {
+      if (waitForFrame(bufDescTable.at(frameNo))) {
+        bufStats.add(BufStatsCounters::HITS);
+        replacementPolicy->recordAccess(frameNo);
+        return true;
+      }
+      continue;
+    }
+
+    const std::chrono::steady_clock::time_point missStart =
+        std::chrono::steady_clock::now();
+    allocBuf(frameNo, homeNode(file.id(), pageNo), &file);
     BufDesc *frameDesc = &bufDescTable.at(frameNo);
-    frameDesc->Set(file, pageNo);
+    {
+      std::lock_guard<std::mutex> partitionGuard(partitionLatch);
+      FrameId loadedFrameNo;
+      if (hashTable.tryLookup(file, pageNo, loadedFrameNo)) {
+        frameDesc->latch.unlock();
+        replacementPolicy->recordRemoval(frameNo);
+        continue;
+      }
+      hashTable.insert(file, pageNo, frameNo);
+      setFrame(*frameDesc, file, pageNo);
+      linkFileFrame(*frameDesc, file);
+    }
+    replacementPolicy->recordLoad(frameNo, file.id(), pageNo);
 
+    bool cached;
+    try {
+      Page &page = bufPool.at(frameNo);
+      cached = victimCache &&
+               victimCache->take(file.id(), file.filename(), pageNo, page);
+      if (!cached) {
+        // The engine reads pages as they are stored; see loadPrefetched()
+        if (ioEngine && !file.isCompressed() && !file.isMapped()) {
+          file.queueRead(batch, pageNo, page);
+          ioEngine->submit(batch);
+          return false;
+        }
+        file.readPageInto(pageNo, page);
+      }
+    } catch (...) {
+      abandonFrame(*frameDesc);
+      throw;
+    }
+
+    frameDesc->markValid();
+    frameDesc->latch.unlock();
+    bufStats.add(BufStatsCounters::MISSES);
+    bufStats.add(cached ? BufStatsCounters::VICTIM_HITS
+                        : BufStatsCounters::DISK_READS);
+    bufStats.addLatency(BufStatsCounters::READ_MISS_LATENCY,
+                        std::chrono::steady_clock::now() - missStart);
+    return true;
+  }
+}
+
+PageGuard BufMgr::finishRead(
+    File &file, const PageId pageNo, const FrameId frameNo, const bool read,
+    const std::chrono::steady_clock::time_point missStart) {
+  BufDesc *frameDesc = &bufDescTable.at(frameNo);
+  Page &page = bufPool.at(frameNo);
+  try {
+    // Short reads, free pages and checksum mismatches are read again the
+    // way readPage() reads them, which reports what is wrong
+    if (!read || page.page_number() != pageNo || !file.verifyPage(page)) {
+      file.readPageInto(pageNo, page);
+    }
+  } catch (...) {
+    abandonFrame(*frameDesc);
+    throw;
+  }
+
+  frameDesc->markValid();
+  frameDesc->latch.unlock();
+  bufStats.add(BufStatsCounters::MISSES);
+  bufStats.add(BufStatsCounters::DISK_READS);
+  bufStats.addLatency(BufStatsCounters::READ_MISS_LATENCY,
+                      std::chrono::steady_clock::now() - missStart);
+  return PageGuard(this, frameNo, &page);
+}
+
+void BufMgr::abandonFrame(BufDesc &bufDesc) {
+  {
+    std::lock_guard<std::mutex> partitionGuard(
+        hashTable.latch(bufDesc.fileId, bufDesc.pageNo));
+    hashTable.tryRemove(bufDesc.fileId, bufDesc.pageNo);
+    // Threads that found the frame while it was loading still hold pins
+    // on it and release them in waitForFrame()
+    dropPin(bufDesc);
+    unlinkFileFrame(bufDesc);
+    bufDesc.fileId = File::INVALID_ID;
+    bufDesc.pageNo = Page::INVALID_NUMBER;
+    ++bufDesc.version;
+  }
+  replacementPolicy->recordRemoval(bufDesc.frameNo);
+  bufDesc.latch.unlock();
+}
+
+void BufMgr::readAhead(File &file, const PageId pageNo) {
+  if (readAheadPages == 0) {
     return;
   }
+
+  PageId firstPage;
+  PageId lastPage;
+  {
+    std::lock_guard<std::mutex> readAheadGuard(readAheadLatch);
+    ReadAhead &state = readAheadState[file.id()];
+    if (state.openNumber != file.openNumber()) {
+      state = ReadAhead{0, 0, file.openNumber()};
+    }
+    const bool sequential = pageNo == state.lastPageNo + 1;
+    state.lastPageNo = pageNo;
+    if (!sequential) {
+      state.prefetchedUpTo = pageNo;
+      return;
+    }
+
+    // Stay at least half a window ahead of the reader, issuing read-ahead
+    // half a window at a time
+    if (state.prefetchedUpTo > pageNo + readAheadPages / 2) {
+      return;
+    }
+    firstPage = std::max(pageNo, state.prefetchedUpTo) + 1;
+    lastPage = pageNo + readAheadPages;
+    state.prefetchedUpTo = lastPage;
+  }
+
+  if (lastPage >= firstPage) {
+    prefetch(file, firstPage, lastPage - firstPage + 1);
+  }
+}
+
+void BufMgr::prefetch(File &file, const PageId firstPage,
+                      std::uint32_t count) {
+  // Frames stay latched until their run has been read, so never claim more
+  // than a quarter of the buffer pool at once
+  count = std::min(count, std::max(numBufs / 4, 1u));
+  const PageId numPages = file.readHeader().num_pages;
+  if (firstPage == Page::INVALID_NUMBER || firstPage >= numPages) {
+    return;
+  }
+  count = std::min(count, numPages - firstPage);
+
+  // Frames claimed for the current run of pages that are not in the pool
+  std::vector<FrameId> frames;
+  PageId runStart = firstPage;
+
+  try {
+    for (PageId pageNo = firstPage; pageNo < firstPage + count; pageNo++) {
+      std::mutex &partitionLatch = hashTable.latch(file, pageNo);
+      FrameId frameNo;
+      bool resident;
+      {
+        std::lock_guard<std::mutex> partitionGuard(partitionLatch);
+        resident = hashTable.tryLookup(file, pageNo, frameNo);
+      }
+
+      if (!resident) {
+        try {
+          allocBuf(frameNo, homeNode(file.id(), pageNo), &file);
+        } catch (const BufferExceededException &) {
+          // Read-ahead is only a hint; load what we have frames for
+          break;
+        }
+
+        BufDesc *frameDesc = &bufDescTable.at(frameNo);
+        std::lock_guard<std::mutex> partitionGuard(partitionLatch);
+        FrameId loadedFrameNo;
+        resident = hashTable.tryLookup(file, pageNo, loadedFrameNo);
+        if (resident) {
+          frameDesc->latch.unlock();
+          replacementPolicy->recordRemoval(frameNo);
+        } else {
+          hashTable.insert(file, pageNo, frameNo);
+          setFrame(*frameDesc, file, pageNo);
+          linkFileFrame(*frameDesc, file);
+          // Prefetched pages have not been referenced yet
+          frameDesc->refbit = false;
+        }
+      }
+
+      if (resident) {
+        // The page splits the run; read what we have so far unless the I/O
+        // engine reads every page on its own anyway
+        if (!ioEngine) {
+          loadPrefetched(file, runStart, frames);
+          runStart = pageNo + 1;
+        }
+        continue;
+      }
+      replacementPolicy->recordLoad(frameNo, file.id(), pageNo);
+      frames.push_back(frameNo);
+    }
+  } catch (...) {
+    for (const FrameId frameNo : frames) {
+      abandonFrame(bufDescTable.at(frameNo));
+    }
+    throw;
+  }
+
+  loadPrefetched(file, runStart, frames);
+}
+
+void BufMgr::loadPrefetched(File &file, const PageId firstPage,
+                            std::vector<FrameId> &frames) {
+  std::vector<Page *> pages;
+  for (const FrameId frameNo : frames) {
+    pages.push_back(&bufPool.at(frameNo));
+  }
+
+  // Frames whose read did not transfer the whole page
+  std::vector<bool> failed(frames.size(), false);
+  try {
+    if (ioEngine && !file.isCompressed()) {
+      // One request per frame, all in flight at once
+      IoBatch batch;
+      for (std::size_t i = 0; i < frames.size(); i++) {
+        file.queueRead(batch, bufDescTable.at(frames[i]).pageNo, *pages[i]);
+      }
+      ioEngine->submit(batch);
+      batch.wait();
+      for (std::size_t i = 0; i < frames.size(); i++) {
+        failed[i] = batch.result(i) != static_cast<long>(Page::SIZE);
+      }
+    } else {
+      file.readPagesInto(firstPage, pages);
+    }
+  } catch (...) {
+    for (const FrameId frameNo : frames) {
+      abandonFrame(bufDescTable.at(frameNo));
+    }
+    frames.clear();
+    throw;
+  }
+
+  for (std::size_t i = 0; i < frames.size(); i++) {
+    BufDesc *frameDesc = &bufDescTable.at(frames[i]);
+    if (failed[i] || pages[i]->page_number() == Page::INVALID_NUMBER ||
+        !file.verifyPage(*pages[i])) {
+      // Unreadable, deleted or corrupt page; readPage() reports it if anyone
+      // asks for it
+      abandonFrame(*frameDesc);
+      continue;
+    }
+    // The copy read from disk is just as current
+    if (victimCache) victimCache->erase(file.id(), frameDesc->pageNo);
+    bufStats.add(BufStatsCounters::DISK_READS);
+    frameDesc->markValid();
+    dropPin(*frameDesc);
+    frameDesc->latch.unlock();
+  }
+  frames.clear();
 }
 
 void BufMgr::unPinPage(File &file, const PageId pageNo, const bool dirty) {
@@ -190,23 +1415,99 @@ void BufMgr::unPinPage(File &file, const PageId pageNo, const bool dirty) {
   // does nothing if page is not found in table
 
   FrameId frameNo;  // will be frame number
-  try {
-    // lookup sets frameNo if successful
-    hashTable.lookup(file, pageNo, frameNo);
+  std::lock_guard<std::mutex> partitionGuard(hashTable.latch(file, pageNo));
 
-    BufDesc *bufDesc = &bufDescTable.at(frameNo);
+  // tryLookup sets frameNo if successful
+  if (!hashTable.tryLookup(file, pageNo, frameNo)) {
+    // does nothing if page is not found in table
+    return;
+  }
 
-    if (bufDesc->pinCnt == 0) {
-      throw PageNotPinnedException(file.filename(), pageNo, frameNo);
-    }
+  BufDesc *bufDesc = &bufDescTable.at(frameNo);
 
-    bufDesc->pinCnt--;
-    if (bufDesc->dirty || dirty) bufDesc->dirty = true;
-  } catch (HashNotFoundException &e) {
-    // does nothing if page is not found in table
+  if (bufDesc->pinCnt == 0) {
+    throw PageNotPinnedException(file.filename(), pageNo, frameNo);
+  }
+
+  // Set the dirty bit before dropping the pin so that an eviction cannot
+  // see the page unpinned but clean
+  if (dirty) {
+    bufDesc->dirty = true;
+    ++bufDesc->version;
+  }
+  dropPin(*bufDesc);
+}
+
+void BufMgr::unPinFrame(const FrameId frameNo, const FileId fileId,
+                        const PageId pageNo, const std::uint32_t assignment,
+                        const bool dirty) {
+  BufDesc *bufDesc = &bufDescTable.at(frameNo);
+  // The pin keeps the frame mapped to its page, so the page need not be
+  // looked up again, unless disposePage() has cleared the frame and taken
+  // the pin with it
+  std::lock_guard<std::mutex> partitionGuard(hashTable.latch(fileId, pageNo));
+  if (bufDesc->assignment != assignment) {
+    return;
+  }
+  if (dirty) {
+    bufDesc->dirty = true;
+    ++bufDesc->version;
+  }
+  dropPin(*bufDesc);
+}
+
+PageGuard::PageGuard(BufMgr *bufMgr, const FrameId frameNo, Page *page)
+    : bufMgr(bufMgr),
+      frameNo(frameNo),
+      fileId(bufMgr->bufDescTable[frameNo].fileId),
+      pageNo(bufMgr->bufDescTable[frameNo].pageNo),
+      assignment(bufMgr->bufDescTable[frameNo].assignment),
+      page(page),
+      dirty(false) {}
+
+PageGuard::PageGuard(PageGuard &&other)
+    : bufMgr(other.bufMgr),
+      frameNo(other.frameNo),
+      fileId(other.fileId),
+      pageNo(other.pageNo),
+      assignment(other.assignment),
+      page(other.page),
+      dirty(other.dirty) {
+  other.bufMgr = nullptr;
+  other.page = nullptr;
+}
+
+PageGuard &PageGuard::operator=(PageGuard &&rhs) {
+  if (this != &rhs) {
+    release();
+    bufMgr = rhs.bufMgr;
+    frameNo = rhs.frameNo;
+    fileId = rhs.fileId;
+    pageNo = rhs.pageNo;
+    assignment = rhs.assignment;
+    page = rhs.page;
+    dirty = rhs.dirty;
+    rhs.bufMgr = nullptr;
+    rhs.page = nullptr;
+  }
+  return *this;
+}
+
+void PageGuard::release() {
+  if (bufMgr != nullptr) {
+    bufMgr->unPinFrame(frameNo, fileId, pageNo, assignment, dirty);
+    bufMgr = nullptr;
+    page = nullptr;
   }
 }
 
+PageGuard BufMgr::allocPage(File &file) {
+  PageId pageNo;
+  Page *page;
+  allocPage(file, pageNo, page);
+  return PageGuard(this, frameOf(page), page);
+}
+
 void BufMgr::allocPage(File &file, PageId &pageNo, Page *&page) {
   // allocate empty page in specificed file by invoking file.allocatePage()
   // newly allocated page gets returned
@@ -217,77 +1518,246 @@ void BufMgr::allocPage(File &file, PageId &pageNo, Page *&page) {
 
   // Get new Frame
   FrameId frameNo;  // will be frame number
-  allocBuf(frameNo);
+  // The page number is not known yet, so new pages start out local
+  allocBuf(frameNo, localNode(), &file);
+  BufDesc *frameDesc = &bufDescTable.at(frameNo);
 
-  Page newPage = file.allocatePage();
+  try {
+    // The new page is placed straight into the buffer frame
+    file.allocatePageInto(bufPool.at(frameNo));
 
-  // Returns both page number of the newly allocated page to the caller via the
-  //    pageNo parameter and a pointer to the BUFFER FRAME allocated for the
-  //    page via the page parameter
-  pageNo = newPage.page_number();
-  bufPool.at(frameNo) = newPage;
-  page = &bufPool.at(frameNo);
+    // Returns both page number of the newly allocated page to the caller via
+    //    the pageNo parameter and a pointer to the BUFFER FRAME allocated for
+    //    the page via the page parameter
+    pageNo = bufPool.at(frameNo).page_number();
+    page = &bufPool.at(frameNo);
+  } catch (...) {
+    // The policy took the frame off its free list when it handed it out
+    replacementPolicy->recordRemoval(frameNo);
+    frameDesc->latch.unlock();
+    throw;
+  }
+  // The page number may be one that was deleted from the file
+  if (victimCache) victimCache->erase(file.id(), pageNo);
 
-  // insert page into hashtable
-  hashTable.insert(file, pageNo, frameNo);
+  // Reported before the page becomes visible so that no hit precedes it
+  replacementPolicy->recordLoad(frameNo, file.id(), pageNo);
+  {
+    std::lock_guard<std::mutex> partitionGuard(hashTable.latch(file, pageNo));
 
-  // invoke Set() on the frame to set it up properly
-  BufDesc *frameDesc = &bufDescTable.at(frameNo);
-  frameDesc->Set(file, pageNo);
+    // insert page into hashtable
+    hashTable.insert(file, pageNo, frameNo);
+
+    // invoke Set() on the frame to set it up properly
+    setFrame(*frameDesc, file, pageNo);
+    linkFileFrame(*frameDesc, file);
+    frameDesc->markValid();
+  }
+  frameDesc->latch.unlock();
+  bufStats.add(BufStatsCounters::ACCESSES);
+  bufStats.add(BufStatsCounters::DISK_READS);
 }
 
-void BufMgr::flushFile(File &file) {
-  // iterate through bufTable to find pages corresponding to our
-  // File parameter
-  for (FrameId i = 0; i < numBufs; ++i) {
-    BufDesc *bufDesc = &bufDescTable.at(i);
+void BufMgr::allocPages(File &file, const std::uint32_t count,
+                        PageId &firstPageNo, std::vector<Page *> &pages) {
+  // Claim every frame up front so that the file is only extended once all of
+  // the pages have a place to go
+  std::vector<FrameId> frames;
+  std::vector<Page *> framePages;
+  try {
+    while (frames.size() < count) {
+      FrameId frameNo;
+      allocBuf(frameNo, localNode(), &file);
+      frames.push_back(frameNo);
+      framePages.push_back(&bufPool.at(frameNo));
+    }
+    // One write for the whole run, straight into the buffer frames
+    firstPageNo = file.allocateExtentInto(framePages);
+  } catch (...) {
+    // The policy took the frames off its free list when it handed them out
+    for (const FrameId frameNo : frames) {
+      replacementPolicy->recordRemoval(frameNo);
+      bufDescTable.at(frameNo).latch.unlock();
+    }
+    throw;
+  }
 
-    if (bufDesc->file == file) {
-      PageId pageNo = bufDesc->pageNo;
+  for (std::size_t i = 0; i < frames.size(); i++) {
+    const PageId pageNo = firstPageNo + i;
+    BufDesc *frameDesc = &bufDescTable.at(frames[i]);
+    replacementPolicy->recordLoad(frames[i], file.id(), pageNo);
+    {
+      std::lock_guard<std::mutex> partitionGuard(
+          hashTable.latch(file, pageNo));
+      hashTable.insert(file, pageNo, frames[i]);
+      setFrame(*frameDesc, file, pageNo);
+      linkFileFrame(*frameDesc, file);
+      frameDesc->markValid();
+    }
+    frameDesc->latch.unlock();
+    pages.push_back(framePages[i]);
+  }
+  bufStats.add(BufStatsCounters::ACCESSES, frames.size());
+  bufStats.add(BufStatsCounters::DISK_READS, frames.size());
+}
 
-      // check if page is pinned
-      if (bufDesc->pinCnt != 0) {
-        // throw file name, page number, and frame number
-        throw PagePinnedException(file.filename(), pageNo, i);
+void BufMgr::flushFile(File &file, const bool sync) {
+  BADGERDB_TRACE_START(traceStart);
+  // Dirty frames of the file by page number.  They stay pinned by us until
+  // they have been written, which keeps them from being evicted.
+  std::vector<std::pair<PageId, FrameId>> dirtyFrames;
+  try {
+    // only look at the frames holding pages of our File parameter
+    for (const FrameId i : framesOfFile(file)) {
+      BufDesc *bufDesc = &bufDescTable.at(i);
+      std::lock_guard<std::mutex> frameGuard(bufDesc->latch);
+
+      if (bufDesc->fileId == file.id()) {
+        PageId pageNo = bufDesc->pageNo;
+        std::lock_guard<std::mutex> partitionGuard(
+            hashTable.latch(file, pageNo));
+
+        // check if page is pinned
+        if (bufDesc->pinCnt != 0) {
+          // throw file name, page number, and frame number
+          throw PagePinnedException(file.filename(), pageNo, i);
+        }
+
+        // check if page is valid
+        if (bufDesc->valid == false) {
+          // throw framenumber, dirty, refbit
+          throw BadBufferException(i, bufDesc->dirty, bufDesc->valid,
+                                   bufDesc->refbit);
+        }
+
+        // check if page's dirty bit is set
+        if (bufDesc->dirty.exchange(false)) {
+          pinFrame(*bufDesc);
+          dirtyFrames.push_back(std::make_pair(pageNo, i));
+        }
       }
+    }
 
-      // check if page is valid
-      if (bufDesc->valid == false) {
-        // throw framenumber, dirty, refbit
-        throw BadBufferException(i, bufDesc->dirty, bufDesc->valid,
-                                 bufDesc->refbit);
-      }
+    // write the pages to disk straight from the frames, in file order
+    std::sort(dirtyFrames.begin(), dirtyFrames.end());
+    std::vector<const Page *> pages;
+    Lsn maxLsn = 0;
+    for (const std::pair<PageId, FrameId> &entry : dirtyFrames) {
+      pages.push_back(&bufPool.at(entry.second));
+      maxLsn = std::max(maxLsn, pages.back()->lsn());
+    }
+    // Log before the pages
+    if (log != nullptr) log->flush(maxLsn);
+    const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    file.writePages(pages, sync);
+    if (!pages.empty()) {
+      bufStats.addLatency(BufStatsCounters::WRITE_LATENCY,
+                          std::chrono::steady_clock::now() - start);
+      bufStats.add(BufStatsCounters::DISK_WRITES, pages.size());
+    }
+  } catch (...) {
+    for (const std::pair<PageId, FrameId> &entry : dirtyFrames) {
+      BufDesc *bufDesc = &bufDescTable.at(entry.second);
+      bufDesc->dirty = true;
+      std::lock_guard<std::mutex> partitionGuard(
+          hashTable.latch(file, entry.first));
+      dropPin(*bufDesc);
+    }
+    throw;
+  }
 
-      // check if page's dirty bit is set
-      if (bufDesc->dirty == true) {
-        // assign current page a var
-        Page currPage = bufPool.at(i);
+  for (const std::pair<PageId, FrameId> &entry : dirtyFrames) {
+    BufDesc *bufDesc = &bufDescTable.at(entry.second);
+    std::lock_guard<std::mutex> frameGuard(bufDesc->latch);
+    std::lock_guard<std::mutex> partitionGuard(
+        hashTable.latch(file, entry.first));
+    if (bufDesc->fileId != file.id() || bufDesc->pageNo != entry.first) {
+      // Disposed of while it was written
+      continue;
+    }
+    dropPin(*bufDesc);
+    // A page that was pinned while it was written stays in the pool
+    if (bufDesc->pinCnt == 0 && !bufDesc->dirty) {
+      // remove page from hash table
+      hashTable.remove(file, entry.first);
+
+      // invoke clear method of bufDesc for page frame
+      unlinkFileFrame(*bufDesc);
+      clearFrame(*bufDesc);
+      replacementPolicy->recordRemoval(entry.second);
+    }
+  }
 
-        // write page to disk
-        bufDesc->file.writePage(currPage);
+  // The file may be closed and changed by others once it is flushed
+  if (victimCache) victimCache->eraseFile(file.id());
+  BADGERDB_TRACE(TraceEvent::FLUSH_FILE, traceStart, file.id(),
+                 Page::INVALID_NUMBER, dirtyFrames.size(), 0);
+}
 
-        // reset dirty bit
-        bufDesc->dirty = false;
+TenantId BufMgr::addTenant(const TenantOptions &options) {
+  std::lock_guard<std::mutex> fileFramesGuard(fileFramesLatch);
+  tenants.push_back(Tenant{options, 0});
+  return static_cast<TenantId>(tenants.size() - 1);
+}
 
-        // remove page from hash table
-        hashTable.remove(file, pageNo);
+void BufMgr::setFileTenant(const File &file, const TenantId tenant) {
+  std::lock_guard<std::mutex> fileFramesGuard(fileFramesLatch);
+  Tenant &newTenant = tenants.at(tenant);
+  if (tenant == 0) {
+    fileTenants.erase(file.id());
+  } else {
+    fileTenants[file.id()] = FileTenant{file.openNumber(), tenant};
+  }
 
-        // invoke clear method of bufDesc for page frame
-        bufDesc->clear();
-      }
-    }
+  // Move the pages already in the pool
+  std::map<FileId, FileEntry>::const_iterator entry = fileTable.find(file.id());
+  if (entry == fileTable.end()) {
+    return;
+  }
+  for (FrameId i = entry->second.firstFrame; i != BufDesc::NO_FRAME;
+       i = bufDescTable[i].nextFileFrame) {
+    BufDesc &bufDesc = bufDescTable[i];
+    tenants[bufDesc.tenant].frames--;
+    newTenant.frames++;
+    bufDesc.tenant = tenant;
+    bufDesc.priority = newTenant.options.priority;
   }
 }
 
+std::uint32_t BufMgr::tenantFrames(const TenantId tenant) {
+  std::lock_guard<std::mutex> fileFramesGuard(fileFramesLatch);
+  return tenants.at(tenant).frames;
+}
+
 void BufMgr::disposePage(File &file, const PageId PageNo) {
   FrameId frameNo;
-  hashTable.lookup(file, PageNo, frameNo);
+  std::mutex &partitionLatch = hashTable.latch(file, PageNo);
+  bool found;
+  {
+    std::lock_guard<std::mutex> partitionGuard(partitionLatch);
+    found = hashTable.tryLookup(file, PageNo, frameNo);
+  }
 
-  // free frame
-  bufDescTable.at(frameNo).clear();
+  // Only free the frame if the page is in the buffer pool at all
+  BufDesc *bufDesc = found ? &bufDescTable.at(frameNo) : nullptr;
+  if (bufDesc != nullptr) {
+    // Latch order is frame before partition, so look the frame up again once
+    // both are held
+    std::lock_guard<std::mutex> frameGuard(bufDesc->latch);
+    std::lock_guard<std::mutex> partitionGuard(partitionLatch);
+    if (bufDesc->fileId == file.id() && bufDesc->pageNo == PageNo) {
+      // free frame
+      unlinkFileFrame(*bufDesc);
+      clearFrame(*bufDesc);
+
+      // corresponding entry is removed
+      hashTable.remove(file, PageNo);
+      replacementPolicy->recordRemoval(frameNo);
+    }
+  }
 
-  // corresponding entry is removed
-  hashTable.remove(file, PageNo);
+  if (victimCache) victimCache->erase(file.id(), PageNo);
 
   // delete page from file
   file.deletePage(PageNo);
@@ -8,11 +8,25 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
+#include "async_io.h"
+#include "buf_stats.h"
 #include "bufHashTbl.h"
 #include "file.h"
+#include "numa.h"
+#include "replacement_policy.h"
+#include "victim_cache.h"
 
 namespace badgerdb {
 
@@ -20,28 +34,83 @@ namespace badgerdb {
  * forward declaration of BufMgr class
  */
 class BufMgr;
+class LogManager;
+
+/**
+ * @brief Priority class of the pages of a tenant; see BufMgr::addTenant()
+ */
+enum class BufferPriority : std::uint8_t {
+  /**
+   * Pages of batch work.  The clock evicts them without the second chance
+   * it gives referenced pages.
+   */
+  LOW,
+
+  /**
+   * Pages the replacement policy evicts as it sees fit
+   */
+  NORMAL,
+
+  /**
+   * Pages that are never picked as victims, such as metadata.  They leave
+   * the buffer pool only when they are flushed or disposed of, or when the
+   * pool shrinks.
+   */
+  HIGH
+};
+
+/**
+ * Identifier of a tenant of a BufMgr.  Tenant 0 holds every file that has
+ * not been assigned to another one.
+ */
+typedef std::uint32_t TenantId;
 
 /**
  * @brief Class for maintaining information about buffer pool frames
+ *
+ * The pin count and the status bits are atomic so that threads can pin and
+ * unpin pages without taking the frame latch.  Pins are only taken while the
+ * hash table partition of the page is latched, which is what makes it safe
+ * for the eviction path to check for a zero pin count and unmap the frame.
+ *
+ * The version lets readers use a frame without pinning it: it changes
+ * whenever the frame is assigned to a page, becomes valid or is given up, and
+ * whenever a pinned page is unpinned dirty.  A reader that finds the page
+ * unpinned and the version the same after reading it has read a stable page.
  */
 class BufDesc {
  public:
   /**
    * Constructor of BufDesc class
    */
-  BufDesc() { clear(); }
+  BufDesc()
+      : version(0),
+        assignment(0),
+        prevFileFrame(NO_FRAME),
+        nextFileFrame(NO_FRAME),
+        tenant(0),
+        priority(BufferPriority::NORMAL) {
+    clear();
+  }
 
  private:
   friend class BufMgr;
+  friend class PageGuard;
+  /**
+   * Identifier of the file to which corresponding frame is assigned
+   */
+  std::atomic<FileId> fileId;
+
   /**
-   * Pointer to file to which corresponding frame is assigned
+   * The file itself, kept in the file table of the buffer manager while the
+   * frame is linked into the list of frames of the file.  Null otherwise.
    */
-  File file;
+  File* file;
 
   /**
    * Page within file to which corresponding frame is assigned
    */
-  PageId pageNo;
+  std::atomic<PageId> pageNo;
 
   /**
    * Frame number of the frame, in the buffer pool, being used
@@ -51,55 +120,108 @@ class BufDesc {
   /**
    * Number of times this page has been pinned
    */
-  int pinCnt;
+  std::atomic<int> pinCnt;
 
   /**
    * True if page is dirty;  false otherwise
    */
-  bool dirty;
+  std::atomic<bool> dirty;
 
   /**
-   * True if page is valid
+   * True if page is valid, i.e. the frame holds the contents of pageNo
    */
-  bool valid;
+  std::atomic<bool> valid;
 
   /**
    * Has this buffer frame been reference recently
    */
-  bool refbit;
+  std::atomic<bool> refbit;
+
+  /**
+   * Version of the frame's assignment and contents; see the class comment
+   */
+  std::atomic<std::uint32_t> version;
+
+  /**
+   * Number of times the frame has been assigned to a page or given up.  A
+   * pin belongs to the assignment it was taken in, which tells a guard on a
+   * disposed page from one on a page that reused its number.
+   */
+  std::atomic<std::uint32_t> assignment;
+
+  /**
+   * Latch held while the frame is being assigned to a page or while its
+   * contents are being read from disk
+   */
+  std::mutex latch;
+
+  /**
+   * Marks the ends of the per-file frame lists
+   */
+  static const FrameId NO_FRAME = std::numeric_limits<FrameId>::max();
+
+  /**
+   * Neighbours in the list of frames holding pages of the same file.
+   * Protected by BufMgr::fileFramesLatch.
+   */
+  FrameId prevFileFrame;
+  FrameId nextFileFrame;
+
+  /**
+   * Tenant of the file of the page and the priority of that tenant.  Set
+   * while the frame is linked into the list of frames of its file.
+   */
+  std::atomic<TenantId> tenant;
+  std::atomic<BufferPriority> priority;
 
   /**
    * Initialize buffer frame for a new user
    */
   void clear() {
     pinCnt = 0;
-    file = File();
+    fileId = File::INVALID_ID;
+    file = nullptr;
     pageNo = Page::INVALID_NUMBER;
     dirty = false;
     refbit = false;
     valid = false;
+    ++version;
+    ++assignment;
+  }
+
+  /**
+   * Marks the frame as holding the contents of its page
+   */
+  void markValid() {
+    valid = true;
+    ++version;
   }
 
   /**
    * Set values of member variables corresponding to assignment of frame to a
    * page in the file. Called when a frame in buffer pool is allocated to any
-   * page in the file through readPage() or allocPage()
+   * page in the file through readPage() or allocPage().  The frame is only
+   * marked valid once the caller has placed the page contents in it, and
+   * only refers to the File object once it has been linked into the list
+   * of frames of the file.
    *
    * @param filePtr	File object
    * @param pageNum	Page number in the file
    */
-  void Set(File& file, PageId pageNum) {
-    this->file = file;
+  void Set(const File& file, PageId pageNum) {
+    fileId = file.id();
     pageNo = pageNum;
     pinCnt = 1;
     dirty = false;
-    valid = true;
+    valid = false;
     refbit = true;
+    ++version;
+    ++assignment;
   }
 
   void Print() {
-    if (file.isValid()) {
-      std::cout << "file:" << file.filename() << " ";
+    if (file != nullptr) {
+      std::cout << "file:" << file->filename() << " ";
       std::cout << "pageNo:" << pageNo << " ";
     } else
       std::cout << "file:NULL ";
@@ -112,50 +234,386 @@ class BufDesc {
 };
 
 /**
- * @brief Class to maintain statistics of buffer usage
+ * @brief Access strategy for bulk sequential scans
+ *
+ * Pages read through a strategy are loaded into a small ring of frames that
+ * is recycled within the scan, so that reading a large file once does not
+ * push the working set of other callers out of the buffer pool.  A frame
+ * leaves the ring if somebody else references its page; pages that are
+ * already in the buffer pool are used where they are.
+ *
+ * A strategy belongs to a single thread and a single BufMgr.
  */
-struct BufStats {
+class BufferAccessStrategy {
+ public:
   /**
-   * Total number of accesses to buffer pool
+   * Default number of frames in the ring (256 KB of pages)
    */
-  int accesses;
+  static const std::uint32_t DEFAULT_RING_SIZE = 32;
 
   /**
-   * Number of pages read from disk (including allocs)
+   * Constructor of BufferAccessStrategy class
+   *
+   * @param ringSize  Number of frames the scan cycles through
    */
-  int diskreads;
+  explicit BufferAccessStrategy(std::uint32_t ringSize = DEFAULT_RING_SIZE)
+      : ring(ringSize > 0 ? ringSize : 1, NO_FRAME), current(0) {}
+
+ private:
+  friend class BufMgr;
 
   /**
-   * Number of pages written back to disk
+   * Marks a ring slot that has no frame yet
    */
-  int diskwrites;
+  static const FrameId NO_FRAME = std::numeric_limits<FrameId>::max();
 
   /**
-   * Clear all values
+   * Frames most recently loaded by the scan
    */
-  void clear() { accesses = diskreads = diskwrites = 0; }
+  std::vector<FrameId> ring;
 
   /**
-   * Constructor of BufStats class
+   * Slot of the ring filled last
    */
-  BufStats() { clear(); }
+  std::uint32_t current;
+};
+
+/**
+ * @brief A pin on a page in the buffer pool, released when the guard goes out
+ * of scope
+ *
+ * The guard remembers the frame the page is in, so releasing it unpins the
+ * frame directly instead of looking the page up in the hash table again.
+ * Releasing a guard whose page has been disposed of meanwhile does nothing.
+ * Guards can be moved but not copied; an empty guard holds no pin.
+ */
+class PageGuard {
+ public:
+  /**
+   * Constructs an empty guard
+   */
+  PageGuard()
+      : bufMgr(nullptr),
+        frameNo(0),
+        fileId(File::INVALID_ID),
+        pageNo(Page::INVALID_NUMBER),
+        assignment(0),
+        page(nullptr),
+        dirty(false) {}
+
+  PageGuard(PageGuard&& other);
+  PageGuard& operator=(PageGuard&& rhs);
+  PageGuard(const PageGuard&) = delete;
+  PageGuard& operator=(const PageGuard&) = delete;
+
+  /**
+   * Destructor of PageGuard class.  Unpins the page if the guard holds it.
+   */
+  ~PageGuard() { release(); }
+
+  /**
+   * Marks the page dirty once it is unpinned
+   */
+  void markDirty() { dirty = true; }
+
+  /**
+   * Unpins the page now and leaves the guard empty
+   */
+  void release();
+
+  /**
+   * Returns the pinned page, or nullptr if the guard is empty
+   */
+  Page* get() const { return page; }
+  Page& operator*() const { return *page; }
+  Page* operator->() const { return page; }
+
+  /**
+   * Returns true if the guard holds a pin
+   */
+  explicit operator bool() const { return page != nullptr; }
+
+ private:
+  friend class BufMgr;
+
+  /**
+   * Constructs a guard holding a pin on the page in the given frame
+   */
+  PageGuard(BufMgr* bufMgr, const FrameId frameNo, Page* page);
+
+  /**
+   * Buffer manager the pin is held in, or nullptr if the guard is empty
+   */
+  BufMgr* bufMgr;
+
+  /**
+   * Frame of the page, the file and number of the page, the assignment of
+   * the frame the pin was taken in, and the page itself
+   */
+  FrameId frameNo;
+  FileId fileId;
+  PageId pageNo;
+  std::uint32_t assignment;
+  Page* page;
+
+  /**
+   * True if markDirty() has been called
+   */
+  bool dirty;
+};
+
+/**
+ * @brief How a page picks the NUMA partition of the buffer pool it is loaded
+ * into
+ */
+enum class NumaHoming {
+  /**
+   * By the hash of the page, which also picks its hash table partition, so a
+   * page always comes back to the same node
+   */
+  HASH,
+
+  /**
+   * By the node of the thread that first reads the page
+   */
+  FIRST_TOUCH
+};
+
+/**
+ * @brief Share of the buffer pool a tenant is given; see BufMgr::addTenant()
+ */
+struct TenantOptions {
+  /**
+   * Largest number of frames the pages of the tenant may hold, or 0 for no
+   * limit.  A tenant at its limit gets frames by evicting its own pages.
+   */
+  std::uint32_t maxFrames = 0;
+
+  /**
+   * Priority class of the pages of the tenant
+   */
+  BufferPriority priority = BufferPriority::NORMAL;
+};
+
+/**
+ * @brief Options a BufMgr is constructed with
+ */
+struct BufMgrOptions {
+  /**
+   * Number of independently latched hash table partitions; use more than one
+   * when several threads share the manager
+   */
+  std::uint32_t hashPartitions = 1;
+
+  /**
+   * Largest number of frames BufMgr::resize() can grow the buffer pool to;
+   * 0 means the initial size.  Address space and frame descriptors are
+   * reserved for all of them, but page memory is only used by frames that
+   * are in the pool.
+   */
+  std::uint32_t maxBufs = 0;
+
+  /**
+   * Number of NUMA partitions to split the buffer pool into; 0 or 1 keeps a
+   * single pool.  Every partition has its own replacement policy, and its
+   * memory is placed on node i modulo NumaTopology::get().nodes().  The
+   * number of hash table partitions is rounded up to a multiple of it.
+   */
+  std::uint32_t numaNodes = 0;
+
+  /**
+   * How pages are assigned to NUMA partitions
+   */
+  NumaHoming numaHoming = NumaHoming::FIRST_TOUCH;
+
+  /**
+   * Sidecar file that keeps the cache warm across restarts: if set, the
+   * constructor prefetches the pages listed in it and the destructor writes
+   * out the pages that are in the pool then.  See saveResidentPages().
+   */
+  std::string warmCacheFile;
+
+  /**
+   * Write-ahead log of the changes to the pages, or null.  The log is made
+   * durable up to the LSN of a page before the page is written back.
+   */
+  LogManager* log = nullptr;
+
+  /**
+   * True to back the buffer pool with 2 MB pages.  Uses reserved huge pages
+   * if there are any and transparent huge pages otherwise; ignored on
+   * platforms other than Linux.
+   */
+  bool hugePages = false;
+
+  /**
+   * Policy that picks the frame to reuse when the buffer pool is full
+   */
+  ReplacementPolicyType replacementPolicy = ReplacementPolicyType::CLOCK;
+
+  /**
+   * Number of pages to read ahead once readPage() sees sequential access to a
+   * file; 0 turns read-ahead off.  Capped at a quarter of the buffer pool.
+   */
+  std::uint32_t readAheadPages = 0;
+
+  /**
+   * Engine that prefetches are read through.  With an engine every page is
+   * read with a request of its own and all of them are in flight at once;
+   * without one each run of consecutive pages is read synchronously.
+   */
+  IoEngineType ioEngine = IoEngineType::NONE;
+
+  /**
+   * Maximum number of requests the I/O engine keeps in flight
+   */
+  std::uint32_t ioQueueDepth = 32;
+
+  /**
+   * True to run a background writer thread that writes out dirty pages in
+   * the frames the replacement policy is about to evict, so that misses find
+   * clean victims
+   */
+  bool backgroundWriter = false;
+
+  /**
+   * Milliseconds between rounds of the background writer.  A miss that has
+   * to write back a dirty victim starts the next round early.
+   */
+  std::uint32_t writerIntervalMs = 20;
+
+  /**
+   * Number of upcoming victims the background writer looks at per round
+   */
+  std::uint32_t writerLookahead = 64;
+
+  /**
+   * Maximum number of pages the background writer writes per round
+   */
+  std::uint32_t writerMaxPages = 16;
+
+  /**
+   * Milliseconds between checkpoints taken by a background checkpointer
+   * thread, or 0 for no such thread.  See BufMgr::checkpoint().
+   */
+  std::uint32_t checkpointIntervalMs = 0;
+
+  /**
+   * Number of pages a checkpoint writes before it pauses
+   */
+  std::uint32_t checkpointBatchPages = 16;
+
+  /**
+   * Milliseconds a checkpoint pauses between batches of pages, which keeps
+   * its writes from crowding out foreground I/O
+   */
+  std::uint32_t checkpointPauseMs = 1;
+
+  /**
+   * Memory cap in bytes of a second tier that keeps evicted pages compressed
+   * in memory, or 0 for none.  See VictimCache.
+   */
+  std::size_t victimCacheBytes = 0;
 };
 
 /**
  * @brief The central class which manages the buffer pool including frame
  * allocation and deallocation to pages in the file
+ *
+ * readPage(), unPinPage(), allocPage() and disposePage() may be called from
+ * several threads at once.  Page hits only latch the hash table partition of
+ * the page, so constructing the manager with more hash partitions lets hits
+ * on different pages proceed in parallel.  Misses additionally serialize on
+ * the replacement policy while they look for a victim frame, but not while
+ * they do disk I/O.
  */
-class BufMgr {
+class BufMgr : private VictimProbe {
  private:
+  friend class PageGuard;
+  friend class PageFetcher;
+
+  /**
+   * Picks the victim frames; see BufMgrOptions::replacementPolicy
+   */
+  std::unique_ptr<ReplacementPolicy> replacementPolicy;
+
+  /**
+   * Number of frames in the buffer pool.  Frames from numBufs up to maxBufs
+   * are reserved for growing the pool and are never handed out.
+   */
+  std::atomic<std::uint32_t> numBufs;
+
+  /**
+   * Number of frames reserved; see BufMgrOptions::maxBufs
+   */
+  std::uint32_t maxBufs;
+
+  /**
+   * Number of frames with at least one pin.  Once it reaches numBufs no
+   * frame can be handed out, which allocBuf() sees without a sweep.
+   */
+  std::atomic<std::uint32_t> pinnedFrames;
+
+  /**
+   * Latch serializing calls to resize()
+   */
+  std::mutex resizeLatch;
+
+  /**
+   * NUMA settings; see BufMgrOptions.  Frames are split between the
+   * partitions in stripes of numaStripeFrames.
+   */
+  std::uint32_t numaNodes;
+  NumaHoming numaHoming;
+  std::uint32_t numaStripeFrames;
+
+  /**
+   * Granularity in which memory of the buffer pool is returned to the
+   * operating system when it shrinks; also the size of a huge page
+   */
+  static const std::size_t POOL_CHUNK_SIZE = 2 * 1024 * 1024;
+
   /**
-   * Current position of clockhand in our buffer pool
+   * How long resize() waits for a page in a frame it removes to be unpinned
    */
-  FrameId clockHand;
+  static const std::uint32_t RESIZE_PIN_WAIT_MS = 100;
 
   /**
-   * Number of frames in the buffer pool
+   * Read-ahead window; see BufMgrOptions::readAheadPages
    */
-  std::uint32_t numBufs;
+  std::uint32_t readAheadPages;
+
+  /**
+   * Sequential access tracking of a file for read-ahead
+   */
+  struct ReadAhead {
+    /**
+     * Page read last
+     */
+    PageId lastPageNo;
+
+    /**
+     * Last page that read-ahead has been issued for
+     */
+    PageId prefetchedUpTo;
+
+    /**
+     * Open number of the file; see File::openNumber()
+     */
+    std::uint64_t openNumber;
+  };
+
+  /**
+   * Read-ahead state of every file with pages in the buffer pool.  An entry
+   * is dropped with the file table entry of its file, and one left by an
+   * earlier file with the same identifier is started over.
+   */
+  std::map<FileId, ReadAhead> readAheadState;
+
+  /**
+   * Latch protecting readAheadState
+   */
+  std::mutex readAheadLatch;
 
   /**
    * Hash table mapping (File, page) to frame
@@ -168,25 +626,452 @@ class BufMgr {
    */
   std::vector<BufDesc> bufDescTable;
 
+  /**
+   * Entry of the file table: a File object for the file, shared by all of
+   * the frames holding its pages, and the first of those frames, linked
+   * through BufDesc::nextFileFrame
+   */
+  struct FileEntry {
+    File file;
+    FrameId firstFrame;
+  };
+
+  /**
+   * Files with pages in the buffer pool, by identifier.  An entry is added
+   * when the first page of a file is assigned a frame and removed when the
+   * last one leaves, so frames never copy File objects around.
+   */
+  std::map<FileId, FileEntry> fileTable;
+
+  /**
+   * Options of a tenant and the number of frames its pages hold
+   */
+  struct Tenant {
+    TenantOptions options;
+    std::uint32_t frames;
+  };
+
+  /**
+   * Tenant a file is assigned to, and the open number of the file; an entry
+   * whose file has since been closed and its identifier handed to another
+   * file is stale
+   */
+  struct FileTenant {
+    std::uint64_t openNumber;
+    TenantId tenant;
+  };
+
+  /**
+   * Tenants by identifier, and the tenant of every file assigned to one
+   * other than tenant 0.  Protected by fileFramesLatch.
+   */
+  std::vector<Tenant> tenants;
+  std::map<FileId, FileTenant> fileTenants;
+
+  /**
+   * Latch protecting fileTable, the tenants and the list links in the
+   * frames.  No other latch is taken while it is held.
+   */
+  std::mutex fileFramesLatch;
+
   /**
    * Maintains Buffer pool usage statistics
    */
-  BufStats bufStats;
+  BufStatsCounters bufStats;
+
+  /**
+   * Asynchronous I/O engine; see BufMgrOptions::ioEngine.  May be null.
+   */
+  std::unique_ptr<IoEngine> ioEngine;
+
+  /**
+   * Sidecar file of the resident pages; see BufMgrOptions::warmCacheFile
+   */
+  std::string warmCacheFile;
+
+  /**
+   * Write-ahead log; see BufMgrOptions::log.  May be null.
+   */
+  LogManager* log;
+
+  /**
+   * Compressed pages evicted from the pool; see
+   * BufMgrOptions::victimCacheBytes.  May be null.
+   */
+  std::unique_ptr<VictimCache> victimCache;
+
+  /**
+   * Background writer settings; see BufMgrOptions
+   */
+  std::uint32_t writerIntervalMs;
+  std::uint32_t writerLookahead;
+  std::uint32_t writerMaxPages;
+
+  /**
+   * Checkpoint settings; see BufMgrOptions
+   */
+  std::uint32_t checkpointIntervalMs;
+  std::uint32_t checkpointBatchPages;
+  std::uint32_t checkpointPauseMs;
+
+  /**
+   * Set when the background writer and checkpointer have to stop
+   */
+  bool writerStopping;
+
+  /**
+   * Latch the background writer and checkpointer sleep under, and the
+   * conditions they sleep on between rounds
+   */
+  std::mutex writerLatch;
+  std::condition_variable writerWake;
+  std::condition_variable checkpointWake;
+
+  /**
+   * The background writer thread, if there is one
+   */
+  std::thread writerThread;
+
+  /**
+   * The background checkpointer thread, if there is one
+   */
+  std::thread checkpointerThread;
+
+  /**
+   * Memory backing the buffer pool: maxBufs page images laid out back to
+   * back, each one viewed by the Page of the same index in bufPool
+   */
+  char* poolArena;
+
+  /**
+   * Size of poolArena in bytes
+   */
+  std::size_t poolArenaSize;
+
+  /**
+   * True if poolArena was obtained with mmap() rather than posix_memalign()
+   */
+  bool poolArenaMapped;
+
+  /**
+   * Allocates poolArena as a single block aligned to Page::ALIGNMENT.
+   *
+   * @param hugePages True to back the arena with 2 MB pages where the
+   * operating system supports it
+   */
+  void allocPoolArena(const bool hugePages);
 
   /**
-   * Advance clock to next frame in the buffer pool
+   * Returns the memory of the whole chunks of the arena that only hold
+   * frames from first up to last to the operating system.  Their images
+   * read as zeroes afterwards.  Does nothing on platforms other than Linux.
+   *
+   * @param first First frame that is no longer in use
+   * @param last  End of the frames that are no longer in use
    */
-  void advanceClock();
+  void releaseFrames(const FrameId first, const FrameId last);
 
   /**
-   * Allocate a free frame.
+   * Allocate a free frame.  The frame is returned with its latch held and no
+   * page mapped to it; the caller releases the latch once it has set up the
+   * frame.
    *
    * @param frame   Frame reference, frame ID of allocated frame returned
    * via this variable
+   * @param node    NUMA partition to take the frame from if possible
+   * @param file    File the frame is for, whose tenant may have to give up
+   * one of its own frames; nullptr if not known
+   * @throws BufferExceededException If no such buffer is found which can be
+   * allocated
+   */
+  void allocBuf(FrameId& frame, const std::uint32_t node,
+                const File* file = nullptr);
+
+  /**
+   * Allocates a frame for a file whose tenant holds as many frames as it may
+   * by evicting a page of the tenant.  Returns with the frame latch held,
+   * like allocBuf().
+   *
+   * @param file    File the frame is for
+   * @param frame   Frame ID of allocated frame returned via this variable
+   * @return  False if the tenant of the file is below its limit
+   * @throws BufferExceededException If all pages of the tenant are pinned
+   */
+  bool allocTenantBuf(const File& file, FrameId& frame);
+
+  /**
+   * Returns the tenant a file is assigned to, dropping an assignment left by
+   * an earlier file with the same identifier.  Called with fileFramesLatch
+   * held.
+   *
+   * @param file  File
+   * @return  Tenant of the file
+   */
+  TenantId fileTenant(const File& file);
+
+  /**
+   * Returns the NUMA partition of the calling thread
+   */
+  std::uint32_t localNode() const {
+    return numaNodes <= 1 ? 0 : NumaTopology::get().currentNode() % numaNodes;
+  }
+
+  /**
+   * Returns the NUMA partition a page is loaded into; see
+   * BufMgrOptions::numaHoming
+   */
+  std::uint32_t homeNode(const FileId fileId, const PageId pageNo) const {
+    if (numaNodes <= 1) return 0;
+    if (numaHoming == NumaHoming::HASH) {
+      return hashTable.partitionOf(fileId, pageNo) % numaNodes;
+    }
+    return localNode();
+  }
+
+  /**
+   * Allocate a frame for a scan using an access strategy.  Reuses the next
+   * frame of the ring if no one else has referenced it since the scan loaded
+   * it, and otherwise allocates a frame with allocBuf() and puts it in the
+   * ring, holding the file to the limit of its tenant.  Returns with the
+   * frame latch held, like allocBuf().
+   *
+   * @param strategy  Access strategy of the scan
+   * @param frame     Frame ID of allocated frame returned via this variable
+   * @param file      File the frame is for
    * @throws BufferExceededException If no such buffer is found which can be
    * allocated
    */
-  void allocBuf(FrameId& frame);
+  void allocRingBuf(BufferAccessStrategy& strategy, FrameId& frame,
+                    const File& file);
+
+  /**
+   * Adds a frame to the list of frames of its file, registering the file in
+   * the file table if needed.  Called right after the frame has been
+   * assigned to a page with Set().
+   *
+   * @param bufDesc Descriptor of the frame
+   * @param file    File the page of the frame belongs to
+   */
+  void linkFileFrame(BufDesc& bufDesc, const File& file);
+
+  /**
+   * Pins a frame, counting it in pinnedFrames if it was unpinned.
+   *
+   * @param bufDesc Descriptor of the frame
+   */
+  void pinFrame(BufDesc& bufDesc);
+
+  /**
+   * Drops a pin on a frame, counting it out of pinnedFrames once it is
+   * unpinned.
+   *
+   * @param bufDesc Descriptor of the frame
+   */
+  void dropPin(BufDesc& bufDesc);
+
+  /**
+   * Assigns a claimed frame to a page with BufDesc::Set(), which pins it.
+   *
+   * @param bufDesc Descriptor of the frame
+   * @param file    File object
+   * @param pageNo  Page number in the file
+   */
+  void setFrame(BufDesc& bufDesc, const File& file, const PageId pageNo);
+
+  /**
+   * Resets a frame with BufDesc::clear(), which drops its pins.
+   *
+   * @param bufDesc Descriptor of the frame
+   */
+  void clearFrame(BufDesc& bufDesc);
+
+  /**
+   * Removes a frame from the list of frames of its file, dropping the file
+   * from the file table once no frame holds its pages any more.  Called
+   * right before the frame stops holding its page.
+   *
+   * @param bufDesc Descriptor of the frame
+   */
+  void unlinkFileFrame(BufDesc& bufDesc);
+
+  /**
+   * Returns the frames currently holding pages of a file.  Frames may change
+   * hands once the call returns, so callers check the frames again under
+   * their latches.
+   *
+   * @param file  File object
+   * @return  Frame numbers
+   */
+  std::vector<FrameId> framesOfFile(const File& file);
+
+  /**
+   * Writes back the page held by a frame if it is dirty and removes it from
+   * the hash table.  The caller holds the latch of the frame.
+   *
+   * @param bufDesc Descriptor of the frame to evict
+   * @param keep    False to leave the page out of the victim cache
+   * @return  True if the frame was unmapped; false if some other thread
+   * pinned or dirtied the page in the meantime
+   */
+  bool evictFrame(BufDesc& bufDesc, const bool keep = true);
+
+  /**
+   * Waits for a frame that has just been pinned through the hash table to
+   * finish loading.  Unpins the frame again if loading it failed.
+   *
+   * @param bufDesc Descriptor of the pinned frame
+   * @return  True if the frame holds its page
+   */
+  bool waitForFrame(BufDesc& bufDesc);
+
+  /**
+   * Body of the background writer thread.
+   */
+  void runWriter();
+
+  /**
+   * Body of the background checkpointer thread.
+   */
+  void runCheckpointer();
+
+  /**
+   * Sleeps between the batches of a checkpoint.
+   *
+   * @param ms  Milliseconds to sleep
+   * @return  False if the manager is being destroyed and the checkpoint has
+   *          to give up
+   */
+  bool pauseCheckpoint(const std::uint32_t ms);
+
+  /**
+   * Writes out the page in a frame if it is dirty and unpinned, leaving it in
+   * the buffer pool.  Frames that are latched by another thread are skipped.
+   *
+   * @param bufDesc Descriptor of the frame
+   * @return  True if the page was written
+   */
+  bool cleanFrame(BufDesc& bufDesc);
+
+  /**
+   * Records an access to a page for sequential access detection and issues
+   * read-ahead when the access continues a sequential run.
+   *
+   * @param file   	File object
+   * @param pageNo  Page number that was read
+   */
+  void readAhead(File& file, const PageId pageNo);
+
+  /**
+   * Starts reading a page for PageFetcher.  A page in the buffer pool is
+   * pinned like readPage() does.  Otherwise a frame is claimed and mapped to
+   * the page, and the read of the page is added to the given batch and
+   * submitted to the I/O engine if there is one; without one the page is
+   * read right away.
+   *
+   * @param file    File object
+   * @param pageNo  Page number
+   * @param batch   Empty batch to read the page with
+   * @param frameNo Set to the frame of the page
+   * @return  True if the page is pinned in the frame; false if the frame
+   * stays latched until the batch has completed and finishRead() is called
+   */
+  bool startRead(File& file, const PageId pageNo, IoBatch& batch,
+                 FrameId& frameNo);
+
+  /**
+   * Completes a read that startRead() submitted.
+   *
+   * @param file      File object
+   * @param pageNo    Page number
+   * @param frameNo   Frame the page was read into
+   * @param read      True if the batch read the whole page
+   * @param missStart Time the miss started at
+   * @return  Guard of the page, which is pinned
+   * @throws  InvalidPageException If the page does not exist
+   * @throws  CorruptPageException If the page does not match its checksum
+   */
+  PageGuard finishRead(File& file, const PageId pageNo, const FrameId frameNo,
+                       const bool read,
+                       const std::chrono::steady_clock::time_point missStart);
+
+  /**
+   * Returns a guard holding the pin the caller has taken on a frame.
+   */
+  PageGuard guardFrame(const FrameId frameNo) {
+    return PageGuard(this, frameNo, &bufPool.at(frameNo));
+  }
+
+  /**
+   * Unmaps a frame whose page could not be loaded and releases the latch and
+   * the pin that the loading thread holds on it.
+   *
+   * @param bufDesc Descriptor of the frame
+   */
+  void abandonFrame(BufDesc& bufDesc);
+
+  /**
+   * Reads pages into the frames claimed for them by prefetch() and releases
+   * the frames.  Each frame has its latch held and a pin owned by the
+   * caller.  Without an I/O engine, frames[i] holds page firstPage + i;
+   * with one the frames may hold any pages of the file.
+   *
+   * @param file      File object
+   * @param firstPage Page number of the first page of the run
+   * @param frames    Frames claimed for the run; cleared on return
+   */
+  void loadPrefetched(File& file, const PageId firstPage,
+                      std::vector<FrameId>& frames);
+
+  /**
+   * Clears the reference bit of a valid frame on behalf of the replacement
+   * policy.
+   */
+  bool testAndClearReference(const FrameId frameNo) override;
+
+  /**
+   * Takes the latch of a frame on behalf of the replacement policy if the
+   * frame is not pinned and does not hold a page of high priority.
+   */
+  bool tryClaim(const FrameId frameNo) override;
+
+  /**
+   * Takes the latch of a frame if the frame is not pinned.
+   *
+   * @param frameNo Frame to claim
+   * @return  True if the latch is held
+   */
+  bool claimFrame(const FrameId frameNo);
+
+  /**
+   * Unpins the page in the given frame, which the caller has pinned, unless
+   * the frame has been given up since.
+   *
+   * @param frameNo     Frame of the page
+   * @param fileId      File of the page
+   * @param pageNo      Page number
+   * @param assignment  Assignment of the frame the pin was taken in
+   * @param dirty       True if the page needs to be marked dirty
+   */
+  void unPinFrame(const FrameId frameNo, const FileId fileId,
+                  const PageId pageNo, const std::uint32_t assignment,
+                  const bool dirty);
+
+  /**
+   * Writes the page in a frame to its file and counts the write.  The caller
+   * keeps the frame from being reassigned.
+   *
+   * @param bufDesc Frame to write
+   */
+  void writeFrame(BufDesc& bufDesc);
+
+  /**
+   * Returns the frame a page of the buffer pool is in.
+   *
+   * @param page  Page in the buffer pool
+   */
+  FrameId frameOf(const Page* page) const {
+    return static_cast<FrameId>(page - bufPool.data());
+  }
 
  public:
   /**
@@ -196,8 +1081,20 @@ class BufMgr {
 
   /**
    * Constructor of BufMgr class
+   *
+   * @param bufs    Number of frames in the buffer pool
+   * @param options Partitioning, memory and replacement options
    */
-  BufMgr(std::uint32_t bufs);
+  BufMgr(std::uint32_t bufs, const BufMgrOptions& options = BufMgrOptions());
+
+  /**
+   * Destructor of BufMgr class.  Stops the background threads and releases
+   * the buffer pool memory without writing back dirty pages.
+   */
+  ~BufMgr();
+
+  BufMgr(const BufMgr&) = delete;
+  BufMgr& operator=(const BufMgr&) = delete;
 
   /**
    * Reads the given page from the file into a frame and returns the pointer to
@@ -212,6 +1109,121 @@ class BufMgr {
    */
   void readPage(File& file, const PageId pageNo, Page*& page);
 
+  /**
+   * Reads the given page like readPage(file, pageNo, page), but loads it
+   * through an access strategy if it is not in the buffer pool yet.
+   *
+   * @param file   	File object
+   * @param PageNo  Page number in the file to be read
+   * @param page  	Reference to page pointer. Used to fetch the Page object
+   * in which requested page from file is read in.
+   * @param strategy  Access strategy of the scan, or nullptr to load the page
+   * like any other
+   */
+  void readPage(File& file, const PageId pageNo, Page*& page,
+                BufferAccessStrategy* strategy);
+
+  /**
+   * Reads the given page like readPage(file, pageNo, page, strategy) and
+   * returns a guard that unpins it.
+   *
+   * @param file   	File object
+   * @param PageNo  Page number in the file to be read
+   * @param strategy  Access strategy of the scan, or nullptr to load the page
+   * like any other
+   * @return  Guard holding the pin on the page
+   */
+  PageGuard readPage(File& file, const PageId pageNo,
+                     BufferAccessStrategy* strategy = nullptr);
+
+  /**
+   * Runs a short read-only access to a page without pinning it.  If the page
+   * is in the buffer pool and nobody has it pinned, the reader is run on the
+   * frame directly, probing the hash table without its latch and writing to
+   * no shared state beyond an unset reference bit; the read is then validated
+   * against the version of the frame.  Otherwise, or if the page changed while
+   * it was read, the page is pinned, read again and unpinned.
+   *
+   * Since the page may change under an unpinned reader, the reader must only
+   * copy data out, must not trust offsets it finds on the page without
+   * checking them, and may be called more than once; only the results of its
+   * last call count.  Exceptions it throws while the page changes are
+   * ignored.
+   *
+   * @param file   	File object
+   * @param PageNo  Page number in the file to be read
+   * @param reader  Function reading the page
+   * @return  True if the page was read without pinning it
+   */
+  bool readPageOptimistic(File& file, const PageId pageNo,
+                          const std::function<void(const Page&)>& reader);
+
+  /**
+   * Starts loading pages that are expected to be read soon.  Pages that are
+   * already in the buffer pool are skipped and the others are read with one
+   * read per run of consecutive pages.  Prefetching stops early if no free
+   * frame can be found and ignores pages past the end of the file; the pages
+   * are left unpinned.
+   *
+   * @param file      File object
+   * @param firstPage Page number of the first page to load
+   * @param count     Number of pages to load
+   */
+  void prefetch(File& file, const PageId firstPage, std::uint32_t count);
+
+  /**
+   * Writes the list of pages in the buffer pool to a sidecar file, one
+   * "pageNo filename" line per page.  Pages the replacement policy would
+   * keep the longest come first.  The file is replaced atomically; pinned
+   * and dirty pages are listed like any other.
+   *
+   * @param path  Name of the sidecar file
+   * @throws  FileIoException If the file cannot be written
+   */
+  void saveResidentPages(const std::string& path);
+
+  /**
+   * Prefetches the pages listed in a sidecar file written by
+   * saveResidentPages().  Only as many pages as there are frames are taken
+   * from the top of the list; they are sorted and read with one batched
+   * prefetch per run of consecutive pages.  A missing or unreadable sidecar
+   * file, files that no longer exist and pages past the end of a file are
+   * skipped.
+   *
+   * @param path  Name of the sidecar file
+   */
+  void loadResidentPages(const std::string& path);
+
+  /**
+   * Takes a fuzzy checkpoint while the pool stays in use.  The pages that
+   * are dirty or pinned when the checkpoint starts are written back in
+   * batches, without latching more than one frame at a time; pinned pages
+   * are written once they have been unpinned, and pages written or evicted
+   * meanwhile by someone else are not written again.  Then the files are
+   * synced and a checkpoint record is logged, after which recovery does not
+   * need the log before the start of the checkpoint.  Run by the
+   * checkpointer thread, but may also be called directly by a thread that
+   * holds no pins.
+   *
+   * @return  LSN of the checkpoint record, or 0 if there is no log or the
+   *          manager is being destroyed
+   * @throws  FileIoException If a page, a file or the log cannot be written
+   */
+  Lsn checkpoint();
+
+  /**
+   * Runs one round of the background writer: writes out up to maxPages dirty,
+   * unpinned pages among the next lookahead victims of the replacement
+   * policy.  Called by the background writer thread, but may also be called
+   * directly.
+   *
+   * @param lookahead Number of upcoming victims to look at
+   * @param maxPages  Maximum number of pages to write
+   * @return  Number of pages written
+   */
+  std::uint32_t cleanVictims(const std::uint32_t lookahead,
+                             const std::uint32_t maxPages);
+
   /**
    * Unpin a page from memory since it is no longer required for it to remain in
    * memory.
@@ -236,18 +1248,77 @@ class BufMgr {
    */
   void allocPage(File& file, PageId& pageNo, Page*& page);
 
+  /**
+   * Allocates a new, empty page in the file like allocPage(file, pageNo,
+   * page) and returns a guard that unpins it.  The page number is the
+   * page_number() of the page.
+   *
+   * @param file   	File object
+   * @return  Guard holding the pin on the new page
+   */
+  PageGuard allocPage(File& file);
+
+  /**
+   * Allocates a run of consecutive new, empty pages at the end of the file
+   * with a single write, and assigns each a frame in the buffer pool.  All of
+   * the pages are returned pinned.
+   *
+   * @param file        File object
+   * @param count       Number of pages to allocate
+   * @param firstPageNo Number of the first page of the run, returned via this
+   * reference.  Page firstPageNo + i is in pages[i].
+   * @param pages       Receives pointers to the in-memory Page objects
+   * @throws  BufferExceededException If fewer than count frames can be
+   * assigned, in which case nothing is allocated
+   */
+  void allocPages(File& file, const std::uint32_t count, PageId& firstPageNo,
+                  std::vector<Page*>& pages);
+
   /**
    * Writes out all dirty pages of the file to disk.
    * All the frames assigned to the file need to be unpinned from buffer pool
-   * before this function can be successfully called. Otherwise Error returned.
+   * before this function can be successfully called. Otherwise Error returned
+   * and nothing is written.  The pages are written in page number order, with
+   * one vectored write per run of consecutive pages.
    *
    * @param file   	File object
+   * @param sync    True to also write back the file header and wait until
+   * everything has reached stable storage
    * @throws  PagePinnedException If any page of the file is pinned in the
    * buffer pool
    * @throws BadBufferException If any frame allocated to the file is found to
    * be invalid
+   * @throws FileIoException If a write fails; the pages stay dirty
+   */
+  void flushFile(File& file, const bool sync = false);
+
+  /**
+   * Adds a tenant, which files can then be assigned to with setFileTenant().
+   *
+   * @param options Share of the buffer pool the tenant is given
+   * @return  Identifier of the tenant
    */
-  void flushFile(File& file);
+  TenantId addTenant(const TenantOptions& options);
+
+  /**
+   * Assigns a file to a tenant.  Pages of the file in the buffer pool move
+   * to the tenant as well, even if that takes it past its limit; the tenant
+   * then only replaces its own pages until enough of them have left.  The
+   * assignment lasts until the file is closed.
+   *
+   * @param file    File object
+   * @param tenant  Tenant to assign the file to; 0 for the default tenant
+   * @throws std::out_of_range If there is no such tenant
+   */
+  void setFileTenant(const File& file, const TenantId tenant);
+
+  /**
+   * Returns the number of frames the pages of a tenant hold.
+   *
+   * @param tenant  Tenant
+   * @throws std::out_of_range If there is no such tenant
+   */
+  std::uint32_t tenantFrames(const TenantId tenant);
 
   /**
    * Delete page from file and also from buffer pool if present.
@@ -259,15 +1330,54 @@ class BufMgr {
    */
   void disposePage(File& file, const PageId PageNo);
 
+  /**
+   * Grows or shrinks the buffer pool to the given number of frames while it
+   * is in use.  Growing adds empty frames.  Shrinking evicts the pages in the
+   * frames past the new end, writing back dirty ones, and returns their
+   * memory; all other pages stay in the pool.  The hash table grows along
+   * with the pool, a few entries at a time as pages are inserted and removed.
+   *
+   * @param newBufs New number of frames, from 1 up to BufMgrOptions::maxBufs
+   * @throws  BufferExceededException If newBufs is out of that range
+   * @throws  PagePinnedException If a page in a frame to be removed stays
+   * pinned; the pool then keeps its size, less any pages already evicted
+   */
+  void resize(const std::uint32_t newBufs);
+
+  /**
+   * Returns the number of frames in the buffer pool
+   */
+  std::uint32_t size() const { return numBufs; }
+
+  /**
+   * Returns the number of frames that are not pinned and so could be handed
+   * out to a page right now
+   */
+  std::uint32_t evictableFrames() const {
+    const std::uint32_t pinned = pinnedFrames;
+    const std::uint32_t frames = numBufs;
+    return pinned < frames ? frames - pinned : 0;
+  }
+
+  /**
+   * Returns the NUMA partition of the frame a page of the buffer pool is in,
+   * or 0 if the pool is not partitioned
+   *
+   * @param page  Page in the buffer pool
+   */
+  std::uint32_t numaNodeOf(const Page* page) const {
+    return numaNodes <= 1 ? 0 : frameOf(page) / numaStripeFrames % numaNodes;
+  }
+
   /**
    * Print member variable values.
    */
   void printSelf();
 
   /**
-   * Get buffer pool usage statistics
+   * Get buffer pool usage statistics, summed over all threads
    */
-  BufStats& getBufStats() { return bufStats; }
+  BufStats getBufStats() const { return bufStats.read(); }
 
   /**
    * Clear buffer pool usage statistics
@@ -0,0 +1,110 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "crc32c.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Reflected polynomial of CRC-32C
+ */
+const std::uint32_t POLYNOMIAL = 0x82F63B78;
+
+struct Table {
+  std::uint32_t entries[256];
+
+  Table() {
+    for (std::uint32_t i = 0; i < 256; i++) {
+      std::uint32_t crc = i;
+      for (int bit = 0; bit < 8; bit++) {
+        crc = (crc & 1) ? (crc >> 1) ^ POLYNOMIAL : crc >> 1;
+      }
+      entries[i] = crc;
+    }
+  }
+};
+
+std::uint32_t software(std::uint32_t crc, const unsigned char *bytes,
+                       std::size_t length) {
+  static const Table table;
+  while (length-- > 0) {
+    crc = table.entries[(crc ^ *bytes++) & 0xFF] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("sse4.2"))) std::uint32_t hardware(
+    std::uint32_t crc, const unsigned char *bytes, std::size_t length) {
+  std::uint64_t crc64 = crc;
+  for (; length >= sizeof(std::uint64_t); length -= sizeof(std::uint64_t)) {
+    std::uint64_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+    crc64 = _mm_crc32_u64(crc64, word);
+    bytes += sizeof(word);
+  }
+  crc = static_cast<std::uint32_t>(crc64);
+  while (length-- > 0) {
+    crc = _mm_crc32_u8(crc, *bytes++);
+  }
+  return crc;
+}
+
+bool hasHardware() { return __builtin_cpu_supports("sse4.2"); }
+
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+
+std::uint32_t hardware(std::uint32_t crc, const unsigned char *bytes,
+                       std::size_t length) {
+  for (; length >= sizeof(std::uint64_t); length -= sizeof(std::uint64_t)) {
+    std::uint64_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+    crc = __crc32cd(crc, word);
+    bytes += sizeof(word);
+  }
+  while (length-- > 0) {
+    crc = __crc32cb(crc, *bytes++);
+  }
+  return crc;
+}
+
+bool hasHardware() { return true; }
+
+#else
+
+std::uint32_t hardware(std::uint32_t crc, const unsigned char *bytes,
+                       std::size_t length) {
+  return software(crc, bytes, length);
+}
+
+bool hasHardware() { return false; }
+
+#endif
+
+}  // namespace
+
+std::uint32_t crc32c(const std::uint32_t crc, const void *data,
+                     const std::size_t length) {
+  static const bool useHardware = hasHardware();
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  return ~(useHardware ? hardware(~crc, bytes, length)
+                       : software(~crc, bytes, length));
+}
+
+}  // namespace badgerdb
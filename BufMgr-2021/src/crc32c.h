@@ -0,0 +1,29 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace badgerdb {
+
+/**
+ * Extends a CRC-32C (Castagnoli) checksum over the given bytes.  Uses the
+ * SSE4.2 or ARMv8 CRC32 instructions when the processor has them, and a
+ * lookup table otherwise.
+ *
+ * @param crc     Checksum of the bytes before these, or 0 to start a new one.
+ * @param data    Bytes to checksum.
+ * @param length  Number of bytes.
+ * @return  Checksum of all bytes so far.
+ */
+std::uint32_t crc32c(const std::uint32_t crc, const void *data,
+                     const std::size_t length);
+
+}  // namespace badgerdb
@@ -0,0 +1,23 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "bad_index_info_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+BadIndexInfoException::BadIndexInfoException(const std::string &problem)
+    : BadgerDbException("") {
+  std::stringstream ss;
+  ss << "Bad index: " << problem;
+  message_.assign(ss.str());
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,31 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when an index file does not hold the
+ * index it is opened as, or an index is given a key or input it cannot take.
+ */
+class BadIndexInfoException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a bad index info exception with the given problem.
+   *
+   * @param problem  What is wrong with the index or the request.
+   */
+  explicit BadIndexInfoException(const std::string &problem);
+};
+
+}  // namespace badgerdb
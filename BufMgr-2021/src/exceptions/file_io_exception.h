@@ -0,0 +1,53 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when the operating system fails a read,
+ *        write or sync of a file.
+ */
+class FileIoException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a file I/O exception for the given file and error.
+   *
+   * @param name  Name of file the I/O was issued against.
+   * @param error errno value the I/O failed with.
+   */
+  FileIoException(const std::string &name, const int error);
+
+  /**
+   * Returns the name of the file that caused this exception.
+   */
+  virtual const std::string &filename() const { return filename_; }
+
+  /**
+   * Returns the errno value the I/O failed with.
+   */
+  virtual int error() const { return error_; }
+
+ protected:
+  /**
+   * Name of file that caused this exception.
+   */
+  const std::string filename_;
+
+  /**
+   * errno value the I/O failed with.
+   */
+  const int error_;
+};
+
+}  // namespace badgerdb
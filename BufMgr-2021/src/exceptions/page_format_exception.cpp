@@ -0,0 +1,24 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "page_format_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+PageFormatException::PageFormatException(const PageId page_number,
+                                         const std::string &problem)
+    : BadgerDbException(""), page_number_(page_number) {
+  std::stringstream ss;
+  ss << "Page " << page_number_ << " has the wrong layout: " << problem;
+  message_.assign(ss.str());
+}
+
+}  // namespace badgerdb
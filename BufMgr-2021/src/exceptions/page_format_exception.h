@@ -0,0 +1,50 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a page is used as a layout it was
+ *        not formatted with, or formatted with a layout that does not fit.
+ */
+class PageFormatException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a page format exception for the given page.
+   *
+   * @param page_number  Number of the page.
+   * @param problem      What is wrong with the layout.
+   */
+  PageFormatException(const PageId page_number, const std::string &problem);
+
+  /**
+   * Destroys the exception.  Does nothing special; just included to make the
+   * compiler happy.
+   */
+  virtual ~PageFormatException() throw() {}
+
+  /**
+   * Returns the number of the page that caused this exception.
+   */
+  virtual PageId page_number() const { return page_number_; }
+
+ protected:
+  /**
+   * Number of the page which caused this exception.
+   */
+  const PageId page_number_;
+};
+
+}  // namespace badgerdb
@@ -0,0 +1,27 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "page_size_mismatch_exception.h"
+
+#include <sstream>
+#include <string>
+
+#include "page.h"
+
+namespace badgerdb {
+
+PageSizeMismatchException::PageSizeMismatchException(
+    const std::string &file, const std::uint32_t page_size)
+    : BadgerDbException(""), filename_(file), page_size_(page_size) {
+  std::stringstream ss;
+  ss << "File '" << filename_ << "' has " << page_size_
+     << " byte pages, but this build uses " << Page::SIZE << " byte pages.";
+  message_.assign(ss.str());
+}
+
+}  // namespace badgerdb
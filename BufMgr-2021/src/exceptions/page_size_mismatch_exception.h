@@ -0,0 +1,62 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a file being opened was created with
+ *        a page size other than the one BadgerDB was built for.
+ */
+class PageSizeMismatchException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a page size mismatch exception for the given file and the page
+   * size it was created with.
+   *
+   * @param file        Name of file that was opened.
+   * @param page_size   Page size the file was created with.
+   */
+  PageSizeMismatchException(const std::string &file,
+                            const std::uint32_t page_size);
+
+  /**
+   * Destroys the exception.  Does nothing special; just included to make the
+   * compiler happy.
+   */
+  virtual ~PageSizeMismatchException() throw() {}
+
+  /**
+   * Returns name of the file that caused this exception.
+   */
+  virtual const std::string &filename() const { return filename_; }
+
+  /**
+   * Returns the page size the file was created with.
+   */
+  virtual std::uint32_t page_size() const { return page_size_; }
+
+ protected:
+  /**
+   * Name of file which caused this exception.
+   */
+  const std::string filename_;
+
+  /**
+   * Page size the file was created with.
+   */
+  const std::uint32_t page_size_;
+};
+
+}  // namespace badgerdb
@@ -0,0 +1,27 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "redo_mismatch_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+RedoMismatchException::RedoMismatchException(const RecordId &rec_id,
+                                             const std::string &file)
+    : BadgerDbException(""), record_id_(rec_id), filename_(file) {
+  std::stringstream ss;
+  ss << "Logged change does not apply to its page."
+     << " Record {page=" << record_id_.page_number
+     << ", slot=" << record_id_.slot_number << "} from file '" << filename_
+     << "'";
+  message_.assign(ss.str());
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,61 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when recovery cannot replay a logged
+ *        change because the page is not in the state the change was made to.
+ */
+class RedoMismatchException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a redo mismatch exception for the given logged record ID and
+   * filename.
+   *
+   * @param rec_id  Record ID of the logged change.
+   * @param file    Name of file the change was logged for.
+   */
+  RedoMismatchException(const RecordId &rec_id, const std::string &file);
+
+  /**
+   * Destroys the exception.  Does nothing special; just included to make the
+   * compiler happy.
+   */
+  virtual ~RedoMismatchException() throw() {}
+
+  /**
+   * Returns the record ID of the change that could not be replayed.
+   */
+  virtual const RecordId &record_id() const { return record_id_; }
+
+  /**
+   * Returns name of the file that caused this exception.
+   */
+  virtual const std::string &filename() const { return filename_; }
+
+ protected:
+  /**
+   * Record ID of the change which caused this exception.
+   */
+  const RecordId record_id_;
+
+  /**
+   * Name of file which caused this exception.
+   */
+  const std::string filename_;
+};
+
+}  // namespace badgerdb
@@ -8,27 +8,95 @@
 
 #include "file.h"
 
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
+#include <cstddef>
 #include <cstdio>
-#include <fstream>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <memory>
+#include <new>
 #include <string>
+#include <thread>
 
+#include "crc32c.h"
+#include "exceptions/corrupt_page_exception.h"
 #include "exceptions/file_exists_exception.h"
+#include "exceptions/file_io_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
+#include "async_io.h"
 #include "exceptions/invalid_page_exception.h"
+#include "exceptions/page_size_mismatch_exception.h"
 #include "file_iterator.h"
+#include "lz.h"
 #include "page.h"
+#include "trace.h"
 
 namespace badgerdb {
 
-File::StreamMap File::open_streams_;
-File::CountMap File::open_counts_;
+File::OpenFile File::open_files_[File::MAX_OPEN_FILES];
+std::map<std::string, FileId> File::open_names_;
+std::vector<FileId> File::free_ids_;
+FileId File::next_id_ = File::INVALID_ID + 1;
+std::uint64_t File::next_open_number_ = 1;
+std::mutex File::open_files_latch_;
+
+namespace {
+
+struct FreeDeleter {
+  void operator()(char *buffer) const { free(buffer); }
+};
+
+/**
+ * Staging buffer for a run of pages, freed with free()
+ */
+typedef std::unique_ptr<char[], FreeDeleter> Staging;
+
+/**
+ * Allocates a staging buffer for the given number of pages, aligned to
+ * Page::ALIGNMENT so that it can be used for direct I/O.
+ */
+Staging allocateStaging(const std::size_t num_pages) {
+  void *buffer = nullptr;
+  if (posix_memalign(&buffer, Page::ALIGNMENT, num_pages * Page::SIZE) != 0) {
+    throw std::bad_alloc();
+  }
+  return Staging(static_cast<char *>(buffer));
+}
+
+/**
+ * Computes the checksum of a page, leaving out the checksum field itself and
+ * the list links, which writeLinks() updates without rewriting the page.
+ */
+std::uint32_t pageChecksum(const PageHeader &header, const char *data) {
+  static_assert(sizeof(PageHeader) == 4 * sizeof(PageOffset) +
+                                          4 * sizeof(std::uint16_t) +
+                                          4 * sizeof(std::uint32_t) +
+                                          sizeof(Lsn),
+                "Page header must not contain padding");
+  PageHeader covered = header;
+  covered.next_page_number = 0;
+  covered.prev_page_number = 0;
+  covered.checksum = 0;
+  const std::uint32_t crc = crc32c(0, &covered, sizeof(covered));
+  return crc32c(crc, data, Page::DATA_SIZE);
+}
+
+}  // namespace
 
-File File::create(const std::string &filename) {
-  return File(filename, true /* create_new */);
+File File::create(const std::string &filename, const bool checksums,
+                  const bool compressed) {
+  return File(filename, true /* create_new */, checksums, compressed);
 }
 
 File File::open(const std::string &filename) {
@@ -49,166 +117,633 @@ bool File::isOpen(const std::string &filename) {
   if (!exists(filename)) {
     return false;
   }
-  return open_counts_.find(filename) != open_counts_.end();
+  std::lock_guard<std::mutex> guard(open_files_latch_);
+  return open_names_.find(filename) != open_names_.end();
 }
 
 bool File::exists(const std::string &filename) {
-  std::fstream file(filename);
-  if (file) {
-    file.close();
-    return true;
-  }
-
-  return false;
+  return ::access(filename.c_str(), R_OK | W_OK) == 0;
 }
 
 File::File(const File &other)
-    : filename_(other.filename_),
-      stream_(open_streams_[filename_]),
-      valid_(other.valid_) {
-  ++open_counts_[filename_];
+    : id_(other.id_), open_(other.open_), fd_(other.fd_), valid_(other.valid_) {
+  if (open_) {
+    // other holds a reference, so the count cannot drop to zero meanwhile
+    open_->count.fetch_add(1, std::memory_order_relaxed);
+  }
 }
 
 File &File::operator=(const File &rhs) {
-  // This accounts for self-assignment and assignment of a File object for the
-  // same file.
+  // Taking a reference to the new file before closing the old one accounts
+  // for self-assignment and assignment of a File object for the same file.
+  const File other(rhs);
   close();  // close my file and associate me with the new one
-  filename_ = rhs.filename_;
-  valid_ = rhs.valid_;
-  openIfNeeded(false /* create_new */);
+  id_ = other.id_;
+  fd_ = other.fd_;
+  valid_ = other.valid_;
+  open_ = other.open_;
+  if (open_) {
+    open_->count.fetch_add(1, std::memory_order_relaxed);
+  }
   return *this;
 }
 
 File::~File() { close(); }
 
+const std::string &File::filename() const {
+  static const std::string no_name;
+  return open_ ? open_->name : no_name;
+}
+
 Page File::allocatePage() {
-  FileHeader header = readHeader();
   Page new_page;
-  Page existing_page;
+  allocatePageInto(new_page);
+  return new_page;
+}
+
+void File::allocatePageInto(Page &new_page) {
+  std::lock_guard<std::recursive_mutex> guard(open_->latch);
+  FileHeader header = readHeader();
+  PageId page_number;
   if (header.num_free_pages > 0) {
-    new_page = readPage(header.first_free_page, true /* allow_free */);
-    new_page.set_page_number(header.first_free_page);
-    header.first_free_page = new_page.next_page_number();
+    // Pop the page off the free list; only its link is needed
+    page_number = header.first_free_page;
+    header.first_free_page = pageLinks(page_number).next_page_number;
     --header.num_free_pages;
 
-    if (header.first_used_page == Page::INVALID_NUMBER ||
-        header.first_used_page > new_page.page_number()) {
-      // Either have no pages used or the head of the used list is a page
-      // later than the one we just allocated, so add the new page to the
-      // head.
-      if (header.first_used_page > new_page.page_number()) {
-        new_page.set_next_page_number(header.first_used_page);
-      }
-      header.first_used_page = new_page.page_number();
-    } else {
-      // New page is reused from somewhere after the beginning, so we need
-      // to find where in the used list to insert it.
-      PageId next_page_number = Page::INVALID_NUMBER;
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        next_page_number = (*iter).next_page_number();
-        if (next_page_number > new_page.page_number() ||
-            next_page_number == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      existing_page.set_next_page_number(new_page.page_number());
-      new_page.set_next_page_number(next_page_number);
-    }
-
     assert((header.num_free_pages == 0) ==
            (header.first_free_page == Page::INVALID_NUMBER));
   } else {
-    new_page.set_page_number(header.num_pages);
-    if (header.first_used_page == Page::INVALID_NUMBER) {
-      header.first_used_page = new_page.page_number();
-    } else {
-      // If we have pages allocated, we need to add the new page to the
-      // tail of the linked list.
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      assert(existing_page.isUsed());
-      existing_page.set_next_page_number(new_page.page_number());
-    }
+    page_number = header.num_pages;
     ++header.num_pages;
   }
-  writePage(new_page.page_number(), new_page);
-  if (existing_page.page_number() != Page::INVALID_NUMBER) {
-    // If we updated an existing page by inserting the new page into the
-    // used list, we need to write it out.
-    writePage(existing_page.page_number(), existing_page);
+  new_page.initialize();
+  new_page.set_page_number(page_number);
+
+  // Append the page to the tail of the used list.
+  new_page.set_prev_page_number(header.last_used_page);
+  if (header.last_used_page == Page::INVALID_NUMBER) {
+    header.first_used_page = page_number;
+  } else {
+    const PageLinks tail = pageLinks(header.last_used_page);
+    writeLinks(header.last_used_page, page_number, tail.prev_page_number);
   }
+  header.last_used_page = page_number;
+
+  writePage(page_number, new_page);
   writeHeader(header);
+}
 
-  return new_page;
+PageId File::allocateExtent(const PageId count) {
+  // Pages are staged a chunk at a time; holding the latch across the chunks
+  // keeps the run contiguous
+  const PageId chunk_size = 256;
+  std::lock_guard<std::recursive_mutex> guard(open_->latch);
+  PageId first_page = Page::INVALID_NUMBER;
+  for (PageId allocated = 0; allocated < count;) {
+    const PageId n = std::min(chunk_size, count - allocated);
+    std::vector<Page> chunk(n);
+    std::vector<Page *> pages;
+    for (Page &page : chunk) {
+      pages.push_back(&page);
+    }
+    const PageId chunk_first = allocateExtentInto(pages);
+    if (first_page == Page::INVALID_NUMBER) {
+      first_page = chunk_first;
+    }
+    allocated += n;
+  }
+  return first_page;
 }
 
-Page File::readPage(const PageId page_number) const {
+PageId File::allocateExtentInto(const std::vector<Page *> &pages) {
+  if (pages.empty()) {
+    return Page::INVALID_NUMBER;
+  }
+  std::lock_guard<std::recursive_mutex> guard(open_->latch);
   FileHeader header = readHeader();
-  if (page_number >= header.num_pages) {
-    throw InvalidPageException(page_number, filename_);
+  const PageId first_page = header.num_pages;
+  const PageId last_page = first_page + pages.size() - 1;
+
+  // Chain the new pages to each other and to the tail of the used list.
+  Staging staging = allocateStaging(pages.size());
+  for (std::size_t i = 0; i < pages.size(); i++) {
+    Page &page = *pages[i];
+    const PageId page_number = first_page + i;
+    page.initialize();
+    page.set_page_number(page_number);
+    page.set_prev_page_number(i == 0 ? header.last_used_page
+                                     : page_number - 1);
+    page.set_next_page_number(page_number == last_page ? Page::INVALID_NUMBER
+                                                       : page_number + 1);
+    char *image = staging.get() + i * Page::SIZE;
+    std::memcpy(image, page.image_, Page::SIZE);
+    if (header.flags & FLAG_CHECKSUMS) {
+      PageHeader *stamped = reinterpret_cast<PageHeader *>(image);
+      stamped->checksum = pageChecksum(*stamped, image + sizeof(PageHeader));
+    }
+  }
+  if (header.flags & FLAG_COMPRESSED) {
+    for (std::size_t i = 0; i < pages.size(); i++) {
+      const char *image = staging.get() + i * Page::SIZE;
+      writeCompressed(first_page + i,
+                      *reinterpret_cast<const PageHeader *>(image),
+                      image + sizeof(PageHeader));
+    }
+  } else {
+    writeAt(pageFd(), pagePosition(first_page), staging.get(),
+            pages.size() * Page::SIZE);
+  }
+  for (std::size_t i = 0; i < pages.size(); i++) {
+    cacheLinks(first_page + i, *pages[i]->header_);
+  }
+
+  if (header.last_used_page == Page::INVALID_NUMBER) {
+    header.first_used_page = first_page;
+  } else {
+    const PageLinks tail = pageLinks(header.last_used_page);
+    writeLinks(header.last_used_page, first_page, tail.prev_page_number);
+  }
+  header.last_used_page = last_page;
+  header.num_pages += pages.size();
+  writeHeader(header);
+  return first_page;
+}
+
+Page File::readPage(const PageId page_number) const {
+  Page page;
+  readPageInto(page_number, page);
+  return page;
+}
+
+void File::readPageInto(const PageId page_number, Page &page) const {
+  if (page_number >= readHeader().num_pages) {
+    throw InvalidPageException(page_number, open_->name);
+  }
+  readPageInto(page_number, page, false /* allow_free */);
+}
+
+void File::readPagesInto(const PageId first_page,
+                         const std::vector<Page *> &pages) const {
+  if (pages.empty()) {
+    return;
+  }
+  // The latch is only held to look things up; the pages are read without it
+  // so that readers of the same file don't wait for each other.
+  const char *mapped = nullptr;
+  int fd;
+  bool checksums;
+  bool compressed;
+  {
+    std::lock_guard<std::recursive_mutex> guard(open_->latch);
+    FileHeader header = readHeader();
+    checksums = header.flags & FLAG_CHECKSUMS;
+    compressed = header.flags & FLAG_COMPRESSED;
+    if (first_page == Page::INVALID_NUMBER ||
+        first_page + pages.size() > header.num_pages) {
+      throw InvalidPageException(first_page + pages.size() - 1, open_->name);
+    }
+    if (open_->mapped) {
+      // Mapping the last page maps the whole run
+      mappedImage(first_page + pages.size() - 1);
+      mapped = mappedImage(first_page);
+    }
+    fd = pageFd();
+  }
+
+  if (mapped != nullptr) {
+    for (std::size_t i = 0; i < pages.size(); i++) {
+      std::memcpy(pages[i]->image_, mapped + i * Page::SIZE, Page::SIZE);
+    }
+  } else if (!compressed) {
+    // One vectored read straight into the pages.  Their images are aligned,
+    // so this works with the direct I/O descriptor as well.
+    std::vector<iovec> buffers;
+    buffers.reserve(pages.size());
+    for (Page *page : pages) {
+      buffers.push_back({page->image_, Page::SIZE});
+    }
+    readVectored(fd, pagePosition(first_page), buffers);
+  } else {
+    // Compressed runs are read into a staging buffer and decompressed in the
+    // pages below
+    Staging staging = allocateStaging(pages.size());
+    readAt(fd, pagePosition(first_page), staging.get(),
+           pages.size() * Page::SIZE);
+    for (std::size_t i = 0; i < pages.size(); i++) {
+      std::memcpy(pages[i]->image_, staging.get() + i * Page::SIZE,
+                  Page::SIZE);
+    }
+  }
+  for (std::size_t i = 0; i < pages.size(); i++) {
+    Page &page = *pages[i];
+    if (compressed) {
+      try {
+        decompressPage(first_page + i, page);
+      } catch (const CorruptPageException &) {
+        // Read as a free page; readPage() reports it if anyone asks for it
+        page.header_->current_page_number = Page::INVALID_NUMBER;
+        continue;
+      }
+    }
+    if (!checksums ||
+        page.header_->checksum == pageChecksum(*page.header_, page.data_)) {
+      learnLinks(first_page + i, *page.header_);
+    }
   }
-  return readPage(page_number, false /* allow_free */);
 }
 
 Page File::readPage(const PageId page_number, const bool allow_free) const {
   Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char *>(&page.header_), sizeof(page.header_));
-  stream_->read(&page.data_[0], Page::DATA_SIZE);
+  readPageInto(page_number, page, allow_free);
+  return page;
+}
+
+void File::readPageInto(const PageId page_number, Page &page,
+                        const bool allow_free) const {
+  const char *mapped = nullptr;
+  int fd;
+  bool checksums;
+  bool compressed;
+  {
+    std::lock_guard<std::recursive_mutex> guard(open_->latch);
+    if (open_->mapped) {
+      mapped = mappedImage(page_number);
+    }
+    fd = pageFd();
+    checksums = open_->header.flags & FLAG_CHECKSUMS;
+    compressed = open_->header.flags & FLAG_COMPRESSED;
+  }
+
+  if (mapped != nullptr) {
+    std::memcpy(page.image_, mapped, Page::SIZE);
+  } else {
+    readAt(fd, pagePosition(page_number), page.image_, Page::SIZE);
+  }
+  if (compressed) {
+    decompressPage(page_number, page);
+  }
+  if (checksums &&
+      page.header_->checksum != pageChecksum(*page.header_, page.data_)) {
+    throw CorruptPageException(page_number, open_->name);
+  }
+  learnLinks(page_number, *page.header_);
   if (!allow_free && !page.isUsed()) {
-    throw InvalidPageException(page_number, filename_);
+    throw InvalidPageException(page_number, open_->name);
+  }
+}
+
+void File::queueRead(IoBatch &batch, const PageId page_number,
+                     Page &page) const {
+  batch.addRead(pageFd(), pagePosition(page_number), page.image_, Page::SIZE);
+}
+
+void File::map(const MapAccess access) {
+  int advice = MADV_NORMAL;
+  switch (access) {
+    case MapAccess::SEQUENTIAL:
+      advice = MADV_SEQUENTIAL;
+      break;
+    case MapAccess::RANDOM:
+      advice = MADV_RANDOM;
+      break;
+    case MapAccess::NORMAL:
+    default:
+      break;
   }
 
+  std::lock_guard<std::recursive_mutex> guard(open_->latch);
+  open_->mapped = true;
+  open_->map_advice = advice;
+  const FileHeader header = readHeader();
+  if (header.num_pages > 1) {
+    // Map everything up to the last page now; the hint covers new mappings
+    // made when the file grows.
+    mappedImage(header.num_pages - 1);
+  }
+  for (const OpenFile::Mapping &mapping : open_->mappings) {
+    ::madvise(mapping.base, mapping.length, advice);
+  }
+}
+
+bool File::isMapped() const {
+  std::lock_guard<std::recursive_mutex> guard(open_->latch);
+  return open_->mapped;
+}
+
+Page File::mappedPage(const PageId page_number) const {
+  std::lock_guard<std::recursive_mutex> guard(open_->latch);
+  if (!open_->mapped) {
+    throw FileIoException(open_->name, EINVAL);
+  }
+  const FileHeader header = readHeader();
+  if (page_number == Page::INVALID_NUMBER || page_number >= header.num_pages) {
+    throw InvalidPageException(page_number, open_->name);
+  }
+  const auto check = [this, page_number](const Page &page) {
+    if (!verifyPage(page)) {
+      throw CorruptPageException(page_number, open_->name);
+    }
+    if (!page.isUsed()) {
+      throw InvalidPageException(page_number, open_->name);
+    }
+  };
+  Page page(mappedImage(page_number));
+  if (header.flags & FLAG_COMPRESSED) {
+    // The mapping holds the compressed image; decompress a copy
+    Page copy(page);
+    decompressPage(page_number, copy);
+    check(copy);
+    return copy;
+  }
+  check(page);
   return page;
 }
 
+char *File::mappedImage(const PageId page_number) const {
+  std::vector<OpenFile::Mapping> &mappings = open_->mappings;
+  const std::size_t end = pagePosition(page_number + 1);
+  if (mappings.empty() || mappings.back().length < end) {
+    // Map the whole file as it is now, so that growing one page at a time
+    // does not map it again on every page.
+    const FileHeader header = readHeader();
+    const std::size_t length =
+        std::max<std::size_t>(end, pagePosition(header.num_pages));
+    void *base =
+        ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd_, 0 /* offset */);
+    if (base == MAP_FAILED) {
+      throw FileIoException(open_->name, errno);
+    }
+    ::madvise(base, length, open_->map_advice);
+    mappings.push_back(
+        OpenFile::Mapping{static_cast<char *>(base), length});
+  }
+  return mappings.back().base + std::size_t(pagePosition(page_number));
+}
+
 void File::writePage(const Page &new_page) {
-  PageHeader header = readPageHeader(new_page.page_number());
-  if (header.current_page_number == Page::INVALID_NUMBER) {
+  std::lock_guard<std::recursive_mutex> guard(open_->latch);
+  const PageLinks links = pageLinks(new_page.page_number());
+  if (links.current_page_number == Page::INVALID_NUMBER) {
     // Page has been deleted since it was read.
-    throw InvalidPageException(new_page.page_number(), filename_);
-  }
-  // Page on disk may have had its next page pointer updated since it was read;
-  // we don't modify that, but we do keep all the other modifications to the
-  // page header.
-  const PageId next_page_number = header.next_page_number;
-  header = new_page.header_;
-  header.next_page_number = next_page_number;
+    throw InvalidPageException(new_page.page_number(), open_->name);
+  }
+  // Page on disk may have had its page pointers updated since it was read; we
+  // don't modify those, but we do keep all the other modifications to the page
+  // header.
+  PageHeader header = *new_page.header_;
+  header.next_page_number = links.next_page_number;
+  header.prev_page_number = links.prev_page_number;
   writePage(new_page.page_number(), header, new_page);
 }
 
+void File::writePages(const std::vector<const Page *> &pages,
+                      const bool sync) {
+  std::lock_guard<std::recursive_mutex> guard(open_->latch);
+
+  // Check every page before writing any, keeping the links on disk as
+  // writePage() does
+  std::vector<PageHeader> headers(pages.size());
+  for (std::size_t i = 0; i < pages.size(); i++) {
+    const PageLinks links = pageLinks(pages[i]->page_number());
+    if (links.current_page_number == Page::INVALID_NUMBER) {
+      throw InvalidPageException(pages[i]->page_number(), open_->name);
+    }
+    headers[i] = *pages[i]->header_;
+    headers[i].next_page_number = links.next_page_number;
+    headers[i].prev_page_number = links.prev_page_number;
+    if (open_->header.flags & FLAG_CHECKSUMS) {
+      headers[i].checksum = pageChecksum(headers[i], pages[i]->data_);
+    }
+  }
+
+  // Each page takes two buffers, its header and its data
+  const std::size_t max_run = IOV_MAX / 2;
+  std::vector<iovec> buffers;
+  for (std::size_t first = 0; first < pages.size();) {
+    std::size_t end = first + 1;
+    while (end < pages.size() && end - first < max_run &&
+           pages[end]->page_number() == pages[end - 1]->page_number() + 1) {
+      end++;
+    }
+    if (open_->header.flags & FLAG_COMPRESSED) {
+      for (std::size_t i = first; i < end; i++) {
+        writeCompressed(pages[i]->page_number(), headers[i], pages[i]->data_);
+      }
+    } else if (open_->direct) {
+      // Direct I/O can't gather the headers and data from separate buffers,
+      // so assemble the run in an aligned staging buffer
+      Staging staging = allocateStaging(end - first);
+      for (std::size_t i = first; i < end; i++) {
+        char *image = staging.get() + (i - first) * Page::SIZE;
+        std::memcpy(image, &headers[i], sizeof(PageHeader));
+        std::memcpy(image + sizeof(PageHeader), pages[i]->data_,
+                    Page::DATA_SIZE);
+      }
+      writeAt(open_->direct_fd, pagePosition(pages[first]->page_number()),
+              staging.get(), (end - first) * Page::SIZE);
+    } else {
+      buffers.clear();
+      for (std::size_t i = first; i < end; i++) {
+        buffers.push_back({&headers[i], sizeof(PageHeader)});
+        buffers.push_back({pages[i]->data_, Page::DATA_SIZE});
+      }
+      writeVectored(pagePosition(pages[first]->page_number()), buffers);
+    }
+    for (std::size_t i = first; i < end; i++) {
+      cacheLinks(pages[i]->page_number(), headers[i]);
+    }
+    first = end;
+  }
+
+  if (sync) {
+    writeBackHeader();
+    if (fdatasync(fd_) != 0) {
+      throw FileIoException(open_->name, errno);
+    }
+  }
+}
+
+void File::writeVectored(const std::streamoff offset,
+                         std::vector<iovec> &buffers) {
+  BADGERDB_TRACE_START(traceStart);
+  std::size_t next = 0;
+  std::streamoff position = offset;
+  while (next < buffers.size()) {
+    const ssize_t written =
+        pwritev(fd_, &buffers[next], buffers.size() - next, position);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      throw FileIoException(open_->name, errno);
+    }
+    // Skip what a short write did transfer
+    position += written;
+    std::size_t remaining = written;
+    while (next < buffers.size() && remaining >= buffers[next].iov_len) {
+      remaining -= buffers[next].iov_len;
+      next++;
+    }
+    if (next < buffers.size()) {
+      buffers[next].iov_base = static_cast<char *>(buffers[next].iov_base) +
+                               remaining;
+      buffers[next].iov_len -= remaining;
+    }
+  }
+  BADGERDB_TRACE(TraceEvent::FILE_WRITE, traceStart, id_,
+                 static_cast<PageId>(offset / Page::SIZE), position - offset,
+                 0);
+}
+
+void File::readVectored(const int fd, const std::streamoff offset,
+                        std::vector<iovec> &buffers) const {
+  BADGERDB_TRACE_START(traceStart);
+  std::size_t length = 0;
+  for (const iovec &buffer : buffers) {
+    length += buffer.iov_len;
+  }
+  std::size_t next = 0;
+  std::streamoff position = offset;
+  while (next < buffers.size()) {
+    const int count =
+        static_cast<int>(std::min<std::size_t>(buffers.size() - next, IOV_MAX));
+    const ssize_t read = preadv(fd, &buffers[next], count, position);
+    if (read < 0) {
+      if (errno == EINTR) continue;
+      throw FileIoException(open_->name, errno);
+    }
+    if (read == 0) {
+      // Past the end of the file
+      for (; next < buffers.size(); next++) {
+        std::memset(buffers[next].iov_base, 0, buffers[next].iov_len);
+      }
+      break;
+    }
+    // Skip what a short read did fill
+    position += read;
+    std::size_t remaining = read;
+    while (next < buffers.size() && remaining >= buffers[next].iov_len) {
+      remaining -= buffers[next].iov_len;
+      next++;
+    }
+    if (next < buffers.size()) {
+      buffers[next].iov_base = static_cast<char *>(buffers[next].iov_base) +
+                               remaining;
+      buffers[next].iov_len -= remaining;
+    }
+  }
+  BADGERDB_TRACE(TraceEvent::FILE_READ, traceStart, id_,
+                 static_cast<PageId>(offset / Page::SIZE), length, 0);
+}
+
+void File::readAt(const int fd, const std::streamoff position, char *buffer,
+                  const std::size_t length) const {
+  BADGERDB_TRACE_START(traceStart);
+  for (std::size_t done = 0; done < length;) {
+    const ssize_t read = pread(fd, buffer + done, length - done,
+                               position + std::streamoff(done));
+    if (read < 0) {
+      if (errno == EINTR) continue;
+      throw FileIoException(open_->name, errno);
+    }
+    if (read == 0) {
+      // Past the end of the file
+      std::memset(buffer + done, 0, length - done);
+      break;
+    }
+    done += read;
+  }
+  BADGERDB_TRACE(TraceEvent::FILE_READ, traceStart, id_,
+                 static_cast<PageId>(position / Page::SIZE), length, 0);
+}
+
+void File::writeAt(const int fd, const std::streamoff position,
+                   const char *buffer, const std::size_t length) {
+  BADGERDB_TRACE_START(traceStart);
+  for (std::size_t done = 0; done < length;) {
+    const ssize_t written = pwrite(fd, buffer + done, length - done,
+                                   position + std::streamoff(done));
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      throw FileIoException(open_->name, errno);
+    }
+    done += written;
+  }
+  BADGERDB_TRACE(TraceEvent::FILE_WRITE, traceStart, id_,
+                 static_cast<PageId>(position / Page::SIZE), length, 0);
+}
+
+int File::pageFd() const {
+  std::lock_guard<std::recursive_mutex> guard(open_->latch);
+  return open_->direct ? open_->direct_fd : fd_;
+}
+
+void File::setDirectIo(const bool enable) {
+  std::lock_guard<std::recursive_mutex> guard(open_->latch);
+  if (enable && open_->direct_fd < 0) {
+    const int direct_fd = ::open(open_->name.c_str(), O_RDWR | O_DIRECT);
+    if (direct_fd < 0) {
+      throw FileIoException(open_->name, errno);
+    }
+    open_->direct_fd = direct_fd;
+  }
+  // The descriptor stays open until the file is closed, since reads issued
+  // without the latch may still be using it
+  open_->direct = enable;
+}
+
+bool File::isDirectIo() const {
+  std::lock_guard<std::recursive_mutex> guard(open_->latch);
+  return open_->direct;
+}
+
+bool File::hasChecksums() const {
+  return readHeader().flags & FLAG_CHECKSUMS;
+}
+
+bool File::isCompressed() const {
+  return readHeader().flags & FLAG_COMPRESSED;
+}
+
+bool File::verifyPage(const Page &page) const {
+  return !hasChecksums() ||
+         page.header_->checksum == pageChecksum(*page.header_, page.data_);
+}
+
 void File::deletePage(const PageId page_number) {
+  std::lock_guard<std::recursive_mutex> guard(open_->latch);
   FileHeader header = readHeader();
-  Page existing_page = readPage(page_number);
-  Page previous_page;
-  // If this page is the head of the used list, update the header to point to
-  // the next page in line.
-  if (page_number == header.first_used_page) {
-    header.first_used_page = existing_page.next_page_number();
+  if (page_number >= header.num_pages) {
+    throw InvalidPageException(page_number, open_->name);
+  }
+  const PageLinks existing = pageLinks(page_number);
+  if (existing.current_page_number == Page::INVALID_NUMBER) {
+    throw InvalidPageException(page_number, open_->name);
+  }
+
+  // Unlink the page from its neighbours in the used list, or from the ends of
+  // the list kept in the header.
+  if (existing.prev_page_number == Page::INVALID_NUMBER) {
+    header.first_used_page = existing.next_page_number;
   } else {
-    // Walk the used list so we can update the page that points to this one.
-    for (FileIterator iter = begin(); iter != end(); ++iter) {
-      previous_page = *iter;
-      if (previous_page.next_page_number() == existing_page.page_number()) {
-        previous_page.set_next_page_number(existing_page.next_page_number());
-        break;
-      }
-    }
+    const PageLinks previous = pageLinks(existing.prev_page_number);
+    writeLinks(existing.prev_page_number, existing.next_page_number,
+               previous.prev_page_number);
   }
+  if (existing.next_page_number == Page::INVALID_NUMBER) {
+    header.last_used_page = existing.prev_page_number;
+  } else {
+    const PageLinks next = pageLinks(existing.next_page_number);
+    writeLinks(existing.next_page_number, next.next_page_number,
+               existing.prev_page_number);
+  }
+
   // Clear the page and add it to the head of the free list.
-  existing_page.initialize();
-  existing_page.set_next_page_number(header.first_free_page);
+  Page cleared_page;
+  cleared_page.initialize();
+  cleared_page.set_next_page_number(header.first_free_page);
   header.first_free_page = page_number;
   ++header.num_free_pages;
-  if (previous_page.isUsed()) {
-    writePage(previous_page.page_number(), previous_page);
-  }
-  writePage(page_number, existing_page);
+  writePage(page_number, cleared_page);
   writeHeader(header);
 }
 
@@ -219,88 +754,336 @@ FileIterator File::begin() {
 
 FileIterator File::end() { return FileIterator(this, Page::INVALID_NUMBER); }
 
-File::File(const std::string &name, const bool create_new)
-    : filename_(name), valid_(true) {
-  openIfNeeded(create_new);
+File::File(const std::string &name, const bool create_new,
+           const bool checksums, const bool compressed)
+    : id_(INVALID_ID), open_(nullptr), fd_(-1), valid_(true) {
+  openIfNeeded(name, create_new);
 
   if (create_new) {
     // File starts with 1 page (the header).
     FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
-                         0 /* num_free_pages */, 0 /* first_free_page */};
+                         0 /* last_used_page */, 0 /* num_free_pages */,
+                         0 /* first_free_page */, FORMAT_VERSION,
+                         (checksums ? FLAG_CHECKSUMS : 0) |
+                             (compressed ? FLAG_COMPRESSED : 0) /* flags */,
+                         Page::SIZE /* page_size */};
     writeHeader(header);
+    sync();
+  } else if (readHeader().page_size != Page::SIZE) {
+    // Pages would be read from the wrong positions
+    const std::uint32_t page_size = readHeader().page_size;
+    close();
+    throw PageSizeMismatchException(name, page_size);
   }
 }
 
-void File::openIfNeeded(const bool create_new) {
-  if (open_counts_.find(filename_) !=
-      open_counts_.end()) {  // exists an entry already
-    ++open_counts_[filename_];
-    stream_ = open_streams_[filename_];
+void File::openIfNeeded(const std::string &name, const bool create_new) {
+  std::unique_lock<std::mutex> guard(open_files_latch_);
+  std::map<std::string, FileId>::iterator existing;
+  while ((existing = open_names_.find(name)) != open_names_.end()) {
+    // exists an entry already
+    OpenFile &entry = open_files_[existing->second - 1];
+    int count = entry.count.load(std::memory_order_relaxed);
+    while (count > 0 &&
+           !entry.count.compare_exchange_weak(count, count + 1,
+                                              std::memory_order_relaxed)) {
+    }
+    if (count > 0) {
+      open_ = &entry;
+      id_ = entry.id;
+      fd_ = entry.fd;
+      return;
+    }
+    // The last File object for it is closing the file; let it finish
+    guard.unlock();
+    std::this_thread::yield();
+    guard.lock();
+  }
+  int flags = O_RDWR;
+  const bool already_exists = exists(name);
+  if (create_new) {
+    // Error if we try to overwrite an existing file.
+    if (already_exists) {
+      throw FileExistsException(name);
+    }
+    flags |= O_CREAT | O_TRUNC;
   } else {
-    std::ios_base::openmode mode =
-        std::fstream::in | std::fstream::out | std::fstream::binary;
-    const bool already_exists = exists(filename_);
-    if (create_new) {
-      // Error if we try to overwrite an existing file.
-      if (already_exists) {
-        throw FileExistsException(filename_);
-      }
-      // New files have to be truncated on open.
-      mode = mode | std::fstream::trunc;
-    } else {
-      // Error if we try to open a file that doesn't exist.
-      if (!already_exists) {
-        valid_ = false;
-        throw FileNotFoundException(filename_);
-      }
+    // Error if we try to open a file that doesn't exist.
+    if (!already_exists) {
+      valid_ = false;
+      throw FileNotFoundException(name);
+    }
+  }
+  if (free_ids_.empty() && next_id_ > MAX_OPEN_FILES) {
+    valid_ = false;
+    throw FileIoException(name, EMFILE);
+  }
+  fd_ = ::open(name.c_str(), flags, 0666);
+  if (fd_ < 0) {
+    valid_ = false;
+    throw FileIoException(name, errno);
+  }
+  if (free_ids_.empty()) {
+    id_ = next_id_++;
+  } else {
+    id_ = free_ids_.back();
+    free_ids_.pop_back();
+  }
+  open_ = &open_files_[id_ - 1];
+  open_->name = name;
+  open_->id = id_;
+  open_->open_number = next_open_number_++;
+  open_->fd = fd_;
+  open_->count.store(1, std::memory_order_relaxed);
+  open_->header = FileHeader();
+  open_->header_dirty = false;
+  open_->links.clear();
+  open_->mapped = false;
+  open_->map_advice = MADV_NORMAL;
+  open_->direct = false;
+  open_->direct_fd = -1;
+  if (!create_new) {
+    try {
+      readAt(fd_, 0 /* position */, reinterpret_cast<char *>(&open_->header),
+             sizeof(open_->header));
+    } catch (...) {
+      // Nothing else knows about the entry yet
+      ::close(fd_);
+      free_ids_.push_back(id_);
+      open_->name.clear();
+      open_ = nullptr;
+      id_ = INVALID_ID;
+      fd_ = -1;
+      valid_ = false;
+      throw;
     }
-    stream_.reset(new std::fstream(filename_, mode));
-    open_streams_[filename_] = stream_;
-    open_counts_[filename_] = 1;
   }
+  open_names_[name] = id_;
 }
 
 void File::close() {
-  --open_counts_[filename_];
-  stream_.reset();
-  if (open_counts_[filename_] == 0) {
-    open_streams_.erase(filename_);
-    open_counts_.erase(filename_);
+  if (open_ && open_->count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    // No File object is left to copy, and openIfNeeded() refuses to revive a
+    // count of zero, so the entry is ours to tear down
+    std::lock_guard<std::mutex> guard(open_files_latch_);
+    {
+      std::lock_guard<std::recursive_mutex> file_guard(open_->latch);
+      writeBackHeader();
+      for (const OpenFile::Mapping &mapping : open_->mappings) {
+        ::munmap(mapping.base, mapping.length);
+      }
+      open_->mappings.clear();
+      if (open_->direct_fd >= 0) {
+        ::close(open_->direct_fd);
+      }
+    }
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+    open_names_.erase(open_->name);
+    open_->name.clear();
+    open_->links.clear();
+    free_ids_.push_back(id_);
   }
+  open_ = nullptr;
+  id_ = INVALID_ID;
+  fd_ = -1;
 }
 
 void File::writePage(const PageId page_number, const Page &new_page) {
-  writePage(page_number, new_page.header_, new_page);
+  std::lock_guard<std::recursive_mutex> guard(open_->latch);
+  if (open_->header.flags & (FLAG_CHECKSUMS | FLAG_COMPRESSED)) {
+    // Stamped or compressed on a copy of the header
+    writePage(page_number, *new_page.header_, new_page);
+    return;
+  }
+  writeAt(pageFd(), pagePosition(page_number), new_page.image_, Page::SIZE);
+  cacheLinks(page_number, *new_page.header_);
 }
 
 void File::writePage(const PageId page_number, const PageHeader &header,
                      const Page &new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char *>(&header), sizeof(header));
-  stream_->write(&new_page.data_[0], Page::DATA_SIZE);
-  stream_->flush();
+  std::lock_guard<std::recursive_mutex> guard(open_->latch);
+  PageHeader stamped = header;
+  if (open_->header.flags & FLAG_CHECKSUMS) {
+    stamped.checksum = pageChecksum(stamped, new_page.data_);
+  }
+  if (open_->header.flags & FLAG_COMPRESSED) {
+    writeCompressed(page_number, stamped, new_page.data_);
+  } else if (open_->direct) {
+    Staging staging = allocateStaging(1);
+    std::memcpy(staging.get(), &stamped, sizeof(stamped));
+    std::memcpy(staging.get() + sizeof(stamped), new_page.data_,
+                Page::DATA_SIZE);
+    writeAt(open_->direct_fd, pagePosition(page_number), staging.get(),
+            Page::SIZE);
+  } else {
+    std::vector<iovec> buffers = {{&stamped, sizeof(stamped)},
+                                  {new_page.data_, Page::DATA_SIZE}};
+    writeVectored(pagePosition(page_number), buffers);
+  }
+  cacheLinks(page_number, header);
 }
 
-FileHeader File::readHeader() const {
-  FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char *>(&header), sizeof(header));
+void File::writeCompressed(const PageId page_number, const PageHeader &header,
+                           const char *data) {
+  // Compressing only pays if it frees at least one aligned block
+  const std::size_t capacity =
+      Page::SIZE > Page::ALIGNMENT + sizeof(PageHeader)
+          ? Page::SIZE - Page::ALIGNMENT - sizeof(PageHeader)
+          : 0;
+  Staging staging = allocateStaging(1);
+  char *image = staging.get();
+  PageHeader stored = header;
+  const std::size_t compressed =
+      capacity == 0 ? 0
+                    : lzCompress(data, Page::DATA_SIZE,
+                                 image + sizeof(PageHeader), capacity);
+  std::size_t length = Page::SIZE;
+  if (compressed != 0) {
+    stored.compressed_length = static_cast<PageOffset>(compressed);
+    length = (sizeof(PageHeader) + compressed + Page::ALIGNMENT - 1) /
+             Page::ALIGNMENT * Page::ALIGNMENT;
+    std::memset(image + sizeof(PageHeader) + compressed, 0,
+                length - sizeof(PageHeader) - compressed);
+  } else {
+    stored.compressed_length = 0;
+    std::memcpy(image + sizeof(PageHeader), data, Page::DATA_SIZE);
+  }
+  std::memcpy(image, &stored, sizeof(stored));
 
-  return header;
+  const std::streamoff position = pagePosition(page_number);
+  writeAt(pageFd(), position, image, length);
+  if (length == Page::SIZE) {
+    return;
+  }
+#if defined(__linux__)
+  // Without hole punching the tail just keeps its blocks
+  fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+            position + std::streamoff(length), Page::SIZE - length);
+#endif
+  // The file still covers the whole slot, so that mappings and reads of the
+  // last page see zeros rather than the end of the file
+  struct stat status;
+  const std::streamoff end = position + std::streamoff(Page::SIZE);
+  if (fstat(fd_, &status) == 0 && status.st_size < end &&
+      ftruncate(fd_, end) != 0) {
+    throw FileIoException(open_->name, errno);
+  }
+}
+
+void File::decompressPage(const PageId page_number, Page &page) const {
+  const std::size_t compressed = page.header_->compressed_length;
+  if (compressed == 0) {
+    return;
+  }
+  if (compressed > Page::DATA_SIZE) {
+    throw CorruptPageException(page_number, open_->name);
+  }
+  const std::unique_ptr<char[]> copy(new char[compressed]);
+  std::memcpy(copy.get(), page.data_, compressed);
+  if (!lzDecompress(copy.get(), compressed, page.data_, Page::DATA_SIZE)) {
+    throw CorruptPageException(page_number, open_->name);
+  }
+  page.header_->compressed_length = 0;
+}
+
+FileHeader File::readHeader() const {
+  std::lock_guard<std::recursive_mutex> guard(open_->latch);
+  return open_->header;
 }
 
 void File::writeHeader(const FileHeader &header) {
-  stream_->seekp(0 /* pos */, std::ios::beg);
-  stream_->write(reinterpret_cast<const char *>(&header), sizeof(header));
-  stream_->flush();
+  std::lock_guard<std::recursive_mutex> guard(open_->latch);
+  open_->header = header;
+  open_->header_dirty = true;
+}
+
+void File::writeBackHeader() {
+  if (!open_->header_dirty) {
+    return;
+  }
+  writeAt(fd_, 0 /* position */,
+          reinterpret_cast<const char *>(&open_->header),
+          sizeof(open_->header));
+  open_->header_dirty = false;
+}
+
+void File::sync() {
+  std::lock_guard<std::recursive_mutex> guard(open_->latch);
+  writeBackHeader();
+}
+
+void File::syncHeader() {
+  std::lock_guard<std::recursive_mutex> guard(open_->latch);
+  if (!open_->header_dirty) {
+    return;
+  }
+  writeBackHeader();
+  if (fdatasync(fd_) != 0) {
+    throw FileIoException(open_->name, errno);
+  }
 }
 
 PageHeader File::readPageHeader(PageId page_number) const {
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char *>(&header), sizeof(header));
+  std::lock_guard<std::recursive_mutex> guard(open_->latch);
+  readAt(fd_, pagePosition(page_number), reinterpret_cast<char *>(&header),
+         sizeof(header));
+  cacheLinks(page_number, header);
 
   return header;
 }
 
+void File::writeLinks(const PageId page_number, const PageId next_page_number,
+                      const PageId prev_page_number) {
+  static_assert(offsetof(PageHeader, prev_page_number) ==
+                    offsetof(PageHeader, next_page_number) + sizeof(PageId),
+                "Page links must be adjacent in the page header");
+  const PageId links[] = {next_page_number, prev_page_number};
+  std::lock_guard<std::recursive_mutex> guard(open_->latch);
+  writeAt(fd_,
+          pagePosition(page_number) +
+              std::streamoff(offsetof(PageHeader, next_page_number)),
+          reinterpret_cast<const char *>(links), sizeof(links));
+
+  PageLinks &cached = open_->links[page_number];
+  cached.next_page_number = next_page_number;
+  cached.prev_page_number = prev_page_number;
+}
+
+File::PageLinks File::pageLinks(const PageId page_number) const {
+  std::lock_guard<std::recursive_mutex> guard(open_->latch);
+  if (page_number >= open_->links.size() || !open_->links[page_number].known) {
+    readPageHeader(page_number);
+  }
+  return open_->links[page_number];
+}
+
+void File::cacheLinks(const PageId page_number,
+                      const PageHeader &header) const {
+  std::vector<PageLinks> &links = open_->links;
+  if (page_number >= links.size()) {
+    links.resize(page_number + 1, PageLinks{false, Page::INVALID_NUMBER,
+                                            Page::INVALID_NUMBER,
+                                            Page::INVALID_NUMBER});
+  }
+  PageLinks &cached = links[page_number];
+  cached.known = true;
+  cached.current_page_number = header.current_page_number;
+  cached.next_page_number = header.next_page_number;
+  cached.prev_page_number = header.prev_page_number;
+}
+
+void File::learnLinks(const PageId page_number,
+                      const PageHeader &header) const {
+  std::lock_guard<std::recursive_mutex> guard(open_->latch);
+  if (page_number < open_->links.size() && open_->links[page_number].known) {
+    // The page was read without the latch, so a link update may have landed
+    // after the read; the cache is kept current by every write
+    return;
+  }
+  cacheLinks(page_number, header);
+}
+
 }  // namespace badgerdb
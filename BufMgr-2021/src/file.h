@@ -8,16 +8,44 @@
 
 #pragma once
 
-#include <fstream>
+#include <sys/uio.h>
+
+#include <atomic>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "page.h"
 
 namespace badgerdb {
 
 class FileIterator;
+class IoBatch;
+
+/**
+ * @brief Expected access pattern of a memory-mapped file, passed on to the
+ * operating system as a madvise() hint
+ */
+enum class MapAccess {
+  /**
+   * No particular pattern
+   */
+  NORMAL,
+
+  /**
+   * Pages are read in order; the operating system reads ahead aggressively
+   * and drops pages soon after they have been read
+   */
+  SEQUENTIAL,
+
+  /**
+   * Pages are read in no particular order; the operating system does not
+   * read ahead
+   */
+  RANDOM
+};
 
 /**
  * @brief Header metadata for files on disk which contain pages.
@@ -33,6 +61,11 @@ struct FileHeader {
    */
   PageId first_used_page;
 
+  /**
+   * Page number of the last used page in the file.
+   */
+  PageId last_used_page;
+
   /**
    * Number of free pages (allocated but unused) in the file.
    */
@@ -43,6 +76,23 @@ struct FileHeader {
    */
   PageId first_free_page;
 
+  /**
+   * Version of the on-disk format the file was created with.
+   */
+  std::uint32_t format_version;
+
+  /**
+   * Features of the format enabled for the file, a combination of the
+   * File::FLAG_* values.
+   */
+  std::uint32_t flags;
+
+  /**
+   * Size in bytes of the pages of the file, the Page::SIZE of the binary that
+   * created it.
+   */
+  std::uint32_t page_size;
+
   /**
    * Returns true if this file header is equal to the other.
    *
@@ -52,7 +102,10 @@ struct FileHeader {
   bool operator==(const FileHeader &rhs) const {
     return num_pages == rhs.num_pages && num_free_pages == rhs.num_free_pages &&
            first_used_page == rhs.first_used_page &&
-           first_free_page == rhs.first_free_page;
+           last_used_page == rhs.last_used_page &&
+           first_free_page == rhs.first_free_page &&
+           format_version == rhs.format_version && flags == rhs.flags &&
+           page_size == rhs.page_size;
   }
 };
 
@@ -60,39 +113,93 @@ struct FileHeader {
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
  *
- * The File class wraps a stream to an underlying file on disk.  Files contain
+ * The File class wraps a descriptor of an underlying file on disk, read and
+ * written with positioned I/O (pread/pwrite).  Files contain
  * fixed-sized pages, and they never deallocate space (though they do reuse
- * deleted pages if possible).  If multiple File objects refer to the same
- * underlying file, they will share the stream in memory.
+ * deleted pages if possible).  Used pages form a doubly linked list in the
+ * order they were allocated, and free pages a stack, so that allocating and
+ * deleting a page touch a constant number of pages.  If multiple File objects
+ * refer to the same underlying file, they will share the descriptor.
  * If a file that has already been opened (possibly by another query), then the
- * File class detects this (by looking in the open_streams_ map) and just
- * returns a file object with the already created stream for the file without
- * actually opening the UNIX file again.
+ * File class detects this (by looking up its name in open_names_) and just
+ * returns a file object with the already opened descriptor for the file
+ * without actually opening the UNIX file again.
+ *
+ * The state of open files lives in a table of MAX_OPEN_FILES entries,
+ * indexed by file identifier, which File objects point into.  Copying or
+ * destroying a File object only updates the reference count of its entry.
+ * Once the last File object for a file is gone, its entry and identifier are
+ * handed to the next file opened, which gets a different openNumber().
+ * Opening a file while MAX_OPEN_FILES others are open fails.
+ *
+ * The file header and the list links of the pages read so far are cached
+ * with the descriptor.  Page reads are bounds checked against the cached header
+ * and page writes keep the cached links, without extra I/O.  The cached
+ * header is written back by sync() and when the last File object for the
+ * file closes it.
  *
- * @warning This class is not threadsafe.
+ * The name index is guarded by a single latch, and every File object
+ * sharing a descriptor also shares a latch that serializes writes and guards
+ * the cached state.  Page reads only hold the latch to look up the header and
+ * cache links, so reads of the same file proceed in parallel.  Separate File
+ * objects may therefore be used from different threads; a single File object
+ * should not be assigned to while another thread is using it.
  */
 class File {
  public:
+  /**
+   * Version of the on-disk format written by this code.
+   */
+  static const std::uint32_t FORMAT_VERSION = 3;
+
+  /**
+   * Flag set in FileHeader::flags for files whose pages carry a checksum.
+   */
+  static const std::uint32_t FLAG_CHECKSUMS = 1;
+
+  /**
+   * Flag set in FileHeader::flags for files whose pages are stored
+   * compressed.
+   */
+  static const std::uint32_t FLAG_COMPRESSED = 2;
+
   /**
    * Creates a new file.
    *
    * @param filename  Name of the file.
+   * @param checksums Whether to stamp every page written with a CRC-32C
+   *                  checksum and verify it when the page is read back.
+   * @param compressed  Whether to store pages compressed.  Every page keeps
+   *                    its slot of Page::SIZE bytes, so page positions and
+   *                    in-place link updates work as usual, but only its
+   *                    header and compressed data are written, rounded up to
+   *                    Page::ALIGNMENT, and the rest of the slot is
+   *                    deallocated as a hole.  Reads decompress into the
+   *                    page object.  Meant for cold data: disk space and
+   *                    device reads shrink, but every write compresses.
    * @throws  FileExistsException     If the requested file already exists.
+   * @throws  FileIoException         If MAX_OPEN_FILES files are open
+   *                                  already (errno EMFILE).
    */
-  static File create(const std::string &filename);
+  static File create(const std::string &filename,
+                     const bool checksums = false,
+                     const bool compressed = false);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
    * It first checks if the file is already open. If so, then the new File
-   * object created uses the same input-output stream to read to or write fom
-   * that already open file. Reference count (open_counts_ static variable
-   * inside the File object) is incremented whenever an already open file is
-   * opened again. Otherwise the UNIX file is actually opened. The fileName and
-   * the stream associated with this File object are inserted into the
-   * open_streams_ map.
+   * object created uses the same descriptor to read to or write from
+   * that already open file. Reference count (count of the OpenFile entry in
+   * the open_files_ table) is incremented whenever an already open file is
+   * opened again. Otherwise the UNIX file is actually opened into a free
+   * entry of the table, possibly one a closed file has left, whose
+   * identifier the file takes over, and the name is added to open_names_.
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
+   * @throws  FileIoException         If the file can't be opened, or
+   *                                  MAX_OPEN_FILES files are open already
+   *                                  (errno EMFILE).
    */
   static File open(const std::string &filename);
 
@@ -136,18 +243,19 @@ class File {
   File &operator=(const File &rhs);
 
   /**
-   * Check if two files are equal.
+   * Check if two files are equal.  All File objects for the same open file
+   * share its identifier.
    * @param rhs File object to compare.
    * @return True if the two files are equal.
    */
-  bool operator==(const File &rhs) const { return filename_ == rhs.filename_; }
+  bool operator==(const File &rhs) const { return id_ == rhs.id_; }
 
   /**
    * Check if two files are not equal.
    * @param rhs File object to compare.
    * @return True if the two files are not equal.
    */
-  bool operator!=(const File &rhs) const { return filename_ != rhs.filename_; }
+  bool operator!=(const File &rhs) const { return id_ != rhs.id_; }
 
   /**
    * Destructor that automatically closes the underlying file if no other
@@ -156,12 +264,44 @@ class File {
   ~File();
 
   /**
-   * Allocates a new page in the file.
+   * Allocates a new page in the file, reusing a deleted page if there is one.
+   * The page becomes the last page of the used list.
    *
    * @return The new page.
    */
   Page allocatePage();
 
+  /**
+   * Allocates a new page in the file and places it in the given page object,
+   * overwriting its previous contents.  Lets the buffer manager allocate
+   * straight into a buffer frame.
+   *
+   * @param new_page  Page object that receives the new page.
+   */
+  void allocatePageInto(Page &new_page);
+
+  /**
+   * Allocates a run of consecutive new pages at the end of the file with a
+   * single write.  Free pages are not reused, since they would break up the
+   * run.  The pages become the last pages of the used list, in order.
+   *
+   * @param count   Number of pages to allocate.
+   * @return  Number of the first page of the run, or Page::INVALID_NUMBER if
+   *          count is zero.
+   */
+  PageId allocateExtent(const PageId count);
+
+  /**
+   * Allocates a run of consecutive new pages like allocateExtent() and places
+   * page first + i in pages[i], overwriting their previous contents.  Lets the
+   * buffer manager allocate straight into buffer frames.
+   *
+   * @param pages   Page objects that receive the new pages.
+   * @return  Number of the first page of the run, or Page::INVALID_NUMBER if
+   *          pages is empty.
+   */
+  PageId allocateExtentInto(const std::vector<Page *> &pages);
+
   /**
    * Reads an existing page from the file.
    *
@@ -169,9 +309,111 @@ class File {
    * @return  The page.
    * @throws  InvalidPageException  If the page doesn't exist in the file or is
    *                                not currently used.
+   * @throws  CorruptPageException  If the file has checksums and the page
+   *                                does not match its checksum.
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file into the given page object,
+   * overwriting its previous contents.  Lets the buffer manager read straight
+   * into a buffer frame without a temporary page.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page object that receives the page.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   * @throws  CorruptPageException  If the file has checksums and the page
+   *                                does not match its checksum.
+   */
+  void readPageInto(const PageId page_number, Page &page) const;
+
+  /**
+   * Reads consecutive pages from the file with a single read, placing page
+   * first_page + i into pages[i].  Free (unused) pages are read like any other
+   * and have Page::INVALID_NUMBER as their page number.  Checksums are not
+   * verified; callers check the pages they keep with verifyPage().
+   *
+   * @param first_page  Number of the first page to read.
+   * @param pages       Page objects that receive the pages.
+   * @throws  InvalidPageException  If any of the pages doesn't exist in the
+   *                                file.
+   */
+  void readPagesInto(const PageId first_page,
+                     const std::vector<Page *> &pages) const;
+
+  /**
+   * Maps the file into memory.  Afterwards mappedPage() can serve pages
+   * straight from the operating system's page cache, and page reads copy out
+   * of the mapping instead of being read from the file.  The mapping is
+   * shared by every File object for the file and lasts until the file is
+   * closed; mapping it again only changes the access hint.
+   *
+   * @param access  Expected access pattern.
+   * @throws  FileIoException If the file cannot be mapped.
+   */
+  void map(const MapAccess access = MapAccess::NORMAL);
+
+  /**
+   * Returns true if the file has been mapped into memory with map().
+   */
+  bool isMapped() const;
+
+  /**
+   * Returns a page viewing an existing page in the memory mapping, without
+   * copying it.  The page is read-only and must not be modified; it stays
+   * valid until the file is closed, although a rewrite of the page through
+   * this or another File object shows through it.  Pages of compressed
+   * files are decompressed into a copy instead.
+   *
+   * @param page_number   Number of page to view.
+   * @return  Page viewing the mapping.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   * @throws  FileIoException       If the file is not mapped or its mapping
+   *                                cannot be extended.
+   * @throws  CorruptPageException  If the file has checksums and the page
+   *                                does not match its checksum.
+   */
+  Page mappedPage(const PageId page_number) const;
+
+  /**
+   * Switches direct I/O on or off.  With direct I/O, whole pages are read and
+   * written with O_DIRECT, bypassing the operating system's page cache so
+   * that a page cached by the buffer manager is not cached a second time by
+   * the kernel.  Pages are transferred straight to and from their images,
+   * which are aligned to Page::ALIGNMENT.  The setting is shared by every
+   * File object for the file and lasts until the file is closed.
+   *
+   * @param enable  Whether to use direct I/O.
+   * @throws  FileIoException If the file system does not support direct I/O.
+   */
+  void setDirectIo(const bool enable);
+
+  /**
+   * Returns true if the file is using direct I/O.
+   */
+  bool isDirectIo() const;
+
+  /**
+   * Returns true if the pages of the file carry checksums.
+   */
+  bool hasChecksums() const;
+
+  /**
+   * Returns true if the pages of the file are stored compressed.
+   */
+  bool isCompressed() const;
+
+  /**
+   * Checks a page read from the file against its checksum.
+   *
+   * @param page  Page as it was read.
+   * @return  True if the page matches its checksum or the file has no
+   *          checksums.
+   */
+  bool verifyPage(const Page &page) const;
+
   /**
    * Writes a page into the file, replacing any existing contents.  The page
    * must have been already allocated in this file by a call to allocatePage().
@@ -181,6 +423,19 @@ class File {
    */
   void writePage(const Page &new_page);
 
+  /**
+   * Writes pages into the file like writePage(const Page&), with one vectored
+   * write per run of consecutive page numbers.  Nothing is written if any of
+   * the pages has been deleted.
+   *
+   * @param pages   Pages to write, in ascending page number order.
+   * @param sync    True to also write back the file header and wait until
+   *                everything has reached stable storage.
+   * @throws  InvalidPageException  If any of the pages is not currently used.
+   * @throws  FileIoException       If a write or the sync fails.
+   */
+  void writePages(const std::vector<const Page *> &pages, const bool sync);
+
   /**
    * Deletes a page from the file.
    *
@@ -188,12 +443,50 @@ class File {
    */
   void deletePage(const PageId page_number);
 
+  /**
+   * Writes the cached file header back to disk if it has changed.
+   */
+  void sync();
+
+  /**
+   * Writes the cached file header back to disk if it has changed and waits
+   * until it is durable, along with the pages written before it.
+   *
+   * @throws  FileIoException If the header cannot be written or synced
+   */
+  void syncHeader();
+
   /**
    * Returns the name of the file this object represents.
    *
-   * @return Name of file.
+   * @return Name of file, or an empty string if the file is not valid.
+   */
+  const std::string &filename() const;
+
+  /**
+   * Returns the identifier of the open file this object represents.  All
+   * File objects for the same open file share the identifier.
+   *
+   * @return File identifier, or INVALID_ID if the file is not valid.
+   */
+  FileId id() const { return id_; }
+
+  /**
+   * Returns the number of the opening of the file this object represents.
+   * All File objects for the same open file share it, while a file opened
+   * later gets a new one even if it is handed the same identifier.
+   *
+   * @return Open number, or 0 if the file is not valid.
    */
-  const std::string &filename() const { return filename_; }
+  std::uint64_t openNumber() const { return open_ ? open_->open_number : 0; }
+
+  /**
+   * Returns the number of pages allocated in the file, counting the header
+   * page and free pages.  Page numbers of the file are below this number.
+   *
+   * @return Number of pages.
+   */
+  PageId num_pages() const { return readHeader().num_pages; }
 
   /**
    * Returns an iterator at the first page in the file.
@@ -221,7 +514,18 @@ class File {
    * Creates an empty file
    * @return File object with valid_ bit set to false
    */
-  File() : valid_(false) {}
+  File() : id_(INVALID_ID), open_(nullptr), fd_(-1), valid_(false) {}
+
+  /**
+   * Identifier of a file object that does not refer to an open file.
+   */
+  static const FileId INVALID_ID = 0;
+
+  /**
+   * Number of files that can be open at the same time.  Identifiers of open
+   * files run from 1 to this number.
+   */
+  static const std::uint32_t MAX_OPEN_FILES = 1024;
 
  private:
   friend class BufMgr;
@@ -235,12 +539,15 @@ class File {
    * @see File::open()
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param checksums   Whether a new file gets page checksums.
+   * @param compressed  Whether a new file stores its pages compressed.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  explicit File(const std::string &name, const bool create_new);
+  File(const std::string &name, const bool create_new,
+       const bool checksums = false, const bool compressed = false);
 
   /**
    * Returns the position of the page with the given number in the file (as an
@@ -250,26 +557,31 @@ class File {
    * @return  Position of page in file.
    */
   static std::streampos pagePosition(const PageId page_number) {
-    return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
+    // The file header takes up the whole of page 0, so every page starts on a
+    // multiple of Page::SIZE as direct I/O requires.
+    return page_number * Page::SIZE;
   }
 
   /**
-   * Opens the underlying file named in filename_.
+   * Opens the underlying file with the given name.
    * This method only opens the file if no other File objects exist that access
-   * the same filesystem file; otherwise, it reuses the existing stream.
+   * the same filesystem file; otherwise, it reuses the existing descriptor.
    *
+   * @param name        Name of file.
    * @param create_new  Whether to create a new file.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
+   * @throws  FileIoException         If the underlying file can't be opened,
+   *                                  or MAX_OPEN_FILES files are open.
    */
-  void openIfNeeded(const bool create_new);
+  void openIfNeeded(const std::string &name, const bool create_new);
 
   /**
-   * Closes the underlying file stream in <stream_>.
-   * This method only closes the file if no other File objects exist that access
-   * the same file.
+   * Closes the underlying file descriptor in <open_>, writing back the cached
+   * header first.  This method only closes the file if no other File objects
+   * exist that access the same file.
    */
   void close();
 
@@ -277,8 +589,8 @@ class File {
    * Reads a page from the file.  If <allow_free> is not set, an exception
    * will be thrown if the page read from disk is not currently in use.
    *
-   * No bounds checking is performed; the underlying file stream will throw
-   * an exception if the page is past the end of the file.
+   * No bounds checking is performed; a page past the end of the file reads
+   * as zeros.
    *
    * @param page_number   Number of page to read.
    * @param allow_free    Whether to allow reading a free (unused) page.
@@ -288,6 +600,30 @@ class File {
    */
   Page readPage(const PageId page_number, const bool allow_free) const;
 
+  /**
+   * Reads a page from the file into the given page object.  Behaves like
+   * readPage(page_number, allow_free) otherwise.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page object that receives the page.
+   * @param allow_free    Whether to allow reading a free (unused) page.
+   * @throws  InvalidPageException  If the page is free (unused) and
+   *                                allow_free is false.
+   */
+  void readPageInto(const PageId page_number, Page &page,
+                    const bool allow_free) const;
+
+  /**
+   * Adds a read of a page into the given page object to an I/O batch.  The
+   * page object must not be used until the batch has completed.  No bounds
+   * checking is performed and free pages are read like any other.
+   *
+   * @param batch       Batch to add the read to.
+   * @param page_number Number of page to read.
+   * @param page        Page object that receives the page.
+   */
+  void queueRead(IoBatch &batch, const PageId page_number, Page &page) const;
+
   /**
    * Writes a page into the file at the given page number.  This does not
    * update ensure that the number in the header equals the position on disk.
@@ -311,14 +647,39 @@ class File {
                  const Page &new_page);
 
   /**
-   * Reads the header for this file from disk.
+   * Writes a page of a compressed file at the given page number: the header
+   * as given, with its compressed length filled in, and the compressed data,
+   * or the data as it is if it does not compress enough to save an aligned
+   * block.  The rest of the page's slot is made a hole.  The caller holds
+   * the latch of the file.
+   *
+   * @param page_number Number of page whose contents to replace.
+   * @param header      Header of page to write, checksum stamped if need be.
+   * @param data        Data of page to write, Page::DATA_SIZE bytes.
+   */
+  void writeCompressed(const PageId page_number, const PageHeader &header,
+                       const char *data);
+
+  /**
+   * Decompresses a page of a compressed file read into the given page
+   * object, in place.  Pages stored as they are are left alone.
+   *
+   * @param page_number   Number of page.
+   * @param page          Page as it was read.
+   * @throws  CorruptPageException  If the compressed data is corrupt.
+   */
+  void decompressPage(const PageId page_number, Page &page) const;
+
+  /**
+   * Returns the cached header for this file.
    *
    * @return  The file header.
    */
   FileHeader readHeader() const;
 
   /**
-   * Writes the given header to the disk as the header for this file.
+   * Replaces the cached header for this file.  It is written to disk by
+   * sync() or when the file is closed.
    *
    * @param header  File header to write.
    */
@@ -326,35 +687,250 @@ class File {
 
   /**
    * Reads only the header of the given page from disk (not the record data
-   * or slot table).  No bounds checking is performed.
+   * or slot table).  No bounds checking is performed.  The links of the page
+   * are cached.
    *
    * @param page_number   Number of page whose header is to be read.
    * @return  Header of page.
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
-  typedef std::map<std::string, std::shared_ptr<std::fstream>> StreamMap;
-  typedef std::map<std::string, int> CountMap;
+  /**
+   * Writes the given buffers to the file descriptor, starting at the given
+   * offset, until everything is written.  The buffers are consumed.
+   *
+   * @param offset    Position in the file to write at.
+   * @param buffers   Buffers to write, in order.
+   * @throws  FileIoException If a write fails.
+   */
+  void writeVectored(const std::streamoff offset, std::vector<iovec> &buffers);
+
+  /**
+   * Reads consecutive bytes of the file into the given buffers, in order,
+   * starting at the given offset, until every buffer is full; the
+   * counterpart of writeVectored().  Bytes past the end of the file read as
+   * zero.  With the direct I/O descriptor every buffer must be aligned to
+   * Page::ALIGNMENT.  The buffers are consumed.
+   *
+   * @param fd        Descriptor to read from: fd_ or pageFd().
+   * @param offset    Position in the file to read at.
+   * @param buffers   Buffers to fill, in order.
+   * @throws  FileIoException If a read fails.
+   */
+  void readVectored(const int fd, const std::streamoff offset,
+                    std::vector<iovec> &buffers) const;
+
+  /**
+   * Reads bytes from the file at the given position, without moving any
+   * shared file position, until everything is read.  Bytes past the end of
+   * the file read as zero.  With the direct I/O descriptor the buffer,
+   * position and length must be aligned to Page::ALIGNMENT.
+   *
+   * @param fd        Descriptor to read from: fd_ or pageFd().
+   * @param position  Position in the file to read at.
+   * @param buffer    Receives the bytes.
+   * @param length    Number of bytes to read.
+   * @throws  FileIoException If a read fails.
+   */
+  void readAt(const int fd, const std::streamoff position, char *buffer,
+              const std::size_t length) const;
+
+  /**
+   * Writes bytes to the file at the given position; the counterpart of
+   * readAt().
+   *
+   * @param fd        Descriptor to write to: fd_ or pageFd().
+   * @param position  Position in the file to write at.
+   * @param buffer    Bytes to write.
+   * @param length    Number of bytes to write.
+   * @throws  FileIoException If a write fails.
+   */
+  void writeAt(const int fd, const std::streamoff position,
+               const char *buffer, const std::size_t length);
+
+  /**
+   * Returns the descriptor whole pages are transferred through: the direct
+   * I/O descriptor if direct I/O is on, otherwise the regular one.
+   */
+  int pageFd() const;
+
+  /**
+   * Returns the mapped image of a page, mapping the file again if it has
+   * grown past the current mapping.  The caller holds the latch of the file
+   * and has checked that the page exists.
+   *
+   * @param page_number   Number of page.
+   * @return  Image of the page in the mapping.
+   * @throws  FileIoException If the mapping cannot be extended.
+   */
+  char *mappedImage(const PageId page_number) const;
+
+  /**
+   * Writes only the list links of the given page to disk, leaving the rest of
+   * the page alone.  No bounds checking is performed.
+   *
+   * @param page_number       Number of page whose links are to be written.
+   * @param next_page_number  Number of the next used page.
+   * @param prev_page_number  Number of the previous used page.
+   */
+  void writeLinks(const PageId page_number, const PageId next_page_number,
+                  const PageId prev_page_number);
+
+  /**
+   * Writes the cached file header to disk if it has changed.  The caller
+   * holds the latch of the file.
+   */
+  void writeBackHeader();
+
+  /**
+   * Page numbers in the header of a page as it is on disk
+   */
+  struct PageLinks {
+    bool known;
+    PageId current_page_number;
+    PageId next_page_number;
+    PageId prev_page_number;
+  };
+
+  /**
+   * Returns the list links of a page, from the cache if they are known and
+   * from disk otherwise.
+   *
+   * @param page_number   Number of page.
+   * @return  Links of the page.
+   */
+  PageLinks pageLinks(const PageId page_number) const;
+
+  /**
+   * Caches the list links of a page found in the given page header.
+   *
+   * @param page_number   Number of page.
+   * @param header        Header of the page as it is on disk.
+   */
+  void cacheLinks(const PageId page_number, const PageHeader &header) const;
+
+  /**
+   * Caches the list links of a page read without holding the latch, unless
+   * they are cached already.
+   *
+   * @param page_number   Number of page.
+   * @param header        Header of the page as it was read.
+   */
+  void learnLinks(const PageId page_number, const PageHeader &header) const;
+
+  /**
+   * State shared by every File object for the same open file
+   */
+  struct OpenFile {
+    /**
+     * Latch protecting everything below and serializing writes.  Recursive so
+     * that operations such as allocatePage() can hold it across the header
+     * and page I/O they issue.  Page reads only take it to look things up.
+     */
+    std::recursive_mutex latch;
+
+    /**
+     * Name, identifier and descriptor for positioned I/O of the file
+     */
+    std::string name;
+    FileId id;
+    int fd;
+
+    /**
+     * Number of this opening of the file; see openNumber()
+     */
+    std::uint64_t open_number;
+
+    /**
+     * Number of File objects for the file.  Copying and destroying a File
+     * object only touches this count; the File object that drops it to zero
+     * closes the file under open_files_latch_.
+     */
+    std::atomic<int> count;
+
+    /**
+     * Cached file header, and whether it differs from the one on disk
+     */
+    FileHeader header;
+    bool header_dirty;
+
+    /**
+     * Cached list links, indexed by page number
+     */
+    std::vector<PageLinks> links;
+
+    /**
+     * Memory mappings of the file, newest last.  A file that grows is mapped
+     * again in full; older mappings are kept so that pages viewing them stay
+     * valid until the file is closed.
+     */
+    struct Mapping {
+      char *base;
+      std::size_t length;
+    };
+    std::vector<Mapping> mappings;
+
+    /**
+     * Whether map() has been called, and the madvise() hint it was given
+     */
+    bool mapped;
+    int map_advice;
+
+    /**
+     * Whether direct I/O is on, and the descriptor opened with O_DIRECT the
+     * first time it was switched on (otherwise -1)
+     */
+    bool direct;
+    int direct_fd;
+  };
+
+  /**
+   * Shared state of opened files, indexed by identifier minus one.  Entries
+   * stay in place while the file is open, so File objects point at them.
+   */
+  static OpenFile open_files_[MAX_OPEN_FILES];
+
+  /**
+   * Identifiers of opened files by name.
+   */
+  static std::map<std::string, FileId> open_names_;
+
+  /**
+   * Identifiers released by closed files, to be handed out again.
+   */
+  static std::vector<FileId> free_ids_;
+
+  /**
+   * Next identifier to hand out once free_ids_ is empty.
+   */
+  static FileId next_id_;
+
+  /**
+   * Open number of the next file to be opened.
+   */
+  static std::uint64_t next_open_number_;
 
   /**
-   * Streams for opened files.
+   * Latch protecting the names, identifiers and open number above, and the
+   * opening and closing of files.
    */
-  static StreamMap open_streams_;
+  static std::mutex open_files_latch_;
 
   /**
-   * Counts for opened files.
+   * Identifier of the open file this object represents.
    */
-  static CountMap open_counts_;
+  FileId id_;
 
   /**
-   * Name of the file this object represents.
+   * Shared state of the open file this object represents.
    */
-  std::string filename_;
+  OpenFile *open_;
 
   /**
-   * Stream for underlying filesystem object.
+   * Descriptor of the underlying file, shared by every File object for the
+   * file.  All I/O is positioned, so there is no shared file offset.
    */
-  std::shared_ptr<std::fstream> stream_;
+  int fd_;
 
   /**
    * Whether this file is valid.
@@ -0,0 +1,453 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "hash_index.h"
+
+#include <cstring>
+
+#include "exceptions/bad_index_info_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Identifies the first page of a hash index file
+ */
+const char HASH_MAGIC[16] = "badgerdb-hash1";
+
+/**
+ * Contents of the first page of a hash index file
+ */
+struct HashMeta {
+  char magic[16];
+  std::uint8_t keyType;
+  std::uint8_t reserved[3];
+  std::uint32_t keyLength;
+  std::uint32_t level;
+  std::uint32_t nextSplit;
+  std::uint32_t buckets;
+  PageId firstDirectory;
+  std::uint64_t entries;
+};
+
+/**
+ * Start of every bucket page, which holds count entries in no particular
+ * order after the header
+ */
+struct BucketHeader {
+  std::uint16_t count;
+  std::uint16_t reserved;
+
+  /**
+   * Next page of the bucket, or Page::INVALID_NUMBER
+   */
+  PageId overflow;
+};
+
+/**
+ * Start of every directory page, which holds the page numbers of count
+ * buckets after the header
+ */
+struct DirectoryHeader {
+  /**
+   * Next page of the directory, or Page::INVALID_NUMBER
+   */
+  PageId next;
+  std::uint32_t count;
+};
+
+/**
+ * Number of buckets a directory page holds
+ */
+const std::uint32_t DIRECTORY_CAPACITY =
+    (Page::DATA_SIZE - sizeof(DirectoryHeader)) / sizeof(PageId);
+
+template <typename Header>
+Header readHeader(const char *data) {
+  Header header;
+  std::memcpy(&header, data, sizeof(header));
+  return header;
+}
+
+template <typename Header>
+void writeHeader(char *data, const Header &header) {
+  std::memcpy(data, &header, sizeof(header));
+}
+
+char *bucketEntry(char *data, const std::uint32_t i,
+                  const std::uint32_t size) {
+  return data + sizeof(BucketHeader) + std::size_t(i) * size;
+}
+
+const char *bucketEntry(const char *data, const std::uint32_t i,
+                        const std::uint32_t size) {
+  return data + sizeof(BucketHeader) + std::size_t(i) * size;
+}
+
+RecordId decodeRecordId(const char *encoded) {
+  const unsigned char *id = reinterpret_cast<const unsigned char *>(encoded);
+  RecordId recordId;
+  recordId.page_number = PageId(id[0]) << 24 | PageId(id[1]) << 16 |
+                         PageId(id[2]) << 8 | PageId(id[3]);
+  recordId.slot_number = SlotId(id[4] << 8 | id[5]);
+  return recordId;
+}
+
+}  // namespace
+
+const PageId HashIndex::META_PAGE;
+const std::uint32_t HashIndex::INITIAL_BUCKETS;
+const std::uint32_t HashIndex::LOAD_FACTOR;
+
+HashIndex::HashIndex(BufMgr &bufMgr, File &file, const IndexKeyType keyType,
+                     const std::uint32_t keyLength)
+    : bufMgr(&bufMgr),
+      file(&file),
+      keyType_(keyType),
+      keyLength_(keyLength),
+      entrySize(keyLength + 6),
+      bucketCapacity((Page::DATA_SIZE - sizeof(BucketHeader)) / entrySize),
+      level(0),
+      nextSplit(0),
+      entries(0) {}
+
+HashIndex HashIndex::create(BufMgr &bufMgr, File &file,
+                            const IndexKeyType keyType,
+                            const std::uint32_t keyLength) {
+  if (file.num_pages() != 1) {
+    throw BadIndexInfoException("file '" + file.filename() +
+                                "' is not empty");
+  }
+  HashIndex index(bufMgr, file, keyType,
+                  keyType == IndexKeyType::INTEGER ? 8 : keyLength);
+  if (index.keyLength_ == 0 || index.bucketCapacity < 4) {
+    throw BadIndexInfoException("keys of " + std::to_string(keyLength) +
+                                " bytes do not fit four to a page");
+  }
+
+  bufMgr.allocPage(file).release();
+  for (std::uint32_t i = 0; i < INITIAL_BUCKETS; i++) {
+    index.addBucket();
+  }
+  index.writeMeta();
+  return index;
+}
+
+HashIndex HashIndex::open(BufMgr &bufMgr, File &file) {
+  if (file.num_pages() <= META_PAGE) {
+    throw BadIndexInfoException("file '" + file.filename() +
+                                "' does not hold a hash index");
+  }
+  HashMeta meta;
+  {
+    PageGuard page = bufMgr.readPage(file, META_PAGE);
+    std::memcpy(&meta, pageData(*page), sizeof(meta));
+  }
+  if (std::memcmp(meta.magic, HASH_MAGIC, sizeof(HASH_MAGIC)) != 0) {
+    throw BadIndexInfoException("file '" + file.filename() +
+                                "' does not hold a hash index");
+  }
+
+  HashIndex index(bufMgr, file, static_cast<IndexKeyType>(meta.keyType),
+                  meta.keyLength);
+  index.level = meta.level;
+  index.nextSplit = meta.nextSplit;
+  index.entries = meta.entries;
+  for (PageId pageNo = meta.firstDirectory; pageNo != Page::INVALID_NUMBER;) {
+    PageGuard page = bufMgr.readPage(file, pageNo);
+    const char *data = pageData(*page);
+    const DirectoryHeader header = readHeader<DirectoryHeader>(data);
+    for (std::uint32_t i = 0; i < header.count; i++) {
+      PageId bucket;
+      std::memcpy(&bucket,
+                  data + sizeof(DirectoryHeader) + i * sizeof(PageId),
+                  sizeof(bucket));
+      index.directory.push_back(bucket);
+    }
+    index.directoryPages.push_back(pageNo);
+    pageNo = header.next;
+  }
+  if (index.directory.size() != meta.buckets) {
+    throw BadIndexInfoException("directory of file '" + file.filename() +
+                                "' is incomplete");
+  }
+  return index;
+}
+
+bool HashIndex::insertEntry(const std::int64_t key,
+                            const RecordId &recordId) {
+  return insertEncoded(encodeEntry(encodeKey(key), recordId));
+}
+
+bool HashIndex::insertEntry(const std::string &key,
+                            const RecordId &recordId) {
+  return insertEncoded(encodeEntry(encodeKey(key), recordId));
+}
+
+bool HashIndex::removeEntry(const std::int64_t key,
+                            const RecordId &recordId) {
+  return removeEncoded(encodeEntry(encodeKey(key), recordId));
+}
+
+bool HashIndex::removeEntry(const std::string &key,
+                            const RecordId &recordId) {
+  return removeEncoded(encodeEntry(encodeKey(key), recordId));
+}
+
+std::vector<RecordId> HashIndex::lookup(const std::int64_t key) const {
+  return lookupEncoded(encodeKey(key));
+}
+
+std::vector<RecordId> HashIndex::lookup(const std::string &key) const {
+  return lookupEncoded(encodeKey(key));
+}
+
+std::string HashIndex::encodeKey(const std::int64_t key) const {
+  if (keyType_ != IndexKeyType::INTEGER) {
+    throw BadIndexInfoException("integer key for an index of strings");
+  }
+  const std::uint64_t value =
+      static_cast<std::uint64_t>(key) ^ (std::uint64_t(1) << 63);
+  std::string encoded(8, '\0');
+  for (int i = 0; i < 8; i++) {
+    encoded[i] = static_cast<char>(value >> (56 - 8 * i));
+  }
+  return encoded;
+}
+
+std::string HashIndex::encodeKey(const std::string &key) const {
+  if (keyType_ != IndexKeyType::STRING) {
+    throw BadIndexInfoException("string key for an index of integers");
+  }
+  if (key.size() > keyLength_) {
+    throw BadIndexInfoException("key longer than " +
+                                std::to_string(keyLength_) + " bytes");
+  }
+  std::string encoded(key);
+  encoded.resize(keyLength_, '\0');
+  return encoded;
+}
+
+std::string HashIndex::encodeEntry(const std::string &key,
+                                   const RecordId &recordId) const {
+  std::string entry(key);
+  entry.push_back(static_cast<char>(recordId.page_number >> 24));
+  entry.push_back(static_cast<char>(recordId.page_number >> 16));
+  entry.push_back(static_cast<char>(recordId.page_number >> 8));
+  entry.push_back(static_cast<char>(recordId.page_number));
+  entry.push_back(static_cast<char>(recordId.slot_number >> 8));
+  entry.push_back(static_cast<char>(recordId.slot_number));
+  return entry;
+}
+
+std::uint64_t HashIndex::hash(const char *key) const {
+  // FNV-1a over the key, then the 64-bit finalizer of MurmurHash3 so that
+  // the low bits the buckets are picked by depend on every byte
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  for (std::uint32_t i = 0; i < keyLength_; i++) {
+    hash = (hash ^ static_cast<unsigned char>(key[i])) * 0x100000001b3ULL;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+std::uint32_t HashIndex::bucketOf(const char *key) const {
+  const std::uint64_t roundBuckets = std::uint64_t(INITIAL_BUCKETS) << level;
+  const std::uint64_t keyHash = hash(key);
+  std::uint64_t bucket = keyHash % roundBuckets;
+  // Buckets before the split pointer have been split this round already
+  if (bucket < nextSplit) bucket = keyHash % (roundBuckets * 2);
+  return static_cast<std::uint32_t>(bucket);
+}
+
+bool HashIndex::insertEncoded(const std::string &entry) {
+  const std::uint32_t bucket = bucketOf(entry.data());
+  for (PageId pageNo = directory[bucket]; pageNo != Page::INVALID_NUMBER;) {
+    PageGuard page = bufMgr->readPage(*file, pageNo);
+    const char *data = pageData(*page);
+    const BucketHeader header = readHeader<BucketHeader>(data);
+    for (std::uint32_t i = 0; i < header.count; i++) {
+      if (std::memcmp(bucketEntry(data, i, entrySize), entry.data(),
+                      entrySize) == 0) {
+        return false;
+      }
+    }
+    pageNo = header.overflow;
+  }
+
+  appendToBucket(bucket, entry.data());
+  entries++;
+  if (entries * 100 >
+      std::uint64_t(bucketCapacity) * directory.size() * LOAD_FACTOR) {
+    splitBucket();
+  }
+  writeMeta();
+  return true;
+}
+
+bool HashIndex::removeEncoded(const std::string &entry) {
+  for (PageId pageNo = directory[bucketOf(entry.data())];
+       pageNo != Page::INVALID_NUMBER;) {
+    PageGuard page = bufMgr->readPage(*file, pageNo);
+    char *data = pageData(*page);
+    BucketHeader header = readHeader<BucketHeader>(data);
+    for (std::uint32_t i = 0; i < header.count; i++) {
+      char *found = bucketEntry(data, i, entrySize);
+      if (std::memcmp(found, entry.data(), entrySize) != 0) continue;
+
+      // The last entry of the page takes its place
+      header.count--;
+      std::memmove(found, bucketEntry(data, header.count, entrySize),
+                   entrySize);
+      writeHeader(data, header);
+      page.markDirty();
+      page.release();
+      entries--;
+      writeMeta();
+      return true;
+    }
+    pageNo = header.overflow;
+  }
+  return false;
+}
+
+std::vector<RecordId> HashIndex::lookupEncoded(const std::string &key) const {
+  std::vector<RecordId> recordIds;
+  for (PageId pageNo = directory[bucketOf(key.data())];
+       pageNo != Page::INVALID_NUMBER;) {
+    PageGuard page = bufMgr->readPage(*file, pageNo);
+    const char *data = pageData(*page);
+    const BucketHeader header = readHeader<BucketHeader>(data);
+    for (std::uint32_t i = 0; i < header.count; i++) {
+      const char *entry = bucketEntry(data, i, entrySize);
+      if (std::memcmp(entry, key.data(), keyLength_) == 0) {
+        recordIds.push_back(decodeRecordId(entry + keyLength_));
+      }
+    }
+    pageNo = header.overflow;
+  }
+  return recordIds;
+}
+
+void HashIndex::appendToBucket(const std::uint32_t bucket,
+                               const char *entry) {
+  PageGuard page = bufMgr->readPage(*file, directory[bucket]);
+  BucketHeader header = readHeader<BucketHeader>(pageData(*page));
+  while (header.overflow != Page::INVALID_NUMBER) {
+    const PageId overflowNo = header.overflow;
+    page.release();
+    page = bufMgr->readPage(*file, overflowNo);
+    header = readHeader<BucketHeader>(pageData(*page));
+  }
+
+  if (header.count == bucketCapacity) {
+    // Chain a new page to the bucket
+    PageGuard overflow = bufMgr->allocPage(*file);
+    header.overflow = overflow->page_number();
+    writeHeader(pageData(*page), header);
+    page.markDirty();
+    page = std::move(overflow);
+    header = BucketHeader{0, 0, Page::INVALID_NUMBER};
+  }
+  char *data = pageData(*page);
+  std::memcpy(bucketEntry(data, header.count, entrySize), entry, entrySize);
+  header.count++;
+  writeHeader(data, header);
+  page.markDirty();
+}
+
+void HashIndex::splitBucket() {
+  const std::uint32_t bucket = nextSplit;
+  addBucket();
+  nextSplit++;
+  if (nextSplit == INITIAL_BUCKETS << level) {
+    level++;
+    nextSplit = 0;
+  }
+
+  // Empty the bucket and give its overflow pages back
+  std::string moved;
+  std::vector<PageId> overflowPages;
+  for (PageId pageNo = directory[bucket]; pageNo != Page::INVALID_NUMBER;) {
+    PageGuard page = bufMgr->readPage(*file, pageNo);
+    char *data = pageData(*page);
+    const BucketHeader header = readHeader<BucketHeader>(data);
+    moved.append(bucketEntry(data, 0, entrySize),
+                 std::size_t(header.count) * entrySize);
+    if (pageNo == directory[bucket]) {
+      writeHeader(data, BucketHeader{0, 0, Page::INVALID_NUMBER});
+      page.markDirty();
+    } else {
+      overflowPages.push_back(pageNo);
+    }
+    pageNo = header.overflow;
+  }
+  for (const PageId pageNo : overflowPages) {
+    bufMgr->disposePage(*file, pageNo);
+  }
+
+  // Each entry stays or moves to the new bucket by the next bit of its hash
+  for (std::size_t offset = 0; offset < moved.size(); offset += entrySize) {
+    appendToBucket(bucketOf(moved.data() + offset), moved.data() + offset);
+  }
+}
+
+void HashIndex::addBucket() {
+  PageGuard bucket = bufMgr->allocPage(*file);
+  writeHeader(pageData(*bucket), BucketHeader{0, 0, Page::INVALID_NUMBER});
+  bucket.markDirty();
+  directory.push_back(bucket->page_number());
+
+  const std::size_t slot = (directory.size() - 1) % DIRECTORY_CAPACITY;
+  PageGuard page;
+  if (slot == 0) {
+    // The last directory page is full
+    page = bufMgr->allocPage(*file);
+    writeHeader(pageData(*page), DirectoryHeader{Page::INVALID_NUMBER, 0});
+    if (!directoryPages.empty()) {
+      PageGuard previous = bufMgr->readPage(*file, directoryPages.back());
+      DirectoryHeader header =
+          readHeader<DirectoryHeader>(pageData(*previous));
+      header.next = page->page_number();
+      writeHeader(pageData(*previous), header);
+      previous.markDirty();
+    }
+    directoryPages.push_back(page->page_number());
+  } else {
+    page = bufMgr->readPage(*file, directoryPages.back());
+  }
+  char *data = pageData(*page);
+  DirectoryHeader header = readHeader<DirectoryHeader>(data);
+  std::memcpy(data + sizeof(DirectoryHeader) + slot * sizeof(PageId),
+              &directory.back(), sizeof(PageId));
+  header.count++;
+  writeHeader(data, header);
+  page.markDirty();
+}
+
+void HashIndex::writeMeta() {
+  HashMeta meta = {};
+  std::memcpy(meta.magic, HASH_MAGIC, sizeof(HASH_MAGIC));
+  meta.keyType = static_cast<std::uint8_t>(keyType_);
+  meta.keyLength = keyLength_;
+  meta.level = level;
+  meta.nextSplit = nextSplit;
+  meta.buckets = static_cast<std::uint32_t>(directory.size());
+  meta.firstDirectory = directoryPages.front();
+  meta.entries = entries;
+  PageGuard page = bufMgr->readPage(*file, META_PAGE);
+  std::memcpy(pageData(*page), &meta, sizeof(meta));
+  page.markDirty();
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,258 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "btree.h"
+#include "buffer.h"
+#include "file.h"
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Linear hashing index mapping keys to record IDs for exact-match
+ * lookups, stored in a file of its own and read through the buffer manager
+ *
+ * Every bucket is a page, followed by a chain of overflow pages if more
+ * entries hash to it than fit.  The page number of every bucket is kept in
+ * memory, so a lookup reads the pages of a single bucket, which is one page
+ * unless the bucket overflowed.  Once the buckets are filled to
+ * LOAD_FACTOR percent on average, each insert splits the next bucket in
+ * turn into itself and a new bucket at the end, so the index grows a bucket
+ * at a time and never rehashes everything at once.
+ *
+ * The first page of the file holds the key type, the split state and the
+ * first page of the bucket directory.  Keys are encoded like those of
+ * BTreeIndex, and a key may map to several record IDs.  Removing entries
+ * does not shrink the index.  The changes are made to pages in the buffer
+ * pool and written back like any other pages, e.g. by BufMgr::flushFile().
+ * An index is not safe to use from several threads at once.
+ */
+class HashIndex {
+ public:
+  /**
+   * Creates an empty index in an empty file.
+   *
+   * @param bufMgr     Buffer manager the pages are read through
+   * @param file       Empty file to hold the index
+   * @param keyType    Type of the keys
+   * @param keyLength  Maximum length of STRING keys in bytes; ignored for
+   *                   INTEGER keys
+   * @return  The index
+   * @throws  BadIndexInfoException if the file is not empty or keys of the
+   * given length would not fit four to a page
+   */
+  static HashIndex create(BufMgr& bufMgr, File& file,
+                          const IndexKeyType keyType,
+                          const std::uint32_t keyLength = 0);
+
+  /**
+   * Opens the index held by a file.
+   *
+   * @param bufMgr  Buffer manager the pages are read through
+   * @param file    File holding the index
+   * @return  The index
+   * @throws  BadIndexInfoException if the file does not hold a hash index
+   */
+  static HashIndex open(BufMgr& bufMgr, File& file);
+
+  /**
+   * Returns the type of the keys.
+   */
+  IndexKeyType keyType() const { return keyType_; }
+
+  /**
+   * Returns the length of the keys in bytes.
+   */
+  std::uint32_t keyLength() const { return keyLength_; }
+
+  /**
+   * Returns the number of entries.
+   */
+  std::uint64_t size() const { return entries; }
+
+  /**
+   * Returns the number of buckets.
+   */
+  std::uint32_t buckets() const {
+    return static_cast<std::uint32_t>(directory.size());
+  }
+
+  /**
+   * Adds an entry.
+   *
+   * @param key       Key of the entry
+   * @param recordId  Record ID the key maps to
+   * @return  False if the entry was already in the index
+   * @throws  BadIndexInfoException if the key does not match the key type
+   */
+  bool insertEntry(const std::int64_t key, const RecordId& recordId);
+  bool insertEntry(const std::string& key, const RecordId& recordId);
+
+  /**
+   * Removes an entry.
+   *
+   * @param key       Key of the entry
+   * @param recordId  Record ID the key maps to
+   * @return  False if the entry was not in the index
+   * @throws  BadIndexInfoException if the key does not match the key type
+   */
+  bool removeEntry(const std::int64_t key, const RecordId& recordId);
+  bool removeEntry(const std::string& key, const RecordId& recordId);
+
+  /**
+   * Returns the record IDs a key maps to, in no particular order.
+   *
+   * @param key  Key to look up
+   * @return  The record IDs
+   * @throws  BadIndexInfoException if the key does not match the key type
+   */
+  std::vector<RecordId> lookup(const std::int64_t key) const;
+  std::vector<RecordId> lookup(const std::string& key) const;
+
+ private:
+  /**
+   * Number of the page holding the key type and split state
+   */
+  static const PageId META_PAGE = 1;
+
+  /**
+   * Number of buckets of an empty index
+   */
+  static const std::uint32_t INITIAL_BUCKETS = 4;
+
+  /**
+   * Average fill of the buckets, in percent of a page, above which inserts
+   * split buckets.  A bucket not yet split this round holds up to twice the
+   * average, so this keeps most buckets from overflowing.
+   */
+  static const std::uint32_t LOAD_FACTOR = 50;
+
+  /**
+   * Constructs an index over the given file.  See create() and open().
+   */
+  HashIndex(BufMgr& bufMgr, File& file, const IndexKeyType keyType,
+            const std::uint32_t keyLength);
+
+  /**
+   * Returns the contents of a bucket or directory page.
+   */
+  static char* pageData(Page& page) { return page.data_; }
+  static const char* pageData(const Page& page) { return page.data_; }
+
+  /**
+   * Encodes a key like BTreeIndex does.
+   *
+   * @throws  BadIndexInfoException if the key does not match the key type
+   */
+  std::string encodeKey(const std::int64_t key) const;
+  std::string encodeKey(const std::string& key) const;
+
+  /**
+   * Returns the entry of a key and a record ID.
+   */
+  std::string encodeEntry(const std::string& key,
+                          const RecordId& recordId) const;
+
+  /**
+   * Returns the hash of an encoded key.
+   */
+  std::uint64_t hash(const char* key) const;
+
+  /**
+   * Returns the bucket an encoded key belongs to.
+   */
+  std::uint32_t bucketOf(const char* key) const;
+
+  /**
+   * Adds or removes an encoded entry.
+   */
+  bool insertEncoded(const std::string& entry);
+  bool removeEncoded(const std::string& entry);
+
+  /**
+   * Returns the record IDs of the entries with an encoded key.
+   */
+  std::vector<RecordId> lookupEncoded(const std::string& key) const;
+
+  /**
+   * Appends an encoded entry to the last page of a bucket, adding an
+   * overflow page if it is full.
+   */
+  void appendToBucket(const std::uint32_t bucket, const char* entry);
+
+  /**
+   * Splits the next bucket in turn between itself and a new bucket.
+   */
+  void splitBucket();
+
+  /**
+   * Allocates the page of a new bucket at the end of the directory.
+   */
+  void addBucket();
+
+  /**
+   * Writes the split state and number of entries to the first page.
+   */
+  void writeMeta();
+
+  /**
+   * Buffer manager the pages are read through, and the index file
+   */
+  BufMgr* bufMgr;
+  File* file;
+
+  /**
+   * Type and length of the keys
+   */
+  IndexKeyType keyType_;
+  std::uint32_t keyLength_;
+
+  /**
+   * Length of an entry: its key followed by its record ID
+   */
+  std::uint32_t entrySize;
+
+  /**
+   * Maximum number of entries in a bucket page
+   */
+  std::uint32_t bucketCapacity;
+
+  /**
+   * Number of times the buckets have been doubled
+   */
+  std::uint32_t level;
+
+  /**
+   * Next bucket to split
+   */
+  std::uint32_t nextSplit;
+
+  /**
+   * Number of entries
+   */
+  std::uint64_t entries;
+
+  /**
+   * First page of every bucket, by bucket number
+   */
+  std::vector<PageId> directory;
+
+  /**
+   * Pages the directory is stored in, in order
+   */
+  std::vector<PageId> directoryPages;
+};
+
+}  // namespace badgerdb
@@ -0,0 +1,73 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "heap_appender.h"
+
+#include "exceptions/insufficient_space_exception.h"
+
+namespace badgerdb {
+
+HeapAppender::HeapAppender(BufMgr& bufMgr, File& file)
+    : bufMgr(bufMgr), file(file), tail(nullptr), tailNo(Page::INVALID_NUMBER) {}
+
+HeapAppender::~HeapAppender() { finish(); }
+
+RecordId HeapAppender::append(const std::string& record) {
+  if (record.length() > Page::DATA_SIZE) {
+    // Would not even fit the length of a span
+    throw InsufficientSpaceException(tailNo, record.length(),
+                                     Page::DATA_SIZE);
+  }
+  const RecordSpan span = {record.data(),
+                           static_cast<PageOffset>(record.length())};
+  RecordId recordId;
+  append(&span, 1, &recordId);
+  return recordId;
+}
+
+void HeapAppender::append(const RecordSpan* records, const std::size_t count,
+                          RecordId* recordIds) {
+  std::size_t appended = 0;
+  if (tail == nullptr && count > 0) {
+    nextPage();
+  }
+  while (appended < count) {
+    const std::size_t inserted = tail->insertRecords(
+        records + appended, count - appended,
+        recordIds == nullptr ? nullptr : recordIds + appended);
+    appended += inserted;
+    if (appended == count) {
+      break;
+    }
+    if (inserted == 0 && tail->getFreeSpace() == Page::DATA_SIZE) {
+      // Not even an empty page can hold the record
+      throw InsufficientSpaceException(tailNo, records[appended].length,
+                                       tail->getFreeSpace());
+    }
+    nextPage();
+  }
+}
+
+void HeapAppender::finish() {
+  if (tail != nullptr) {
+    bufMgr.unPinPage(file, tailNo, true);
+    tail = nullptr;
+    tailNo = Page::INVALID_NUMBER;
+  }
+}
+
+void HeapAppender::nextPage() {
+  finish();
+  PageId pageNo;
+  Page* page;
+  bufMgr.allocPage(file, pageNo, page);
+  tail = page;
+  tailNo = pageNo;
+}
+
+}  // namespace badgerdb
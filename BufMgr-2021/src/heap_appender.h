@@ -0,0 +1,99 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "buffer.h"
+#include "file.h"
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Appends records to a heap file through the buffer manager
+ *
+ * The page being filled stays pinned between calls, and a new page is only
+ * allocated once it is full, so loading many records costs one copy per
+ * record plus one allocation per page.  Records go to pages the appender
+ * allocates itself; pages already in the file are left alone.
+ *
+ * An appender belongs to a single thread.
+ */
+class HeapAppender {
+ public:
+  /**
+   * Constructor of HeapAppender class
+   *
+   * @param bufMgr  Buffer manager the pages are allocated through
+   * @param file    File to append to.  Must outlive the appender.
+   */
+  HeapAppender(BufMgr& bufMgr, File& file);
+
+  HeapAppender(const HeapAppender&) = delete;
+  HeapAppender& operator=(const HeapAppender&) = delete;
+
+  /**
+   * Destructor of HeapAppender class.  Unpins the page being filled.
+   */
+  ~HeapAppender();
+
+  /**
+   * Appends a record.
+   *
+   * @param record  Bytes that compose the record
+   * @return  ID of the appended record
+   * @throws  InsufficientSpaceException If the record does not fit on an empty
+   * page
+   */
+  RecordId append(const std::string& record);
+
+  /**
+   * Appends records in order, filling each page before moving on to the next.
+   *
+   * @param records   Records to append
+   * @param count     Number of records
+   * @param recordIds If not null, receives the ID of each appended record
+   * @throws  InsufficientSpaceException If a record does not fit on an empty
+   * page.  The records before it have been appended.
+   */
+  void append(const RecordSpan* records, const std::size_t count,
+              RecordId* recordIds = nullptr);
+
+  /**
+   * Unpins the page being filled.  The next append starts a new page.
+   */
+  void finish();
+
+ private:
+  /**
+   * Unpins the current tail page and allocates a new one.
+   */
+  void nextPage();
+
+  /**
+   * Buffer manager the pages are allocated through
+   */
+  BufMgr& bufMgr;
+
+  /**
+   * File the records are appended to
+   */
+  File& file;
+
+  /**
+   * Page being filled and its number, or null if there is none
+   */
+  Page* tail;
+  PageId tailNo;
+};
+
+}  // namespace badgerdb
@@ -0,0 +1,187 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "lz.h"
+
+#include <cstring>
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Shortest copy worth coding; also the length of the hashed prefixes
+ */
+const std::size_t MIN_MATCH = 4;
+
+/**
+ * Farthest back a copy may reach, so that offsets fit in two bytes
+ */
+const std::size_t MAX_OFFSET = 65535;
+
+/**
+ * Size of the hash table of prefixes, as a power of two
+ */
+const int HASH_BITS = 12;
+
+/**
+ * Value of a hash table slot that holds no position
+ */
+const std::uint32_t NO_POSITION = 0xFFFFFFFF;
+
+std::uint32_t read32(const std::uint8_t *p) {
+  std::uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+std::uint32_t hashPrefix(const std::uint32_t prefix) {
+  return (prefix * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/**
+ * Appends the rest of a length that did not fit in its token nibble.
+ */
+bool putLength(std::uint8_t *&out, const std::uint8_t *end, std::size_t n) {
+  for (; n >= 255; n -= 255) {
+    if (out == end) return false;
+    *out++ = 255;
+  }
+  if (out == end) return false;
+  *out++ = static_cast<std::uint8_t>(n);
+  return true;
+}
+
+/**
+ * Reads the rest of a length whose token nibble was 15.
+ */
+bool getLength(const std::uint8_t *&in, const std::uint8_t *end,
+               std::size_t &n) {
+  std::uint8_t byte;
+  do {
+    if (in == end) return false;
+    byte = *in++;
+    n += byte;
+  } while (byte == 255);
+  return true;
+}
+
+/**
+ * Appends a sequence: a token, the literals, and unless matchLength is 0
+ * the offset and rest of the length of the copy that follows them.
+ */
+bool putSequence(std::uint8_t *&out, const std::uint8_t *end,
+                 const std::uint8_t *literals, const std::size_t literalLength,
+                 const std::size_t offset, const std::size_t matchLength) {
+  const std::size_t matchCode = matchLength == 0 ? 0 : matchLength - MIN_MATCH;
+  if (out == end) return false;
+  std::uint8_t *token = out++;
+  *token = static_cast<std::uint8_t>(
+      ((literalLength < 15 ? literalLength : 15) << 4) |
+      (matchCode < 15 ? matchCode : 15));
+  if (literalLength >= 15 && !putLength(out, end, literalLength - 15)) {
+    return false;
+  }
+  if (static_cast<std::size_t>(end - out) < literalLength) return false;
+  std::memcpy(out, literals, literalLength);
+  out += literalLength;
+  if (matchLength == 0) return true;
+
+  if (end - out < 2) return false;
+  *out++ = static_cast<std::uint8_t>(offset);
+  *out++ = static_cast<std::uint8_t>(offset >> 8);
+  return matchCode < 15 || putLength(out, end, matchCode - 15);
+}
+
+}  // namespace
+
+std::size_t lzCompress(const char *data, const std::size_t length, char *out,
+                       const std::size_t capacity) {
+  const std::uint8_t *in = reinterpret_cast<const std::uint8_t *>(data);
+  std::uint8_t *start = reinterpret_cast<std::uint8_t *>(out);
+  std::uint8_t *next = start;
+  const std::uint8_t *end = start + capacity;
+
+  std::uint32_t table[1 << HASH_BITS];
+  for (std::uint32_t &slot : table) slot = NO_POSITION;
+
+  std::size_t anchor = 0;
+  std::size_t position = 0;
+  while (position + MIN_MATCH <= length) {
+    const std::uint32_t prefix = read32(in + position);
+    std::uint32_t &slot = table[hashPrefix(prefix)];
+    const std::size_t candidate = slot;
+    slot = static_cast<std::uint32_t>(position);
+    if (candidate == NO_POSITION || position - candidate > MAX_OFFSET ||
+        read32(in + candidate) != prefix) {
+      position++;
+      continue;
+    }
+
+    std::size_t matchLength = MIN_MATCH;
+    while (position + matchLength < length &&
+           in[candidate + matchLength] == in[position + matchLength]) {
+      matchLength++;
+    }
+    if (!putSequence(next, end, in + anchor, position - anchor,
+                     position - candidate, matchLength)) {
+      return 0;
+    }
+    position += matchLength;
+    anchor = position;
+  }
+  if (!putSequence(next, end, in + anchor, length - anchor, 0, 0)) {
+    return 0;
+  }
+  return next - start;
+}
+
+bool lzDecompress(const char *data, const std::size_t length, char *out,
+                  const std::size_t expected) {
+  const std::uint8_t *in = reinterpret_cast<const std::uint8_t *>(data);
+  const std::uint8_t *inEnd = in + length;
+  std::uint8_t *start = reinterpret_cast<std::uint8_t *>(out);
+  std::uint8_t *next = start;
+  const std::uint8_t *outEnd = start + expected;
+
+  while (in != inEnd) {
+    const std::uint8_t token = *in++;
+    std::size_t literalLength = token >> 4;
+    if (literalLength == 15 && !getLength(in, inEnd, literalLength)) {
+      return false;
+    }
+    if (static_cast<std::size_t>(inEnd - in) < literalLength ||
+        static_cast<std::size_t>(outEnd - next) < literalLength) {
+      return false;
+    }
+    std::memcpy(next, in, literalLength);
+    in += literalLength;
+    next += literalLength;
+    if (in == inEnd) break;  // the last sequence has no copy
+
+    if (inEnd - in < 2) return false;
+    const std::size_t offset = in[0] | (std::size_t(in[1]) << 8);
+    in += 2;
+    std::size_t matchLength = token & 15;
+    if (matchLength == 15 && !getLength(in, inEnd, matchLength)) {
+      return false;
+    }
+    matchLength += MIN_MATCH;
+    if (offset == 0 || offset > static_cast<std::size_t>(next - start) ||
+        static_cast<std::size_t>(outEnd - next) < matchLength) {
+      return false;
+    }
+    // Byte by byte, since the copy may overlap what it produces
+    const std::uint8_t *from = next - offset;
+    for (std::size_t i = 0; i < matchLength; i++) next[i] = from[i];
+    next += matchLength;
+  }
+  return next == outEnd;
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,43 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace badgerdb {
+
+/**
+ * Compresses bytes with a fast LZ77 coder in the style of LZ4: a sequence of
+ * literal runs, each followed by a copy of earlier output, found through a
+ * hash table of four byte prefixes.  Meant for pages, so inputs are small.
+ *
+ * @param data      Bytes to compress.
+ * @param length    Number of bytes.
+ * @param out       Receives the compressed bytes.
+ * @param capacity  Room in out.
+ * @return  Number of compressed bytes, or 0 if they do not fit in capacity.
+ */
+std::size_t lzCompress(const char *data, const std::size_t length, char *out,
+                       const std::size_t capacity);
+
+/**
+ * Decompresses bytes compressed by lzCompress().
+ *
+ * @param data      Compressed bytes.
+ * @param length    Number of compressed bytes.
+ * @param out       Receives the decompressed bytes.
+ * @param expected  Number of bytes the data decompresses to.
+ * @return  True if the data decompressed to exactly expected bytes; false if
+ *          it is corrupt.
+ */
+bool lzDecompress(const char *data, const std::size_t length, char *out,
+                  const std::size_t expected);
+
+}  // namespace badgerdb
@@ -14,23 +14,52 @@
  * Email: shizmi@wisc.edu
  */
 
+#include <signal.h>
 #include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
 //#include <stdio.h>
 #include <cstring>
+#include <fstream>
 #include <memory>
 #include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
+#include "btree.h"
 #include "buffer.h"
+#include "exceptions/bad_index_info_exception.h"
 #include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/corrupt_page_exception.h"
+#include "exceptions/file_io_exception.h"
 #include "exceptions/file_not_found_exception.h"
+#include "exceptions/insufficient_space_exception.h"
 #include "exceptions/invalid_page_exception.h"
+#include "exceptions/invalid_record_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
+#include "exceptions/page_format_exception.h"
 #include "exceptions/page_pinned_exception.h"
+#include "exceptions/page_size_mismatch_exception.h"
+#include "exceptions/redo_mismatch_exception.h"
 #include "file_iterator.h"
+#include "hash_index.h"
+#include "heap_appender.h"
 #include "page.h"
+#include "page_fetcher.h"
 #include "page_iterator.h"
+#include "pax_page.h"
+#include "parallel_scan.h"
+#include "trace.h"
+#include "wal.h"
 
 #define PRINT_ERROR(str)                            \
   {                                                 \
@@ -56,6 +85,53 @@ void test3(File &file4);
 void test4(File &file4);
 void test5(File &file4);
 void test6(File &file1);
+void test7(File &file1);
+void test8(File &file1);
+void test9(File &file1);
+void test10(File &file1);
+void test11(File &file1);
+void test12(File &file1);
+void test13();
+void test14();
+void test15(File &file1);
+void test16();
+void test17();
+void test18();
+void test19();
+void test20();
+void test21();
+void test22();
+void test23();
+void test24();
+void test25();
+void test26();
+void test27();
+void test28();
+void test29();
+void test30();
+void test31();
+void test32();
+void test33();
+void test34();
+void test35();
+void test36();
+void test37();
+void test38();
+void test39();
+void test40();
+void test41();
+void test42();
+void test43();
+void test44();
+void test45();
+void test46();
+void test47();
+void test48();
+void test49();
+void test50();
+void test51();
+void test52();
+void test53();
 // Calls the above tests
 void testBufMgr();
 
@@ -156,6 +232,53 @@ void testBufMgr() {
     test4(file4);
     test5(file5);
     test6(file1);
+    test7(file1);
+    test8(file1);
+    test9(file1);
+    test10(file1);
+    test11(file1);
+    test12(file1);
+    test13();
+    test14();
+    test15(file1);
+    test16();
+    test17();
+    test18();
+    test19();
+    test20();
+    test21();
+    test22();
+    test23();
+    test24();
+    test25();
+    test26();
+    test27();
+    test28();
+    test29();
+    test30();
+    test31();
+    test32();
+    test33();
+    test34();
+    test35();
+    test36();
+    test37();
+    test38();
+    test39();
+    test40();
+    test41();
+    test42();
+    test43();
+    test44();
+    test45();
+    test46();
+    test47();
+    test48();
+    test49();
+    test50();
+    test51();
+    test52();
+    test53();
 
     // Close the files by going out of scope
   }
@@ -313,3 +436,3282 @@ void test6(File &file1) {
 
   bufMgr->flushFile(file1);
 }
+
+void test7(File &file1) {
+  // Several threads reading the same file through a small, partitioned pool
+  // so that hits, misses and evictions run concurrently
+  BufMgrOptions options;
+  options.hashPartitions = 4;
+  BufMgr sharedMgr(num / 10, options);
+  std::atomic<bool> mismatch(false);
+  std::vector<std::thread> workers;
+
+  for (int t = 0; t < 4; t++) {
+    workers.emplace_back([&sharedMgr, &file1, &mismatch, t]() {
+      File file = file1;
+      Page *workerPage;
+      char expected[100];
+      for (PageId j = 0; j < 5 * num; j++) {
+        PageId pageNo = (j * (t + 1)) % num + 1;
+        sharedMgr.readPage(file, pageNo, workerPage);
+        sprintf(expected, "test.1 Page %u %7.1f", pageNo, (float)pageNo);
+        if (strncmp(workerPage->getRecord({pageNo, 1}).c_str(), expected,
+                    strlen(expected)) != 0) {
+          mismatch = true;
+        }
+        sharedMgr.unPinPage(file, pageNo, false);
+      }
+    });
+  }
+  for (std::thread &worker : workers) worker.join();
+
+  if (mismatch) {
+    PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+  }
+
+  std::cout << "Test 7 passed"
+            << "\n";
+}
+
+void test8(File &file1) {
+  // Every replacement policy must return the right pages under a mix of a
+  // small hot set and a scan, and must give up once every frame is pinned
+  const ReplacementPolicyType policies[] = {ReplacementPolicyType::CLOCK,
+                                            ReplacementPolicyType::LRU_K,
+                                            ReplacementPolicyType::TWO_Q};
+  for (const ReplacementPolicyType policy : policies) {
+    BufMgrOptions options;
+    options.replacementPolicy = policy;
+    BufMgr policyMgr(num / 10, options);
+
+    for (PageId j = 0; j < 3 * num; j++) {
+      PageId pageNo = j % 2 == 0 ? (j / 2) % 5 + 1 : (j / 2) % num + 1;
+      policyMgr.readPage(file1, pageNo, page);
+      sprintf(tmpbuf, "test.1 Page %u %7.1f", pageNo, (float)pageNo);
+      if (strncmp(page->getRecord({pageNo, 1}).c_str(), tmpbuf,
+                  strlen(tmpbuf)) != 0) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+      policyMgr.unPinPage(file1, pageNo, false);
+    }
+
+    for (i = 1; i <= num / 10; i++) {
+      policyMgr.readPage(file1, i, page);
+    }
+    try {
+      policyMgr.readPage(file1, num, page);
+      PRINT_ERROR(
+          "ERROR :: No more frames left for allocation. Exception should have "
+          "been thrown before execution reaches this point.");
+    } catch (const BufferExceededException &e) {
+    }
+    for (i = 1; i <= num / 10; i++) {
+      policyMgr.unPinPage(file1, i, false);
+    }
+    policyMgr.readPage(file1, num, page);
+    policyMgr.unPinPage(file1, num, false);
+  }
+
+  std::cout << "Test 8 passed"
+            << "\n";
+}
+
+void test9(File &file1) {
+  // A scan through a two frame ring must leave the rest of the pool alone.
+  // The hot pages are changed in memory without being marked dirty, so the
+  // change only survives if they are never evicted.
+  BufMgr scanMgr(num / 10);
+  const PageId hotPages = 5;
+  for (i = 1; i <= hotPages; i++) {
+    scanMgr.readPage(file1, i, page);
+    page->updateRecord({i, 1}, "hot");
+    scanMgr.unPinPage(file1, i, false);
+  }
+
+  BufferAccessStrategy scan(2);
+  for (i = hotPages + 1; i <= num; i++) {
+    scanMgr.readPage(file1, i, page, &scan);
+    sprintf(tmpbuf, "test.1 Page %u %7.1f", i, (float)i);
+    if (strncmp(page->getRecord({i, 1}).c_str(), tmpbuf, strlen(tmpbuf)) != 0) {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+    scanMgr.unPinPage(file1, i, false);
+  }
+
+  for (i = 1; i <= hotPages; i++) {
+    scanMgr.readPage(file1, i, page);
+    if (page->getRecord({i, 1}) != "hot") {
+      PRINT_ERROR("ERROR :: SCAN EVICTED A HOT PAGE");
+    }
+    scanMgr.unPinPage(file1, i, false);
+  }
+
+  std::cout << "Test 9 passed"
+            << "\n";
+}
+
+void test10(File &file1) {
+  // Sequential reads with read-ahead, an explicit prefetch with some of the
+  // pages already resident, and a prefetch running past the end of the file
+  BufMgrOptions options;
+  options.readAheadPages = 8;
+  BufMgr prefetchMgr(num / 2, options);
+
+  for (int pass = 0; pass < 2; pass++) {
+    if (pass == 1) {
+      prefetchMgr.readPage(file1, 3, page);
+      prefetchMgr.unPinPage(file1, 3, false);
+      prefetchMgr.prefetch(file1, 1, num);
+    }
+    for (i = 1; i <= num; i++) {
+      prefetchMgr.readPage(file1, i, page);
+      sprintf(tmpbuf, "test.1 Page %u %7.1f", i, (float)i);
+      if (strncmp(page->getRecord({i, 1}).c_str(), tmpbuf, strlen(tmpbuf)) !=
+          0) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+      prefetchMgr.unPinPage(file1, i, false);
+    }
+  }
+  prefetchMgr.prefetch(file1, num - 2, 10);
+
+  std::cout << "Test 10 passed"
+            << "\n";
+}
+
+void test11(File &file1) {
+  // Read-ahead through each asynchronous I/O engine, with some pages already
+  // resident so that the batches are not contiguous
+  const IoEngineType engines[] = {IoEngineType::THREAD_POOL,
+                                  IoEngineType::IO_URING};
+  for (const IoEngineType engine : engines) {
+    BufMgrOptions options;
+    options.readAheadPages = 16;
+    options.ioEngine = engine;
+    options.ioQueueDepth = 4;
+    BufMgr asyncMgr(num / 2, options);
+
+    for (i = 5; i <= num; i += 7) {
+      asyncMgr.readPage(file1, i, page);
+      asyncMgr.unPinPage(file1, i, false);
+    }
+    asyncMgr.prefetch(file1, 1, num);
+    for (i = 1; i <= num; i++) {
+      asyncMgr.readPage(file1, i, page);
+      sprintf(tmpbuf, "test.1 Page %u %7.1f", i, (float)i);
+      if (strncmp(page->getRecord({i, 1}).c_str(), tmpbuf, strlen(tmpbuf)) !=
+          0) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+      asyncMgr.unPinPage(file1, i, false);
+    }
+  }
+
+  std::cout << "Test 11 passed"
+            << "\n";
+}
+
+void test12(File &file1) {
+  // The background writer must get dirty pages to disk without a flush
+  BufMgrOptions options;
+  options.backgroundWriter = true;
+  options.writerIntervalMs = 1;
+  options.writerLookahead = num;
+  BufMgr writerMgr(num / 10, options);
+  const PageId dirtyPages = 3;
+  for (i = 1; i <= dirtyPages; i++) {
+    writerMgr.readPage(file1, i, page);
+    page->updateRecord({i, 1}, "bg");
+    writerMgr.unPinPage(file1, i, true);
+  }
+
+  for (i = 1; i <= dirtyPages; i++) {
+    int waitedMs = 0;
+    while (file1.readPage(i).getRecord({i, 1}) != "bg") {
+      if (waitedMs >= 5000) {
+        PRINT_ERROR("ERROR :: DIRTY PAGE WAS NOT WRITTEN IN THE BACKGROUND");
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      waitedMs++;
+    }
+  }
+
+  // Put the original records back for any test that follows
+  for (i = 1; i <= dirtyPages; i++) {
+    writerMgr.readPage(file1, i, page);
+    sprintf(tmpbuf, "test.1 Page %u %7.1f", i, (float)i);
+    page->updateRecord({i, 1}, tmpbuf);
+    writerMgr.unPinPage(file1, i, true);
+  }
+  writerMgr.flushFile(file1);
+
+  std::cout << "Test 12 passed"
+            << "\n";
+}
+
+void test13() {
+  // Deleting pages from the ends and the middle of the used list and reusing
+  // them must leave a list that is consistent in both directions
+  const std::string filename = "test.13";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    for (i = 0; i < 10; i++) {
+      file.allocatePage();
+    }
+    file.deletePage(1);
+    file.deletePage(5);
+    file.deletePage(10);
+    file.allocatePage();
+    file.allocatePage();
+
+    PageId previous = Page::INVALID_NUMBER;
+    int count = 0;
+    for (FileIterator iter = file.begin(); iter != file.end(); ++iter) {
+      if ((*iter).prev_page_number() != previous) {
+        PRINT_ERROR("ERROR :: USED PAGE LIST IS INCONSISTENT");
+      }
+      previous = (*iter).page_number();
+      count++;
+    }
+    if (count != 9 || previous != 5) {
+      PRINT_ERROR("ERROR :: DELETED PAGES WERE NOT REUSED");
+    }
+  }
+
+  {
+    // The cached header must have been written back when the file closed
+    File file = File::open(filename);
+    int count = 0;
+    for (FileIterator iter = file.begin(); iter != file.end(); ++iter) {
+      count++;
+    }
+    if (count != 9 || file.allocatePage().page_number() != 1) {
+      PRINT_ERROR("ERROR :: FILE HEADER WAS NOT WRITTEN BACK");
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 13 passed"
+            << "\n";
+}
+
+void test14() {
+  // Allocate a run of pages into the buffer pool, then ask for more pages
+  // than there are frames
+  const std::string filename = "test.14";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    file.allocatePage();
+    BufMgr extentMgr(num / 10);
+    const std::uint32_t runLength = num / 20;
+    PageId firstPageNo;
+    std::vector<Page *> pages;
+    extentMgr.allocPages(file, runLength, firstPageNo, pages);
+    if (firstPageNo != 2 || pages.size() != runLength) {
+      PRINT_ERROR("ERROR :: EXTENT WAS NOT ALLOCATED AT THE END OF THE FILE");
+    }
+    for (i = 0; i < runLength; i++) {
+      if (pages[i]->page_number() != firstPageNo + i) {
+        PRINT_ERROR("ERROR :: EXTENT IS NOT CONTIGUOUS");
+      }
+      sprintf(tmpbuf, "extent page %u", i);
+      pages[i]->insertRecord(tmpbuf);
+      extentMgr.unPinPage(file, firstPageNo + i, true);
+    }
+
+    try {
+      std::vector<Page *> tooMany;
+      extentMgr.allocPages(file, num, firstPageNo, tooMany);
+      PRINT_ERROR(
+          "ERROR :: More pages than frames. Exception should have been "
+          "generated.");
+    } catch (const BufferExceededException &e) {
+    }
+    // One vectored write for the whole run, then a sync
+    extentMgr.flushFile(file, true);
+
+    int count = 0;
+    for (FileIterator iter = file.begin(); iter != file.end(); ++iter) {
+      if (count > 0) {
+        sprintf(tmpbuf, "extent page %u", count - 1);
+        if ((*iter).getRecord({(*iter).page_number(), 1}) != tmpbuf) {
+          PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+        }
+      }
+      count++;
+    }
+    if (count != static_cast<int>(runLength) + 1) {
+      PRINT_ERROR("ERROR :: FILE WAS EXTENDED BY A FAILED ALLOCATION");
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 14 passed"
+            << "\n";
+}
+
+void test15(File &file1) {
+  // Flushing one file must write its pages and leave the pages of another
+  // file alone, even when their frames are interleaved
+  const std::string filename = "test.15";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    file.allocateExtent(3);
+    BufMgr flushMgr(num / 10);
+    for (i = 1; i <= 3; i++) {
+      flushMgr.readPage(file1, i, page);
+      page->updateRecord({i, 1}, "not flushed");
+      flushMgr.unPinPage(file1, i, true);
+
+      flushMgr.readPage(file, i, page);
+      page->insertRecord("flushed");
+      flushMgr.unPinPage(file, i, true);
+    }
+    flushMgr.flushFile(file);
+
+    for (i = 1; i <= 3; i++) {
+      if (file.readPage(i).getRecord({i, 1}) != "flushed") {
+        PRINT_ERROR("ERROR :: PAGE OF FLUSHED FILE WAS NOT WRITTEN");
+      }
+      if (file1.readPage(i).getRecord({i, 1}) == "not flushed") {
+        PRINT_ERROR("ERROR :: PAGE OF ANOTHER FILE WAS WRITTEN");
+      }
+    }
+    // The changes to file1 are dropped along with flushMgr
+  }
+  File::remove(filename);
+
+  std::cout << "Test 15 passed"
+            << "\n";
+}
+
+void test16() {
+  // Pages served from a mapped file must match the pages on disk, also after
+  // the file has grown past the mapping and pages have been rewritten
+  const std::string filename = "test.16";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    for (i = 1; i <= 5; i++) {
+      Page new_page = file.allocatePage();
+      sprintf(tmpbuf, "mapped %u", i);
+      new_page.insertRecord(tmpbuf);
+      file.writePage(new_page);
+    }
+    file.map(MapAccess::SEQUENTIAL);
+    if (!file.isMapped()) {
+      PRINT_ERROR("ERROR :: FILE WAS NOT MAPPED");
+    }
+    const Page first = file.mappedPage(1);
+
+    // Grow the file past the mapping; the old view must stay usable
+    Page grown = file.allocatePage();
+    grown.insertRecord("grown");
+    file.writePage(grown);
+    if (file.mappedPage(grown.page_number()).getRecord(
+            {grown.page_number(), 1}) != "grown") {
+      PRINT_ERROR("ERROR :: MAPPING WAS NOT EXTENDED");
+    }
+
+    // Reads through the buffer manager copy out of the mapping
+    BufMgr mapMgr(num / 10);
+    for (i = 1; i <= 5; i++) {
+      sprintf(tmpbuf, "mapped %u", i);
+      mapMgr.readPage(file, i, page);
+      if (file.mappedPage(i).getRecord({i, 1}) != tmpbuf ||
+          page->getRecord({i, 1}) != tmpbuf) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+      mapMgr.unPinPage(file, i, false);
+    }
+
+    Page rewritten = file.readPage(1);
+    rewritten.updateRecord({1, 1}, "rewritten");
+    file.writePage(rewritten);
+    if (first.getRecord({1, 1}) != "rewritten") {
+      PRINT_ERROR("ERROR :: MAPPED PAGE DID NOT SEE THE REWRITE");
+    }
+
+    file.deletePage(2);
+    try {
+      file.mappedPage(2);
+      PRINT_ERROR(
+          "ERROR :: Page is not used. Exception should have been generated.");
+    } catch (const InvalidPageException &e) {
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 16 passed"
+            << "\n";
+}
+
+void test17() {
+  // Pages written and read with direct I/O must match what buffered I/O sees
+  const std::string filename = "test.17";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    try {
+      file.setDirectIo(true);
+    } catch (const FileIoException &e) {
+      // The file system does not support direct I/O; nothing to test
+    }
+    if (file.isDirectIo()) {
+      BufMgr directMgr(num / 10);
+      PageId firstPageNo;
+      std::vector<Page *> pages;
+      directMgr.allocPages(file, 10, firstPageNo, pages);
+      for (i = 0; i < 10; i++) {
+        sprintf(tmpbuf, "direct %u", i);
+        pages[i]->insertRecord(tmpbuf);
+        directMgr.unPinPage(file, firstPageNo + i, true);
+      }
+      directMgr.flushFile(file);
+      file.deletePage(firstPageNo + 4);
+      for (i = 0; i < 10; i++) {
+        if (i == 4) continue;
+        sprintf(tmpbuf, "direct %u", i);
+        directMgr.readPage(file, firstPageNo + i, page);
+        if (page->getRecord({firstPageNo + i, 1}) != tmpbuf) {
+          PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+        }
+        directMgr.unPinPage(file, firstPageNo + i, false);
+      }
+
+      // A prefetched run is read straight into the frames
+      BufMgr prefetchMgr(16);
+      prefetchMgr.prefetch(file, firstPageNo, 4);
+      prefetchMgr.clearBufStats();
+      for (i = 0; i < 4; i++) {
+        sprintf(tmpbuf, "direct %u", i);
+        PageGuard prefetched = prefetchMgr.readPage(file, firstPageNo + i);
+        if (prefetched->getRecord({firstPageNo + i, 1}) != tmpbuf) {
+          PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+        }
+      }
+      if (prefetchMgr.getBufStats().misses != 0) {
+        PRINT_ERROR("ERROR :: PREFETCHED PAGES NOT IN THE POOL");
+      }
+
+      file.setDirectIo(false);
+      int count = 0;
+      for (FileIterator iter = file.begin(); iter != file.end(); ++iter) {
+        sprintf(tmpbuf, "direct %u", (*iter).page_number() - firstPageNo);
+        if ((*iter).getRecord({(*iter).page_number(), 1}) != tmpbuf) {
+          PRINT_ERROR("ERROR :: BUFFERED READ DID NOT SEE DIRECT WRITE");
+        }
+        count++;
+      }
+      if (count != 9) {
+        PRINT_ERROR("ERROR :: USED PAGE LIST IS INCONSISTENT");
+      }
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 17 passed"
+            << "\n";
+}
+
+void test18() {
+  // Readers of one file run in parallel with a thread that appends to it;
+  // afterwards the used page list must still be consistent
+  const std::string filename = "test.18";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    const PageId initial = 50;
+    for (i = 1; i <= initial; i++) {
+      Page new_page = file.allocatePage();
+      sprintf(tmpbuf, "parallel %u", i);
+      new_page.insertRecord(tmpbuf);
+      file.writePage(new_page);
+    }
+
+    std::atomic<bool> mismatch(false);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; t++) {
+      workers.emplace_back([&file, &mismatch, initial, t]() {
+        File reader = file;
+        char expected[100];
+        for (PageId j = 0; j < 10 * initial; j++) {
+          const PageId pageNo = (j * (t + 1)) % initial + 1;
+          sprintf(expected, "parallel %u", pageNo);
+          if (reader.readPage(pageNo).getRecord({pageNo, 1}) != expected) {
+            mismatch = true;
+          }
+        }
+      });
+    }
+    workers.emplace_back([&file, initial]() {
+      File writer = file;
+      for (PageId j = 0; j < initial; j++) {
+        writer.allocatePage();
+      }
+    });
+    for (std::thread &worker : workers) worker.join();
+
+    if (mismatch) {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+    PageId previous = Page::INVALID_NUMBER;
+    PageId count = 0;
+    for (FileIterator iter = file.begin(); iter != file.end(); ++iter) {
+      if ((*iter).prev_page_number() != previous) {
+        PRINT_ERROR("ERROR :: USED PAGE LIST IS INCONSISTENT");
+      }
+      previous = (*iter).page_number();
+      count++;
+    }
+    if (count != 2 * initial) {
+      PRINT_ERROR("ERROR :: USED PAGE LIST IS INCONSISTENT");
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 18 passed"
+            << "\n";
+}
+
+void test19() {
+  // Pages of a checksummed file survive list updates and reopening, and a
+  // corrupted page is refused both by the file and by the buffer manager
+  const std::string filename = "test.19";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename, true /* checksums */);
+    for (i = 1; i <= 5; i++) {
+      Page new_page = file.allocatePage();
+      sprintf(tmpbuf, "checksummed %u", i);
+      new_page.insertRecord(tmpbuf);
+      file.writePage(new_page);
+    }
+    // Deleting a page rewrites the links of its neighbours in place
+    file.deletePage(2);
+  }
+
+  {
+    File file = File::open(filename);
+    if (!file.hasChecksums()) {
+      PRINT_ERROR("ERROR :: CHECKSUM FLAG WAS NOT PERSISTED");
+    }
+    for (FileIterator iter = file.begin(); iter != file.end(); ++iter) {
+      const PageId pageNo = (*iter).page_number();
+      sprintf(tmpbuf, "checksummed %u", pageNo);
+      if (file.readPage(pageNo).getRecord({pageNo, 1}) != tmpbuf) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+    }
+
+    // Flip a byte in the data of page 3 behind the file's back
+    {
+      std::fstream raw(filename,
+                       std::fstream::in | std::fstream::out |
+                           std::fstream::binary);
+      raw.seekp(3 * Page::SIZE + Page::SIZE / 2, std::ios::beg);
+      raw.put('!');
+    }
+    try {
+      file.readPage(3);
+      PRINT_ERROR(
+          "ERROR :: Page is corrupt. Exception should have been generated.");
+    } catch (const CorruptPageException &e) {
+    }
+    BufMgr checkMgr(num / 10);
+    try {
+      checkMgr.readPage(file, 3, page);
+      PRINT_ERROR(
+          "ERROR :: Page is corrupt. Exception should have been generated.");
+    } catch (const CorruptPageException &e) {
+    }
+    checkMgr.readPage(file, 4, page);
+    checkMgr.unPinPage(file, 4, false);
+  }
+  File::remove(filename);
+
+  std::cout << "Test 19 passed"
+            << "\n";
+}
+
+void test20() {
+  // Mixing lazy and eager deletes with inserts and updates that need the
+  // holes back must keep every remaining record intact
+  Page scratch;
+  std::map<SlotId, std::string> expected;
+  std::uint32_t seed = 20;
+  for (int step = 0; step < 5000; step++) {
+    seed = seed * 1103515245 + 12345;
+    const std::uint32_t choice = (seed >> 16) % 4;
+    if (choice == 0 || expected.empty()) {
+      const std::string record(100 + (seed >> 8) % 400, 'a' + step % 26);
+      if (!scratch.hasSpaceForRecord(record)) {
+        continue;
+      }
+      const RecordId rid = scratch.insertRecord(record);
+      expected[rid.slot_number] = record;
+      continue;
+    }
+
+    std::map<SlotId, std::string>::iterator victim = expected.begin();
+    std::advance(victim, (seed >> 4) % expected.size());
+    const RecordId rid = {scratch.page_number(), victim->first};
+    if (choice == 1) {
+      scratch.deleteRecordLazily(rid);
+      expected.erase(victim);
+    } else if (choice == 2) {
+      scratch.deleteRecord(rid);
+      expected.erase(victim);
+    } else {
+      const std::string record(50 + (seed >> 8) % 600, 'A' + step % 26);
+      if (record.length() <= scratch.getFreeSpace() + victim->second.length()) {
+        scratch.updateRecord(rid, record);
+        victim->second = record;
+      }
+    }
+  }
+
+  for (const std::pair<const SlotId, std::string> &record : expected) {
+    const RecordSpan span =
+        scratch.getRecordSpan({scratch.page_number(), record.first});
+    if (std::string(span.data, span.length) != record.second) {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+  }
+
+  std::cout << "Test 20 passed"
+            << "\n";
+}
+
+void test21() {
+  // Bulk load a heap file through an appender and read every record back in
+  // order
+  const std::string filename = "test.21";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    BufMgr loadMgr(num / 10);
+    const std::size_t numRecords = 2000;
+    std::vector<std::string> records;
+    std::vector<RecordSpan> spans;
+    for (std::size_t r = 0; r < numRecords; r++) {
+      sprintf(tmpbuf, "bulk record %06zu", r);
+      records.push_back(tmpbuf);
+    }
+    for (const std::string &record : records) {
+      spans.push_back(
+          {record.data(), static_cast<PageOffset>(record.length())});
+    }
+    std::vector<RecordId> rids(numRecords);
+    {
+      HeapAppender appender(loadMgr, file);
+      appender.append(spans.data(), numRecords - 1, rids.data());
+      rids[numRecords - 1] = appender.append(records[numRecords - 1]);
+      try {
+        appender.append(std::string(Page::DATA_SIZE, 'x'));
+        PRINT_ERROR(
+            "ERROR :: Record is too large. Exception should have been "
+            "generated.");
+      } catch (const InsufficientSpaceException &e) {
+      }
+    }
+    loadMgr.flushFile(file);
+
+    std::size_t next = 0;
+    int pages = 0;
+    for (FileIterator iter = file.begin(); iter != file.end(); ++iter) {
+      Page filled = *iter;
+      for (PageIterator rec = filled.begin(); rec != filled.end(); ++rec) {
+        if (next >= numRecords || *rec != records[next] ||
+            filled.page_number() != rids[next].page_number) {
+          PRINT_ERROR("ERROR :: RECORDS WERE NOT APPENDED IN ORDER");
+        }
+        next++;
+      }
+      pages++;
+    }
+    // Only the page that was started for the oversized record is left empty
+    const std::size_t perPage =
+        Page::DATA_SIZE / (records[0].length() + sizeof(PackedPageSlot));
+    if (next != numRecords ||
+        pages != static_cast<int>((numRecords + perPage - 1) / perPage) + 1) {
+      PRINT_ERROR("ERROR :: PAGES WERE NOT FILLED");
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 21 passed"
+            << "\n";
+}
+
+void test22() {
+  // Freed slots in the middle of the slot array are reused before any new
+  // slot is allocated, most recently freed first
+  Page scratch;
+  std::vector<RecordId> rids;
+  for (int i = 0; i < 200; i++) {
+    sprintf(tmpbuf, "slot record %d", i);
+    rids.push_back(scratch.insertRecord(tmpbuf));
+  }
+  for (int i = 0; i < 200; i += 2) {
+    scratch.deleteRecordLazily(rids[i]);
+  }
+
+  for (int i = 198; i >= 0; i -= 2) {
+    sprintf(tmpbuf, "reused record %d", i);
+    const RecordId rid = scratch.insertRecord(tmpbuf);
+    if (rid.slot_number != rids[i].slot_number) {
+      PRINT_ERROR("ERROR :: FREED SLOT WAS NOT REUSED");
+    }
+  }
+  const RecordId fresh = scratch.insertRecord("fresh record");
+  if (fresh.slot_number != rids.back().slot_number + 1) {
+    PRINT_ERROR("ERROR :: NEW SLOT WAS NOT APPENDED");
+  }
+
+  for (int i = 0; i < 200; i++) {
+    sprintf(tmpbuf, i % 2 == 0 ? "reused record %d" : "slot record %d", i);
+    if (scratch.getRecord(rids[i]) != tmpbuf) {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+  }
+
+  std::cout << "Test 22 passed"
+            << "\n";
+}
+
+void test23() {
+  // Small records fill a new page with only a packed slot of overhead each
+  Page scratch;
+  const std::string record = "tuple 42";
+  std::vector<RecordId> rids;
+  while (scratch.hasSpaceForRecord(record)) {
+    rids.push_back(scratch.insertRecord(record));
+  }
+  if (rids.size() !=
+      Page::DATA_SIZE / (record.length() + sizeof(PackedPageSlot))) {
+    PRINT_ERROR("ERROR :: SLOTS WERE NOT PACKED");
+  }
+
+  int found = 0;
+  for (PageIterator iter = scratch.begin(); iter != scratch.end(); ++iter) {
+    if (*iter != record) {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+    found++;
+  }
+  if (found != static_cast<int>(rids.size())) {
+    PRINT_ERROR("ERROR :: RECORDS WERE LOST");
+  }
+
+  std::cout << "Test 23 passed"
+            << "\n";
+}
+
+void test24() {
+  // A file records its page size and is refused by builds with another one
+  const std::string filename = "test.24";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    file.allocatePage();
+  }
+  {
+    File file = File::open(filename);
+  }
+  {
+    const std::uint32_t otherSize = Page::SIZE * 2;
+    std::fstream raw(filename, std::fstream::in | std::fstream::out |
+                                   std::fstream::binary);
+    raw.seekp(offsetof(FileHeader, page_size), std::ios::beg);
+    raw.write(reinterpret_cast<const char *>(&otherSize), sizeof(otherSize));
+  }
+  try {
+    File file = File::open(filename);
+    PRINT_ERROR(
+        "ERROR :: Page size differs. Exception should have been generated.");
+  } catch (const PageSizeMismatchException &e) {
+  }
+  File::remove(filename);
+
+  std::cout << "Test 24 passed"
+            << "\n";
+}
+
+void test25() {
+  // A parallel scan visits every used page exactly once, and a failing
+  // callback stops the scan without leaving pages pinned
+  const std::string filename = "test.25";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    const PageId numPages = 300;
+    for (i = 1; i <= numPages; i++) {
+      Page new_page = file.allocatePage();
+      sprintf(tmpbuf, "scan %u", i);
+      new_page.insertRecord(tmpbuf);
+      file.writePage(new_page);
+    }
+    for (PageId pageNo = 7; pageNo <= numPages; pageNo += 37) {
+      file.deletePage(pageNo);
+    }
+
+    BufMgr scanMgr(num);
+    ParallelScan scan(scanMgr, file, 4, 8);
+    std::vector<std::atomic<int>> visits(numPages + 1);
+    std::vector<int> perWorker(scan.workers(), 0);
+    std::atomic<bool> mismatch(false);
+    scan.run([&](unsigned worker, const Page &page) {
+      const PageId pageNo = page.page_number();
+      char expected[100];
+      sprintf(expected, "scan %u", pageNo);
+      if (page.getRecord({pageNo, 1}) != expected) {
+        mismatch = true;
+      }
+      visits[pageNo]++;
+      perWorker[worker]++;
+    });
+    if (mismatch) {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+    int total = 0;
+    for (PageId pageNo = 1; pageNo <= numPages; pageNo++) {
+      if (visits[pageNo] != ((pageNo - 7) % 37 == 0 ? 0 : 1)) {
+        PRINT_ERROR("ERROR :: PAGE WAS NOT VISITED EXACTLY ONCE");
+      }
+    }
+    for (int count : perWorker) {
+      total += count;
+    }
+    if (total != static_cast<int>(numPages - (numPages - 7) / 37 - 1)) {
+      PRINT_ERROR("ERROR :: PAGES WERE NOT COUNTED");
+    }
+
+    try {
+      scan.run([](unsigned, const Page &page) {
+        if (page.page_number() == 100) {
+          throw std::runtime_error("stop");
+        }
+      });
+      PRINT_ERROR(
+          "ERROR :: Callback failed. Exception should have been generated.");
+    } catch (const std::runtime_error &e) {
+    }
+    scanMgr.flushFile(file);
+  }
+  File::remove(filename);
+
+  std::cout << "Test 25 passed"
+            << "\n";
+}
+
+void test26() {
+  // Guards unpin their page when they go out of scope, carry the dirty bit
+  // and hand the pin over when moved
+  const std::string filename = "test.26";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    BufMgr guardMgr(num / 10);
+    std::vector<PageGuard> guards;
+    for (i = 1; i <= 5; i++) {
+      PageGuard page = guardMgr.allocPage(file);
+      sprintf(tmpbuf, "guarded %u", page->page_number());
+      page->insertRecord(tmpbuf);
+      page.markDirty();
+      guards.push_back(std::move(page));
+      if (page) {
+        PRINT_ERROR("ERROR :: MOVED GUARD STILL HOLDS A PIN");
+      }
+    }
+    guards.clear();
+    guardMgr.flushFile(file);
+
+    {
+      PageGuard page = guardMgr.readPage(file, 3);
+      page->updateRecord({3, 1}, "updated");
+      page.markDirty();
+      PageGuard other = guardMgr.readPage(file, 4);
+      other = std::move(page);
+    }
+    try {
+      guardMgr.unPinPage(file, 3, false);
+      PRINT_ERROR(
+          "ERROR :: Page is not pinned. Exception should have been generated.");
+    } catch (const PageNotPinnedException &e) {
+    }
+    guardMgr.flushFile(file);
+
+    for (i = 1; i <= 5; i++) {
+      sprintf(tmpbuf, i == 3 ? "updated" : "guarded %u", i);
+      if (file.readPage(i).getRecord({i, 1}) != tmpbuf) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 26 passed"
+            << "\n";
+}
+
+void test27() {
+  // Optimistic reads of unpinned pages in the buffer pool need no pin, fall
+  // back to pinning otherwise, and see changes made by dirty unpins
+  const std::string filename = "test.27";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    for (i = 1; i <= 3; i++) {
+      Page new_page = file.allocatePage();
+      sprintf(tmpbuf, "optimistic %u", i);
+      new_page.insertRecord(tmpbuf);
+      file.writePage(new_page);
+    }
+
+    BufMgr optimisticMgr(num / 10);
+    std::string record;
+    const auto readRecord = [&record](const Page &page) {
+      record = page.getRecord({page.page_number(), 1});
+    };
+    if (optimisticMgr.readPageOptimistic(file, 1, readRecord) ||
+        record != "optimistic 1") {
+      PRINT_ERROR("ERROR :: PAGE WAS NOT LOADED");
+    }
+    if (!optimisticMgr.readPageOptimistic(file, 1, readRecord) ||
+        record != "optimistic 1") {
+      PRINT_ERROR("ERROR :: RESIDENT PAGE WAS NOT READ OPTIMISTICALLY");
+    }
+    {
+      PageGuard page = optimisticMgr.readPage(file, 1);
+      if (optimisticMgr.readPageOptimistic(file, 1, readRecord)) {
+        PRINT_ERROR("ERROR :: PINNED PAGE WAS READ OPTIMISTICALLY");
+      }
+      page->updateRecord({1, 1}, "changed");
+      page.markDirty();
+    }
+    if (!optimisticMgr.readPageOptimistic(file, 1, readRecord) ||
+        record != "changed") {
+      PRINT_ERROR("ERROR :: CHANGE WAS NOT SEEN");
+    }
+
+    optimisticMgr.readPage(file, 2).release();
+    optimisticMgr.readPage(file, 3).release();
+    std::atomic<int> optimistic(0);
+    std::atomic<bool> mismatch(false);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++) {
+      readers.emplace_back([&, t]() {
+        for (int j = 0; j < 5000; j++) {
+          const PageId pageNo = 2 + (j + t) % 2;
+          std::string seen;
+          if (optimisticMgr.readPageOptimistic(
+                  file, pageNo, [&seen, pageNo](const Page &page) {
+                    seen = page.getRecord({pageNo, 1});
+                  })) {
+            optimistic++;
+          }
+          char expected[100];
+          sprintf(expected, "optimistic %u", pageNo);
+          if (seen != expected) {
+            mismatch = true;
+          }
+        }
+      });
+    }
+    for (std::thread &reader : readers) reader.join();
+    if (mismatch) {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+    if (optimistic != 4 * 5000) {
+      PRINT_ERROR("ERROR :: RESIDENT PAGE WAS NOT READ OPTIMISTICALLY");
+    }
+    optimisticMgr.flushFile(file);
+  }
+  File::remove(filename);
+
+  std::cout << "Test 27 passed"
+            << "\n";
+}
+
+void test28() {
+  // Statistics count hits, misses, evictions and writes from every thread
+  const std::string filename = "test.28";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    for (i = 1; i <= 10; i++) {
+      file.allocatePage();
+    }
+
+    BufMgr statsMgr(4);
+    for (i = 1; i <= 10; i++) {
+      PageGuard page = statsMgr.readPage(file, i);
+      if (i == 5) page.markDirty();
+    }
+    statsMgr.readPage(file, 10).release();
+    BufStats stats = statsMgr.getBufStats();
+    if (stats.accesses != 11 || stats.hits != 1 || stats.misses != 10 ||
+        stats.diskreads != 10 || stats.evictions != 6 ||
+        stats.dirtyEvictions != 1 || stats.diskwrites != 1 ||
+        stats.allocations != 10 || stats.sweepSteps < stats.allocations) {
+      PRINT_ERROR("ERROR :: STATISTICS DID NOT MATCH");
+    }
+    if (stats.readMissLatency.total() != 10 ||
+        stats.writeLatency.total() != 1 ||
+        stats.readMissLatency.percentile(0.5) == 0 ||
+        stats.readMissLatency.percentile(0.5) >
+            stats.readMissLatency.percentile(1.0)) {
+      PRINT_ERROR("ERROR :: LATENCIES WERE NOT RECORDED");
+    }
+
+    statsMgr.clearBufStats();
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 8; t++) {
+      readers.emplace_back([&statsMgr, &file]() {
+        for (int j = 0; j < 1000; j++) {
+          statsMgr.readPage(file, 10).release();
+        }
+      });
+    }
+    for (std::thread &reader : readers) reader.join();
+    stats = statsMgr.getBufStats();
+    if (stats.accesses != 8000 || stats.hits != 8000 || stats.misses != 0) {
+      PRINT_ERROR("ERROR :: STATISTICS DID NOT MATCH");
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 28 passed"
+            << "\n";
+}
+
+void test29() {
+  // The buffer pool grows and shrinks while it is in use, keeping the pages
+  // in the frames that stay and writing back the ones it evicts
+  const std::string filename = "test.29";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    for (i = 1; i <= 30; i++) {
+      Page new_page = file.allocatePage();
+      sprintf(tmpbuf, "resize %u", i);
+      new_page.insertRecord(tmpbuf);
+      file.writePage(new_page);
+    }
+    const auto checkPage = [](const Page &page, const PageId pageNo) {
+      char expected[100];
+      sprintf(expected, "resize %u", pageNo);
+      return page.getRecord({pageNo, 1}) == expected;
+    };
+
+    const ReplacementPolicyType policies[] = {ReplacementPolicyType::CLOCK,
+                                              ReplacementPolicyType::LRU_K,
+                                              ReplacementPolicyType::TWO_Q};
+    for (const ReplacementPolicyType policy : policies) {
+      BufMgrOptions options;
+      options.maxBufs = 40;
+      options.hashPartitions = 4;
+      options.replacementPolicy = policy;
+      BufMgr resizeMgr(10, options);
+
+      for (i = 1; i <= 10; i++) resizeMgr.readPage(file, i).release();
+      resizeMgr.resize(30);
+      if (resizeMgr.size() != 30) {
+        PRINT_ERROR("ERROR :: POOL DID NOT GROW");
+      }
+      for (i = 11; i <= 30; i++) resizeMgr.readPage(file, i).release();
+      resizeMgr.clearBufStats();
+      for (i = 1; i <= 30; i++) {
+        PageGuard page = resizeMgr.readPage(file, i);
+        if (!checkPage(*page, i)) {
+          PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+        }
+        page->insertRecord("dirty");
+        page.markDirty();
+      }
+      if (resizeMgr.getBufStats().misses != 0) {
+        PRINT_ERROR("ERROR :: PAGES WERE LOST WHEN GROWING");
+      }
+
+      // Ten pinned pages cannot all fit in five frames
+      {
+        std::vector<PageGuard> pinned;
+        for (i = 1; i <= 10; i++) pinned.push_back(resizeMgr.readPage(file, i));
+        try {
+          resizeMgr.resize(5);
+          PRINT_ERROR("ERROR :: No error thrown");
+        } catch (const PagePinnedException &e) {
+        }
+        if (resizeMgr.size() != 30) {
+          PRINT_ERROR("ERROR :: FAILED SHRINK CHANGED THE POOL SIZE");
+        }
+      }
+
+      resizeMgr.resize(5);
+      if (resizeMgr.size() != 5) {
+        PRINT_ERROR("ERROR :: POOL DID NOT SHRINK");
+      }
+      for (i = 1; i <= 30; i++) {
+        PageGuard page = resizeMgr.readPage(file, i);
+        if (!checkPage(*page, i) || page->getRecord({i, 2}) != "dirty") {
+          PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+        }
+      }
+      try {
+        resizeMgr.resize(41);
+        PRINT_ERROR("ERROR :: No error thrown");
+      } catch (const BufferExceededException &e) {
+      }
+
+      // Readers keep going while the pool changes size under them
+      std::atomic<bool> stop(false);
+      std::atomic<bool> mismatch(false);
+      std::vector<std::thread> readers;
+      for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&, t]() {
+          for (PageId j = 0; !stop; j++) {
+            const PageId pageNo = 1 + (j * 7 + t) % 30;
+            PageGuard page = resizeMgr.readPage(file, pageNo);
+            if (!checkPage(*page, pageNo)) mismatch = true;
+          }
+        });
+      }
+      const std::uint32_t sizes[] = {40, 8, 25, 5, 12};
+      for (int round = 0; round < 20; round++) {
+        try {
+          resizeMgr.resize(sizes[round % 5]);
+        } catch (const PagePinnedException &e) {
+          // A reader held on to its page for too long
+        }
+      }
+      stop = true;
+      for (std::thread &reader : readers) reader.join();
+      if (mismatch) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+      resizeMgr.flushFile(file);
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 29 passed"
+            << "\n";
+}
+
+void test30() {
+  // A NUMA partitioned pool uses free frames of every partition before it
+  // evicts, brings pages homed by hash back to the same partition, and keeps
+  // working as it grows and under concurrent readers
+  const std::string filename = "test.30";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    for (i = 1; i <= 40; i++) {
+      Page new_page = file.allocatePage();
+      sprintf(tmpbuf, "numa %u", i);
+      new_page.insertRecord(tmpbuf);
+      file.writePage(new_page);
+    }
+    const auto checkPage = [](const Page &page, const PageId pageNo) {
+      char expected[100];
+      sprintf(expected, "numa %u", pageNo);
+      return page.getRecord({pageNo, 1}) == expected;
+    };
+
+    const NumaHoming homings[] = {NumaHoming::HASH, NumaHoming::FIRST_TOUCH};
+    for (const NumaHoming homing : homings) {
+      BufMgrOptions options;
+      options.numaNodes = 2;
+      options.numaHoming = homing;
+      options.maxBufs = 40;
+      BufMgr numaMgr(20, options);
+
+      std::vector<std::uint32_t> nodes(21);
+      for (i = 1; i <= 20; i++) {
+        PageGuard page = numaMgr.readPage(file, i);
+        if (!checkPage(*page, i)) {
+          PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+        }
+        nodes[i] = numaMgr.numaNodeOf(page.get());
+      }
+      if (numaMgr.getBufStats().evictions != 0) {
+        PRINT_ERROR("ERROR :: PAGE EVICTED WHILE FRAMES WERE FREE");
+      }
+
+      if (homing == NumaHoming::HASH) {
+        // Half the pages at a time, so that every home partition has room
+        numaMgr.flushFile(file);
+        for (i = 1; i <= 20; i += 2) {
+          PageGuard page = numaMgr.readPage(file, i);
+          if (numaMgr.numaNodeOf(page.get()) != nodes[i]) {
+            PRINT_ERROR("ERROR :: PAGE CAME BACK TO ANOTHER PARTITION");
+          }
+        }
+      }
+
+      numaMgr.resize(40);
+      for (i = 1; i <= 40; i++) numaMgr.readPage(file, i).release();
+      numaMgr.clearBufStats();
+      for (i = 1; i <= 40; i++) numaMgr.readPage(file, i).release();
+      if (numaMgr.getBufStats().misses != 0) {
+        PRINT_ERROR("ERROR :: PAGES WERE LOST WHEN GROWING");
+      }
+
+      numaMgr.resize(10);
+      std::atomic<bool> mismatch(false);
+      std::vector<std::thread> readers;
+      for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&, t]() {
+          for (PageId j = 0; j < 2000; j++) {
+            const PageId pageNo = 1 + (j * 7 + t) % 40;
+            PageGuard page = numaMgr.readPage(file, pageNo);
+            if (!checkPage(*page, pageNo)) mismatch = true;
+          }
+        });
+      }
+      for (std::thread &reader : readers) reader.join();
+      if (mismatch) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+      numaMgr.flushFile(file);
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 30 passed"
+            << "\n";
+}
+
+void test31() {
+  // The pages in the pool are written to the warm cache file when a manager
+  // goes away; the next manager prefetches the hottest of them that fit
+  const std::string filename = "test.31";
+  const std::string warmCacheFile = "test.31.warm";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+  std::remove(warmCacheFile.c_str());
+
+  {
+    File file = File::create(filename);
+    for (i = 1; i <= 30; i++) {
+      Page new_page = file.allocatePage();
+      sprintf(tmpbuf, "warm %u", i);
+      new_page.insertRecord(tmpbuf);
+      file.writePage(new_page);
+    }
+
+    BufMgrOptions options;
+    options.replacementPolicy = ReplacementPolicyType::LRU_K;
+    options.warmCacheFile = warmCacheFile;
+    {
+      BufMgr coldMgr(10, options);
+      if (coldMgr.getBufStats().diskreads != 0) {
+        PRINT_ERROR("ERROR :: PAGES LOADED WITHOUT A WARM CACHE FILE");
+      }
+      for (i = 1; i <= 10; i++) coldMgr.readPage(file, i).release();
+      for (i = 6; i <= 10; i++) coldMgr.readPage(file, i).release();
+    }
+
+    std::ifstream in(warmCacheFile);
+    std::string header;
+    if (!std::getline(in, header) || header != "badgerdb-warm-cache 1") {
+      PRINT_ERROR("ERROR :: WARM CACHE FILE NOT WRITTEN");
+    }
+    in.close();
+
+    // Only the five pages read twice fit, and they come in with one read
+    {
+      BufMgr warmMgr(5, options);
+      if (warmMgr.getBufStats().diskreads != 5) {
+        PRINT_ERROR("ERROR :: WRONG NUMBER OF PAGES LOADED");
+      }
+      for (i = 6; i <= 10; i++) {
+        PageGuard page = warmMgr.readPage(file, i);
+        sprintf(tmpbuf, "warm %u", i);
+        if (page->getRecord({i, 1}) != tmpbuf) {
+          PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+        }
+      }
+      const BufStats stats = warmMgr.getBufStats();
+      if (stats.hits != 5 || stats.misses != 0) {
+        PRINT_ERROR("ERROR :: HOT PAGES NOT LOADED");
+      }
+    }
+  }
+
+  // Entries for files that no longer exist are skipped
+  File::remove(filename);
+  {
+    BufMgrOptions options;
+    options.warmCacheFile = warmCacheFile;
+    BufMgr staleMgr(5, options);
+    if (staleMgr.getBufStats().diskreads != 0) {
+      PRINT_ERROR("ERROR :: PAGES LOADED FROM A REMOVED FILE");
+    }
+  }
+  std::remove(warmCacheFile.c_str());
+
+  std::cout << "Test 31 passed"
+            << "\n";
+}
+
+void test32() {
+  // Changes made through the write-ahead log are replayed into pages that
+  // never made it to disk, the log is durable before a page it changed is
+  // written back, and concurrent commits share log syncs
+  const std::string filename = "test.32";
+  const std::string logFilename = "test.32.log";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+  std::remove(logFilename.c_str());
+
+  {
+    File file = File::create(filename);
+    for (i = 1; i <= 10; i++) {
+      Page new_page = file.allocatePage();
+      file.writePage(new_page);
+    }
+
+    RecordId updated;
+    RecordId deleted;
+    {
+      LogManager log(logFilename);
+      BufMgrOptions options;
+      options.log = &log;
+      BufMgr logMgr(3, options);
+
+      // Changes to pages 1 and 2, which stay pinned and are lost with the
+      // buffer manager
+      const TxnId txn = log.begin();
+      PageGuard first = logMgr.readPage(file, 1);
+      deleted = log.insertRecord(txn, file, *first, "deleted");
+      updated = log.insertRecord(txn, file, *first, "before");
+      log.updateRecord(txn, file, *first, updated, "after");
+      log.deleteRecord(txn, file, *first, deleted);
+      first.markDirty();
+      PageGuard second = logMgr.readPage(file, 2);
+      log.insertRecord(txn, file, *second, "second");
+      second.markDirty();
+      log.commit(txn);
+      if (log.durableLsn() != log.endLsn()) {
+        PRINT_ERROR("ERROR :: COMMIT NOT DURABLE");
+      }
+
+      // Evicting a page changed after the commit forces the log out first
+      {
+        PageGuard page = logMgr.readPage(file, 3);
+        log.insertRecord(log.begin(), file, *page, "third");
+        page.markDirty();
+      }
+      const Lsn pageLsn = log.endLsn();
+      logMgr.readPage(file, 4).release();
+      if (log.durableLsn() < pageLsn) {
+        PRINT_ERROR("ERROR :: PAGE WRITTEN BEFORE ITS LOG RECORD");
+      }
+
+      std::vector<std::thread> committers;
+      for (int t = 0; t < 8; t++) {
+        committers.emplace_back([&log]() {
+          for (int j = 0; j < 50; j++) log.commit(log.begin());
+        });
+      }
+      for (std::thread &committer : committers) committer.join();
+      if (log.syncCount() > 8 * 50 + 2) {
+        PRINT_ERROR("ERROR :: TOO MANY LOG SYNCS");
+      }
+    }
+
+    // Page 3 reached disk; pages 1 and 2 did not
+    if (file.readPage(1).getFreeSpace() != Page().getFreeSpace() ||
+        file.readPage(3).lsn() == 0) {
+      PRINT_ERROR("ERROR :: WRONG PAGES WRITTEN BACK");
+    }
+
+    // A torn record at the end of the log is cut off
+    {
+      std::ofstream torn(logFilename, std::ios::app | std::ios::binary);
+      torn << "torn";
+    }
+
+    for (int round = 0; round < 2; round++) {
+      LogManager log(logFilename);
+      BufMgr recoveryMgr(3);
+      const std::uint64_t replayed = log.recover(recoveryMgr);
+      if (replayed != (round == 0 ? 5 : 0)) {
+        PRINT_ERROR("ERROR :: WRONG NUMBER OF CHANGES REPLAYED");
+      }
+      PageGuard first = recoveryMgr.readPage(file, 1);
+      PageGuard second = recoveryMgr.readPage(file, 2);
+      PageGuard third = recoveryMgr.readPage(file, 3);
+      if (first->getRecord(updated) != "after" ||
+          second->getRecord({2, 1}) != "second" ||
+          third->getRecord({3, 1}) != "third") {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+      try {
+        first->getRecord(deleted);
+        PRINT_ERROR("ERROR :: DELETED RECORD STILL THERE");
+      } catch (const InvalidRecordException &e) {
+      }
+    }
+  }
+  File::remove(filename);
+  std::remove(logFilename.c_str());
+
+  std::cout << "Test 32 passed"
+            << "\n";
+}
+
+void test33() {
+  // A checkpoint writes back the pages dirty or pinned when it starts while
+  // readers keep using the file, and recovery starts after it
+  const std::string filename = "test.33";
+  const std::string logFilename = "test.33.log";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+  std::remove(logFilename.c_str());
+
+  {
+    File file = File::create(filename);
+    for (i = 1; i <= 20; i++) {
+      Page new_page = file.allocatePage();
+      file.writePage(new_page);
+    }
+
+    {
+      LogManager log(logFilename);
+      BufMgrOptions options;
+      options.log = &log;
+      options.checkpointBatchPages = 2;
+      BufMgr checkpointMgr(10, options);
+
+      const TxnId txn = log.begin();
+      for (i = 1; i <= 5; i++) {
+        PageGuard page = checkpointMgr.readPage(file, i);
+        sprintf(tmpbuf, "checkpoint %u", i);
+        log.insertRecord(txn, file, *page, tmpbuf);
+        page.markDirty();
+      }
+      log.commit(txn);
+
+      // Page 6 is changed and still pinned when the checkpoint starts
+      std::atomic<bool> changed(false);
+      std::thread writer([&]() {
+        PageGuard page = checkpointMgr.readPage(file, 6);
+        log.insertRecord(log.begin(), file, *page, "checkpoint 6");
+        page.markDirty();
+        changed = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      });
+      while (!changed) std::this_thread::yield();
+
+      std::atomic<bool> done(false);
+      std::atomic<bool> failed(false);
+      std::thread reader([&]() {
+        PageId pageNo = 0;
+        while (!done) {
+          try {
+            checkpointMgr.readPage(file, pageNo % 10 + 1).release();
+          } catch (...) {
+            failed = true;
+          }
+          pageNo++;
+        }
+      });
+      if (checkpointMgr.checkpoint() == 0) {
+        PRINT_ERROR("ERROR :: NO CHECKPOINT RECORD");
+      }
+      done = true;
+      reader.join();
+      writer.join();
+      if (failed) {
+        PRINT_ERROR("ERROR :: READER FAILED DURING CHECKPOINT");
+      }
+      for (i = 1; i <= 6; i++) {
+        sprintf(tmpbuf, "checkpoint %u", i);
+        if (file.readPage(i).getRecord({i, 1}) != tmpbuf) {
+          PRINT_ERROR("ERROR :: PAGE NOT WRITTEN BY CHECKPOINT");
+        }
+      }
+
+      // A change after the checkpoint, lost with the buffer manager
+      PageGuard page = checkpointMgr.readPage(file, 7);
+      log.insertRecord(log.begin(), file, *page, "checkpoint 7");
+      page.markDirty();
+      log.flush(log.endLsn());
+    }
+
+    {
+      LogManager log(logFilename);
+      BufMgr recoveryMgr(10);
+      if (log.recover(recoveryMgr) != 1) {
+        PRINT_ERROR("ERROR :: REPLAYED CHANGES BEFORE THE CHECKPOINT");
+      }
+      PageGuard page = recoveryMgr.readPage(file, 7);
+      if (page->getRecord({7, 1}) != "checkpoint 7") {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+    }
+
+    // The background checkpointer writes changed pages on its own
+    {
+      LogManager log(logFilename);
+      BufMgrOptions options;
+      options.log = &log;
+      options.checkpointIntervalMs = 5;
+      BufMgr checkpointMgr(10, options);
+      {
+        PageGuard page = checkpointMgr.readPage(file, 8);
+        log.insertRecord(log.begin(), file, *page, "checkpoint 8");
+        page.markDirty();
+      }
+      for (int tries = 0; tries < 400 && file.readPage(8).lsn() == 0;
+           tries++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      }
+      if (file.readPage(8).lsn() == 0) {
+        PRINT_ERROR("ERROR :: PAGE NOT WRITTEN BY CHECKPOINTER");
+      }
+    }
+  }
+  File::remove(filename);
+  std::remove(logFilename.c_str());
+
+  std::cout << "Test 33 passed"
+            << "\n";
+}
+
+void test34() {
+  // Pages of a compressed file read back the same through the file, its
+  // mapping and the buffer manager, take less disk space, and survive
+  // reopening, rewrites that do not compress and deletes
+  const std::string filename = "test.34";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  const auto checkPage = [](const Page &page, const PageId pageNo) {
+    for (SlotId slot = 1; slot <= 20; slot++) {
+      sprintf(tmpbuf, "compressed page %u record %u", pageNo, slot);
+      if (page.getRecord({pageNo, slot}) != tmpbuf) return false;
+    }
+    return true;
+  };
+  std::string noise(Page::DATA_SIZE * 3 / 4, ' ');
+  for (char &c : noise) c = static_cast<char>(rand());
+
+  {
+    File file =
+        File::create(filename, true /* checksums */, true /* compressed */);
+    for (i = 1; i <= 40; i++) {
+      Page new_page = file.allocatePage();
+      for (SlotId slot = 1; slot <= 20; slot++) {
+        sprintf(tmpbuf, "compressed page %u record %u", i, slot);
+        new_page.insertRecord(tmpbuf);
+      }
+      file.writePage(new_page);
+    }
+    struct stat status;
+    if (Page::SIZE > Page::ALIGNMENT &&
+        (stat(filename.c_str(), &status) != 0 ||
+         std::uint64_t(status.st_blocks) * 512 > 41 * Page::SIZE * 3 / 4)) {
+      PRINT_ERROR("ERROR :: COMPRESSED FILE TAKES FULL SPACE");
+    }
+
+    // A page that does not compress is stored as it is
+    Page noisy = file.readPage(7);
+    noisy.deleteRecord({7, 1});
+    noisy.insertRecord(noise);
+    file.writePage(noisy);
+    file.deletePage(9);
+  }
+
+  {
+    File file = File::open(filename);
+    if (!file.isCompressed() || !file.hasChecksums()) {
+      PRINT_ERROR("ERROR :: FILE FLAGS WERE NOT PERSISTED");
+    }
+    PageId count = 0;
+    for (FileIterator iter = file.begin(); iter != file.end(); ++iter) {
+      const PageId pageNo = (*iter).page_number();
+      const Page page = file.readPage(pageNo);
+      if (pageNo == 7 ? page.getRecord({7, 1}) != noise
+                      : !checkPage(page, pageNo)) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+      count++;
+    }
+    if (count != 39) {
+      PRINT_ERROR("ERROR :: USED PAGE LIST IS INCONSISTENT");
+    }
+
+    file.map();
+    if (!checkPage(file.mappedPage(40), 40)) {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+
+    // Prefetched runs and single reads both decompress into the frames, and
+    // flushed pages are compressed again
+    BufMgrOptions options;
+    options.ioEngine = IoEngineType::THREAD_POOL;
+    BufMgr compressedMgr(16, options);
+    compressedMgr.prefetch(file, 1, 4);
+    for (i = 1; i <= 12; i++) {
+      if (i == 7 || i == 9) continue;
+      PageGuard page = compressedMgr.readPage(file, i);
+      if (!checkPage(*page, i)) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+      page->updateRecord({i, 20}, "updated");
+      page.markDirty();
+    }
+    if (compressedMgr.getBufStats().hits != 4) {
+      PRINT_ERROR("ERROR :: PREFETCHED PAGES NOT FOUND");
+    }
+    compressedMgr.flushFile(file);
+    if (file.readPage(12).getRecord({12, 20}) != "updated" ||
+        file.readPage(12).getRecord({12, 19}) !=
+            "compressed page 12 record 19") {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 34 passed"
+            << "\n";
+}
+
+void test35() {
+  // Evicted pages come back from the victim cache without disk reads, with
+  // the changes made to them, and disposed of or flushed pages do not
+  const std::string filename = "test.35";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    for (i = 1; i <= 12; i++) {
+      Page new_page = file.allocatePage();
+      sprintf(tmpbuf, "victim page %u", i);
+      new_page.insertRecord(tmpbuf);
+      file.writePage(new_page);
+    }
+
+    BufMgrOptions options;
+    options.victimCacheBytes = 1 << 20;
+    BufMgr victimMgr(4, options);
+    for (i = 1; i <= 12; i++) {
+      PageGuard page = victimMgr.readPage(file, i);
+      if (i % 2 == 0) {
+        page->updateRecord({i, 1}, "updated");
+        page.markDirty();
+      }
+    }
+    victimMgr.clearBufStats();
+    for (i = 1; i <= 12; i++) {
+      PageGuard page = victimMgr.readPage(file, i);
+      sprintf(tmpbuf, "victim page %u", i);
+      if (page->getRecord({i, 1}) != (i % 2 == 0 ? "updated" : tmpbuf)) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+    }
+    BufStats stats = victimMgr.getBufStats();
+    if (stats.diskreads != 0 || stats.victimHits + stats.hits != 12 ||
+        stats.victimHits < 8) {
+      PRINT_ERROR("ERROR :: EVICTED PAGES NOT FOUND IN VICTIM CACHE");
+    }
+
+    // Page 1 was evicted again by the second pass
+    victimMgr.disposePage(file, 1);
+    try {
+      victimMgr.readPage(file, 1);
+      PRINT_ERROR("ERROR :: DISPOSED PAGE FOUND IN VICTIM CACHE");
+    } catch (const InvalidPageException &e) {
+    }
+
+    victimMgr.flushFile(file);
+    victimMgr.clearBufStats();
+    victimMgr.readPage(file, 2).release();
+    victimMgr.readPage(file, 3).release();
+    if (victimMgr.getBufStats().diskreads != 2) {
+      PRINT_ERROR("ERROR :: FLUSHED PAGES FOUND IN VICTIM CACHE");
+    }
+    victimMgr.flushFile(file);
+
+    // Pages that do not fit under the cap are dropped
+    options.victimCacheBytes = 16;
+    BufMgr tinyMgr(4, options);
+    for (int pass = 0; pass < 2; pass++) {
+      for (i = 2; i <= 12; i++) {
+        tinyMgr.readPage(file, i).release();
+      }
+    }
+    if (tinyMgr.getBufStats().victimHits != 0) {
+      PRINT_ERROR("ERROR :: VICTIM CACHE EXCEEDED ITS CAP");
+    }
+    tinyMgr.flushFile(file);
+  }
+  File::remove(filename);
+
+  std::cout << "Test 35 passed"
+            << "\n";
+}
+
+void test36() {
+  // B+-tree indexes find entries inserted in any order or bulk loaded, keep
+  // them in key order for range scans, and read one node per level
+  const std::string intName = "test.36";
+  const std::string stringName = "test.37";
+  for (const std::string &filename : {intName, stringName}) {
+    try {
+      File::remove(filename);
+    } catch (const FileNotFoundException &e) {
+    }
+  }
+
+  const int count = 20000;
+  const auto ridOf = [](const int key) {
+    return RecordId{PageId(key / 100 + 1), SlotId(key % 100 + 1)};
+  };
+  // Long string keys that fill a tree at least three levels deep at any
+  // page size
+  const int perNode = Page::SIZE / 408;
+  const int stringCount = 2 * perNode * perNode;
+  char midKey[32];
+  sprintf(midKey, "key %05da", stringCount / 2);
+  {
+    // Clean pages stay in the pool, and their files open, until the
+    // manager is destroyed
+    BufMgr indexMgr(16);
+    {
+      File file = File::create(intName);
+      BTreeIndex index =
+          BTreeIndex::create(indexMgr, file, IndexKeyType::INTEGER);
+      for (int n = 0; n < count; n++) {
+        const int key = n * 7919 % count - count / 2;
+        if (!index.insertEntry(key, ridOf(key + count / 2))) {
+          PRINT_ERROR("ERROR :: NEW ENTRY FOUND IN INDEX");
+        }
+      }
+      if (index.insertEntry(0, ridOf(count / 2)) ||
+          !index.insertEntry(0, ridOf(0)) || index.size() != count + 1 ||
+          index.height() < 2) {
+        PRINT_ERROR("ERROR :: INDEX HAS WRONG ENTRIES");
+      }
+      const std::vector<RecordId> both = index.lookup(0);
+      if (both.size() != 2 || both[0] != ridOf(0) ||
+          both[1] != ridOf(count / 2)) {
+        PRINT_ERROR("ERROR :: LOOKUP RETURNED WRONG RECORDS");
+      }
+
+      // A point lookup reads the nodes on one path
+      indexMgr.clearBufStats();
+      if (index.lookup(-123).size() != 1 || !index.lookup(count).empty()) {
+        PRINT_ERROR("ERROR :: LOOKUP RETURNED WRONG RECORDS");
+      }
+      if (indexMgr.getBufStats().accesses != 2 * index.height()) {
+        PRINT_ERROR("ERROR :: LOOKUP READ MORE THAN ONE PATH");
+      }
+
+      int expected = 100;
+      for (BTreeIterator iter = index.lowerBound(100);
+           iter != index.upperBound(199); ++iter) {
+        if (iter.intKey() != expected ||
+            *iter != ridOf(expected + count / 2)) {
+          PRINT_ERROR("ERROR :: RANGE SCAN OUT OF ORDER");
+        }
+        expected++;
+      }
+      if (expected != 200) {
+        PRINT_ERROR("ERROR :: RANGE SCAN MISSED ENTRIES");
+      }
+
+      for (int key = -count / 2; key < 0; key++) {
+        if (!index.removeEntry(key, ridOf(key + count / 2))) {
+          PRINT_ERROR("ERROR :: ENTRY NOT REMOVED");
+        }
+      }
+      if (index.removeEntry(-1, ridOf(count / 2 - 1)) ||
+          index.begin().intKey() != 0 || index.size() != count / 2 + 1) {
+        PRINT_ERROR("ERROR :: INDEX HAS WRONG ENTRIES");
+      }
+      try {
+        index.insertEntry("string", ridOf(1));
+        PRINT_ERROR("ERROR :: KEY OF WRONG TYPE ACCEPTED");
+      } catch (const BadIndexInfoException &e) {
+      }
+      indexMgr.flushFile(file);
+    }
+
+    {
+      // Long keys make for a deep tree
+      File file = File::create(stringName);
+      BTreeIndex index =
+          BTreeIndex::create(indexMgr, file, IndexKeyType::STRING, 400);
+      std::vector<std::pair<std::string, RecordId>> sorted;
+      for (int key = 0; key < stringCount; key++) {
+        sprintf(tmpbuf, "key %05d", key);
+        sorted.push_back(std::make_pair(std::string(tmpbuf), ridOf(key)));
+      }
+      std::swap(sorted[10].second, sorted[11].second);
+      sorted[11].first = sorted[10].first;
+      try {
+        std::vector<std::pair<std::string, RecordId>> unsorted(sorted);
+        std::swap(unsorted[0], unsorted[1]);
+        index.bulkLoad(unsorted);
+        PRINT_ERROR("ERROR :: UNSORTED BULK LOAD ACCEPTED");
+      } catch (const BadIndexInfoException &e) {
+      }
+      index.bulkLoad(sorted);
+      if (index.size() != std::uint64_t(stringCount) || index.height() < 3 ||
+          index.lookup("key 00010").size() != 2) {
+        PRINT_ERROR("ERROR :: BULK LOAD HAS WRONG ENTRIES");
+      }
+      index.insertEntry(midKey, ridOf(1));
+      index.insertEntry("a", ridOf(2));
+
+      std::string previous;
+      std::uint64_t scanned = 0;
+      for (BTreeIterator iter = index.begin(); iter != index.end(); ++iter) {
+        if (iter.stringKey() < previous) {
+          PRINT_ERROR("ERROR :: SCAN OUT OF ORDER");
+        }
+        previous = iter.stringKey();
+        scanned++;
+      }
+      if (scanned != std::uint64_t(stringCount) + 2 ||
+          previous != sorted.back().first) {
+        PRINT_ERROR("ERROR :: SCAN MISSED ENTRIES");
+      }
+      indexMgr.flushFile(file);
+    }
+
+    {
+      // The indexes come back from their files
+      File file = File::open(intName);
+      BTreeIndex index = BTreeIndex::open(indexMgr, file);
+      if (index.keyType() != IndexKeyType::INTEGER ||
+          index.size() != count / 2 + 1 || index.lookup(4321).size() != 1) {
+        PRINT_ERROR("ERROR :: INDEX NOT PERSISTED");
+      }
+      File strings = File::open(stringName);
+      BTreeIndex stringIndex = BTreeIndex::open(indexMgr, strings);
+      if (stringIndex.keyLength() != 400 ||
+          stringIndex.size() != std::uint64_t(stringCount) + 2 ||
+          stringIndex.lookup(midKey).size() != 1) {
+        PRINT_ERROR("ERROR :: INDEX NOT PERSISTED");
+      }
+      indexMgr.flushFile(file);
+      indexMgr.flushFile(strings);
+    }
+  }
+  File::remove(intName);
+  File::remove(stringName);
+
+  std::cout << "Test 36 passed"
+            << "\n";
+}
+
+void test37() {
+  // Hash indexes grow a bucket at a time, find entries with about one page
+  // read per lookup and come back from their files
+  const std::string intName = "test.38";
+  const std::string stringName = "test.39";
+  for (const std::string &filename : {intName, stringName}) {
+    try {
+      File::remove(filename);
+    } catch (const FileNotFoundException &e) {
+    }
+  }
+
+  // Enough entries for about 20 buckets at any page size
+  const int count = 2500 * (Page::SIZE / 1024);
+  const auto ridOf = [](const int key) {
+    return RecordId{PageId(key / 100 + 1), SlotId(key % 100 + 1)};
+  };
+  {
+    BufMgr indexMgr(64);
+    {
+      File file = File::create(intName);
+      HashIndex index =
+          HashIndex::create(indexMgr, file, IndexKeyType::INTEGER);
+      std::uint32_t buckets = index.buckets();
+      for (int key = 0; key < count; key++) {
+        if (!index.insertEntry(key, ridOf(key))) {
+          PRINT_ERROR("ERROR :: NEW ENTRY FOUND IN INDEX");
+        }
+        // Never more than one bucket is added per insert
+        if (index.buckets() > buckets + 1) {
+          PRINT_ERROR("ERROR :: INDEX REHASHED AT ONCE");
+        }
+        buckets = index.buckets();
+      }
+      if (index.insertEntry(7, ridOf(7)) || !index.insertEntry(7, ridOf(8)) ||
+          index.size() != count + 1 || index.buckets() < 20) {
+        PRINT_ERROR("ERROR :: INDEX HAS WRONG ENTRIES");
+      }
+
+      indexMgr.clearBufStats();
+      for (int key = 0; key < count; key += 10) {
+        const std::vector<RecordId> found = index.lookup(key);
+        if (found.size() != (key == 7 ? 2u : 1u) || found[0] != ridOf(key)) {
+          PRINT_ERROR("ERROR :: LOOKUP RETURNED WRONG RECORDS");
+        }
+      }
+      if (!index.lookup(-1).empty() ||
+          indexMgr.getBufStats().accesses > (count / 10) * 6 / 5) {
+        PRINT_ERROR("ERROR :: LOOKUPS READ TOO MANY PAGES");
+      }
+
+      for (int key = 0; key < count; key += 2) {
+        if (!index.removeEntry(key, ridOf(key))) {
+          PRINT_ERROR("ERROR :: ENTRY NOT REMOVED");
+        }
+      }
+      if (index.removeEntry(0, ridOf(0)) || !index.lookup(0).empty() ||
+          index.lookup(1).size() != 1 || index.size() != count / 2 + 1) {
+        PRINT_ERROR("ERROR :: INDEX HAS WRONG ENTRIES");
+      }
+      indexMgr.flushFile(file);
+    }
+
+    {
+      File file = File::create(stringName);
+      HashIndex index =
+          HashIndex::create(indexMgr, file, IndexKeyType::STRING, 24);
+      for (int key = 0; key < 2000; key++) {
+        sprintf(tmpbuf, "user %d", key);
+        index.insertEntry(std::string(tmpbuf), ridOf(key));
+      }
+      try {
+        index.insertEntry(std::string(25, 'x'), ridOf(0));
+        PRINT_ERROR("ERROR :: OVERLONG KEY ACCEPTED");
+      } catch (const BadIndexInfoException &e) {
+      }
+      indexMgr.flushFile(file);
+    }
+
+    {
+      File file = File::open(intName);
+      HashIndex index = HashIndex::open(indexMgr, file);
+      if (index.size() != count / 2 + 1 || index.lookup(4321).size() != 1 ||
+          !index.lookup(4320).empty()) {
+        PRINT_ERROR("ERROR :: INDEX NOT PERSISTED");
+      }
+      File strings = File::open(stringName);
+      HashIndex stringIndex = HashIndex::open(indexMgr, strings);
+      const std::vector<RecordId> found = stringIndex.lookup("user 1234");
+      if (found.size() != 1 || found[0] != ridOf(1234)) {
+        PRINT_ERROR("ERROR :: INDEX NOT PERSISTED");
+      }
+      try {
+        BTreeIndex::open(indexMgr, strings);
+        PRINT_ERROR("ERROR :: HASH INDEX OPENED AS B+-TREE");
+      } catch (const BadIndexInfoException &e) {
+      }
+      indexMgr.flushFile(file);
+      indexMgr.flushFile(strings);
+    }
+  }
+  File::remove(intName);
+  File::remove(stringName);
+
+  std::cout << "Test 37 passed"
+            << "\n";
+}
+
+void test38() {
+  // Filters and aggregates over the minipages of columnar pages match a
+  // row at a time evaluation, and the layout survives a trip to disk
+  const std::string filename = "test.40";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    BufMgr paxMgr(4);
+    PageId widePageNo;
+    PageId narrowPageNo;
+    {
+      // 30 columns of which a scan reads 2, and 2 columns with many rows
+      std::vector<PaxType> wideColumns;
+      for (int c = 0; c < 30; c++) {
+        wideColumns.push_back(c % 3 == 0 ? PaxType::INT64 : PaxType::INT32);
+      }
+      PageGuard wide = paxMgr.allocPage(file);
+      PageGuard narrow = paxMgr.allocPage(file);
+      widePageNo = wide->page_number();
+      narrowPageNo = narrow->page_number();
+      PaxPage widePax = PaxPage::format(*wide, wideColumns);
+      PaxPage narrowPax =
+          PaxPage::format(*narrow, {PaxType::INT32, PaxType::INT64});
+      std::int64_t row[30];
+      while (true) {
+        for (int c = 0; c < 30; c++) {
+          row[c] = static_cast<std::int64_t>(rand() % 2001) - 1000;
+          if (c % 3 == 0) row[c] *= std::int64_t(1) << 40;
+        }
+        if (!widePax.appendRow(row)) break;
+      }
+      while (narrowPax.appendRow(row)) {
+        row[0] = rand() % 100;
+        row[1] = static_cast<std::int64_t>(rand()) << 20;
+      }
+      if (widePax.rowCount() != widePax.capacity() ||
+          narrowPax.rowCount() < 256 || widePax.columnType(3) !=
+                                             PaxType::INT64) {
+        PRINT_ERROR("ERROR :: COLUMNAR PAGE HOLDS WRONG NUMBER OF ROWS");
+      }
+      wide.markDirty();
+      narrow.markDirty();
+    }
+    paxMgr.flushFile(file);
+
+    for (const PageId pageNo : {widePageNo, narrowPageNo}) {
+      PageGuard page = paxMgr.readPage(file, pageNo);
+      const PaxPage pax(*page);
+      const bool wide = pax.numColumns() == 30;
+      const std::uint32_t filterColumn = wide ? 4 : 0;
+      const std::uint32_t sumColumn = wide ? 3 : 1;
+      const std::int64_t low = wide ? -200 : 10;
+      const std::int64_t high = wide ? 700 : 60;
+
+      PaxSelection all(pax.rowCount());
+      PaxSelection selection(pax.rowCount());
+      const std::uint32_t selected =
+          pax.select(filterColumn, low, high, selection);
+      if (wide) pax.select(5, 0, 1000, selection);
+      const PaxAggregate total = pax.aggregate(sumColumn, all);
+      const PaxAggregate filtered = pax.aggregate(sumColumn, selection);
+
+      std::uint32_t expectedSelected = 0;
+      std::uint32_t expectedPositive = 0;
+      std::uint64_t expectedCount = 0;
+      std::int64_t expectedSum = 0;
+      std::int64_t expectedTotal = 0;
+      std::int64_t expectedMax = std::numeric_limits<std::int64_t>::min();
+      for (std::uint32_t r = 0; r < pax.rowCount(); r++) {
+        const std::int64_t value = pax.value(r, sumColumn);
+        expectedTotal += value;
+        if (value >= 0) expectedPositive++;
+        const std::int64_t key = pax.value(r, filterColumn);
+        if (key < low || key > high) continue;
+        expectedSelected++;
+        if (wide && (pax.value(r, 5) < 0 || pax.value(r, 5) > 1000)) continue;
+        if (!selection.selected(r)) {
+          PRINT_ERROR("ERROR :: FILTER DROPPED A ROW");
+        }
+        expectedCount++;
+        expectedSum += value;
+        expectedMax = std::max(expectedMax, value);
+      }
+      if (selected != expectedSelected || filtered.count != expectedCount ||
+          selection.count() != expectedCount ||
+          filtered.sum != expectedSum ||
+          filtered.max != (expectedCount == 0 ? 0 : expectedMax) ||
+          total.count != pax.rowCount() || total.sum != expectedTotal) {
+        PRINT_ERROR("ERROR :: COLUMNAR KERNELS RETURNED WRONG RESULTS");
+      }
+      PaxSelection positive(pax.rowCount());
+      if (pax.select(sumColumn, 0, std::numeric_limits<std::int64_t>::max(),
+                     positive) != expectedPositive) {
+        PRINT_ERROR("ERROR :: COLUMNAR KERNELS RETURNED WRONG RESULTS");
+      }
+      if (pax.select(filterColumn, std::int64_t(1) << 40,
+                     std::int64_t(1) << 41, all) != 0 ||
+          pax.aggregate(sumColumn, all).count != 0) {
+        PRINT_ERROR("ERROR :: COLUMNAR KERNELS RETURNED WRONG RESULTS");
+      }
+    }
+
+    PageGuard slotted = paxMgr.allocPage(file);
+    slotted->insertRecord("not columnar");
+    try {
+      PaxPage pax(*slotted);
+      PRINT_ERROR("ERROR :: SLOTTED PAGE READ AS COLUMNAR");
+    } catch (const PageFormatException &e) {
+    }
+    slotted.release();
+    paxMgr.flushFile(file);
+  }
+  File::remove(filename);
+
+  std::cout << "Test 38 passed"
+            << "\n";
+}
+
+void test39() {
+  // The trace points record hits, misses, frame allocations, file I/O and
+  // flushes, and the records can be sampled and exported
+#if BADGERDB_TRACING
+  const std::string filename = "test.41";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  Tracer &tracer = Tracer::get();
+  {
+    File file = File::create(filename);
+    BufMgr traceMgr(3);
+    tracer.clear();
+    tracer.enable(1024);
+
+    // Six dirty pages in three frames so that allocations evict dirty pages
+    std::vector<PageId> pageNos;
+    for (int i = 0; i < 6; i++) {
+      PageGuard page = traceMgr.allocPage(file);
+      page->insertRecord("traced");
+      page.markDirty();
+      pageNos.push_back(page->page_number());
+    }
+    // The last page is still in the pool and the first one is not
+    traceMgr.readPage(file, pageNos.back()).release();
+    traceMgr.readPage(file, pageNos.front()).release();
+    traceMgr.flushFile(file);
+
+    bool hit = false, miss = false, dirtyVictim = false, fileRead = false;
+    bool fileWrite = false, flush = false;
+    std::uint64_t recorded[static_cast<int>(TraceEvent::NUM_EVENTS)] = {};
+    for (const TraceRecord &record : tracer.snapshot()) {
+      recorded[static_cast<int>(record.event)]++;
+      switch (record.event) {
+        case TraceEvent::READ_HIT:
+          hit = hit || (record.fileId == file.id() &&
+                        record.pageNo == pageNos.back());
+          break;
+        case TraceEvent::READ_MISS:
+          miss = miss || (record.pageNo == pageNos.front() &&
+                          record.detail == 0);
+          break;
+        case TraceEvent::ALLOC_BUF:
+          dirtyVictim =
+              dirtyVictim ||
+              (record.detail == static_cast<std::uint8_t>(TraceVictim::DIRTY) &&
+               record.value >= 1);
+          break;
+        case TraceEvent::FILE_READ:
+          fileRead = fileRead || (record.pageNo == pageNos.front() &&
+                                  record.value == Page::SIZE);
+          break;
+        case TraceEvent::FILE_WRITE:
+          fileWrite = fileWrite || (record.fileId == file.id() &&
+                                    record.value % Page::SIZE == 0);
+          break;
+        case TraceEvent::FLUSH_FILE:
+          flush = flush || (record.fileId == file.id() && record.value >= 1);
+          break;
+        default:
+          PRINT_ERROR("ERROR :: TRACE HOLDS AN UNKNOWN EVENT");
+      }
+    }
+    if (!hit || !miss || !dirtyVictim || !fileRead || !fileWrite || !flush) {
+      PRINT_ERROR("ERROR :: TRACE MISSES AN OPERATION");
+    }
+    for (int e = 0; e < static_cast<int>(TraceEvent::NUM_EVENTS); e++) {
+      if (recorded[e] != tracer.count(static_cast<TraceEvent>(e))) {
+        PRINT_ERROR("ERROR :: TRACE TOTALS DISAGREE WITH THE RECORDS");
+      }
+    }
+
+    std::ostringstream chrome;
+    tracer.writeChromeTrace(chrome);
+    std::ostringstream prometheus;
+    tracer.writePrometheus(prometheus);
+    if (chrome.str().find("{\"traceEvents\":[") != 0 ||
+        chrome.str().find("\"name\":\"read_miss\"") == std::string::npos ||
+        prometheus.str().find("badgerdb_trace_events_total{event=\"read_hit\"}"
+                              " 1\n") == std::string::npos ||
+        prometheus.str().find("# TYPE badgerdb_trace_value_total counter") ==
+            std::string::npos) {
+      PRINT_ERROR("ERROR :: TRACE EXPORTED WRONGLY");
+    }
+
+    // Sampled threads add every operation to the totals but only some of
+    // them to the ring
+    PageGuard resident = traceMgr.readPage(file, pageNos.front());
+    tracer.clear();
+    tracer.enable(1024, 4);
+    for (int i = 0; i < 40; i++) {
+      traceMgr.readPage(file, pageNos.front()).release();
+    }
+    const std::size_t sampled = tracer.snapshot().size();
+    if (tracer.count(TraceEvent::READ_HIT) != 40 || sampled < 9 ||
+        sampled > 11) {
+      PRINT_ERROR("ERROR :: TRACE SAMPLED WRONGLY");
+    }
+
+    // Concurrent threads fill the ring, which keeps the newest records
+    tracer.clear();
+    tracer.enable(1024);
+    std::atomic<int> running(4);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+      threads.emplace_back([&]() {
+        for (int i = 0; i < 1000; i++) {
+          traceMgr.readPage(file, pageNos.front()).release();
+        }
+        running--;
+      });
+    }
+    std::vector<TraceRecord> records;
+    do {
+      records = tracer.snapshot();
+      for (const TraceRecord &record : records) {
+        if (record.event != TraceEvent::READ_HIT ||
+            record.pageNo != pageNos.front()) {
+          PRINT_ERROR("ERROR :: TRACE HOLDS A TORN RECORD");
+        }
+      }
+    } while (running > 0);
+    for (std::thread &thread : threads) {
+      thread.join();
+    }
+    // A slot may be left to a slower thread's older record, which is skipped
+    records = tracer.snapshot();
+    if (tracer.count(TraceEvent::READ_HIT) != 4000 || records.size() > 1024 ||
+        records.size() < 1024 / 2) {
+      PRINT_ERROR("ERROR :: TRACE LOST RECORDS");
+    }
+
+    // Nothing is recorded once tracing is off
+    tracer.disable();
+    traceMgr.readPage(file, pageNos.front()).release();
+    if (tracer.count(TraceEvent::READ_HIT) != 4000) {
+      PRINT_ERROR("ERROR :: TRACE RECORDED WHILE DISABLED");
+    }
+    tracer.clear();
+    resident.release();
+    traceMgr.flushFile(file);
+  }
+  File::remove(filename);
+#endif
+
+  std::cout << "Test 39 passed"
+            << "\n";
+}
+
+void test40() {
+  // Frames freed by disposals and flushes are handed out from the free list
+  // without a sweep, and a fully pinned pool is detected without one
+  const std::string filename = "test.42";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    BufMgr freeMgr(8);
+    std::vector<PageGuard> pinned;
+    for (int i = 0; i < 8; i++) {
+      pinned.push_back(freeMgr.allocPage(file));
+      pinned.back().markDirty();
+    }
+    PageGuard again = freeMgr.readPage(file, pinned[0]->page_number());
+    if (freeMgr.evictableFrames() != 0) {
+      PRINT_ERROR("ERROR :: PINNED FRAMES COUNTED AS EVICTABLE");
+    }
+    freeMgr.clearBufStats();
+    try {
+      freeMgr.allocPage(file);
+      PRINT_ERROR("ERROR :: PAGE ALLOCATED IN A FULLY PINNED POOL");
+    } catch (const BufferExceededException &e) {
+    }
+    if (freeMgr.getBufStats().sweepSteps != 0) {
+      PRINT_ERROR("ERROR :: FULLY PINNED POOL WAS SWEPT");
+    }
+    again.release();
+    std::vector<PageId> pageNos;
+    for (PageGuard &page : pinned) {
+      pageNos.push_back(page->page_number());
+      page.release();
+    }
+    if (freeMgr.evictableFrames() != 8) {
+      PRINT_ERROR("ERROR :: UNPINNED FRAMES NOT COUNTED AS EVICTABLE");
+    }
+
+    // Every frame is referenced, so the clock would have to clear them all
+    // before it could evict one
+    freeMgr.disposePage(file, pageNos[3]);
+    freeMgr.clearBufStats();
+    freeMgr.allocPage(file).markDirty();
+    BufStats stats = freeMgr.getBufStats();
+    if (stats.sweepSteps != 1 || stats.evictions != 0) {
+      PRINT_ERROR("ERROR :: DISPOSED FRAME NOT REUSED FROM THE FREE LIST");
+    }
+
+    freeMgr.flushFile(file);
+    freeMgr.clearBufStats();
+    for (int i = 0; i < 8; i++) {
+      freeMgr.allocPage(file).markDirty();
+    }
+    stats = freeMgr.getBufStats();
+    if (stats.sweepSteps != 8 || stats.evictions != 0) {
+      PRINT_ERROR("ERROR :: FLUSHED FRAMES NOT REUSED FROM THE FREE LIST");
+    }
+    freeMgr.flushFile(file);
+  }
+  File::remove(filename);
+
+  std::cout << "Test 40 passed"
+            << "\n";
+}
+
+void test41() {
+  // A batch tenant kept to a few frames cannot push out the pages of other
+  // tenants, and pages of high priority survive any amount of other work
+  const std::string metaName = "test.43";
+  const std::string batchName = "test.44";
+  const std::string tableName = "test.45";
+  for (const std::string &filename : {metaName, batchName, tableName}) {
+    try {
+      File::remove(filename);
+    } catch (const FileNotFoundException &e) {
+    }
+  }
+
+  {
+    File metaFile = File::create(metaName);
+    File batchFile = File::create(batchName);
+    File tableFile = File::create(tableName);
+    BufMgr tenantMgr(10);
+    TenantOptions metaOptions;
+    metaOptions.priority = BufferPriority::HIGH;
+    TenantOptions batchOptions;
+    batchOptions.maxFrames = 3;
+    batchOptions.priority = BufferPriority::LOW;
+    const TenantId metaTenant = tenantMgr.addTenant(metaOptions);
+    const TenantId batchTenant = tenantMgr.addTenant(batchOptions);
+    tenantMgr.setFileTenant(metaFile, metaTenant);
+    tenantMgr.setFileTenant(batchFile, batchTenant);
+
+    std::vector<PageId> metaPages;
+    std::vector<PageId> tablePages;
+    for (int i = 0; i < 2; i++) {
+      PageGuard page = tenantMgr.allocPage(metaFile);
+      page.markDirty();
+      metaPages.push_back(page->page_number());
+    }
+    for (int i = 0; i < 4; i++) {
+      PageGuard page = tenantMgr.allocPage(tableFile);
+      page.markDirty();
+      tablePages.push_back(page->page_number());
+    }
+
+    // The batch job keeps replacing its own pages
+    for (int i = 0; i < 20; i++) {
+      tenantMgr.allocPage(batchFile).markDirty();
+      if (tenantMgr.tenantFrames(batchTenant) > 3) {
+        PRINT_ERROR("ERROR :: TENANT WENT PAST ITS FRAME LIMIT");
+      }
+    }
+    tenantMgr.clearBufStats();
+    for (const PageId pageNo : tablePages) {
+      tenantMgr.readPage(tableFile, pageNo).release();
+    }
+    for (const PageId pageNo : metaPages) {
+      tenantMgr.readPage(metaFile, pageNo).release();
+    }
+    if (tenantMgr.getBufStats().misses != 0 ||
+        tenantMgr.tenantFrames(batchTenant) != 3 ||
+        tenantMgr.tenantFrames(0) != 4) {
+      PRINT_ERROR("ERROR :: BATCH TENANT EVICTED PAGES OF OTHER TENANTS");
+    }
+
+    // Work of the default tenant evicts everything but the metadata
+    for (int i = 0; i < 30; i++) {
+      tenantMgr.allocPage(tableFile).markDirty();
+    }
+    tenantMgr.clearBufStats();
+    for (const PageId pageNo : metaPages) {
+      tenantMgr.readPage(metaFile, pageNo).release();
+    }
+    if (tenantMgr.getBufStats().misses != 0 ||
+        tenantMgr.tenantFrames(metaTenant) != 2 ||
+        tenantMgr.tenantFrames(batchTenant) != 0) {
+      PRINT_ERROR("ERROR :: HIGH PRIORITY PAGES WERE EVICTED");
+    }
+
+    // Resident pages move with their file
+    tenantMgr.setFileTenant(metaFile, 0);
+    if (tenantMgr.tenantFrames(metaTenant) != 0 ||
+        tenantMgr.tenantFrames(0) != 10) {
+      PRINT_ERROR("ERROR :: PAGES DID NOT MOVE TO THE NEW TENANT");
+    }
+    try {
+      tenantMgr.setFileTenant(metaFile, 7);
+      PRINT_ERROR("ERROR :: FILE ASSIGNED TO A TENANT THAT DOES NOT EXIST");
+    } catch (const std::out_of_range &e) {
+    }
+
+    tenantMgr.flushFile(metaFile);
+    tenantMgr.flushFile(batchFile);
+    tenantMgr.flushFile(tableFile);
+  }
+  for (const std::string &filename : {metaName, batchName, tableName}) {
+    File::remove(filename);
+  }
+
+  std::cout << "Test 41 passed"
+            << "\n";
+}
+
+void test42() {
+  // Lookups that follow links from page to page overlap their reads on a
+  // single thread and find the same pages as blocking reads do
+  const std::string filename = "test.46";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  const PageId numPages = 300;
+  {
+    File file = File::create(filename);
+    BufMgr writeMgr(16);
+    for (PageId i = 1; i <= numPages; i++) {
+      PageGuard page = writeMgr.allocPage(file);
+      page->insertRecord(std::to_string((i * 7 + 3) % numPages + 1));
+      page.markDirty();
+    }
+    writeMgr.flushFile(file);
+  }
+
+  // Each lookup reads four pages, the last of which is its result
+  const int numLookups = 100;
+  std::vector<PageId> expected;
+  for (int k = 0; k < numLookups; k++) {
+    PageId pageNo = k * 3 + 1;
+    for (int hop = 0; hop < 3; hop++) {
+      pageNo = (pageNo * 7 + 3) % numPages + 1;
+    }
+    expected.push_back(pageNo);
+  }
+
+  for (const IoEngineType engine :
+       {IoEngineType::THREAD_POOL, IoEngineType::IO_URING,
+        IoEngineType::NONE}) {
+    for (const std::uint32_t frames : {6u, 48u}) {
+      File file = File::open(filename);
+      BufMgrOptions options;
+      options.ioEngine = engine;
+      BufMgr fetchMgr(frames, options);
+      PageFetcher fetcher(fetchMgr, 16);
+      std::vector<PageId> found(numLookups, PageId(Page::INVALID_NUMBER));
+      std::size_t maxInFlight = 0;
+      std::function<void(int, PageId, int)> step =
+          [&](const int lookup, const PageId pageNo, const int hops) {
+            fetcher.fetch(file, pageNo, [&, lookup, hops](PageGuard page) {
+              maxInFlight = std::max(maxInFlight, fetcher.inFlight());
+              if (hops == 0) {
+                found[lookup] = page->page_number();
+                return;
+              }
+              const PageId next = std::stoul(*page->begin());
+              page.release();
+              step(lookup, next, hops - 1);
+            });
+          };
+      for (int k = 0; k < numLookups; k++) {
+        step(k, k * 3 + 1, 3);
+      }
+      if (fetcher.run() != static_cast<std::size_t>(numLookups) * 4 ||
+          found != expected || fetcher.inFlight() != 0) {
+        PRINT_ERROR("ERROR :: FETCHED LOOKUPS FOUND THE WRONG PAGES");
+      }
+      if (engine != IoEngineType::NONE && maxInFlight < 2) {
+        PRINT_ERROR("ERROR :: FETCHES DID NOT OVERLAP");
+      }
+
+      // Fetches of a page being read share the read, and a page that does
+      // not exist fails the run once the other fetches have completed
+      int handed = 0;
+      fetcher.fetch(file, 250, [&](PageGuard page) {
+        if (page->page_number() == 250) handed++;
+      });
+      fetcher.fetch(file, numPages + 50, [&](PageGuard page) { handed += 10; });
+      fetcher.fetch(file, 250, [&](PageGuard page) {
+        if (page->page_number() == 250) handed++;
+      });
+      try {
+        fetcher.run();
+        PRINT_ERROR("ERROR :: FETCH OF A MISSING PAGE DID NOT FAIL");
+      } catch (const InvalidPageException &e) {
+      }
+      if (handed != 2 || fetchMgr.evictableFrames() != frames) {
+        PRINT_ERROR("ERROR :: FETCHES WERE NOT COMPLETED");
+      }
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 42 passed"
+            << "\n";
+}
+
+void test43() {
+  // File objects for the same file can be copied, assigned and dropped from
+  // many threads at once, and the file closes with the last of them
+  const std::string filename = "test.47";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  FileId firstId;
+  {
+    File file = File::create(filename);
+    Page page = file.allocatePage();
+    page.insertRecord("registry");
+    file.writePage(page);
+    firstId = file.id();
+
+    std::atomic<bool> mismatch(false);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; t++) {
+      workers.emplace_back([&file, &mismatch]() {
+        File other;
+        for (int j = 0; j < 20000; j++) {
+          File copy = file;
+          other = copy;
+          if (other != file || other.filename() != file.filename()) {
+            mismatch = true;
+          }
+        }
+      });
+    }
+    workers.emplace_back([&file, &filename, &mismatch]() {
+      for (int j = 0; j < 2000; j++) {
+        if (File::open(filename).id() != file.id()) mismatch = true;
+      }
+    });
+    for (std::thread &worker : workers) worker.join();
+    if (mismatch) {
+      PRINT_ERROR("ERROR :: COPIES DID NOT SHARE THE OPEN FILE");
+    }
+  }
+  if (File::isOpen(filename)) {
+    PRINT_ERROR("ERROR :: FILE STAYED OPEN AFTER ITS LAST COPY");
+  }
+
+  {
+    // Opening the file while its last File object closes it either joins
+    // the open file or waits for the close and opens it again
+    std::atomic<bool> mismatch(false);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; t++) {
+      workers.emplace_back([&filename, &mismatch]() {
+        for (int j = 0; j < 2000; j++) {
+          File file = File::open(filename);
+          if (file.readPage(1).getRecord({1, 1}) != "registry") {
+            mismatch = true;
+          }
+        }
+      });
+    }
+    for (std::thread &worker : workers) worker.join();
+    if (mismatch) {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+  }
+  if (File::isOpen(filename)) {
+    PRINT_ERROR("ERROR :: FILE STAYED OPEN AFTER ITS LAST COPY");
+  }
+
+  {
+    // A closed file's identifier is handed out again
+    File file = File::open(filename);
+    File invalid;
+    if (file.id() != firstId || invalid.filename() != "" ||
+        invalid == file) {
+      PRINT_ERROR("ERROR :: IDENTIFIER WAS NOT REUSED");
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 43 passed"
+            << "\n";
+}
+
+void test44() {
+  // A tenant assignment ends with its file: a file opened later under the
+  // same identifier is not held to the limit of the tenant
+  const std::string oldName = "test.48";
+  const std::string newName = "test.49";
+  for (const std::string &filename : {oldName, newName}) {
+    try {
+      File::remove(filename);
+    } catch (const FileNotFoundException &e) {
+    }
+  }
+
+  {
+    BufMgr tenantMgr(10);
+    TenantOptions options;
+    options.maxFrames = 2;
+    options.priority = BufferPriority::LOW;
+    const TenantId tenant = tenantMgr.addTenant(options);
+    FileId oldId;
+    {
+      File oldFile = File::create(oldName);
+      tenantMgr.setFileTenant(oldFile, tenant);
+      for (int i = 0; i < 4; i++) {
+        tenantMgr.allocPage(oldFile).markDirty();
+      }
+      tenantMgr.flushFile(oldFile);
+      oldId = oldFile.id();
+    }
+    if (File::isOpen(oldName)) {
+      PRINT_ERROR("ERROR :: FLUSHED FILE STAYED OPEN");
+    }
+
+    File newFile = File::create(newName);
+    if (newFile.id() != oldId) {
+      PRINT_ERROR("ERROR :: IDENTIFIER WAS NOT REUSED");
+    }
+    std::vector<PageGuard> pages;
+    for (int i = 0; i < 5; i++) {
+      pages.push_back(tenantMgr.allocPage(newFile));
+    }
+    if (tenantMgr.tenantFrames(tenant) != 0 ||
+        tenantMgr.tenantFrames(0) != 5) {
+      PRINT_ERROR("ERROR :: NEW FILE INHERITED THE TENANT OF A CLOSED FILE");
+    }
+  }
+  File::remove(oldName);
+  File::remove(newName);
+
+  std::cout << "Test 44 passed"
+            << "\n";
+}
+
+void test45() {
+  // Releasing a guard on a page that has been disposed of leaves the pin of
+  // the page loaded into its frame since alone
+  const std::string filename = "test.50";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    BufMgr guardMgr(1);
+    PageGuard disposed = guardMgr.allocPage(file);
+    disposed.markDirty();
+    guardMgr.disposePage(file, disposed->page_number());
+    PageGuard reloaded = guardMgr.allocPage(file);
+    disposed.release();
+    if (guardMgr.evictableFrames() != 0) {
+      PRINT_ERROR("ERROR :: STALE GUARD UNPINNED ANOTHER PAGE");
+    }
+    reloaded.release();
+    if (guardMgr.evictableFrames() != 1) {
+      PRINT_ERROR("ERROR :: PAGE WAS NOT UNPINNED");
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 45 passed"
+            << "\n";
+}
+
+void test46() {
+  // Frames taken for pages that the file then fails to allocate go back to
+  // the free list, and are handed out before any page is evicted
+  const std::string filename = "test.51";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    BufMgr freeMgr(4);
+    // Low priority pages get no second chance from the clock, so a sweep
+    // rather than the free list would take the frame of the kept page
+    TenantOptions options;
+    options.priority = BufferPriority::LOW;
+    freeMgr.setFileTenant(file, freeMgr.addTenant(options));
+    const PageId kept = freeMgr.allocPage(file)->page_number();
+
+    // Writes past the current end of the file fail with EFBIG
+    struct rlimit previous;
+    getrlimit(RLIMIT_FSIZE, &previous);
+    struct rlimit limit = previous;
+    limit.rlim_cur = file.num_pages() * Page::SIZE;
+    void (*previousHandler)(int) = signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &limit);
+    int failures = 0;
+    try {
+      freeMgr.allocPage(file);
+    } catch (const FileIoException &e) {
+      failures++;
+    }
+    try {
+      PageId firstPageNo;
+      std::vector<Page *> pages;
+      freeMgr.allocPages(file, 2, firstPageNo, pages);
+    } catch (const FileIoException &e) {
+      failures++;
+    }
+    setrlimit(RLIMIT_FSIZE, &previous);
+    signal(SIGXFSZ, previousHandler);
+    if (failures != 2) {
+      PRINT_ERROR("ERROR :: ALLOCATION DID NOT FAIL");
+    }
+
+    for (int i = 0; i < 3; i++) {
+      freeMgr.allocPage(file).markDirty();
+    }
+    freeMgr.clearBufStats();
+    freeMgr.readPage(file, kept).release();
+    if (freeMgr.getBufStats().misses != 0) {
+      PRINT_ERROR("ERROR :: FRAMES WERE LOST FROM THE FREE LIST");
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 46 passed"
+            << "\n";
+}
+
+void test47() {
+  // Lookups without the latch keep finding a page while the hash table grows
+  // and drops the tables they may have been probing
+  const std::string filename = "test.52";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    const PageId numPages = 256;
+    for (PageId j = 1; j <= numPages; j++) {
+      Page new_page = file.allocatePage();
+      sprintf(tmpbuf, "growing %u", j);
+      new_page.insertRecord(tmpbuf);
+      file.writePage(new_page);
+    }
+
+    BufMgrOptions options;
+    options.maxBufs = numPages;
+    options.hashPartitions = 2;
+    BufMgr growMgr(4, options);
+    growMgr.readPage(file, 1).release();
+    std::atomic<bool> done(false);
+    std::atomic<bool> mismatch(false);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; t++) {
+      readers.emplace_back([&]() {
+        while (!done) {
+          std::string seen = "growing 1";
+          growMgr.readPageOptimistic(file, 1, [&seen](const Page &page) {
+            seen = page.getRecord({1, 1});
+          });
+          if (seen != "growing 1") mismatch = true;
+        }
+      });
+    }
+    for (std::uint32_t frames = 8; frames <= numPages; frames *= 2) {
+      growMgr.resize(frames);
+      for (PageId j = 2; j <= frames; j++) {
+        growMgr.readPage(file, j).release();
+      }
+    }
+    done = true;
+    for (std::thread &reader : readers) reader.join();
+    if (mismatch) {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 47 passed"
+            << "\n";
+}
+
+void test48() {
+  // A file opened under the identifier of a closed file does not continue
+  // the sequential run that was being read from the closed one
+  const std::string oldName = "test.53";
+  const std::string newName = "test.54";
+  for (const std::string &filename : {oldName, newName}) {
+    try {
+      File::remove(filename);
+    } catch (const FileNotFoundException &e) {
+    }
+  }
+
+  {
+    BufMgrOptions options;
+    options.readAheadPages = 8;
+    BufMgr aheadMgr(32, options);
+    FileId oldId;
+    {
+      File oldFile = File::create(oldName);
+      for (PageId j = 1; j <= 20; j++) oldFile.allocatePage();
+      // Dirty pages leave the pool when the file is flushed
+      for (PageId j = 1; j <= 20; j++) {
+        aheadMgr.readPage(oldFile, j).markDirty();
+      }
+      aheadMgr.flushFile(oldFile);
+      oldId = oldFile.id();
+    }
+
+    File newFile = File::create(newName);
+    for (PageId j = 1; j <= 30; j++) newFile.allocatePage();
+    if (newFile.id() != oldId) {
+      PRINT_ERROR("ERROR :: IDENTIFIER WAS NOT REUSED");
+    }
+    // Pages 21 and 22 start a run, so page 23 has been read ahead
+    aheadMgr.readPage(newFile, 21).release();
+    aheadMgr.readPage(newFile, 22).release();
+    aheadMgr.clearBufStats();
+    aheadMgr.readPage(newFile, 23).release();
+    if (aheadMgr.getBufStats().misses != 0) {
+      PRINT_ERROR("ERROR :: READ-AHEAD CARRIED OVER FROM A CLOSED FILE");
+    }
+  }
+  File::remove(oldName);
+  File::remove(newName);
+
+  std::cout << "Test 48 passed"
+            << "\n";
+}
+
+void test49() {
+  // A committed change to a page allocated in the same transaction is
+  // recovered even when the file header is lost in a crash after the commit
+  const std::string filename = "test.55";
+  const std::string logFilename = "test.55.log";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+  std::remove(logFilename.c_str());
+
+  RecordId committedId;
+  std::string image;
+  {
+    File file = File::create(filename);
+    LogManager log(logFilename);
+    BufMgrOptions options;
+    options.log = &log;
+    BufMgr logMgr(5, options);
+
+    const TxnId txn = log.begin();
+    PageGuard page = logMgr.allocPage(file);
+    committedId = log.insertRecord(txn, file, *page, "allocated");
+    page.markDirty();
+    log.commit(txn);
+
+    // What a crash right after the commit leaves on disk
+    std::ifstream in(filename, std::ios::binary);
+    image.assign(std::istreambuf_iterator<char>(in),
+                 std::istreambuf_iterator<char>());
+    PageId diskPages = 0;
+    std::memcpy(&diskPages, image.data(), sizeof(diskPages));
+    if (diskPages <= committedId.page_number) {
+      PRINT_ERROR("ERROR :: ALLOCATION NOT DURABLE AT COMMIT");
+    }
+
+    // A later transaction allocates a page but never commits
+    PageGuard other = logMgr.allocPage(file);
+    log.insertRecord(log.begin(), file, *other, "uncommitted");
+    other.markDirty();
+    log.flush(log.endLsn());
+  }
+  {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out.write(image.data(), image.size());
+  }
+
+  {
+    File file = File::open(filename);
+    LogManager log(logFilename);
+    BufMgr recoveryMgr(5);
+    if (log.recover(recoveryMgr) != 1) {
+      PRINT_ERROR("ERROR :: WRONG NUMBER OF CHANGES REPLAYED");
+    }
+    PageGuard page = recoveryMgr.readPage(file, committedId.page_number);
+    if (page->getRecord(committedId) != "allocated") {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+  }
+  File::remove(filename);
+  std::remove(logFilename.c_str());
+
+  std::cout << "Test 49 passed"
+            << "\n";
+}
+
+void test50() {
+  // Redo puts an insert back into the slot it was logged with, and reports
+  // an insert into a slot that is in use instead of taking another one
+  const std::string filename = "test.56";
+  const std::string logFilename = "test.56.log";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+  std::remove(logFilename.c_str());
+
+  {
+    File file = File::create(filename);
+    for (i = 1; i <= 2; i++) {
+      Page new_page = file.allocatePage();
+      if (i == 1) {
+        for (int j = 1; j <= 3; j++) {
+          sprintf(tmpbuf, "record %d", j);
+          new_page.insertRecord(tmpbuf);
+        }
+      }
+      file.writePage(new_page);
+    }
+
+    RecordId reused;
+    {
+      LogManager log(logFilename);
+      BufMgrOptions options;
+      options.log = &log;
+      BufMgr logMgr(3, options);
+
+      // Both pages stay pinned and are lost with the buffer manager
+      const TxnId txn = log.begin();
+      PageGuard first = logMgr.readPage(file, 1);
+      log.deleteRecord(txn, file, *first, {1, 2});
+      reused = log.insertRecord(txn, file, *first, "reused");
+      first.markDirty();
+      PageGuard second = logMgr.readPage(file, 2);
+      log.insertRecord(txn, file, *second, "logged");
+      second.markDirty();
+      log.commit(txn);
+
+      // Page 2 on disk gets a record the log does not know about
+      Page stray = file.readPage(2);
+      stray.insertRecord("stray");
+      file.writePage(stray);
+    }
+    if (reused.slot_number != 2) {
+      PRINT_ERROR("ERROR :: DELETED SLOT NOT REUSED");
+    }
+
+    {
+      LogManager log(logFilename);
+      BufMgr recoveryMgr(3);
+      try {
+        log.recover(recoveryMgr);
+        PRINT_ERROR("ERROR :: INSERT INTO A SLOT IN USE REPLAYED");
+      } catch (const RedoMismatchException &e) {
+        if (e.record_id().page_number != 2 ||
+            e.record_id().slot_number != 1) {
+          PRINT_ERROR("ERROR :: WRONG CHANGE REPORTED");
+        }
+      }
+      PageGuard first = recoveryMgr.readPage(file, 1);
+      if (first->getRecord(reused) != "reused" ||
+          first->getRecord({1, 3}) != "record 3") {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+    }
+  }
+  File::remove(filename);
+  std::remove(logFilename.c_str());
+
+  std::cout << "Test 50 passed"
+            << "\n";
+}
+
+void test51() {
+  // Flushing a file writes nothing while one of its pages is pinned, keeps
+  // the pages dirty when a write fails, and otherwise writes each run of
+  // adjacent dirty pages with one write, leaving clean frames alone
+  const std::string filename = "test.57";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    for (i = 1; i <= 8; i++) file.allocatePage();
+    BufMgr flushMgr(10);
+    const std::vector<PageId> dirtyPages = {2, 3, 5, 6};
+    for (const PageId pageNo : dirtyPages) {
+      PageGuard page = flushMgr.readPage(file, pageNo);
+      sprintf(tmpbuf, "flushed %u", pageNo);
+      page->insertRecord(tmpbuf);
+      page.markDirty();
+    }
+    flushMgr.readPage(file, 7).release();
+    PageGuard pinned = flushMgr.readPage(file, 8);
+    const auto written = [&file, &dirtyPages]() {
+      int count = 0;
+      for (const PageId pageNo : dirtyPages) {
+        if (file.readPage(pageNo).getFreeSpace() != Page().getFreeSpace()) {
+          count++;
+        }
+      }
+      return count;
+    };
+
+    try {
+      flushMgr.flushFile(file);
+      PRINT_ERROR("ERROR :: FLUSHED A FILE WITH A PINNED PAGE");
+    } catch (const PagePinnedException &e) {
+    }
+    if (written() != 0) {
+      PRINT_ERROR("ERROR :: PAGES WRITTEN WHILE ONE WAS PINNED");
+    }
+    pinned.release();
+
+    // Writes past page 4 fail with EFBIG
+    struct rlimit previous;
+    getrlimit(RLIMIT_FSIZE, &previous);
+    struct rlimit limit = previous;
+    limit.rlim_cur = 4 * Page::SIZE;
+    void (*previousHandler)(int) = signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &limit);
+    bool failed = false;
+    try {
+      flushMgr.flushFile(file);
+    } catch (const FileIoException &e) {
+      failed = true;
+    }
+    setrlimit(RLIMIT_FSIZE, &previous);
+    signal(SIGXFSZ, previousHandler);
+    if (!failed) {
+      PRINT_ERROR("ERROR :: FAILED WRITE NOT REPORTED");
+    }
+
+    // Every page is still dirty, so all of them are written again
+#if BADGERDB_TRACING
+    Tracer &tracer = Tracer::get();
+    tracer.clear();
+    tracer.enable(1024);
+#endif
+    flushMgr.flushFile(file);
+#if BADGERDB_TRACING
+    tracer.disable();
+    std::vector<std::pair<PageId, std::uint64_t>> writes;
+    for (const TraceRecord &record : tracer.snapshot()) {
+      if (record.event == TraceEvent::FILE_WRITE &&
+          record.fileId == file.id()) {
+        writes.push_back(std::make_pair(record.pageNo, record.value));
+      }
+    }
+    const std::vector<std::pair<PageId, std::uint64_t>> runs = {
+        {2, 2 * Page::SIZE}, {5, 2 * Page::SIZE}};
+    if (writes != runs) {
+      PRINT_ERROR("ERROR :: RUNS OF DIRTY PAGES NOT MERGED");
+    }
+#endif
+    if (written() != 4) {
+      PRINT_ERROR("ERROR :: DIRTY PAGES NOT WRITTEN");
+    }
+    for (const PageId pageNo : dirtyPages) {
+      const Page page = file.readPage(pageNo);
+      sprintf(tmpbuf, "flushed %u", pageNo);
+      if (page.getRecord({pageNo, 1}) != tmpbuf ||
+          page.page_number() != pageNo ||
+          page.prev_page_number() != pageNo - 1 ||
+          page.next_page_number() != pageNo + 1) {
+        PRINT_ERROR("ERROR :: FLUSHED PAGE DID NOT MATCH");
+      }
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 51 passed"
+            << "\n";
+}
+
+void test52() {
+  // A scan through a ring larger than the limit of its tenant stays within
+  // the limit
+  const std::string filename = "test.58";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    for (PageId j = 1; j <= 30; j++) {
+      Page new_page = file.allocatePage();
+      sprintf(tmpbuf, "ring %u", j);
+      new_page.insertRecord(tmpbuf);
+      file.writePage(new_page);
+    }
+    BufMgr ringMgr(20);
+    TenantOptions options;
+    options.maxFrames = 3;
+    const TenantId tenant = ringMgr.addTenant(options);
+    ringMgr.setFileTenant(file, tenant);
+
+    BufferAccessStrategy scan(8);
+    for (PageId j = 1; j <= 30; j++) {
+      PageGuard page = ringMgr.readPage(file, j, &scan);
+      sprintf(tmpbuf, "ring %u", j);
+      if (page->getRecord({j, 1}) != tmpbuf) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+      if (ringMgr.tenantFrames(tenant) > 3) {
+        PRINT_ERROR("ERROR :: RING SCAN EXCEEDED THE TENANT LIMIT");
+      }
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 52 passed"
+            << "\n";
+}
+
+void test53() {
+  // A hash partition that receives far more than its share of the entries
+  // keeps finding and removing them while it rehashes and once it is done
+  const std::string filename = "test.59";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+
+  {
+    File file = File::create(filename);
+    // 16 entries per partition, so 64 buckets each
+    BufHashTbl table(64, 4);
+    std::vector<PageId> crowded;
+    std::vector<PageId> others;
+    for (PageId pageNo = 1; crowded.size() < 400; pageNo++) {
+      if (table.partitionOf(file.id(), pageNo) == 0) {
+        crowded.push_back(pageNo);
+      } else if (others.size() < 20) {
+        others.push_back(pageNo);
+      }
+    }
+    for (const PageId pageNo : others) table.insert(file, pageNo, pageNo);
+
+    const auto found = [&table, &file](const PageId pageNo) {
+      FrameId frameNo = 0;
+      FrameId optimisticNo = 0;
+      return table.tryLookup(file, pageNo, frameNo) && frameNo == pageNo &&
+             table.tryLookupOptimistic(file.id(), pageNo, optimisticNo) &&
+             optimisticNo == pageNo;
+    };
+    std::vector<bool> present(crowded.size(), false);
+    const auto check = [&]() {
+      for (std::size_t j = 0; j < crowded.size(); j++) {
+        if (found(crowded[j]) != present[j]) return false;
+      }
+      for (const PageId pageNo : others) {
+        if (!found(pageNo)) return false;
+      }
+      return true;
+    };
+
+    // Every third entry is removed again while the partition is growing
+    bool consistent = true;
+    for (std::size_t j = 0; j < crowded.size(); j++) {
+      table.insert(file, crowded[j], crowded[j]);
+      present[j] = true;
+      if (j % 3 == 2) {
+        if (!table.tryRemove(file, crowded[j - 1])) {
+          PRINT_ERROR("ERROR :: REMOVAL MISSED AN ENTRY");
+        }
+        present[j - 1] = false;
+      }
+      consistent = consistent && check();
+    }
+    // Removals move draining entries too, so the last rehash is over by the
+    // final check
+    for (std::size_t j = 0; j < crowded.size(); j += 3) {
+      table.remove(file, crowded[j]);
+      present[j] = false;
+    }
+    if (!consistent || !check()) {
+      PRINT_ERROR("ERROR :: LOOKUP MISSED AN ENTRY");
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 53 passed"
+            << "\n";
+}
@@ -0,0 +1,110 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "numa.h"
+
+#if defined(__linux__)
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Parses a list of numbers and ranges like "0-3,8,10-11".
+ */
+std::vector<std::uint32_t> parseList(const std::string& list) {
+  std::vector<std::uint32_t> numbers;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    std::uint32_t first;
+    std::uint32_t last;
+    char dash;
+    std::stringstream range(item);
+    if (!(range >> first)) continue;
+    if (!(range >> dash >> last)) last = first;
+    for (std::uint32_t n = first; n <= last; n++) numbers.push_back(n);
+  }
+  return numbers;
+}
+
+/**
+ * Returns the first line of a file, or an empty string.
+ */
+std::string readLine(const std::string& path) {
+  std::ifstream in(path);
+  std::string line;
+  std::getline(in, line);
+  return line;
+}
+
+}  // namespace
+
+const NumaTopology& NumaTopology::get() {
+  static const NumaTopology topology;
+  return topology;
+}
+
+NumaTopology::NumaTopology() {
+#if defined(__linux__)
+  const std::string root = "/sys/devices/system/node/";
+  for (const std::uint32_t id : parseList(readLine(root + "online"))) {
+    const std::uint32_t node = static_cast<std::uint32_t>(nodeIds.size());
+    nodeIds.push_back(id);
+    const std::string cpus =
+        readLine(root + "node" + std::to_string(id) + "/cpulist");
+    for (const std::uint32_t cpu : parseList(cpus)) {
+      if (cpu >= cpuNodes.size()) cpuNodes.resize(cpu + 1, 0);
+      cpuNodes[cpu] = node;
+    }
+  }
+#endif
+  if (nodeIds.empty()) {
+    nodeIds.push_back(0);
+  }
+}
+
+std::uint32_t NumaTopology::currentNode() const {
+#if defined(__linux__)
+  if (nodeIds.size() > 1) {
+    const int cpu = sched_getcpu();
+    if (cpu >= 0 && static_cast<std::size_t>(cpu) < cpuNodes.size()) {
+      return cpuNodes[cpu];
+    }
+  }
+#endif
+  return 0;
+}
+
+void NumaTopology::preferNode(char* memory, const std::size_t length,
+                              const std::uint32_t node) const {
+#if defined(__linux__)
+  const unsigned long bits = 8 * sizeof(unsigned long);
+  if (nodeIds.size() <= 1 || length == 0 || nodeIds[node] >= bits) {
+    return;
+  }
+  const unsigned long mask = 1UL << nodeIds[node];
+  // Only a hint: pages are still placed elsewhere if the node runs out
+  syscall(SYS_mbind, memory, length, MPOL_PREFERRED, &mask, bits + 1, 0);
+#else
+  (void)memory;
+  (void)length;
+  (void)node;
+#endif
+}
+
+}  // namespace badgerdb
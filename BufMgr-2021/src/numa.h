@@ -0,0 +1,71 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace badgerdb {
+
+/**
+ * @brief The NUMA nodes of the machine and the CPUs that belong to them
+ *
+ * Nodes are numbered from 0 in the order the operating system lists them.
+ * The topology is read from /sys/devices/system/node on Linux; elsewhere, or
+ * if that fails, the machine is taken to be a single node.
+ */
+class NumaTopology {
+ public:
+  /**
+   * Returns the topology of this machine, read on first use.
+   */
+  static const NumaTopology& get();
+
+  /**
+   * Returns the number of nodes
+   */
+  std::uint32_t nodes() const {
+    return static_cast<std::uint32_t>(nodeIds.size());
+  }
+
+  /**
+   * Returns the node of the CPU the calling thread is running on
+   */
+  std::uint32_t currentNode() const;
+
+  /**
+   * Asks for the pages of a range of memory that have not been touched yet
+   * to be placed on a node.  Does nothing on a single node machine.
+   *
+   * @param memory  Start of the range, aligned to the operating system page
+   * @param length  Length of the range in bytes
+   * @param node    Node to place the pages on
+   */
+  void preferNode(char* memory, const std::size_t length,
+                  const std::uint32_t node) const;
+
+ private:
+  /**
+   * Reads the topology.
+   */
+  NumaTopology();
+
+  /**
+   * Operating system identifier of every node
+   */
+  std::vector<std::uint32_t> nodeIds;
+
+  /**
+   * Node of every CPU, by CPU number
+   */
+  std::vector<std::uint32_t> cpuNodes;
+};
+
+}  // namespace badgerdb
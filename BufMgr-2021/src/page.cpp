@@ -8,7 +8,14 @@
 
 #include "page.h"
 
+#include <stdlib.h>
+
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <vector>
 
 #include "exceptions/insufficient_space_exception.h"
 #include "exceptions/invalid_record_exception.h"
@@ -18,16 +25,91 @@
 
 namespace badgerdb {
 
-Page::Page() { initialize(); }
+namespace {
+
+/**
+ * Allocates memory for a page image owned by a Page.
+ */
+char *allocateImage() {
+  void *image = nullptr;
+  if (posix_memalign(&image, Page::ALIGNMENT, Page::SIZE) != 0) {
+    throw std::bad_alloc();
+  }
+  return static_cast<char *>(image);
+}
+
+}  // namespace
+
+Page::Page() {
+  attach(allocateImage(), true /* owned */);
+  initialize();
+}
+
+Page::Page(const Page &other) {
+  attach(allocateImage(), true /* owned */);
+  std::memcpy(image_, other.image_, SIZE);
+}
+
+Page::Page(Page &&other) {
+  attach(other.image_, other.owns_image_);
+  other.image_ = nullptr;
+  other.owns_image_ = false;
+}
+
+Page &Page::operator=(const Page &rhs) {
+  if (this != &rhs) {
+    std::memcpy(image_, rhs.image_, SIZE);
+  }
+  return *this;
+}
+
+Page &Page::operator=(Page &&rhs) {
+  if (owns_image_ && rhs.owns_image_) {
+    std::swap(image_, rhs.image_);
+    std::swap(header_, rhs.header_);
+    std::swap(data_, rhs.data_);
+  } else if (this != &rhs) {
+    std::memcpy(image_, rhs.image_, SIZE);
+  }
+  return *this;
+}
+
+Page::~Page() {
+  if (owns_image_) {
+    free(image_);
+  }
+}
+
+Page Page::view(char *image) {
+  Page page(image);
+  page.initialize();
+  return page;
+}
+
+Page::Page(char *image) { attach(image, false /* owned */); }
+
+void Page::attach(char *image, const bool owned) {
+  image_ = image;
+  owns_image_ = owned;
+  header_ = reinterpret_cast<PageHeader *>(image_);
+  data_ = image_ + sizeof(PageHeader);
+}
 
-void Page::initialize() {
-  header_.free_space_lower_bound = 0;
-  header_.free_space_upper_bound = DATA_SIZE;
-  header_.num_slots = 0;
-  header_.num_free_slots = 0;
-  header_.current_page_number = INVALID_NUMBER;
-  header_.next_page_number = INVALID_NUMBER;
-  data_.assign(DATA_SIZE, char());
+void Page::initialize(const std::uint16_t slot_format) {
+  header_->free_space_lower_bound = 0;
+  header_->free_space_upper_bound = DATA_SIZE;
+  header_->fragmented_space = 0;
+  header_->first_free_slot = INVALID_SLOT;
+  header_->num_slots = 0;
+  header_->num_free_slots = 0;
+  header_->slot_format = slot_format;
+  header_->compressed_length = 0;
+  header_->current_page_number = INVALID_NUMBER;
+  header_->next_page_number = INVALID_NUMBER;
+  header_->prev_page_number = INVALID_NUMBER;
+  header_->checksum = 0;
+  header_->lsn = 0;
+  std::memset(data_, 0, DATA_SIZE);
 }
 
 RecordId Page::insertRecord(const std::string &record_data) {
@@ -35,23 +117,53 @@ RecordId Page::insertRecord(const std::string &record_data) {
     throw InsufficientSpaceException(page_number(), record_data.length(),
                                      getFreeSpace());
   }
+  if (spaceForRecord(record_data.length()) > getContiguousFreeSpace()) {
+    // A new slot must not grow into the data of records
+    compact();
+  }
   const SlotId slot_number = getAvailableSlot();
   insertRecordInSlot(slot_number, record_data);
   return {page_number(), slot_number};
 }
 
+std::size_t Page::insertRecords(const RecordSpan *records,
+                                const std::size_t count,
+                                RecordId *record_ids) {
+  std::size_t inserted = 0;
+  for (; inserted < count; ++inserted) {
+    const RecordSpan &record = records[inserted];
+    const std::size_t needed = spaceForRecord(record.length);
+    if (needed > getFreeSpace()) {
+      break;
+    }
+    if (needed > getContiguousFreeSpace()) {
+      compact();
+    }
+    const SlotId slot_number = getAvailableSlot();
+    insertRecordInSlot(slot_number, record.data, record.length);
+    if (record_ids != nullptr) {
+      record_ids[inserted] = {page_number(), slot_number};
+    }
+  }
+  return inserted;
+}
+
 std::string Page::getRecord(const RecordId &record_id) const {
+  const RecordSpan span = getRecordSpan(record_id);
+  return std::string(span.data, span.length);
+}
+
+RecordSpan Page::getRecordSpan(const RecordId &record_id) const {
   validateRecordId(record_id);
-  const PageSlot *slot = getSlot(record_id.slot_number);
-  return data_.substr(slot->item_offset, slot->item_length);
+  const PageSlot slot = getSlot(record_id.slot_number);
+  return {data_ + slot.item_offset, slot.item_length};
 }
 
 void Page::updateRecord(const RecordId &record_id,
                         const std::string &record_data) {
   validateRecordId(record_id);
-  const PageSlot *slot = getSlot(record_id.slot_number);
   const std::size_t free_space_after_delete =
-      getFreeSpace() + slot->item_length;
+      getFreeSpace() + getSlot(record_id.slot_number).item_length;
   if (record_data.length() > free_space_after_delete) {
     throw InsufficientSpaceException(page_number(), record_data.length(),
                                      free_space_after_delete);
@@ -59,7 +171,7 @@ void Page::updateRecord(const RecordId &record_id,
   // We have to disallow slot compaction here because we're going to place the
   // record data in the same slot, and compaction might delete the slot if we
   // permit it.
-  deleteRecord(record_id, false /* allow_slot_compaction */);
+  deleteRecordLazily(record_id, false /* allow_slot_compaction */);
   insertRecordInSlot(record_id.slot_number, record_data);
 }
 
@@ -67,98 +179,157 @@ void Page::deleteRecord(const RecordId &record_id) {
   deleteRecord(record_id, true /* allow_slot_compaction */);
 }
 
+void Page::deleteRecordLazily(const RecordId &record_id) {
+  deleteRecordLazily(record_id, true /* allow_slot_compaction */);
+}
+
 void Page::deleteRecord(const RecordId &record_id,
                         const bool allow_slot_compaction) {
   validateRecordId(record_id);
-  PageSlot *slot = getSlot(record_id.slot_number);
-  data_.replace(slot->item_offset, slot->item_length, slot->item_length, '\0');
+  const PageSlot slot = getSlot(record_id.slot_number);
+  std::memset(data_ + slot.item_offset, 0, slot.item_length);
 
   // Compact the data by removing the hole left by this record (if necessary).
-  std::uint16_t move_offset = slot->item_offset;
-  std::size_t move_bytes = 0;
-  for (SlotId i = 1; i <= header_.num_slots; ++i) {
-    PageSlot *other_slot = getSlot(i);
-    if (other_slot->used && other_slot->item_offset < slot->item_offset) {
-      if (other_slot->item_offset < move_offset) {
-        move_offset = other_slot->item_offset;
+  PageOffset move_offset = slot.item_offset;
+  for (SlotId i = 1; i <= header_->num_slots; ++i) {
+    PageSlot other_slot = getSlot(i);
+    if (other_slot.used && other_slot.item_offset < slot.item_offset) {
+      if (other_slot.item_offset < move_offset) {
+        move_offset = other_slot.item_offset;
       }
-      move_bytes += other_slot->item_length;
       // Update the slot for the other data to reflect the soon-to-be-new
       // location.
-      other_slot->item_offset += slot->item_length;
+      other_slot.item_offset += slot.item_length;
+      setSlot(i, other_slot);
     }
   }
-  // If we have data to move, shift it to the right.
+  // If we have data to move, shift it to the right.  Holes left by lazy
+  // deletes below this record move along with it.
+  const std::size_t move_bytes = slot.item_offset - move_offset;
   if (move_bytes > 0) {
-    const std::string &data_to_move = data_.substr(move_offset, move_bytes);
-    data_.replace(move_offset + slot->item_length, move_bytes, data_to_move);
-  }
-  header_.free_space_upper_bound += slot->item_length;
-
-  // Mark slot as unused.
-  slot->used = false;
-  slot->item_offset = 0;
-  slot->item_length = 0;
-  ++header_.num_free_slots;
-
-  if (allow_slot_compaction && record_id.slot_number == header_.num_slots) {
-    // Last slot in the list, so we need to free any unused slots that are at
-    // the end of the slot list.
-    int num_slots_to_delete = 1;
-    for (SlotId i = 1; i < header_.num_slots; ++i) {
-      // Traverse list backwards, looking for unused slots.
-      const PageSlot *other_slot = getSlot(header_.num_slots - i);
-      if (!other_slot->used) {
-        ++num_slots_to_delete;
-      } else {
-        // Stop at the first used slot we find, since we can't move used
-        // slots without affecting record IDs.
-        break;
-      }
+    std::memmove(data_ + move_offset + slot.item_length, data_ + move_offset,
+                 move_bytes);
+  }
+  header_->free_space_upper_bound += slot.item_length;
+  releaseSlot(record_id.slot_number, allow_slot_compaction);
+}
+
+void Page::deleteRecordLazily(const RecordId &record_id,
+                              const bool allow_slot_compaction) {
+  validateRecordId(record_id);
+  const PageSlot slot = getSlot(record_id.slot_number);
+  if (slot.item_offset == header_->free_space_upper_bound) {
+    // Borders the free space, so there is no hole to leave
+    header_->free_space_upper_bound += slot.item_length;
+  } else {
+    header_->fragmented_space += slot.item_length;
+  }
+  releaseSlot(record_id.slot_number, allow_slot_compaction);
+}
+
+void Page::releaseSlot(const SlotId slot_number,
+                       const bool allow_slot_compaction) {
+  if (!allow_slot_compaction || slot_number != header_->num_slots) {
+    // Mark slot as unused.
+    pushFreeSlot(slot_number);
+    return;
+  }
+
+  // Last slot in the list, so we need to free any unused slots that are at
+  // the end of the slot list.
+  int num_slots_to_delete = 1;
+  for (SlotId i = 1; i < header_->num_slots; ++i) {
+    // Traverse list backwards, looking for unused slots.
+    const SlotId other_number = header_->num_slots - i;
+    if (!getSlot(other_number).used) {
+      unlinkFreeSlot(other_number);
+      ++num_slots_to_delete;
+    } else {
+      // Stop at the first used slot we find, since we can't move used
+      // slots without affecting record IDs.
+      break;
     }
-    header_.num_slots -= num_slots_to_delete;
-    header_.num_free_slots -= num_slots_to_delete;
-    header_.free_space_lower_bound -= sizeof(PageSlot) * num_slots_to_delete;
   }
+  header_->num_slots -= num_slots_to_delete;
+  header_->free_space_lower_bound -= slotSize() * num_slots_to_delete;
 }
 
-bool Page::hasSpaceForRecord(const std::string &record_data) const {
-  std::size_t record_size = record_data.length();
-  if (header_.num_free_slots == 0) {
-    record_size += sizeof(PageSlot);
+void Page::pushFreeSlot(const SlotId slot_number) {
+  const SlotId next = header_->first_free_slot;
+  setSlot(slot_number, {false /* used */, next, INVALID_SLOT});
+  if (next != INVALID_SLOT) {
+    PageSlot next_slot = getSlot(next);
+    next_slot.item_length = slot_number;
+    setSlot(next, next_slot);
   }
-  return record_size <= getFreeSpace();
+  header_->first_free_slot = slot_number;
+  ++header_->num_free_slots;
+}
+
+void Page::unlinkFreeSlot(const SlotId slot_number) {
+  const PageSlot slot = getSlot(slot_number);
+  const SlotId next = slot.item_offset;
+  const SlotId prev = slot.item_length;
+  if (prev == INVALID_SLOT) {
+    header_->first_free_slot = next;
+  } else {
+    PageSlot prev_slot = getSlot(prev);
+    prev_slot.item_offset = next;
+    setSlot(prev, prev_slot);
+  }
+  if (next != INVALID_SLOT) {
+    PageSlot next_slot = getSlot(next);
+    next_slot.item_length = prev;
+    setSlot(next, next_slot);
+  }
+  --header_->num_free_slots;
+}
+
+bool Page::hasSpaceForRecord(const std::string &record_data) const {
+  return spaceForRecord(record_data.length()) <= getFreeSpace();
 }
 
-PageSlot *Page::getSlot(const SlotId slot_number) {
-  return reinterpret_cast<PageSlot *>(
-      &data_[(slot_number - 1) * sizeof(PageSlot)]);
+PageSlot Page::getSlot(const SlotId slot_number) const {
+  if (header_->slot_format != PACKED_SLOTS) {
+    return *reinterpret_cast<const PageSlot *>(
+        &data_[(slot_number - 1) * sizeof(PageSlot)]);
+  }
+  const PackedPageSlot *packed = reinterpret_cast<const PackedPageSlot *>(
+      &data_[(slot_number - 1) * sizeof(PackedPageSlot)]);
+  PageSlot slot;
+  slot.used = (packed->offset_and_used & PackedPageSlot::USED) != 0;
+  slot.item_offset = packed->offset_and_used & ~PackedPageSlot::USED;
+  slot.item_length = packed->item_length;
+  return slot;
 }
 
-const PageSlot *Page::getSlot(const SlotId slot_number) const {
-  return reinterpret_cast<const PageSlot *>(
-      &data_[(slot_number - 1) * sizeof(PageSlot)]);
+void Page::setSlot(const SlotId slot_number, const PageSlot &slot) {
+  if (header_->slot_format != PACKED_SLOTS) {
+    *reinterpret_cast<PageSlot *>(
+        &data_[(slot_number - 1) * sizeof(PageSlot)]) = slot;
+    return;
+  }
+  PackedPageSlot *packed = reinterpret_cast<PackedPageSlot *>(
+      &data_[(slot_number - 1) * sizeof(PackedPageSlot)]);
+  packed->offset_and_used =
+      slot.used ? slot.item_offset | PackedPageSlot::USED : slot.item_offset;
+  packed->item_length = slot.item_length;
 }
 
 SlotId Page::getAvailableSlot() {
   SlotId slot_number = INVALID_SLOT;
-  if (header_.num_free_slots > 0) {
-    // Have an allocated but unused slot that we can reuse.
-    for (SlotId i = 1; i <= header_.num_slots; ++i) {
-      const PageSlot *slot = getSlot(i);
-      if (!slot->used) {
-        // We don't decrement the number of free slots until someone
-        // actually puts data in the slot.
-        slot_number = i;
-        break;
-      }
-    }
+  if (header_->num_free_slots > 0) {
+    // Have an allocated but unused slot that we can reuse.  It stays in the
+    // chain until someone actually puts data in the slot.
+    slot_number = header_->first_free_slot;
   } else {
     // Have to allocate a new slot.
-    slot_number = header_.num_slots + 1;
-    ++header_.num_slots;
-    ++header_.num_free_slots;
-    header_.free_space_lower_bound = sizeof(PageSlot) * header_.num_slots;
+    slot_number = header_->num_slots + 1;
+    ++header_->num_slots;
+    header_->free_space_lower_bound = slotSize() * header_->num_slots;
+    // The new slot takes over free space, which may still hold bytes of
+    // records that were moved or deleted, so all of it is written.
+    pushFreeSlot(slot_number);
   }
   assert(slot_number != INVALID_SLOT);
   return slot_number;
@@ -166,28 +337,89 @@ SlotId Page::getAvailableSlot() {
 
 void Page::insertRecordInSlot(const SlotId slot_number,
                               const std::string &record_data) {
-  if (slot_number > header_.num_slots || slot_number == INVALID_SLOT) {
+  insertRecordInSlot(slot_number, record_data.data(), record_data.length());
+}
+
+void Page::insertRecordInSlot(const SlotId slot_number, const char *data,
+                              const std::size_t length) {
+  if (slot_number > header_->num_slots || slot_number == INVALID_SLOT) {
     throw InvalidSlotException(page_number(), slot_number);
   }
-  PageSlot *slot = getSlot(slot_number);
-  if (slot->used) {
+  if (getSlot(slot_number).used) {
     throw SlotInUseException(page_number(), slot_number);
   }
-  const int record_length = record_data.length();
-  slot->used = true;
-  slot->item_length = record_length;
-  slot->item_offset = header_.free_space_upper_bound - record_length;
-  header_.free_space_upper_bound = slot->item_offset;
-  --header_.num_free_slots;
-  data_.replace(slot->item_offset, slot->item_length, record_data);
+  const PageOffset record_length = length;
+  if (record_length > getContiguousFreeSpace()) {
+    compact();
+  }
+  unlinkFreeSlot(slot_number);
+  PageSlot slot;
+  slot.used = true;
+  slot.item_length = record_length;
+  slot.item_offset = header_->free_space_upper_bound - record_length;
+  setSlot(slot_number, slot);
+  header_->free_space_upper_bound = slot.item_offset;
+  std::memcpy(data_ + slot.item_offset, data, slot.item_length);
+}
+
+void Page::compact() {
+  if (header_->fragmented_space == 0) {
+    return;
+  }
+
+  // Records ordered by where they end, from the end of the page down
+  typedef std::pair<SlotId, PageSlot> Record;
+  std::vector<Record> records;
+  records.reserve(header_->num_slots - header_->num_free_slots);
+  for (SlotId i = 1; i <= header_->num_slots; ++i) {
+    const PageSlot slot = getSlot(i);
+    if (slot.used) {
+      records.push_back(Record(i, slot));
+    }
+  }
+  std::sort(records.begin(), records.end(),
+            [](const Record &a, const Record &b) {
+              return a.second.item_offset + a.second.item_length >
+                     b.second.item_offset + b.second.item_length;
+            });
+
+  // Pack the records against the end of the page, one run of adjacent
+  // records at a time
+  PageOffset packed_end = DATA_SIZE;
+  for (std::size_t first = 0; first < records.size();) {
+    const PageSlot &first_slot = records[first].second;
+    const PageOffset run_end =
+        first_slot.item_offset + first_slot.item_length;
+    PageOffset run_start = first_slot.item_offset;
+    std::size_t last = first;
+    while (last + 1 < records.size() &&
+           records[last + 1].second.item_offset +
+                   records[last + 1].second.item_length ==
+               run_start) {
+      ++last;
+      run_start = records[last].second.item_offset;
+    }
+    const PageOffset shift = packed_end - run_end;
+    if (shift > 0) {
+      std::memmove(data_ + run_start + shift, data_ + run_start,
+                   run_end - run_start);
+      for (std::size_t i = first; i <= last; ++i) {
+        records[i].second.item_offset += shift;
+        setSlot(records[i].first, records[i].second);
+      }
+    }
+    packed_end = run_start + shift;
+    first = last + 1;
+  }
+  header_->free_space_upper_bound = packed_end;
+  header_->fragmented_space = 0;
 }
 
 void Page::validateRecordId(const RecordId &record_id) const {
   if (record_id.page_number != page_number()) {
     throw InvalidRecordException(record_id, page_number());
   }
-  const PageSlot *slot = getSlot(record_id.slot_number);
-  if (!slot->used) {
+  if (!getSlot(record_id.slot_number).used) {
     throw InvalidRecordException(record_id, page_number());
   }
 }
@@ -13,11 +13,29 @@
 #include <cstddef>
 #include <memory>
 #include <string>
+#include <type_traits>
 
 #include "types.h"
 
+/**
+ * Page size in bytes that BadgerDB is built for, a power of two from 4096 to
+ * 65536.  Set it when building, as in make PAGE_SIZE=32768.
+ */
+#ifndef BADGERDB_PAGE_SIZE
+#define BADGERDB_PAGE_SIZE 8192
+#endif
+
 namespace badgerdb {
 
+/**
+ * @brief Offset or length of data within a page.
+ *
+ * Two bytes are enough up to 32 KB pages, whose slots can still spare a bit of
+ * the offset for the used flag; larger pages take four.
+ */
+typedef std::conditional<(BADGERDB_PAGE_SIZE > 32768), std::uint32_t,
+                         std::uint16_t>::type PageOffset;
+
 /**
  * @brief Header metadata in a page.
  *
@@ -29,13 +47,25 @@ struct PageHeader {
    * Lower bound of the free space.  This is the offset of the first unused byte
    * after the slot array.
    */
-  std::uint16_t free_space_lower_bound;
+  PageOffset free_space_lower_bound;
 
   /**
    * Upper bound of the free space.  This is the offset of the last unused byte
    * before the first data record.
    */
-  std::uint16_t free_space_upper_bound;
+  PageOffset free_space_upper_bound;
+
+  /**
+   * Bytes in holes left between records by deleteRecordLazily().  They count
+   * as free space and are reclaimed when an insert needs them.
+   */
+  PageOffset fragmented_space;
+
+  /**
+   * First slot of the chain of allocated but unused slots, most recently
+   * freed first, or Page::INVALID_SLOT if there are none.
+   */
+  SlotId first_free_slot;
 
   /**
    * Number of slots currently allocated.  This number may include slots which
@@ -49,6 +79,18 @@ struct PageHeader {
    */
   SlotId num_free_slots;
 
+  /**
+   * Layout of the slot array: Page::WIDE_SLOTS or Page::PACKED_SLOTS.
+   */
+  std::uint16_t slot_format;
+
+  /**
+   * Length of the compressed data of the page as stored in a file with
+   * File::FLAG_COMPRESSED, or 0 if the data is stored as it is.  Always 0 in
+   * memory.
+   */
+  PageOffset compressed_length;
+
   /**
    * Number of the page within the file.
    */
@@ -59,6 +101,23 @@ struct PageHeader {
    */
   PageId next_page_number;
 
+  /**
+   * Number of the previous used page in the file.
+   */
+  PageId prev_page_number;
+
+  /**
+   * CRC-32C of the page as written to a file with checksums, or 0.  Covers
+   * the whole page except this field and the list links, which the file
+   * updates in place.
+   */
+  std::uint32_t checksum;
+
+  /**
+   * LSN of the last logged change to the page, or 0.  See LogManager.
+   */
+  Lsn lsn;
+
   /**
    * Returns true if this page header is equal to the other.
    *
@@ -68,12 +127,16 @@ struct PageHeader {
   bool operator==(const PageHeader &rhs) const {
     return num_slots == rhs.num_slots && num_free_slots == rhs.num_free_slots &&
            current_page_number == rhs.current_page_number &&
-           next_page_number == rhs.next_page_number;
+           next_page_number == rhs.next_page_number &&
+           prev_page_number == rhs.prev_page_number;
   }
 };
 
 /**
  * @brief Slot metadata that tracks where a record is in the data space.
+ *
+ * This is also how a slot is stored on a page with Page::WIDE_SLOTS, where
+ * padding makes it six bytes (twelve on pages larger than 32 KB).
  */
 struct PageSlot {
   /**
@@ -83,14 +146,58 @@ struct PageSlot {
   bool used;
 
   /**
-   * Offset of the data item in the page.
+   * Offset of the data item in the page.  In an unused slot, the next slot of
+   * the free slot chain.
+   */
+  PageOffset item_offset;
+
+  /**
+   * Length of the data item in this slot.  In an unused slot, the previous
+   * slot of the free slot chain.
+   */
+  PageOffset item_length;
+};
+
+/**
+ * @brief How a slot is stored on a page with Page::PACKED_SLOTS.
+ *
+ * The used flag takes the top bit of the offset, which still addresses any
+ * byte of the page, so the slot fits in four bytes (eight on pages larger than
+ * 32 KB).
+ */
+struct PackedPageSlot {
+  /**
+   * Bit of offset_and_used that is set if the slot currently holds data.
    */
-  std::uint16_t item_offset;
+  static const PageOffset USED = PageOffset(1)
+                                 << (8 * sizeof(PageOffset) - 1);
 
   /**
-   * Length of the data item in this slot.
+   * PageSlot::item_offset, with PageSlot::used as the USED bit.
    */
-  std::uint16_t item_length;
+  PageOffset offset_and_used;
+
+  /**
+   * PageSlot::item_length.
+   */
+  PageOffset item_length;
+};
+
+/**
+ * @brief Location of a record's data inside a page image.
+ *
+ * Valid until the page is next modified.
+ */
+struct RecordSpan {
+  /**
+   * First byte of the record.
+   */
+  const char *data;
+
+  /**
+   * Length of the record in bytes.
+   */
+  PageOffset length;
 };
 
 class PageIterator;
@@ -103,15 +210,21 @@ class PageIterator;
  * slots and identified by a RecordId.  Although a record's actual contents may
  * be moved on the page, accessing a record by its slot is consistent.
  *
+ * The page header and data are kept together in one image of SIZE bytes, laid
+ * out exactly as the page is stored on disk.  A page normally owns its image;
+ * a page created with view() instead works on an image in memory owned by
+ * someone else, such as a frame of the buffer pool.  Copying into a viewing
+ * page overwrites the viewed bytes rather than making the page own a copy.
+ *
  * @warning This class is not threadsafe.
  */
 class Page {
  public:
   /**
-   * Page size in bytes.  If this is changed, database files created with a
-   * different page size value will be unreadable by the resulting binaries.
+   * Page size in bytes, BADGERDB_PAGE_SIZE.  Files record the page size they
+   * were created with, and cannot be opened by binaries built for another.
    */
-  static const std::size_t SIZE = 8192;
+  static const std::size_t SIZE = BADGERDB_PAGE_SIZE;
 
   /**
    * Size of page free space area in bytes.
@@ -128,11 +241,75 @@ class Page {
    */
   static const SlotId INVALID_SLOT = 0;
 
+  /**
+   * Alignment of page images in memory, suitable for direct I/O.
+   */
+  static const std::size_t ALIGNMENT = 4096;
+
+  /**
+   * Slot format of pages whose slots are stored as PageSlot.
+   */
+  static const std::uint16_t WIDE_SLOTS = 0;
+
+  /**
+   * Slot format of pages whose slots are stored as PackedPageSlot.  New pages
+   * are created with this format.
+   */
+  static const std::uint16_t PACKED_SLOTS = 1;
+
   /**
    * Constructs a new, uninitialized page.
    */
   Page();
 
+  /**
+   * Constructs a page that owns a copy of the other page's contents.
+   *
+   * @param other Page to copy.
+   */
+  Page(const Page &other);
+
+  /**
+   * Constructs a page from a temporary page.  Takes over the other page's
+   * image, so a page made from a viewing page views the same bytes.
+   *
+   * @param other Page to move from.
+   */
+  Page(Page &&other);
+
+  /**
+   * Replaces the contents of this page with those of the other page.
+   *
+   * @param rhs Page to copy.
+   * @return  This page.
+   */
+  Page &operator=(const Page &rhs);
+
+  /**
+   * Replaces the contents of this page with those of a temporary page.  The
+   * images are swapped if both pages own theirs; otherwise the bytes are
+   * copied so that a viewing page keeps viewing the same memory.
+   *
+   * @param rhs Page to move from.
+   * @return  This page.
+   */
+  Page &operator=(Page &&rhs);
+
+  /**
+   * Releases the image of the page if the page owns it.
+   */
+  ~Page();
+
+  /**
+   * Returns a page that works on the given image of SIZE bytes instead of
+   * owning one.  The image is initialized as an empty page and must outlive
+   * the returned page.
+   *
+   * @param image Memory holding the page image, aligned to ALIGNMENT.
+   * @return  Page viewing the image.
+   */
+  static Page view(char *image);
+
   /**
    * Inserts a new record into the page.
    *
@@ -141,6 +318,19 @@ class Page {
    */
   RecordId insertRecord(const std::string &record_data);
 
+  /**
+   * Inserts records into the page in order, for as long as they fit.  Stops at
+   * the first record that does not fit, so records keep their order across
+   * pages when a caller moves on to another page.
+   *
+   * @param records     Records to insert.
+   * @param count       Number of records.
+   * @param record_ids  If not null, receives the ID of each inserted record.
+   * @return  Number of records inserted, from the start of records.
+   */
+  std::size_t insertRecords(const RecordSpan *records, const std::size_t count,
+                            RecordId *record_ids = nullptr);
+
   /**
    * Returns the record with the given ID.  Returned data is a copy of what is
    * stored on the page; use updateRecord to change it.
@@ -151,10 +341,20 @@ class Page {
    */
   std::string getRecord(const RecordId &record_id) const;
 
+  /**
+   * Returns where the data of the record with the given ID is on the page,
+   * without copying it.
+   *
+   * @param record_id  ID of the record to return.
+   * @return  Location of the record's data, valid until the page is modified.
+   */
+  RecordSpan getRecordSpan(const RecordId &record_id) const;
+
   /**
    * Updates the record with the given ID, replacing its data with a new
-   * version.  This is equivalent to deleting the old record and inserting a
-   * new one, with the exception that the record ID will not change.
+   * version.  This is equivalent to deleting the old record lazily and
+   * inserting a new one, with the exception that the record ID will not
+   * change.
    *
    * @param record_id   ID of record to update.
    * @param record_data Updated bytes that compose the record.
@@ -170,6 +370,16 @@ class Page {
    */
   void deleteRecord(const RecordId &record_id);
 
+  /**
+   * Deletes the record with the given ID without moving the data of any other
+   * record.  The hole left behind counts as free space and is reclaimed the
+   * next time an insert or update needs it, by compacting the page in one
+   * pass.  Slot array is compacted as with deleteRecord().
+   *
+   * @param record_id   ID of the record to delete.
+   */
+  void deleteRecordLazily(const RecordId &record_id);
+
   /**
    * Returns true if the page has enough free space to hold the given data.
    *
@@ -179,12 +389,13 @@ class Page {
   bool hasSpaceForRecord(const std::string &record_data) const;
 
   /**
-   * Returns this page's free space in bytes.
+   * Returns this page's free space in bytes, including holes left by lazy
+   * deletes.
    *
    * @return  Free space in bytes.
    */
-  std::uint16_t getFreeSpace() const {
-    return header_.free_space_upper_bound - header_.free_space_lower_bound;
+  PageOffset getFreeSpace() const {
+    return getContiguousFreeSpace() + header_->fragmented_space;
   }
 
   /**
@@ -192,14 +403,30 @@ class Page {
    *
    * @return  Page number.
    */
-  PageId page_number() const { return header_.current_page_number; }
+  PageId page_number() const { return header_->current_page_number; }
 
   /**
    * Returns the number of the next used page this page in its file.
    *
    * @return  Page number of next used page in file.
    */
-  PageId next_page_number() const { return header_.next_page_number; }
+  PageId next_page_number() const { return header_->next_page_number; }
+
+  /**
+   * Returns the number of the previous used page before this page in its
+   * file.
+   *
+   * @return  Page number of previous used page in file.
+   */
+  PageId prev_page_number() const { return header_->prev_page_number; }
+
+  /**
+   * Returns the LSN of the last logged change to this page.
+   *
+   * @return  LSN of the change, or 0 if the page was never changed through
+   *          the log.
+   */
+  Lsn lsn() const { return header_->lsn; }
 
   /**
    * Returns an iterator at the first record in the page.
@@ -219,8 +446,10 @@ class Page {
  private:
   /**
    * Initializes this page as a new page with no header information or data.
+   *
+   * @param slot_format Layout of the slot array, WIDE_SLOTS or PACKED_SLOTS.
    */
-  void initialize();
+  void initialize(const std::uint16_t slot_format = PACKED_SLOTS);
 
   /**
    * Sets this page's number in its file.
@@ -228,7 +457,7 @@ class Page {
    * @param page_number   Number of page in file.
    */
   void set_page_number(const PageId new_page_number) {
-    header_.current_page_number = new_page_number;
+    header_->current_page_number = new_page_number;
   }
 
   /**
@@ -237,9 +466,25 @@ class Page {
    * @param next_page_number  Page number of next used page in file.
    */
   void set_next_page_number(const PageId new_next_page_number) {
-    header_.next_page_number = new_next_page_number;
+    header_->next_page_number = new_next_page_number;
+  }
+
+  /**
+   * Sets the number of the previous used page before this page in its file.
+   *
+   * @param prev_page_number  Page number of previous used page in file.
+   */
+  void set_prev_page_number(const PageId new_prev_page_number) {
+    header_->prev_page_number = new_prev_page_number;
   }
 
+  /**
+   * Sets the LSN of the last logged change to this page.
+   *
+   * @param new_lsn   LSN of the change.
+   */
+  void set_lsn(const Lsn new_lsn) { header_->lsn = new_lsn; }
+
   /**
    * Deletes the record with the given ID.  Page is compacted upon delete to
    * ensure that data of all records is contiguous.  Slot array is compacted if
@@ -254,30 +499,92 @@ class Page {
                     const bool allow_slot_compaction);
 
   /**
-   * Returns the slot with the given number.  This method will return
-   * unallocated slots if requested; it is up to the caller to ensure they
-   * have a valid slot number.
+   * Deletes the record with the given ID, leaving a hole unless the record
+   * borders the free space.  Behaves like deleteRecordLazily() otherwise.
    *
-   * @param slot_number   Number of slot to retrieve.
-   * @return  Pointer to the slot.
+   * @param record_id             ID of the record to delete.
+   * @param allow_slot_compaction If true, the slot array will be compacted if
+   *                              possible.
+   */
+  void deleteRecordLazily(const RecordId &record_id,
+                          const bool allow_slot_compaction);
+
+  /**
+   * Marks a slot whose data has been removed as unused, and frees the unused
+   * slots at the end of the slot array if <allow_slot_compaction> is set and
+   * the slot is the last one.
+   *
+   * @param slot_number           Number of the slot.
+   * @param allow_slot_compaction If true, the slot array will be compacted if
+   *                              possible.
+   */
+  void releaseSlot(const SlotId slot_number, const bool allow_slot_compaction);
+
+  /**
+   * Returns the free space between the slot array and the record data.
+   *
+   * @return  Contiguous free space in bytes.
+   */
+  PageOffset getContiguousFreeSpace() const {
+    return header_->free_space_upper_bound - header_->free_space_lower_bound;
+  }
+
+  /**
+   * Moves the data of all records to the end of the page, closing the holes
+   * left by lazy deletes so that all free space is contiguous.  Records that
+   * are already adjacent are moved together with a single memmove.
    */
-  PageSlot *getSlot(const SlotId slot_number);
+  void compact();
 
   /**
-   * Returns the slot with the given number.  This method will return
-   * unallocated slots if requested; it is up to the caller to ensure they
-   * have a valid slot number.
+   * Returns the size of a slot in the slot array of this page.
+   *
+   * @return  Slot size in bytes.
+   */
+  std::size_t slotSize() const {
+    return header_->slot_format == PACKED_SLOTS ? sizeof(PackedPageSlot)
+                                                : sizeof(PageSlot);
+  }
+
+  /**
+   * Returns the slot with the given number, decoded from the slot format of
+   * the page.  This method will return unallocated slots if requested; it is
+   * up to the caller to ensure they have a valid slot number.
    *
    * @param slot_number   Number of slot to retrieve.
-   * @return  The slot.
+   * @return  Copy of the slot.
+   */
+  PageSlot getSlot(const SlotId slot_number) const;
+
+  /**
+   * Stores the slot with the given number in the slot format of the page.
+   *
+   * @param slot_number   Number of slot to store.
+   * @param slot          New contents of the slot.
    */
-  const PageSlot *getSlot(const SlotId slot_number) const;
+  void setSlot(const SlotId slot_number, const PageSlot &slot);
 
   /**
-   * Returns the slot number of an available slot.  If no slots are available
-   * to be reused, allocates a new slot.  Updates available slot count in the
-   * header metadata, but does not mark returned slot as used.  If a new slot is
-   * allocated, updates the free space lower bound.
+   * Adds an unused slot to the front of the free slot chain and counts it as
+   * free.
+   *
+   * @param slot_number   Number of the slot.
+   */
+  void pushFreeSlot(const SlotId slot_number);
+
+  /**
+   * Takes an unused slot out of the free slot chain and stops counting it as
+   * free.
+   *
+   * @param slot_number   Number of the slot.
+   */
+  void unlinkFreeSlot(const SlotId slot_number);
+
+  /**
+   * Returns the slot number of an available slot, in constant time.  If no
+   * slots are available to be reused, allocates a new slot.  Updates available
+   * slot count in the header metadata, but does not mark returned slot as
+   * used.  If a new slot is allocated, updates the free space lower bound.
    *
    * Callers are responsible for making sure there is enough space to allocate a
    * new slot before calling this method.
@@ -305,6 +612,28 @@ class Page {
   void insertRecordInSlot(const SlotId slot_number,
                           const std::string &record_data);
 
+  /**
+   * Inserts record data given as a pointer and length into the given slot.
+   * Behaves like insertRecordInSlot(slot_number, record_data) otherwise.
+   *
+   * @param slot_number   Number of slot to insert record into.
+   * @param data          First byte of the record.
+   * @param length        Length of the record in bytes.
+   */
+  void insertRecordInSlot(const SlotId slot_number, const char *data,
+                          const std::size_t length);
+
+  /**
+   * Returns the space a record of the given length takes up when inserted,
+   * including a new slot if no free slot can be reused.
+   *
+   * @param length  Length of the record in bytes.
+   * @return  Space needed in bytes.
+   */
+  std::size_t spaceForRecord(const std::size_t length) const {
+    return header_->num_free_slots == 0 ? length + slotSize() : length;
+  }
+
   /**
    * Throws an exception if the given record ID is not valid for this page
    * (i.e., it has the right page number and the slot it references is in use).
@@ -323,25 +652,62 @@ class Page {
   bool isUsed() const { return page_number() != INVALID_NUMBER; }
 
   /**
-   * Header metadata.
+   * Constructs a page viewing the given image without initializing it.
+   *
+   * @param image Memory holding the page image.
    */
-  PageHeader header_;
+  explicit Page(char *image);
 
   /**
-   * Data stored on the page.  Includes bookkeeping information about slots as
-   * well as actual content.
+   * Points the page at the given image.
+   *
+   * @param image   Memory holding the page image.
+   * @param owned   Whether the page is responsible for freeing the image.
+   */
+  void attach(char *image, const bool owned);
+
+  /**
+   * Page image of SIZE bytes: the header followed by the data.
+   */
+  char *image_;
+
+  /**
+   * Whether image_ was allocated by and belongs to this page.
    */
+  bool owns_image_;
 
-  std::string data_;
+  /**
+   * Header metadata, at the start of image_.
+   */
+  PageHeader *header_;
+
+  /**
+   * Data stored on the page.  Includes bookkeeping information about slots as
+   * well as actual content.  Follows the header in image_.
+   */
+  char *data_;
 
   friend class File;
+  friend class BufMgr;
+  friend class BTreeIndex;
+  friend class HashIndex;
+  friend class LogManager;
   friend class PageIterator;
+  friend class PaxPage;
+  friend class VictimCache;
   friend class PageTest;
   friend class BufferTest;
 };
 
+static_assert(Page::SIZE >= 4096 && Page::SIZE <= 65536 &&
+                  (Page::SIZE & (Page::SIZE - 1)) == 0,
+              "Page size must be a power of two from 4 KB to 64 KB.");
+static_assert(Page::SIZE % Page::ALIGNMENT == 0,
+              "Pages must stay aligned for direct I/O.");
 static_assert(Page::SIZE > sizeof(PageHeader),
               "Page size must be large enough to hold header and data.");
 static_assert(Page::DATA_SIZE > 0, "Page must have some space to hold data.");
+static_assert(Page::DATA_SIZE <= PackedPageSlot::USED,
+              "Packed slots must be able to address all data on a page.");
 
 }  // namespace badgerdb
@@ -0,0 +1,138 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "page_fetcher.h"
+
+#include "exceptions/buffer_exceeded_exception.h"
+
+namespace badgerdb {
+
+const std::size_t PageFetcher::DEFAULT_MAX_IN_FLIGHT;
+
+PageFetcher::PageFetcher(BufMgr &bufMgr, const std::size_t maxInFlight)
+    : bufMgr(bufMgr), maxInFlight(maxInFlight > 0 ? maxInFlight : 1) {}
+
+PageFetcher::~PageFetcher() {
+  // Every read in flight hands its batch to the queue exactly once, and its
+  // frame stays latched until the read is completed
+  while (!reads.empty()) {
+    complete(readsByBatch.at(completions.pop()));
+  }
+}
+
+void PageFetcher::fetch(File &file, const PageId pageNo,
+                        Continuation continuation) {
+  if (reads.size() >= maxInFlight) {
+    deferred.push_back({&file, pageNo, std::move(continuation)});
+    return;
+  }
+  if (!start(file, pageNo, continuation)) {
+    deferred.push_back({&file, pageNo, std::move(continuation)});
+  }
+}
+
+bool PageFetcher::start(File &file, const PageId pageNo,
+                        Continuation &continuation) {
+  // A page already being read is handed to every fetch of it
+  const std::pair<FileId, PageId> key(file.id(), pageNo);
+  std::map<std::pair<FileId, PageId>, std::list<Read>::iterator>::iterator
+      reading = readsByPage.find(key);
+  if (reading != readsByPage.end()) {
+    reading->second->continuations.push_back(std::move(continuation));
+    return true;
+  }
+
+  reads.emplace_back();
+  std::list<Read>::iterator read = std::prev(reads.end());
+  read->file = &file;
+  read->pageNo = pageNo;
+  read->start = std::chrono::steady_clock::now();
+  read->batch.notify(completions);
+  bool pinned;
+  try {
+    pinned = bufMgr.startRead(file, pageNo, read->batch, read->frameNo);
+  } catch (const BufferExceededException &) {
+    reads.erase(read);
+    // Frames free up as reads in flight complete and as continuations
+    // release their pages
+    if (reads.empty() && ready.empty()) throw;
+    return false;
+  } catch (...) {
+    // Reported by run() like a failed read
+    reads.erase(read);
+    if (!error) error = std::current_exception();
+    return true;
+  }
+
+  if (pinned) {
+    const FrameId frameNo = read->frameNo;
+    reads.erase(read);
+    ready.push_back({bufMgr.guardFrame(frameNo), std::move(continuation)});
+    return true;
+  }
+  read->continuations.push_back(std::move(continuation));
+  readsByPage[key] = read;
+  readsByBatch[&read->batch] = read;
+  return true;
+}
+
+void PageFetcher::complete(std::list<Read>::iterator read) {
+  try {
+    PageGuard page = bufMgr.finishRead(
+        *read->file, read->pageNo, read->frameNo,
+        read->batch.result(0) == static_cast<long>(Page::SIZE), read->start);
+    ready.push_back({std::move(page), std::move(read->continuations[0])});
+    // Every further fetch of the page takes a pin of its own
+    for (std::size_t i = 1; i < read->continuations.size(); i++) {
+      ready.push_back({bufMgr.readPage(*read->file, read->pageNo),
+                       std::move(read->continuations[i])});
+    }
+  } catch (...) {
+    if (!error) error = std::current_exception();
+  }
+  readsByPage.erase(std::make_pair(read->file->id(), read->pageNo));
+  readsByBatch.erase(&read->batch);
+  reads.erase(read);
+}
+
+std::size_t PageFetcher::run() {
+  std::size_t ran = 0;
+  while (true) {
+    while (!ready.empty()) {
+      Ready next = std::move(ready.front());
+      ready.pop_front();
+      next.continuation(std::move(next.page));
+      ran++;
+    }
+
+    while (!deferred.empty() && reads.size() < maxInFlight) {
+      Deferred next = std::move(deferred.front());
+      deferred.pop_front();
+      if (!start(*next.file, next.pageNo, next.continuation)) {
+        deferred.push_front(std::move(next));
+        break;
+      }
+    }
+    if (!ready.empty()) {
+      continue;
+    }
+    if (reads.empty()) {
+      break;
+    }
+    complete(readsByBatch.at(completions.pop()));
+  }
+
+  if (error) {
+    std::exception_ptr failure = error;
+    error = nullptr;
+    std::rethrow_exception(failure);
+  }
+  return ran;
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,189 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <list>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "async_io.h"
+#include "buffer.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Overlaps the page reads of many lookups on a single thread
+ *
+ * fetch() asks for a page and names the continuation that uses it.  A page
+ * in the buffer pool is pinned right away.  For a miss a frame is claimed
+ * and the page is read through the I/O engine of the buffer manager (see
+ * BufMgrOptions::ioEngine), so that the thread goes on with other lookups
+ * instead of blocking on the read.  run() hands every page to its
+ * continuation once it is there, and continuations may fetch further pages:
+ * a lookup that descends an index is written as a chain of continuations,
+ * and any number of such lookups proceed at once.
+ *
+ * Without an I/O engine, and for compressed or mapped files, misses are read
+ * synchronously within fetch().
+ *
+ * A fetcher belongs to a single thread and a single BufMgr.  File objects
+ * must stay valid until their fetches have completed.
+ */
+class PageFetcher {
+ public:
+  /**
+   * Code that uses a fetched page; the guard holds a pin on it
+   */
+  typedef std::function<void(PageGuard page)> Continuation;
+
+  /**
+   * Default number of reads in flight at once
+   */
+  static const std::size_t DEFAULT_MAX_IN_FLIGHT = 64;
+
+  /**
+   * Constructor of PageFetcher class
+   *
+   * @param bufMgr      Buffer manager to read the pages through
+   * @param maxInFlight Number of reads in flight at once; further fetches
+   *                    wait until earlier ones complete.  Every read holds
+   *                    a frame of the buffer pool.
+   */
+  explicit PageFetcher(BufMgr& bufMgr,
+                       const std::size_t maxInFlight = DEFAULT_MAX_IN_FLIGHT);
+
+  PageFetcher(const PageFetcher&) = delete;
+  PageFetcher& operator=(const PageFetcher&) = delete;
+
+  /**
+   * Waits for the reads in flight.  Continuations that have not run are
+   * dropped.
+   */
+  ~PageFetcher();
+
+  /**
+   * Asks for a page.  The continuation runs within run(), never within
+   * fetch() itself, and run() also reports a failure to read the page.
+   *
+   * @param file          File object
+   * @param pageNo        Page number
+   * @param continuation  Code to hand the page to
+   * @throws  BufferExceededException If no frame is free and no other fetch
+   * holds a frame that could be waited for
+   */
+  void fetch(File& file, const PageId pageNo, Continuation continuation);
+
+  /**
+   * Runs continuations until every fetch, including those made by the
+   * continuations, has completed.  A fetch that fails does not stop the
+   * others; the first failure is rethrown once they have completed.
+   * Exceptions thrown by continuations leave run() right away, and run()
+   * may be called again to go on.
+   *
+   * @return  Number of continuations run
+   * @throws  InvalidPageException If a fetched page does not exist
+   * @throws  CorruptPageException If a fetched page does not match its
+   * checksum
+   */
+  std::size_t run();
+
+  /**
+   * Returns the number of reads in flight.
+   */
+  std::size_t inFlight() const { return reads.size(); }
+
+ private:
+  /**
+   * A read in flight and the continuations waiting for its page
+   */
+  struct Read {
+    File* file;
+    PageId pageNo;
+    FrameId frameNo;
+    std::chrono::steady_clock::time_point start;
+    IoBatch batch;
+    std::vector<Continuation> continuations;
+  };
+
+  /**
+   * A pinned page whose continuation has not run yet
+   */
+  struct Ready {
+    PageGuard page;
+    Continuation continuation;
+  };
+
+  /**
+   * A fetch that waits for a read to complete before it is started
+   */
+  struct Deferred {
+    File* file;
+    PageId pageNo;
+    Continuation continuation;
+  };
+
+  /**
+   * Starts a fetch.
+   *
+   * @return  False if no frame was free, in which case the fetch has been
+   * deferred until another read completes
+   */
+  bool start(File& file, const PageId pageNo, Continuation& continuation);
+
+  /**
+   * Completes a read whose batch has completed and queues its
+   * continuations.
+   */
+  void complete(std::list<Read>::iterator read);
+
+  /**
+   * Buffer manager the pages are read through
+   */
+  BufMgr& bufMgr;
+
+  /**
+   * Number of reads in flight at once
+   */
+  std::size_t maxInFlight;
+
+  /**
+   * Reads in flight, by page and by batch
+   */
+  std::list<Read> reads;
+  std::map<std::pair<FileId, PageId>, std::list<Read>::iterator> readsByPage;
+  std::map<const IoBatch*, std::list<Read>::iterator> readsByBatch;
+
+  /**
+   * Batches of the reads in flight as they complete
+   */
+  IoCompletionQueue completions;
+
+  /**
+   * Pages whose continuation is next, in order
+   */
+  std::deque<Ready> ready;
+
+  /**
+   * Fetches waiting for a read to complete
+   */
+  std::deque<Deferred> deferred;
+
+  /**
+   * First failed read of the current run()
+   */
+  std::exception_ptr error;
+};
+
+}  // namespace badgerdb
@@ -99,6 +99,15 @@ class PageIterator {
     return page_->getRecord(current_record_);
   }
 
+  /**
+   * Returns where the current record is in the page, without copying it.
+   *
+   * @return  Location of the record's data.
+   */
+  inline RecordSpan span() const {
+    return page_->getRecordSpan(current_record_);
+  }
+
   /**
    * Returns the next used slot in the page after the given slot or
    * Page::INVALID_SLOT if no slots are used after the given slot.
@@ -107,10 +116,14 @@ class PageIterator {
    * @return  Next used slot after given slot or Page::INVALID_SLOT.
    */
   SlotId getNextUsedSlot(const SlotId start) const {
+    if (page_->header_->num_free_slots == 0) {
+      // Every allocated slot is used
+      return start < page_->header_->num_slots ? start + 1
+                                               : Page::INVALID_SLOT;
+    }
     SlotId slot_number = Page::INVALID_SLOT;
-    for (SlotId i = start + 1; i <= page_->header_.num_slots; ++i) {
-      const PageSlot *slot = page_->getSlot(i);
-      if (slot->used) {
+    for (SlotId i = start + 1; i <= page_->header_->num_slots; ++i) {
+      if (page_->getSlot(i).used) {
         slot_number = i;
         break;
       }
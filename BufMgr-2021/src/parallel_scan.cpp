@@ -0,0 +1,85 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "parallel_scan.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "exceptions/invalid_page_exception.h"
+
+namespace badgerdb {
+
+ParallelScan::ParallelScan(BufMgr& bufMgr, File& file, unsigned numWorkers,
+                           std::uint32_t morselPages)
+    : bufMgr(bufMgr),
+      file(file),
+      numWorkers(numWorkers),
+      morselPages(std::max(morselPages, 1u)),
+      nextPage(Page::INVALID_NUMBER),
+      endPage(Page::INVALID_NUMBER),
+      failed(false) {
+  if (this->numWorkers == 0) {
+    this->numWorkers = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+}
+
+void ParallelScan::run(const PageCallback& callback) {
+  // Page 0 holds the file header
+  nextPage = 1;
+  endPage = file.num_pages();
+  failed = false;
+  error = nullptr;
+
+  std::vector<std::thread> threads;
+  for (unsigned worker = 1; worker < numWorkers; worker++) {
+    threads.push_back(
+        std::thread(&ParallelScan::work, this, worker, std::cref(callback)));
+  }
+  work(0, callback);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void ParallelScan::work(const unsigned worker, const PageCallback& callback) {
+  try {
+    while (!failed) {
+      const PageId first = nextPage.fetch_add(morselPages);
+      if (first >= endPage) {
+        return;
+      }
+      const PageId last = std::min(first + morselPages, endPage);
+      bufMgr.prefetch(file, first, last - first);
+
+      for (PageId pageNo = first; pageNo < last && !failed; pageNo++) {
+        PageGuard page;
+        try {
+          page = bufMgr.readPage(file, pageNo);
+        } catch (const InvalidPageException&) {
+          // Free page
+          continue;
+        }
+        callback(worker, *page);
+      }
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> errorGuard(errorLatch);
+    if (!error) {
+      error = std::current_exception();
+    }
+    failed = true;
+  }
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,131 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+
+#include "buffer.h"
+#include "file.h"
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Scans the pages of a file with a pool of worker threads
+ *
+ * The pages of the file are split into morsels of consecutive page numbers
+ * that the workers claim one at a time, so a worker held up by slow pages
+ * does not hold up the others.  A worker prefetches its morsel through the
+ * buffer manager, with one read per run of pages not in the buffer pool, and
+ * then pins, processes and unpins the pages in order.  Free pages are
+ * skipped.
+ *
+ * Pages are visited in no particular order.  Pages allocated while a scan
+ * runs may or may not be visited.
+ */
+class ParallelScan {
+ public:
+  /**
+   * Function called for each used page, from the worker that read it.  The
+   * page stays pinned for the duration of the call.  Calls from different
+   * workers run at the same time; the worker number, from 0 to workers() - 1,
+   * lets callers keep per worker state without latching.
+   */
+  typedef std::function<void(unsigned worker, const Page& page)> PageCallback;
+
+  /**
+   * Default number of pages in a morsel
+   */
+  static const std::uint32_t DEFAULT_MORSEL_PAGES = 16;
+
+  /**
+   * Constructor of ParallelScan class
+   *
+   * @param bufMgr      Buffer manager the pages are read through
+   * @param file        File to scan.  Must outlive the scan.
+   * @param numWorkers  Number of worker threads, or 0 for one per hardware
+   * thread
+   * @param morselPages Number of pages a worker claims at a time
+   */
+  ParallelScan(BufMgr& bufMgr, File& file, unsigned numWorkers = 0,
+               std::uint32_t morselPages = DEFAULT_MORSEL_PAGES);
+
+  ParallelScan(const ParallelScan&) = delete;
+  ParallelScan& operator=(const ParallelScan&) = delete;
+
+  /**
+   * Calls the callback for every used page of the file and returns once all
+   * of them have been processed.  The calling thread is one of the workers.
+   *
+   * If the callback or a read throws, the workers stop after the page they
+   * are on and the first exception is rethrown.
+   *
+   * @param callback  Function to call for each page
+   */
+  void run(const PageCallback& callback);
+
+  /**
+   * Returns the number of worker threads.
+   */
+  unsigned workers() const { return numWorkers; }
+
+ private:
+  /**
+   * Claims and processes morsels until there are none left or the scan
+   * failed.
+   *
+   * @param worker    Number of the worker
+   * @param callback  Function to call for each page
+   */
+  void work(const unsigned worker, const PageCallback& callback);
+
+  /**
+   * Buffer manager the pages are read through
+   */
+  BufMgr& bufMgr;
+
+  /**
+   * File being scanned
+   */
+  File& file;
+
+  /**
+   * Number of worker threads, including the one calling run()
+   */
+  unsigned numWorkers;
+
+  /**
+   * Number of pages a worker claims at a time
+   */
+  std::uint32_t morselPages;
+
+  /**
+   * First page of the next morsel, and the page where the scan ends
+   */
+  std::atomic<PageId> nextPage;
+  PageId endPage;
+
+  /**
+   * Set once a worker has failed, so that the others stop
+   */
+  std::atomic<bool> failed;
+
+  /**
+   * First exception thrown by a worker, guarded by errorLatch
+   */
+  std::exception_ptr error;
+  std::mutex errorLatch;
+};
+
+}  // namespace badgerdb
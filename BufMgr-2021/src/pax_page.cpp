@@ -0,0 +1,451 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "pax_page.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#include "exceptions/page_format_exception.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Identifies a columnar page; "BPAX" in little-endian order
+ */
+const std::uint32_t PAX_MAGIC = 0x58415042;
+
+/**
+ * Alignment of the minipages within the page image, in bytes
+ */
+const std::size_t MINIPAGE_ALIGNMENT = 32;
+
+/**
+ * Start of the data area of a columnar page
+ */
+struct PaxHeader {
+  std::uint32_t magic;
+  std::uint16_t numColumns;
+  std::uint16_t reserved;
+  std::uint32_t capacity;
+  std::uint32_t rows;
+  std::uint8_t types[PaxPage::MAX_COLUMNS];
+
+  /**
+   * Start of the minipage of every column in the data area
+   */
+  std::uint16_t offsets[PaxPage::MAX_COLUMNS];
+};
+
+static_assert(sizeof(PaxHeader) < Page::DATA_SIZE / 4,
+              "Columnar page header must leave room for rows.");
+
+std::size_t widthOf(const PaxType type) {
+  return type == PaxType::INT32 ? sizeof(std::int32_t) : sizeof(std::int64_t);
+}
+
+/**
+ * Running aggregates of a column
+ */
+struct Totals {
+  std::uint64_t count = 0;
+  std::uint64_t sum = 0;
+  std::int64_t min = std::numeric_limits<std::int64_t>::max();
+  std::int64_t max = std::numeric_limits<std::int64_t>::min();
+};
+
+/**
+ * Returns a bit for each of the first count values, set if it lies in the
+ * range.
+ */
+template <typename T>
+std::uint64_t rangeBits(const T *values, const std::uint32_t count,
+                        const T low, const T high) {
+  std::uint64_t bits = 0;
+  for (std::uint32_t i = 0; i < count; i++) {
+    bits |= std::uint64_t(values[i] >= low && values[i] <= high) << i;
+  }
+  return bits;
+}
+
+/**
+ * rangeBits() of a full word of 64 values
+ */
+template <typename T>
+std::uint64_t rangeWord(const T *values, const T low, const T high) {
+  return rangeBits(values, 64, low, high);
+}
+
+/**
+ * Adds a block of 64 values, all selected, to the totals.
+ */
+template <typename T>
+void addBlock(const T *values, Totals &totals) {
+  std::int64_t min = totals.min;
+  std::int64_t max = totals.max;
+  std::uint64_t sum = 0;
+  for (int i = 0; i < 64; i++) {
+    sum += static_cast<std::uint64_t>(values[i]);
+    min = std::min<std::int64_t>(min, values[i]);
+    max = std::max<std::int64_t>(max, values[i]);
+  }
+  totals.count += 64;
+  totals.sum += sum;
+  totals.min = min;
+  totals.max = max;
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("avx2"))) std::uint64_t rangeWordAvx2(
+    const std::int32_t *values, const std::int32_t low,
+    const std::int32_t high) {
+  const __m256i lows = _mm256_set1_epi32(low);
+  const __m256i highs = _mm256_set1_epi32(high);
+  std::uint64_t bits = 0;
+  for (int i = 0; i < 64; i += 8) {
+    const __m256i vector =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+    const __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(lows, vector),
+                                            _mm256_cmpgt_epi32(vector, highs));
+    const unsigned inside =
+        ~_mm256_movemask_ps(_mm256_castsi256_ps(outside)) & 0xFF;
+    bits |= std::uint64_t(inside) << i;
+  }
+  return bits;
+}
+
+__attribute__((target("avx2"))) std::uint64_t rangeWordAvx2(
+    const std::int64_t *values, const std::int64_t low,
+    const std::int64_t high) {
+  const __m256i lows = _mm256_set1_epi64x(low);
+  const __m256i highs = _mm256_set1_epi64x(high);
+  std::uint64_t bits = 0;
+  for (int i = 0; i < 64; i += 4) {
+    const __m256i vector =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+    const __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi64(lows, vector),
+                                            _mm256_cmpgt_epi64(vector, highs));
+    const unsigned inside =
+        ~_mm256_movemask_pd(_mm256_castsi256_pd(outside)) & 0xF;
+    bits |= std::uint64_t(inside) << i;
+  }
+  return bits;
+}
+
+__attribute__((target("avx2"))) void addBlockAvx2(const std::int32_t *values,
+                                                  Totals &totals) {
+  __m256i sums = _mm256_setzero_si256();
+  __m256i mins = _mm256_set1_epi32(std::numeric_limits<std::int32_t>::max());
+  __m256i maxs = _mm256_set1_epi32(std::numeric_limits<std::int32_t>::min());
+  for (int i = 0; i < 64; i += 8) {
+    const __m256i vector =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+    // Summed as 64-bit lanes so that the block cannot overflow
+    sums = _mm256_add_epi64(
+        sums, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(vector)));
+    sums = _mm256_add_epi64(
+        sums, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(vector, 1)));
+    mins = _mm256_min_epi32(mins, vector);
+    maxs = _mm256_max_epi32(maxs, vector);
+  }
+  std::int64_t sumLanes[4];
+  std::int32_t minLanes[8];
+  std::int32_t maxLanes[8];
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(sumLanes), sums);
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(minLanes), mins);
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(maxLanes), maxs);
+  for (int i = 0; i < 4; i++) {
+    totals.sum += static_cast<std::uint64_t>(sumLanes[i]);
+  }
+  for (int i = 0; i < 8; i++) {
+    totals.min = std::min<std::int64_t>(totals.min, minLanes[i]);
+    totals.max = std::max<std::int64_t>(totals.max, maxLanes[i]);
+  }
+  totals.count += 64;
+}
+
+__attribute__((target("avx2"))) void addBlockAvx2(const std::int64_t *values,
+                                                  Totals &totals) {
+  __m256i sums = _mm256_setzero_si256();
+  __m256i mins = _mm256_set1_epi64x(totals.min);
+  __m256i maxs = _mm256_set1_epi64x(totals.max);
+  for (int i = 0; i < 64; i += 4) {
+    const __m256i vector =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+    sums = _mm256_add_epi64(sums, vector);
+    mins = _mm256_blendv_epi8(mins, vector, _mm256_cmpgt_epi64(mins, vector));
+    maxs = _mm256_blendv_epi8(maxs, vector, _mm256_cmpgt_epi64(vector, maxs));
+  }
+  std::int64_t sumLanes[4];
+  std::int64_t minLanes[4];
+  std::int64_t maxLanes[4];
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(sumLanes), sums);
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(minLanes), mins);
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(maxLanes), maxs);
+  for (int i = 0; i < 4; i++) {
+    totals.sum += static_cast<std::uint64_t>(sumLanes[i]);
+    totals.min = std::min(totals.min, minLanes[i]);
+    totals.max = std::max(totals.max, maxLanes[i]);
+  }
+  totals.count += 64;
+}
+
+bool hasAvx2() { return __builtin_cpu_supports("avx2"); }
+
+#else
+
+template <typename T>
+std::uint64_t rangeWordAvx2(const T *values, const T low, const T high) {
+  return rangeWord(values, low, high);
+}
+
+template <typename T>
+void addBlockAvx2(const T *values, Totals &totals) {
+  addBlock(values, totals);
+}
+
+bool hasAvx2() { return false; }
+
+#endif
+
+/**
+ * Narrows a selection to the rows of a minipage whose value lies in the
+ * range, a word of 64 rows at a time.
+ */
+template <typename T>
+void selectRange(const T *values, const std::uint32_t rows, const T low,
+                 const T high, std::uint64_t *words) {
+  static const bool useAvx2 = hasAvx2();
+  std::uint64_t (*fullWord)(const T *, T, T) = rangeWord<T>;
+  if (useAvx2) fullWord = rangeWordAvx2;
+  const std::uint32_t fullWords = rows / 64;
+  for (std::uint32_t w = 0; w < fullWords; w++) {
+    // Skip words nothing is selected in anymore
+    if (words[w] != 0) words[w] &= fullWord(values + 64 * w, low, high);
+  }
+  if (rows % 64 != 0) {
+    words[fullWords] &=
+        rangeBits(values + 64 * fullWords, rows % 64, low, high);
+  }
+}
+
+/**
+ * Adds the selected values of a minipage to the totals.  Words with every
+ * row selected go through the block kernel, others a row at a time.
+ */
+template <typename T>
+void addSelected(const T *values, const std::uint32_t rows,
+                 const std::uint64_t *words, Totals &totals) {
+  static const bool useAvx2 = hasAvx2();
+  void (*fullBlock)(const T *, Totals &) = addBlock<T>;
+  if (useAvx2) fullBlock = addBlockAvx2;
+  for (std::uint32_t w = 0; w * 64 < rows; w++) {
+    std::uint64_t word = words[w];
+    if (word == ~std::uint64_t(0)) {
+      fullBlock(values + 64 * w, totals);
+      continue;
+    }
+    for (; word != 0; word &= word - 1) {
+      const std::int64_t value = values[64 * w + __builtin_ctzll(word)];
+      totals.count++;
+      totals.sum += static_cast<std::uint64_t>(value);
+      totals.min = std::min(totals.min, value);
+      totals.max = std::max(totals.max, value);
+    }
+  }
+}
+
+}  // namespace
+
+const std::uint32_t PaxPage::MAX_COLUMNS;
+
+PaxSelection::PaxSelection(const std::uint32_t rows)
+    : rows_(rows), words_((rows + 63) / 64, ~std::uint64_t(0)) {
+  if (rows % 64 != 0) {
+    words_.back() = (std::uint64_t(1) << (rows % 64)) - 1;
+  }
+}
+
+std::uint32_t PaxSelection::count() const {
+  std::uint32_t selected = 0;
+  for (const std::uint64_t word : words_) {
+    selected += __builtin_popcountll(word);
+  }
+  return selected;
+}
+
+PaxPage PaxPage::format(Page &page, const std::vector<PaxType> &columns) {
+  if (columns.empty() || columns.size() > MAX_COLUMNS) {
+    throw PageFormatException(page.page_number(),
+                              "columnar pages take 1 to " +
+                                  std::to_string(MAX_COLUMNS) + " columns");
+  }
+  PaxHeader header = {};
+  header.magic = PAX_MAGIC;
+  header.numColumns = static_cast<std::uint16_t>(columns.size());
+
+  // Leave room for aligning every minipage
+  std::size_t rowWidth = 0;
+  for (const PaxType type : columns) {
+    rowWidth += widthOf(type);
+  }
+  header.capacity = static_cast<std::uint32_t>(
+      (Page::DATA_SIZE - sizeof(PaxHeader) -
+       MINIPAGE_ALIGNMENT * columns.size()) /
+      rowWidth);
+
+  // Offsets are aligned within the image, whose data area follows the page
+  // header
+  std::size_t offset = sizeof(PaxHeader);
+  for (std::size_t c = 0; c < columns.size(); c++) {
+    const std::size_t inImage = sizeof(PageHeader) + offset;
+    offset += (MINIPAGE_ALIGNMENT - inImage % MINIPAGE_ALIGNMENT) %
+              MINIPAGE_ALIGNMENT;
+    header.types[c] = static_cast<std::uint8_t>(columns[c]);
+    header.offsets[c] = static_cast<std::uint16_t>(offset);
+    offset += widthOf(columns[c]) * header.capacity;
+  }
+  std::memcpy(page.data_, &header, sizeof(header));
+  return PaxPage(page, true);
+}
+
+bool PaxPage::isPaxPage(const Page &page) {
+  std::uint32_t magic;
+  std::memcpy(&magic, page.data_, sizeof(magic));
+  return magic == PAX_MAGIC;
+}
+
+PaxPage::PaxPage(Page &page) : page_(&page) {
+  if (!isPaxPage(page)) {
+    throw PageFormatException(page.page_number(), "not a columnar page");
+  }
+}
+
+PaxPage::PaxPage(Page &page, const bool) : page_(&page) {}
+
+std::uint32_t PaxPage::numColumns() const {
+  return reinterpret_cast<const PaxHeader *>(page_->data_)->numColumns;
+}
+
+PaxType PaxPage::columnType(const std::uint32_t column) const {
+  return static_cast<PaxType>(
+      reinterpret_cast<const PaxHeader *>(page_->data_)->types[column]);
+}
+
+std::uint32_t PaxPage::capacity() const {
+  return reinterpret_cast<const PaxHeader *>(page_->data_)->capacity;
+}
+
+std::uint32_t PaxPage::rowCount() const {
+  return reinterpret_cast<const PaxHeader *>(page_->data_)->rows;
+}
+
+bool PaxPage::appendRow(const std::int64_t *values) {
+  PaxHeader *header = reinterpret_cast<PaxHeader *>(page_->data_);
+  if (header->rows == header->capacity) return false;
+  for (std::uint32_t c = 0; c < header->numColumns; c++) {
+    if (columnType(c) == PaxType::INT32) {
+      const std::int32_t narrow = static_cast<std::int32_t>(values[c]);
+      std::memcpy(minipage(c) + header->rows * sizeof(narrow), &narrow,
+                  sizeof(narrow));
+    } else {
+      std::memcpy(minipage(c) + header->rows * sizeof(values[c]), &values[c],
+                  sizeof(values[c]));
+    }
+  }
+  header->rows++;
+  return true;
+}
+
+std::int64_t PaxPage::value(const std::uint32_t row,
+                            const std::uint32_t column) const {
+  return columnType(column) == PaxType::INT32 ? int32Column(column)[row]
+                                              : int64Column(column)[row];
+}
+
+const std::int32_t *PaxPage::int32Column(const std::uint32_t column) const {
+  return reinterpret_cast<const std::int32_t *>(minipage(column));
+}
+
+const std::int64_t *PaxPage::int64Column(const std::uint32_t column) const {
+  return reinterpret_cast<const std::int64_t *>(minipage(column));
+}
+
+std::uint32_t PaxPage::select(const std::uint32_t column,
+                              const std::int64_t low,
+                              const std::int64_t high,
+                              PaxSelection &selection) const {
+  check(column, selection);
+  if (columnType(column) == PaxType::INT64) {
+    selectRange(int64Column(column), rowCount(), low, high,
+                selection.words());
+    return selection.count();
+  }
+
+  // Clamp the range to the values a 32-bit column can hold
+  const std::int64_t int32Min = std::numeric_limits<std::int32_t>::min();
+  const std::int64_t int32Max = std::numeric_limits<std::int32_t>::max();
+  if (low > high || low > int32Max || high < int32Min) {
+    std::fill(selection.words(), selection.words() + (rowCount() + 63) / 64,
+              0);
+    return 0;
+  }
+  selectRange(int32Column(column), rowCount(),
+              static_cast<std::int32_t>(std::max(low, int32Min)),
+              static_cast<std::int32_t>(std::min(high, int32Max)),
+              selection.words());
+  return selection.count();
+}
+
+PaxAggregate PaxPage::aggregate(const std::uint32_t column,
+                                const PaxSelection &selection) const {
+  check(column, selection);
+  Totals totals;
+  if (columnType(column) == PaxType::INT32) {
+    addSelected(int32Column(column), rowCount(), selection.words(), totals);
+  } else {
+    addSelected(int64Column(column), rowCount(), selection.words(), totals);
+  }
+
+  PaxAggregate aggregate;
+  aggregate.count = totals.count;
+  aggregate.sum = static_cast<std::int64_t>(totals.sum);
+  aggregate.min = totals.count == 0 ? 0 : totals.min;
+  aggregate.max = totals.count == 0 ? 0 : totals.max;
+  return aggregate;
+}
+
+char *PaxPage::minipage(const std::uint32_t column) const {
+  return page_->data_ +
+         reinterpret_cast<const PaxHeader *>(page_->data_)->offsets[column];
+}
+
+void PaxPage::check(const std::uint32_t column,
+                    const PaxSelection &selection) const {
+  if (column >= numColumns()) {
+    throw PageFormatException(page_->page_number(),
+                              "no column " + std::to_string(column));
+  }
+  if (selection.rows() != rowCount()) {
+    throw PageFormatException(
+        page_->page_number(),
+        "selection over " + std::to_string(selection.rows()) + " rows for " +
+            std::to_string(rowCount()));
+  }
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,238 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Type of a column of a columnar page
+ */
+enum class PaxType : std::uint8_t {
+  /**
+   * Signed 32-bit integers
+   */
+  INT32 = 1,
+
+  /**
+   * Signed 64-bit integers
+   */
+  INT64 = 2
+};
+
+/**
+ * @brief Rows of a columnar page selected by filters, one bit per row
+ */
+class PaxSelection {
+ public:
+  /**
+   * Constructs a selection of all of the given rows.
+   *
+   * @param rows  Number of rows
+   */
+  explicit PaxSelection(const std::uint32_t rows);
+
+  /**
+   * Returns the number of rows the selection is over.
+   */
+  std::uint32_t rows() const { return rows_; }
+
+  /**
+   * Returns the number of selected rows.
+   */
+  std::uint32_t count() const;
+
+  /**
+   * Returns true if a row is selected.
+   */
+  bool selected(const std::uint32_t row) const {
+    return (words_[row / 64] >> (row % 64)) & 1;
+  }
+
+  /**
+   * Returns the bits of the selection, 64 rows to a word starting with the
+   * lowest bit.  Bits past the last row are always clear.
+   */
+  std::uint64_t* words() { return words_.data(); }
+  const std::uint64_t* words() const { return words_.data(); }
+
+ private:
+  /**
+   * Number of rows the selection is over
+   */
+  std::uint32_t rows_;
+
+  /**
+   * Bits of the selection
+   */
+  std::vector<std::uint64_t> words_;
+};
+
+/**
+ * @brief Aggregates of a column over the selected rows of a columnar page
+ */
+struct PaxAggregate {
+  /**
+   * Number of selected rows
+   */
+  std::uint64_t count;
+
+  /**
+   * Sum of the values, wrapping around on overflow
+   */
+  std::int64_t sum;
+
+  /**
+   * Smallest and largest value, or 0 if no row is selected
+   */
+  std::int64_t min;
+  std::int64_t max;
+};
+
+/**
+ * @brief Columnar (PAX) layout of a page
+ *
+ * Instead of records in slots, the data area of the page holds a minipage
+ * per column with the values of that column for every row, back to back.
+ * A scan then reads only the columns it needs, and the filter and aggregate
+ * kernels run over the minipages of a pinned frame a vector of values at a
+ * time rather than a record at a time.  On x86-64 machines with AVX2 the
+ * kernels use it; elsewhere they fall back to plain loops.
+ *
+ * PaxPage is a view: it works directly on the image of the Page it is made
+ * from, which must outlive it.  A columnar page has no records, so the
+ * record functions of Page must not be used on it.
+ */
+class PaxPage {
+ public:
+  /**
+   * Largest number of columns of a page
+   */
+  static const std::uint32_t MAX_COLUMNS = 64;
+
+  /**
+   * Lays out a page for rows of the given columns, dropping whatever it
+   * held before, and returns a view of it.
+   *
+   * @param page     Page to lay out
+   * @param columns  Type of every column
+   * @return  View of the empty columnar page
+   * @throws  PageFormatException if there are no or too many columns
+   */
+  static PaxPage format(Page& page, const std::vector<PaxType>& columns);
+
+  /**
+   * Returns true if a page has been laid out by format().
+   */
+  static bool isPaxPage(const Page& page);
+
+  /**
+   * Constructs a view of a columnar page.
+   *
+   * @param page  Page laid out by format()
+   * @throws  PageFormatException if the page is not a columnar page
+   */
+  explicit PaxPage(Page& page);
+
+  /**
+   * Returns the number of columns.
+   */
+  std::uint32_t numColumns() const;
+
+  /**
+   * Returns the type of a column.
+   */
+  PaxType columnType(const std::uint32_t column) const;
+
+  /**
+   * Returns the largest number of rows the page holds.
+   */
+  std::uint32_t capacity() const;
+
+  /**
+   * Returns the number of rows.
+   */
+  std::uint32_t rowCount() const;
+
+  /**
+   * Appends a row.  Values of INT32 columns are truncated to 32 bits.
+   *
+   * @param values  Value of every column
+   * @return  False if the page is full
+   */
+  bool appendRow(const std::int64_t* values);
+
+  /**
+   * Returns a value.
+   *
+   * @param row     Row of the value
+   * @param column  Column of the value
+   */
+  std::int64_t value(const std::uint32_t row,
+                     const std::uint32_t column) const;
+
+  /**
+   * Returns the minipage of an INT32 or INT64 column, with rowCount()
+   * values.
+   */
+  const std::int32_t* int32Column(const std::uint32_t column) const;
+  const std::int64_t* int64Column(const std::uint32_t column) const;
+
+  /**
+   * Deselects the rows whose value of a column lies outside of a range.
+   * Applying it for several columns selects the rows that pass all of them.
+   *
+   * @param column     Column to filter on
+   * @param low        Smallest value kept
+   * @param high       Largest value kept
+   * @param selection  Selection over rowCount() rows to narrow
+   * @return  Number of rows still selected
+   */
+  std::uint32_t select(const std::uint32_t column, const std::int64_t low,
+                       const std::int64_t high,
+                       PaxSelection& selection) const;
+
+  /**
+   * Returns the count, sum, minimum and maximum of a column over the
+   * selected rows.
+   *
+   * @param column     Column to aggregate
+   * @param selection  Selection over rowCount() rows
+   */
+  PaxAggregate aggregate(const std::uint32_t column,
+                         const PaxSelection& selection) const;
+
+ private:
+  /**
+   * Constructs a view of a page without checking its layout.
+   */
+  PaxPage(Page& page, const bool);
+
+  /**
+   * Returns the minipage of a column.
+   */
+  char* minipage(const std::uint32_t column) const;
+
+  /**
+   * Checks the column number and the selection against the page.
+   */
+  void check(const std::uint32_t column, const PaxSelection& selection) const;
+
+  /**
+   * Page the view works on
+   */
+  Page* page_;
+};
+
+}  // namespace badgerdb
@@ -0,0 +1,547 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "replacement_policy.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace badgerdb {
+
+std::unique_ptr<ReplacementPolicy> ReplacementPolicy::create(
+    const ReplacementPolicyType type, const std::uint32_t numFrames) {
+  switch (type) {
+    case ReplacementPolicyType::LRU_K:
+      return std::unique_ptr<ReplacementPolicy>(new LruKPolicy(numFrames));
+    case ReplacementPolicyType::TWO_Q:
+      return std::unique_ptr<ReplacementPolicy>(new TwoQPolicy(numFrames));
+    case ReplacementPolicyType::CLOCK:
+    default:
+      return std::unique_ptr<ReplacementPolicy>(new ClockPolicy(numFrames));
+  }
+}
+
+//----------------------------------------
+// Clock
+//----------------------------------------
+
+ClockPolicy::ClockPolicy(const std::uint32_t numFrames)
+    : numFrames_(numFrames),
+      clockHand_(numFrames - 1),
+      free_(numFrames, true) {
+  // Handed out from the first frame on, as the hand would
+  for (FrameId i = numFrames; i > 0; i--) {
+    freeFrames_.push_back(i - 1);
+  }
+}
+
+void ClockPolicy::recordLoad(const FrameId frameNo, const FileId,
+                             const PageId) {
+  std::lock_guard<std::mutex> guard(latch_);
+  // Claimed by the sweep while it was on the free list
+  if (frameNo < free_.size()) free_[frameNo] = false;
+}
+
+void ClockPolicy::recordRemoval(const FrameId frameNo) {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (frameNo >= numFrames_ || free_[frameNo]) {
+    return;
+  }
+  free_[frameNo] = true;
+  freeFrames_.push_back(frameNo);
+}
+
+void ClockPolicy::advanceClock() {
+  // advance clock pointer
+  clockHand_++;
+
+  if (clockHand_ >= numFrames_)
+    // Reset clockHand to first buffer
+    clockHand_ = 0;
+}
+
+bool ClockPolicy::pickVictim(VictimProbe &probe, FrameId &frameNo) {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (numFrames_ == 0) {
+    return false;
+  }
+
+  // Frames that hold no page go before any page is evicted.  A free frame
+  // that another thread has latched is left to the sweep.
+  while (!freeFrames_.empty()) {
+    const FrameId candidate = freeFrames_.back();
+    freeFrames_.pop_back();
+    if (candidate >= numFrames_ || !free_[candidate]) {
+      continue;
+    }
+    free_[candidate] = false;
+    if (probe.tryClaim(candidate)) {
+      frameNo = candidate;
+      return true;
+    }
+  }
+
+  // The buffer that the clock is starting on. Used together with
+  // candidateSeen to determine if no frame can be found
+  FrameId startingFrame = clockHand_;
+
+  // Whether a candidate has been seen since last rotation of clock hand
+  bool candidateSeen = false;
+
+  while (true) {
+    // Advance the clock hand
+    advanceClock();
+
+    if (clockHand_ == startingFrame) {
+      if (!candidateSeen) {
+        return false;
+      }
+      // Reset it so that if there is no candidateSeen this time around
+      // we give up
+      candidateSeen = false;
+    }
+
+    // refbit set?
+    if (probe.testAndClearReference(clockHand_)) {
+      // This frame can be used next full rotation of clock so we must not
+      // give up if full revolution done once
+      candidateSeen = true;
+      continue;
+    }
+
+    // Free or unpinned and unreferenced frame
+    if (probe.tryClaim(clockHand_)) {
+      frameNo = clockHand_;
+      return true;
+    }
+  }
+}
+
+void ClockPolicy::nextVictims(const std::size_t count,
+                              std::vector<FrameId> &frames) {
+  std::lock_guard<std::mutex> guard(latch_);
+  // The frames the hand reaches next
+  for (std::size_t k = 1; k <= count && k <= numFrames_; k++) {
+    frames.push_back((clockHand_ + k) % numFrames_);
+  }
+}
+
+void ClockPolicy::resize(const std::uint32_t numFrames) {
+  std::lock_guard<std::mutex> guard(latch_);
+  // Frames that are added hold no page; entries of removed frames are
+  // skipped when they are reached
+  free_.resize(numFrames, false);
+  for (FrameId i = numFrames_; i < numFrames; i++) {
+    free_[i] = true;
+    freeFrames_.push_back(i);
+  }
+  numFrames_ = numFrames;
+  if (clockHand_ >= numFrames_) clockHand_ = numFrames_ - 1;
+}
+
+//----------------------------------------
+// LRU-K
+//----------------------------------------
+
+LruKPolicy::LruKPolicy(const std::uint32_t numFrames)
+    : now_(0),
+      numFrames_(numFrames),
+      resident_(numFrames, false),
+      pages_(numFrames),
+      history_(numFrames),
+      maxRetained_(numFrames) {
+  for (FrameId i = 0; i < numFrames; i++) {
+    free_.insert(i);
+  }
+}
+
+LruKPolicy::OrderKey LruKPolicy::orderKey(const FrameId frameNo) const {
+  // Pages with a single reference have previous == 0 and so come first,
+  // ordered by that reference
+  const History &history = history_[frameNo];
+  return OrderKey(std::make_pair(history.previous, history.last), frameNo);
+}
+
+void LruKPolicy::touch(const FrameId frameNo) {
+  order_.erase(orderKey(frameNo));
+  History &history = history_[frameNo];
+  history.previous = history.last;
+  history.last = ++now_;
+  order_.insert(orderKey(frameNo));
+}
+
+void LruKPolicy::retain(const FrameId frameNo) {
+  const PageKey &page = pages_[frameNo];
+  auto existing = retained_.find(page);
+  if (existing != retained_.end()) {
+    retainedOrder_.erase(existing->second.position);
+    retained_.erase(existing);
+  }
+
+  if (retained_.size() >= maxRetained_) {
+    if (retainedOrder_.empty()) {
+      return;
+    }
+    retained_.erase(retainedOrder_.front());
+    retainedOrder_.pop_front();
+  }
+
+  retainedOrder_.push_back(page);
+  Retained retained = {history_[frameNo], std::prev(retainedOrder_.end())};
+  retained_[page] = retained;
+}
+
+void LruKPolicy::recordLoad(const FrameId frameNo, const FileId fileId,
+                            const PageId pageNo) {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (resident_[frameNo]) {
+    order_.erase(orderKey(frameNo));
+    retain(frameNo);
+  }
+
+  const PageKey page(fileId, pageNo);
+  History history = {0, 0};
+  auto retained = retained_.find(page);
+  if (retained != retained_.end()) {
+    // The page comes back with the references it had before it was evicted
+    history = retained->second.history;
+    retainedOrder_.erase(retained->second.position);
+    retained_.erase(retained);
+  }
+
+  free_.erase(frameNo);
+  resident_[frameNo] = true;
+  pages_[frameNo] = page;
+  history_[frameNo] = history;
+  order_.insert(orderKey(frameNo));
+  touch(frameNo);
+}
+
+void LruKPolicy::recordAccess(const FrameId frameNo) {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (resident_[frameNo]) {
+    touch(frameNo);
+  }
+}
+
+void LruKPolicy::recordRemoval(const FrameId frameNo) {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (!resident_[frameNo]) {
+    return;
+  }
+  order_.erase(orderKey(frameNo));
+  retain(frameNo);
+  resident_[frameNo] = false;
+  free_.insert(frameNo);
+}
+
+bool LruKPolicy::pickVictim(VictimProbe &probe, FrameId &frameNo) {
+  std::lock_guard<std::mutex> guard(latch_);
+  for (const FrameId candidate : free_) {
+    if (probe.tryClaim(candidate)) {
+      frameNo = candidate;
+      return true;
+    }
+  }
+  for (const OrderKey &key : order_) {
+    if (probe.tryClaim(key.second)) {
+      frameNo = key.second;
+      return true;
+    }
+  }
+  return false;
+}
+
+void LruKPolicy::nextVictims(const std::size_t count,
+                             std::vector<FrameId> &frames) {
+  std::lock_guard<std::mutex> guard(latch_);
+  for (const OrderKey &key : order_) {
+    if (frames.size() >= count) break;
+    frames.push_back(key.second);
+  }
+}
+
+void LruKPolicy::resize(const std::uint32_t numFrames) {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (numFrames > resident_.size()) {
+    resident_.resize(numFrames, false);
+    pages_.resize(numFrames);
+    history_.resize(numFrames);
+  }
+  for (FrameId i = numFrames_; i < numFrames; i++) {
+    free_.insert(i);
+  }
+  free_.erase(free_.lower_bound(numFrames), free_.end());
+  numFrames_ = numFrames;
+
+  maxRetained_ = numFrames;
+  while (retained_.size() > maxRetained_) {
+    retained_.erase(retainedOrder_.front());
+    retainedOrder_.pop_front();
+  }
+}
+
+//----------------------------------------
+// 2Q
+//----------------------------------------
+
+TwoQPolicy::TwoQPolicy(const std::uint32_t numFrames)
+    : numFrames_(numFrames),
+      queue_(numFrames, NONE),
+      position_(numFrames),
+      pages_(numFrames) {
+  setLimits(numFrames);
+  for (FrameId i = 0; i < numFrames; i++) {
+    free_.insert(i);
+  }
+}
+
+void TwoQPolicy::setLimits(const std::uint32_t numFrames) {
+  maxIn_ = numFrames / 4 > 0 ? numFrames / 4 : 1;
+  maxOut_ = numFrames / 2 > 0 ? numFrames / 2 : 1;
+}
+
+void TwoQPolicy::recordLoad(const FrameId frameNo, const FileId fileId,
+                            const PageId pageNo) {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (queue_[frameNo] != NONE) {
+    // Frame was reused without being reported as freed
+    std::list<FrameId> &queue = queue_[frameNo] == A1IN ? a1in_ : am_;
+    queue.erase(position_[frameNo]);
+  }
+
+  const PageKey page(fileId, pageNo);
+  free_.erase(frameNo);
+  pages_[frameNo] = page;
+  auto ghost = a1outPages_.find(page);
+  if (ghost != a1outPages_.end()) {
+    // Referenced again soon after it was evicted: the page is hot
+    a1out_.erase(ghost->second);
+    a1outPages_.erase(ghost);
+    queue_[frameNo] = AM;
+    position_[frameNo] = am_.insert(am_.end(), frameNo);
+  } else {
+    queue_[frameNo] = A1IN;
+    position_[frameNo] = a1in_.insert(a1in_.end(), frameNo);
+  }
+}
+
+void TwoQPolicy::recordAccess(const FrameId frameNo) {
+  std::lock_guard<std::mutex> guard(latch_);
+  // Hits on pages in A1in are deliberately ignored; they are most likely
+  // correlated references right after the page was loaded
+  if (queue_[frameNo] == AM) {
+    am_.splice(am_.end(), am_, position_[frameNo]);
+  }
+}
+
+void TwoQPolicy::recordRemoval(const FrameId frameNo) {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (queue_[frameNo] == NONE) {
+    return;
+  }
+
+  if (queue_[frameNo] == A1IN) {
+    a1in_.erase(position_[frameNo]);
+    const PageKey &page = pages_[frameNo];
+    if (a1outPages_.find(page) == a1outPages_.end()) {
+      a1outPages_[page] = a1out_.insert(a1out_.end(), page);
+      if (a1out_.size() > maxOut_) {
+        a1outPages_.erase(a1out_.front());
+        a1out_.pop_front();
+      }
+    }
+  } else {
+    am_.erase(position_[frameNo]);
+  }
+  queue_[frameNo] = NONE;
+  free_.insert(frameNo);
+}
+
+bool TwoQPolicy::claimFrom(const std::list<FrameId> &queue,
+                           VictimProbe &probe, FrameId &frameNo) {
+  for (const FrameId candidate : queue) {
+    if (probe.tryClaim(candidate)) {
+      frameNo = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TwoQPolicy::pickVictim(VictimProbe &probe, FrameId &frameNo) {
+  std::lock_guard<std::mutex> guard(latch_);
+  for (const FrameId candidate : free_) {
+    if (probe.tryClaim(candidate)) {
+      frameNo = candidate;
+      return true;
+    }
+  }
+
+  // Evict from A1in while it is over its share of the frames, otherwise from
+  // the cold end of Am
+  if (a1in_.size() > maxIn_ || am_.empty()) {
+    return claimFrom(a1in_, probe, frameNo) || claimFrom(am_, probe, frameNo);
+  }
+  return claimFrom(am_, probe, frameNo) || claimFrom(a1in_, probe, frameNo);
+}
+
+void TwoQPolicy::nextVictims(const std::size_t count,
+                             std::vector<FrameId> &frames) {
+  std::lock_guard<std::mutex> guard(latch_);
+  const bool inFirst = a1in_.size() > maxIn_ || am_.empty();
+  const std::list<FrameId> *queues[] = {inFirst ? &a1in_ : &am_,
+                                        inFirst ? &am_ : &a1in_};
+  for (const std::list<FrameId> *queue : queues) {
+    for (const FrameId frameNo : *queue) {
+      if (frames.size() >= count) return;
+      frames.push_back(frameNo);
+    }
+  }
+}
+
+void TwoQPolicy::resize(const std::uint32_t numFrames) {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (numFrames > queue_.size()) {
+    queue_.resize(numFrames, NONE);
+    position_.resize(numFrames);
+    pages_.resize(numFrames);
+  }
+  for (FrameId i = numFrames_; i < numFrames; i++) {
+    free_.insert(i);
+  }
+  free_.erase(free_.lower_bound(numFrames), free_.end());
+  numFrames_ = numFrames;
+
+  setLimits(numFrames);
+  while (a1out_.size() > maxOut_) {
+    a1outPages_.erase(a1out_.front());
+    a1out_.pop_front();
+  }
+}
+
+//----------------------------------------
+// Partitions
+//----------------------------------------
+
+PartitionedPolicy::PartitionedPolicy(const ReplacementPolicyType type,
+                                     const std::uint32_t numFrames,
+                                     const std::uint32_t maxFrames,
+                                     const std::uint32_t numPartitions,
+                                     const std::uint32_t stripeFrames)
+    : partitions_(std::max(numPartitions, 1u)),
+      resident_(std::max(numFrames, maxFrames)),
+      stripeFrames_(std::max(stripeFrames, 1u)),
+      numFrames_(numFrames) {
+  for (std::uint32_t i = 0; i < partitions_.size(); i++) {
+    const std::uint32_t frames = framesIn(i, numFrames);
+    partitions_[i].policy = ReplacementPolicy::create(type, frames);
+    partitions_[i].freeFrames = frames;
+  }
+  for (std::atomic<bool> &resident : resident_) {
+    resident = false;
+  }
+}
+
+FrameId PartitionedPolicy::localFrame(const FrameId frameNo) const {
+  const std::uint32_t round = stripeFrames_ * partitions_.size();
+  return frameNo / round * stripeFrames_ + frameNo % stripeFrames_;
+}
+
+FrameId PartitionedPolicy::globalFrame(const std::uint32_t partition,
+                                       const FrameId localNo) const {
+  return (localNo / stripeFrames_ * partitions_.size() + partition) *
+             stripeFrames_ +
+         localNo % stripeFrames_;
+}
+
+std::uint32_t PartitionedPolicy::framesIn(
+    const std::uint32_t partition, const std::uint32_t numFrames) const {
+  const std::uint32_t round = stripeFrames_ * partitions_.size();
+  const std::uint32_t rest = numFrames % round;
+  const std::uint32_t start = partition * stripeFrames_;
+  return numFrames / round * stripeFrames_ +
+         (rest > start ? std::min(rest - start, stripeFrames_) : 0);
+}
+
+void PartitionedPolicy::recordLoad(const FrameId frameNo, const FileId fileId,
+                                   const PageId pageNo) {
+  Partition &partition = partitions_[partitionOf(frameNo)];
+  if (!resident_[frameNo].exchange(true)) partition.freeFrames--;
+  partition.policy->recordLoad(localFrame(frameNo), fileId, pageNo);
+}
+
+void PartitionedPolicy::recordAccess(const FrameId frameNo) {
+  partitions_[partitionOf(frameNo)].policy->recordAccess(localFrame(frameNo));
+}
+
+void PartitionedPolicy::recordRemoval(const FrameId frameNo) {
+  Partition &partition = partitions_[partitionOf(frameNo)];
+  if (resident_[frameNo].exchange(false)) partition.freeFrames++;
+  partition.policy->recordRemoval(localFrame(frameNo));
+}
+
+bool PartitionedPolicy::pickIn(const std::uint32_t partition,
+                               VictimProbe &probe, FrameId &frameNo) {
+  PartitionProbe partitionProbe(*this, probe, partition);
+  FrameId localNo;
+  if (!partitions_[partition].policy->pickVictim(partitionProbe, localNo)) {
+    return false;
+  }
+  frameNo = globalFrame(partition, localNo);
+  return true;
+}
+
+bool PartitionedPolicy::pickVictim(VictimProbe &probe, FrameId &frameNo) {
+  return pickVictimOn(probe, 0, frameNo);
+}
+
+bool PartitionedPolicy::pickVictimOn(VictimProbe &probe,
+                                     const std::uint32_t partition,
+                                     FrameId &frameNo) {
+  const std::uint32_t count = partitions_.size();
+  // Free frames anywhere before any page is evicted
+  for (std::uint32_t k = 0; k < count; k++) {
+    const std::uint32_t i = (partition + k) % count;
+    if (partitions_[i].freeFrames > 0 && pickIn(i, probe, frameNo)) {
+      return true;
+    }
+  }
+  for (std::uint32_t k = 0; k < count; k++) {
+    if (pickIn((partition + k) % count, probe, frameNo)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void PartitionedPolicy::nextVictims(const std::size_t count,
+                                    std::vector<FrameId> &frames) {
+  // An even share of the upcoming victims of every partition
+  const std::size_t share = count / partitions_.size() + 1;
+  for (std::uint32_t i = 0; i < partitions_.size(); i++) {
+    std::vector<FrameId> local;
+    partitions_[i].policy->nextVictims(share, local);
+    for (const FrameId localNo : local) {
+      if (frames.size() >= count) return;
+      frames.push_back(globalFrame(i, localNo));
+    }
+  }
+}
+
+void PartitionedPolicy::resize(const std::uint32_t numFrames) {
+  for (std::uint32_t i = 0; i < partitions_.size(); i++) {
+    const std::uint32_t before = framesIn(i, numFrames_);
+    const std::uint32_t after = framesIn(i, numFrames);
+    partitions_[i].policy->resize(after);
+    partitions_[i].freeFrames += std::int64_t(after) - before;
+  }
+  numFrames_ = numFrames;
+}
+
+}  // namespace badgerdb
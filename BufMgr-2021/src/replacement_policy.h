@@ -0,0 +1,559 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Replacement policies that a BufMgr can be constructed with
+ */
+enum class ReplacementPolicyType {
+  /**
+   * Single reference bit clock sweep
+   */
+  CLOCK,
+
+  /**
+   * LRU-K with K = 2: evicts the page whose second most recent reference is
+   * the oldest
+   */
+  LRU_K,
+
+  /**
+   * Full version of 2Q: new pages enter a FIFO queue and are only promoted to
+   * the LRU queue if they are referenced again soon after being evicted
+   */
+  TWO_Q
+};
+
+/**
+ * @brief Interface through which a replacement policy inspects and claims
+ * buffer frames while it looks for a victim
+ */
+class VictimProbe {
+ public:
+  virtual ~VictimProbe() {}
+
+  /**
+   * Clears the reference bit of a frame.
+   *
+   * @param frameNo Frame to look at
+   * @return  True if the frame had been referenced since the last call
+   */
+  virtual bool testAndClearReference(const FrameId frameNo) = 0;
+
+  /**
+   * Tries to take a frame for reuse.  Fails if the frame is pinned or is
+   * being set up by another thread.
+   *
+   * @param frameNo Frame to claim
+   * @return  True if the frame was claimed and may be handed out
+   */
+  virtual bool tryClaim(const FrameId frameNo) = 0;
+};
+
+/**
+ * @brief Decides which buffer frame is reused when the buffer pool is full
+ *
+ * The buffer manager reports every page it places in a frame, every hit on a
+ * resident page and every frame that stops holding its page.  Frames that hold
+ * no page are handed out before any page is evicted.  All methods may be
+ * called concurrently.
+ */
+class ReplacementPolicy {
+ public:
+  virtual ~ReplacementPolicy() {}
+
+  /**
+   * Creates a policy of the given type.
+   *
+   * @param type      Policy to create
+   * @param numFrames Number of frames in the buffer pool
+   * @return  The new policy.
+   */
+  static std::unique_ptr<ReplacementPolicy> create(
+      const ReplacementPolicyType type, const std::uint32_t numFrames);
+
+  /**
+   * Records that a page has been placed in a frame.
+   *
+   * @param frameNo Frame the page was placed in
+   * @param fileId  Identifier of the file of the page
+   * @param pageNo  Page number in the file
+   */
+  virtual void recordLoad(const FrameId frameNo, const FileId fileId,
+                          const PageId pageNo) = 0;
+
+  /**
+   * Records a hit on the page held by a frame.
+   *
+   * @param frameNo Frame that was accessed
+   */
+  virtual void recordAccess(const FrameId frameNo) = 0;
+
+  /**
+   * Records that a frame no longer holds its page, either because the page
+   * was evicted or because it was flushed or disposed of.
+   *
+   * @param frameNo Frame that was freed
+   */
+  virtual void recordRemoval(const FrameId frameNo) = 0;
+
+  /**
+   * Picks a victim frame and claims it through the probe.  The policy keeps
+   * tracking the page of the victim until recordRemoval() is called for it.
+   *
+   * @param probe   Used to inspect and claim candidate frames
+   * @param frameNo Set to the claimed frame
+   * @return  False if no frame could be claimed
+   */
+  virtual bool pickVictim(VictimProbe &probe, FrameId &frameNo) = 0;
+
+  /**
+   * Picks a victim like pickVictim(), preferring frames of the given
+   * partition.  Policies that do not partition the frames ignore the
+   * preference.
+   *
+   * @param probe     Used to inspect and claim candidate frames
+   * @param partition Partition to take the frame from if possible
+   * @param frameNo   Set to the claimed frame
+   * @return  False if no frame could be claimed
+   */
+  virtual bool pickVictimOn(VictimProbe &probe, const std::uint32_t partition,
+                            FrameId &frameNo) {
+    (void)partition;
+    return pickVictim(probe, frameNo);
+  }
+
+  /**
+   * Lists the frames that are likely to be picked as victims next, most
+   * likely first, so that their pages can be cleaned ahead of time.
+   *
+   * @param count   Maximum number of frames to list
+   * @param frames  Receives the frames
+   */
+  virtual void nextVictims(const std::size_t count,
+                           std::vector<FrameId> &frames) = 0;
+
+  /**
+   * Changes the number of frames in the buffer pool.  Frames that are added
+   * hold no page.  When the pool shrinks, the frames that are removed have
+   * already been reported with recordRemoval() and are never picked again.
+   *
+   * @param numFrames New number of frames
+   */
+  virtual void resize(const std::uint32_t numFrames) = 0;
+};
+
+/**
+ * @brief The clock algorithm over the reference bits of the frames
+ *
+ * Frames that hold no page are kept on a free list and handed out without
+ * moving the clock hand, so that frames freed by flushes and disposals are
+ * reused right away instead of when the hand happens to pass them.
+ */
+class ClockPolicy : public ReplacementPolicy {
+ public:
+  explicit ClockPolicy(const std::uint32_t numFrames);
+
+  void recordLoad(const FrameId frameNo, const FileId,
+                  const PageId) override;
+  void recordAccess(const FrameId) override {}
+  void recordRemoval(const FrameId frameNo) override;
+  bool pickVictim(VictimProbe &probe, FrameId &frameNo) override;
+  void nextVictims(const std::size_t count,
+                   std::vector<FrameId> &frames) override;
+  void resize(const std::uint32_t numFrames) override;
+
+ private:
+  /**
+   * Advance clock to next frame in the buffer pool
+   */
+  void advanceClock();
+
+  /**
+   * Number of frames in the buffer pool
+   */
+  std::uint32_t numFrames_;
+
+  /**
+   * Current position of clockhand in our buffer pool
+   */
+  FrameId clockHand_;
+
+  /**
+   * Frames that hold no page, the next one to hand out last.  Frames that
+   * have been loaded since they were freed are skipped when reached.
+   */
+  std::vector<FrameId> freeFrames_;
+
+  /**
+   * Whether each frame is free and on freeFrames_
+   */
+  std::vector<bool> free_;
+
+  /**
+   * Latch protecting clockHand_ and the free list
+   */
+  std::mutex latch_;
+};
+
+/**
+ * @brief LRU-K replacement with K = 2
+ *
+ * Pages referenced only once have an infinite backward 2-distance and are
+ * evicted first, oldest reference first.  The reference history of evicted
+ * pages is kept for as many pages as there are frames, so that a page which
+ * comes back soon keeps its history.
+ */
+class LruKPolicy : public ReplacementPolicy {
+ public:
+  explicit LruKPolicy(const std::uint32_t numFrames);
+
+  void recordLoad(const FrameId frameNo, const FileId fileId,
+                  const PageId pageNo) override;
+  void recordAccess(const FrameId frameNo) override;
+  void recordRemoval(const FrameId frameNo) override;
+  bool pickVictim(VictimProbe &probe, FrameId &frameNo) override;
+  void nextVictims(const std::size_t count,
+                   std::vector<FrameId> &frames) override;
+  void resize(const std::uint32_t numFrames) override;
+
+ private:
+  /**
+   * Page identity used to look up retained history
+   */
+  typedef std::pair<FileId, PageId> PageKey;
+
+  /**
+   * Times of the last two references, most recent first.  Zero means no
+   * reference.
+   */
+  struct History {
+    std::uint64_t last;
+    std::uint64_t previous;
+  };
+
+  /**
+   * Eviction order: the frame with the smallest key goes first
+   */
+  typedef std::pair<std::pair<std::uint64_t, std::uint64_t>, FrameId> OrderKey;
+
+  /**
+   * Returns the position of a frame in the eviction order.
+   */
+  OrderKey orderKey(const FrameId frameNo) const;
+
+  /**
+   * Adds a reference at the current time to a frame and reorders it.
+   */
+  void touch(const FrameId frameNo);
+
+  /**
+   * Remembers the history of the page in an evicted frame.
+   */
+  void retain(const FrameId frameNo);
+
+  /**
+   * Reference clock, incremented on every reference
+   */
+  std::uint64_t now_;
+
+  /**
+   * Number of frames in the buffer pool.  The per-frame vectors below may
+   * be longer once the pool has shrunk.
+   */
+  std::uint32_t numFrames_;
+
+  /**
+   * Whether a frame currently holds a page
+   */
+  std::vector<bool> resident_;
+
+  /**
+   * Page held by each frame
+   */
+  std::vector<PageKey> pages_;
+
+  /**
+   * Reference history of each frame
+   */
+  std::vector<History> history_;
+
+  /**
+   * Frames that hold no page
+   */
+  std::set<FrameId> free_;
+
+  /**
+   * Resident frames in eviction order
+   */
+  std::set<OrderKey> order_;
+
+  /**
+   * History of a recently evicted page and its position in retainedOrder_
+   */
+  struct Retained {
+    History history;
+    std::list<PageKey>::iterator position;
+  };
+
+  /**
+   * History of recently evicted pages
+   */
+  std::map<PageKey, Retained> retained_;
+
+  /**
+   * Evicted pages in the order their history was retained, oldest first
+   */
+  std::list<PageKey> retainedOrder_;
+
+  /**
+   * Maximum number of evicted pages whose history is retained
+   */
+  std::size_t maxRetained_;
+
+  /**
+   * Latch protecting all of the above
+   */
+  std::mutex latch_;
+};
+
+/**
+ * @brief The full version of the 2Q algorithm
+ *
+ * Newly loaded pages go to the A1in FIFO queue.  Pages evicted from A1in are
+ * remembered in the A1out ghost queue; a page that is loaded again while it is
+ * remembered there goes to the Am LRU queue instead.  A1in is held to a
+ * quarter of the frames and A1out to half of them.
+ */
+class TwoQPolicy : public ReplacementPolicy {
+ public:
+  explicit TwoQPolicy(const std::uint32_t numFrames);
+
+  void recordLoad(const FrameId frameNo, const FileId fileId,
+                  const PageId pageNo) override;
+  void recordAccess(const FrameId frameNo) override;
+  void recordRemoval(const FrameId frameNo) override;
+  bool pickVictim(VictimProbe &probe, FrameId &frameNo) override;
+  void nextVictims(const std::size_t count,
+                   std::vector<FrameId> &frames) override;
+  void resize(const std::uint32_t numFrames) override;
+
+ private:
+  /**
+   * Page identity used in the ghost queue
+   */
+  typedef std::pair<FileId, PageId> PageKey;
+
+  /**
+   * Queue a frame is in
+   */
+  enum Queue { NONE, A1IN, AM };
+
+  /**
+   * Tries to claim a frame from the given queue, oldest first.
+   */
+  static bool claimFrom(const std::list<FrameId> &queue, VictimProbe &probe,
+                        FrameId &frameNo);
+
+  /**
+   * Sets maxIn_ and maxOut_ for the given number of frames.
+   */
+  void setLimits(const std::uint32_t numFrames);
+
+  /**
+   * Number of frames in the buffer pool.  The per-frame vectors below may
+   * be longer once the pool has shrunk.
+   */
+  std::uint32_t numFrames_;
+
+  /**
+   * Maximum length of A1in and A1out
+   */
+  std::size_t maxIn_;
+  std::size_t maxOut_;
+
+  /**
+   * Queue of each frame and its position in it
+   */
+  std::vector<Queue> queue_;
+  std::vector<std::list<FrameId>::iterator> position_;
+
+  /**
+   * Page held by each frame
+   */
+  std::vector<PageKey> pages_;
+
+  /**
+   * Frames that hold no page
+   */
+  std::set<FrameId> free_;
+
+  /**
+   * FIFO of pages referenced once, oldest at the front
+   */
+  std::list<FrameId> a1in_;
+
+  /**
+   * LRU list of hot pages, least recently used at the front
+   */
+  std::list<FrameId> am_;
+
+  /**
+   * Ghost FIFO of pages recently evicted from A1in, oldest at the front
+   */
+  std::list<PageKey> a1out_;
+  std::map<PageKey, std::list<PageKey>::iterator> a1outPages_;
+
+  /**
+   * Latch protecting all of the above
+   */
+  std::mutex latch_;
+};
+
+/**
+ * @brief Splits the frames into partitions, each with a replacement policy
+ * of its own
+ *
+ * The frames are dealt out in stripes of consecutive frames: partition p
+ * holds stripes p, p + numPartitions, p + 2 * numPartitions and so on.  Like a
+ * NUMA memory allocator, pickVictimOn() takes a free frame of the preferred
+ * partition, then a free frame of any other partition, and only then evicts
+ * a page, again from the preferred partition first.  Each partition has its
+ * own latch, so misses in different partitions do not wait for each other.
+ */
+class PartitionedPolicy : public ReplacementPolicy {
+ public:
+  /**
+   * Constructor of PartitionedPolicy class
+   *
+   * @param type          Policy used within each partition
+   * @param numFrames     Number of frames in the buffer pool
+   * @param maxFrames     Largest number of frames the pool can grow to
+   * @param numPartitions Number of partitions
+   * @param stripeFrames  Number of consecutive frames in a stripe
+   */
+  PartitionedPolicy(const ReplacementPolicyType type,
+                    const std::uint32_t numFrames,
+                    const std::uint32_t maxFrames,
+                    const std::uint32_t numPartitions,
+                    const std::uint32_t stripeFrames);
+
+  /**
+   * Returns the partition a frame belongs to
+   */
+  std::uint32_t partitionOf(const FrameId frameNo) const {
+    return frameNo / stripeFrames_ % partitions_.size();
+  }
+
+  void recordLoad(const FrameId frameNo, const FileId fileId,
+                  const PageId pageNo) override;
+  void recordAccess(const FrameId frameNo) override;
+  void recordRemoval(const FrameId frameNo) override;
+  bool pickVictim(VictimProbe &probe, FrameId &frameNo) override;
+  bool pickVictimOn(VictimProbe &probe, const std::uint32_t partition,
+                    FrameId &frameNo) override;
+  void nextVictims(const std::size_t count,
+                   std::vector<FrameId> &frames) override;
+  void resize(const std::uint32_t numFrames) override;
+
+ private:
+  /**
+   * Hands the frames of one partition to its policy under the numbers the
+   * policy knows them by
+   */
+  class PartitionProbe : public VictimProbe {
+   public:
+    PartitionProbe(const PartitionedPolicy &policy, VictimProbe &probe,
+                   const std::uint32_t partition)
+        : policy_(policy), probe_(probe), partition_(partition) {}
+
+    bool testAndClearReference(const FrameId frameNo) override {
+      return probe_.testAndClearReference(
+          policy_.globalFrame(partition_, frameNo));
+    }
+
+    bool tryClaim(const FrameId frameNo) override {
+      return probe_.tryClaim(policy_.globalFrame(partition_, frameNo));
+    }
+
+   private:
+    const PartitionedPolicy &policy_;
+    VictimProbe &probe_;
+    const std::uint32_t partition_;
+  };
+
+  /**
+   * A partition and the number of its frames that hold no page.  The count
+   * is only a hint for where to look first.
+   */
+  struct Partition {
+    std::unique_ptr<ReplacementPolicy> policy;
+    std::atomic<std::int64_t> freeFrames;
+  };
+
+  /**
+   * Returns the number of a frame within its partition.
+   */
+  FrameId localFrame(const FrameId frameNo) const;
+
+  /**
+   * Returns the frame with the given number within a partition.
+   */
+  FrameId globalFrame(const std::uint32_t partition,
+                      const FrameId localNo) const;
+
+  /**
+   * Returns how many of the first numFrames frames belong to a partition.
+   */
+  std::uint32_t framesIn(const std::uint32_t partition,
+                         const std::uint32_t numFrames) const;
+
+  /**
+   * Picks a victim within one partition.
+   */
+  bool pickIn(const std::uint32_t partition, VictimProbe &probe,
+              FrameId &frameNo);
+
+  /**
+   * The partitions
+   */
+  std::vector<Partition> partitions_;
+
+  /**
+   * Whether each frame holds a page, for counting free frames
+   */
+  std::vector<std::atomic<bool>> resident_;
+
+  /**
+   * Number of consecutive frames in a stripe
+   */
+  std::uint32_t stripeFrames_;
+
+  /**
+   * Number of frames in the buffer pool
+   */
+  std::uint32_t numFrames_;
+};
+
+}  // namespace badgerdb
@@ -0,0 +1,254 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <ostream>
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Writes a time in nanoseconds as microseconds with three decimals.
+ */
+void writeMicros(std::ostream& out, const std::uint64_t nanos) {
+  char text[32];
+  std::snprintf(text, sizeof(text), "%llu.%03u",
+                static_cast<unsigned long long>(nanos / 1000),
+                static_cast<unsigned>(nanos % 1000));
+  out << text;
+}
+
+}  // namespace
+
+Tracer& Tracer::get() {
+  static Tracer tracer;
+  return tracer;
+}
+
+Tracer::Tracer()
+    : enabled_(false), sampleEvery(1), ring(nullptr), mask(0), head(0) {
+  for (Totals& total : totals) {
+    total.count = total.nanos = total.value = 0;
+  }
+}
+
+void Tracer::enable(const std::size_t capacity,
+                    const std::uint32_t sampleEvery) {
+  std::lock_guard<std::mutex> lock(latch);
+  if (ring.load(std::memory_order_relaxed) == nullptr) {
+    std::size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    Slot* slots = new Slot[size];
+    for (std::size_t i = 0; i < size; i++) {
+      slots[i].sequence.store(0, std::memory_order_relaxed);
+    }
+    mask = size - 1;
+    // The ring is never freed, so trace points racing with enable() or a
+    // later disable() never see it go away
+    ring.store(slots, std::memory_order_release);
+  }
+  this->sampleEvery.store(sampleEvery == 0 ? 1 : sampleEvery,
+                          std::memory_order_relaxed);
+  enabled_.store(true, std::memory_order_release);
+}
+
+void Tracer::disable() { enabled_.store(false, std::memory_order_release); }
+
+void Tracer::clear() {
+  std::lock_guard<std::mutex> lock(latch);
+  Slot* slots = ring.load(std::memory_order_acquire);
+  if (slots != nullptr) {
+    for (std::size_t i = 0; i <= mask; i++) {
+      slots[i].sequence.store(0, std::memory_order_relaxed);
+    }
+  }
+  head.store(0, std::memory_order_relaxed);
+  for (Totals& total : totals) {
+    total.count.store(0, std::memory_order_relaxed);
+    total.nanos.store(0, std::memory_order_relaxed);
+    total.value.store(0, std::memory_order_relaxed);
+  }
+}
+
+void Tracer::record(const TraceEvent event, const std::uint64_t start,
+                    const FileId fileId, const PageId pageNo,
+                    const std::uint64_t value, const std::uint8_t detail) {
+  const std::uint64_t end = now();
+  const std::uint64_t duration = end > start ? end - start : 0;
+  Totals& total = totals[static_cast<int>(event)];
+  total.count.fetch_add(1, std::memory_order_relaxed);
+  total.nanos.fetch_add(duration, std::memory_order_relaxed);
+  total.value.fetch_add(value, std::memory_order_relaxed);
+
+  static thread_local std::uint32_t skipped = 0;
+  const std::uint32_t every = sampleEvery.load(std::memory_order_relaxed);
+  if (every > 1) {
+    if (++skipped < every) {
+      return;
+    }
+    skipped = 0;
+  }
+  Slot* slots = ring.load(std::memory_order_acquire);
+  if (slots == nullptr) {
+    return;
+  }
+
+  const std::uint64_t ticket = head.fetch_add(1, std::memory_order_relaxed);
+  Slot& slot = slots[ticket & mask];
+  slot.sequence.store(2 * ticket + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.words[0].store(start, std::memory_order_relaxed);
+  slot.words[1].store(duration, std::memory_order_relaxed);
+  slot.words[2].store(static_cast<std::uint64_t>(event) |
+                          (static_cast<std::uint64_t>(detail) << 8) |
+                          (static_cast<std::uint64_t>(threadNumber()) << 16) |
+                          (static_cast<std::uint64_t>(fileId) << 32),
+                      std::memory_order_relaxed);
+  slot.words[3].store(pageNo, std::memory_order_relaxed);
+  slot.words[4].store(value, std::memory_order_relaxed);
+  slot.sequence.store(2 * ticket + 2, std::memory_order_release);
+}
+
+std::vector<TraceRecord> Tracer::snapshot() const {
+  std::vector<TraceRecord> records;
+  const Slot* slots = ring.load(std::memory_order_acquire);
+  if (slots == nullptr) {
+    return records;
+  }
+  const std::uint64_t end = head.load(std::memory_order_acquire);
+  const std::uint64_t size = static_cast<std::uint64_t>(mask) + 1;
+  const std::uint64_t begin = end > size ? end - size : 0;
+  records.reserve(end - begin);
+  for (std::uint64_t ticket = begin; ticket < end; ticket++) {
+    const Slot& slot = slots[ticket & mask];
+    // Skip records still being written or already overwritten by a newer
+    // ticket
+    const std::uint64_t sequence =
+        slot.sequence.load(std::memory_order_acquire);
+    if (sequence != 2 * ticket + 2) {
+      continue;
+    }
+    std::uint64_t words[RECORD_WORDS];
+    for (int w = 0; w < RECORD_WORDS; w++) {
+      words[w] = slot.words[w].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+      continue;
+    }
+    TraceRecord record;
+    record.start = words[0];
+    record.duration = words[1];
+    record.event = static_cast<TraceEvent>(words[2] & 0xff);
+    record.detail = static_cast<std::uint8_t>(words[2] >> 8);
+    record.thread = static_cast<std::uint16_t>(words[2] >> 16);
+    record.fileId = static_cast<FileId>(words[2] >> 32);
+    record.pageNo = static_cast<PageId>(words[3]);
+    record.value = words[4];
+    records.push_back(record);
+  }
+  return records;
+}
+
+std::uint64_t Tracer::count(const TraceEvent event) const {
+  return totals[static_cast<int>(event)].count.load(
+      std::memory_order_relaxed);
+}
+
+void Tracer::writeChromeTrace(std::ostream& out) const {
+  const std::vector<TraceRecord> records = snapshot();
+  out << "{\"traceEvents\":[";
+  for (std::size_t i = 0; i < records.size(); i++) {
+    const TraceRecord& record = records[i];
+    out << (i == 0 ? "\n" : ",\n") << "{\"name\":\""
+        << eventName(record.event) << "\",\"cat\":\"badgerdb\",\"ph\":\"X\""
+        << ",\"ts\":";
+    writeMicros(out, record.start);
+    out << ",\"dur\":";
+    writeMicros(out, record.duration);
+    out << ",\"pid\":1,\"tid\":" << record.thread
+        << ",\"args\":{\"file\":" << record.fileId
+        << ",\"page\":" << record.pageNo << ",\"value\":" << record.value
+        << ",\"detail\":" << static_cast<unsigned>(record.detail) << "}}";
+  }
+  out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+void Tracer::writePrometheus(std::ostream& out) const {
+  const int numEvents = static_cast<int>(TraceEvent::NUM_EVENTS);
+  out << "# HELP badgerdb_trace_events_total Operations seen by the trace "
+         "points.\n"
+      << "# TYPE badgerdb_trace_events_total counter\n";
+  for (int e = 0; e < numEvents; e++) {
+    out << "badgerdb_trace_events_total{event=\""
+        << eventName(static_cast<TraceEvent>(e)) << "\"} "
+        << totals[e].count.load(std::memory_order_relaxed) << "\n";
+  }
+  out << "# HELP badgerdb_trace_duration_seconds_total Time spent in the "
+         "traced operations.\n"
+      << "# TYPE badgerdb_trace_duration_seconds_total counter\n";
+  for (int e = 0; e < numEvents; e++) {
+    const std::uint64_t nanos = totals[e].nanos.load(std::memory_order_relaxed);
+    char seconds[32];
+    std::snprintf(seconds, sizeof(seconds), "%.9f", nanos / 1e9);
+    out << "badgerdb_trace_duration_seconds_total{event=\""
+        << eventName(static_cast<TraceEvent>(e)) << "\"} " << seconds
+        << "\n";
+  }
+  out << "# HELP badgerdb_trace_value_total Sum of the event values (frames "
+         "swept, bytes moved, pages flushed).\n"
+      << "# TYPE badgerdb_trace_value_total counter\n";
+  for (int e = 0; e < numEvents; e++) {
+    out << "badgerdb_trace_value_total{event=\""
+        << eventName(static_cast<TraceEvent>(e)) << "\"} "
+        << totals[e].value.load(std::memory_order_relaxed) << "\n";
+  }
+}
+
+std::uint64_t Tracer::now() {
+  const std::uint64_t nanos =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count();
+  return nanos == 0 ? 1 : nanos;
+}
+
+std::uint16_t Tracer::threadNumber() {
+  // Threads are numbered in the order they first record something
+  static std::atomic<unsigned> nextThread(0);
+  static thread_local const std::uint16_t thread = static_cast<std::uint16_t>(
+      nextThread.fetch_add(1, std::memory_order_relaxed));
+  return thread;
+}
+
+const char* Tracer::eventName(const TraceEvent event) {
+  switch (event) {
+    case TraceEvent::READ_HIT:
+      return "read_hit";
+    case TraceEvent::READ_MISS:
+      return "read_miss";
+    case TraceEvent::ALLOC_BUF:
+      return "alloc_buf";
+    case TraceEvent::FILE_READ:
+      return "file_read";
+    case TraceEvent::FILE_WRITE:
+      return "file_write";
+    case TraceEvent::FLUSH_FILE:
+      return "flush_file";
+    default:
+      return "unknown";
+  }
+}
+
+}  // namespace badgerdb
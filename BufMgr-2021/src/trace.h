@@ -0,0 +1,293 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <vector>
+
+#include "types.h"
+
+/**
+ * Set to 0 to compile the trace points out
+ */
+#ifndef BADGERDB_TRACING
+#define BADGERDB_TRACING 1
+#endif
+
+#if BADGERDB_TRACING
+
+/**
+ * Declares a variable holding the start time of a traced operation, or 0 if
+ * tracing is off
+ */
+#define BADGERDB_TRACE_START(startTime) \
+  const std::uint64_t startTime = ::badgerdb::Tracer::get().start()
+
+/**
+ * Records a traced operation that began at the given start time
+ */
+#define BADGERDB_TRACE(event, start, fileId, pageNo, value, detail)      \
+  do {                                                                   \
+    if (start != 0) {                                                    \
+      ::badgerdb::Tracer::get().record(event, start, fileId, pageNo,     \
+                                       value, detail);                   \
+    }                                                                    \
+  } while (0)
+
+#else
+
+#define BADGERDB_TRACE_START(startTime)
+#define BADGERDB_TRACE(event, start, fileId, pageNo, value, detail) \
+  do {                                                              \
+  } while (0)
+
+#endif
+
+namespace badgerdb {
+
+/**
+ * @brief Operations the trace points record
+ */
+enum class TraceEvent : std::uint8_t {
+  /**
+   * BufMgr::readPage() found the page in the buffer pool
+   */
+  READ_HIT,
+
+  /**
+   * BufMgr::readPage() loaded the page; the detail is 1 if it came from the
+   * victim cache
+   */
+  READ_MISS,
+
+  /**
+   * The buffer manager picked a frame for a page; the value is the number of
+   * frames looked at and the detail a TraceVictim
+   */
+  ALLOC_BUF,
+
+  /**
+   * A read from a file; the value is the number of bytes
+   */
+  FILE_READ,
+
+  /**
+   * A write to a file; the value is the number of bytes
+   */
+  FILE_WRITE,
+
+  /**
+   * BufMgr::flushFile(); the value is the number of pages written
+   */
+  FLUSH_FILE,
+
+  NUM_EVENTS
+};
+
+/**
+ * @brief What an ALLOC_BUF event found in the frame it picked
+ */
+enum class TraceVictim : std::uint8_t { FREE, CLEAN, DIRTY };
+
+/**
+ * @brief One traced operation
+ */
+struct TraceRecord {
+  /**
+   * Start and duration of the operation in nanoseconds of the steady clock
+   */
+  std::uint64_t start;
+  std::uint64_t duration;
+
+  TraceEvent event;
+  std::uint8_t detail;
+
+  /**
+   * Small number of the thread that ran the operation
+   */
+  std::uint16_t thread;
+
+  /**
+   * File and page the operation was on, where known
+   */
+  FileId fileId;
+  PageId pageNo;
+
+  /**
+   * Event specific value; see TraceEvent
+   */
+  std::uint64_t value;
+};
+
+/**
+ * @brief Process wide collector of the trace points
+ *
+ * Tracing is off until enable() is called; a trace point then costs a
+ * relaxed load of a flag.  When it is on, every traced operation is added to
+ * running totals per event, and every sampled one is written to a ring
+ * buffer that keeps the most recent records.  Threads claim slots of the
+ * ring with an atomic increment and never wait for each other.  The totals
+ * can be exported as a Prometheus text snapshot and the ring as a Chrome
+ * trace (JSON), which Perfetto opens as well.
+ *
+ * Building with BADGERDB_TRACING set to 0 removes the trace points.
+ */
+class Tracer {
+ public:
+  /**
+   * Returns the tracer of the process.
+   */
+  static Tracer& get();
+
+  Tracer(const Tracer&) = delete;
+  Tracer& operator=(const Tracer&) = delete;
+
+  /**
+   * Turns tracing on.
+   *
+   * @param capacity     Records the ring keeps, rounded up to a power of
+   *                     two; only the first call allocates the ring
+   * @param sampleEvery  Write every n-th operation of a thread to the ring;
+   *                     the totals count all of them
+   */
+  void enable(const std::size_t capacity = 65536,
+              const std::uint32_t sampleEvery = 1);
+
+  /**
+   * Turns tracing off.  The records and totals are kept.
+   */
+  void disable();
+
+  /**
+   * Returns true if tracing is on.
+   */
+  bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  /**
+   * Drops the records and zeroes the totals.
+   */
+  void clear();
+
+  /**
+   * Returns the current time for a trace point, or 0 if tracing is off.
+   */
+  std::uint64_t start() const { return enabled() ? now() : 0; }
+
+  /**
+   * Records an operation that began at the given time and ends now.
+   *
+   * @param event   Operation
+   * @param start   Value start() returned when the operation began
+   * @param fileId  File the operation was on, or File::INVALID_ID
+   * @param pageNo  Page the operation was on, or Page::INVALID_NUMBER
+   * @param value   Event specific value
+   * @param detail  Event specific detail
+   */
+  void record(const TraceEvent event, const std::uint64_t start,
+              const FileId fileId, const PageId pageNo,
+              const std::uint64_t value, const std::uint8_t detail);
+
+  /**
+   * Returns the records in the ring, oldest first.  Records being written
+   * are left out, as are slots that a slower thread has since filled with
+   * an older record.
+   */
+  std::vector<TraceRecord> snapshot() const;
+
+  /**
+   * Returns the number of operations of an event recorded since the last
+   * clear().
+   */
+  std::uint64_t count(const TraceEvent event) const;
+
+  /**
+   * Writes the records in the ring in the Chrome trace event format.
+   */
+  void writeChromeTrace(std::ostream& out) const;
+
+  /**
+   * Writes the totals of every event in the Prometheus text format.
+   */
+  void writePrometheus(std::ostream& out) const;
+
+ private:
+  /**
+   * Number of 64-bit words a record is packed into
+   */
+  static const int RECORD_WORDS = 5;
+
+  /**
+   * @brief A record of the ring
+   *
+   * The sequence is odd while the record is written and twice its ticket
+   * plus 2 once it is complete, so that readers can skip torn records.
+   */
+  struct Slot {
+    std::atomic<std::uint64_t> sequence;
+    std::atomic<std::uint64_t> words[RECORD_WORDS];
+  };
+
+  /**
+   * @brief Running totals of an event
+   */
+  struct Totals {
+    std::atomic<std::uint64_t> count;
+    std::atomic<std::uint64_t> nanos;
+    std::atomic<std::uint64_t> value;
+  };
+
+  Tracer();
+
+  /**
+   * Returns the steady clock in nanoseconds; never 0.
+   */
+  static std::uint64_t now();
+
+  /**
+   * Returns the small number of the calling thread.
+   */
+  static std::uint16_t threadNumber();
+
+  /**
+   * Returns the name of an event.
+   */
+  static const char* eventName(const TraceEvent event);
+
+  std::atomic<bool> enabled_;
+
+  /**
+   * Write every n-th operation of a thread to the ring
+   */
+  std::atomic<std::uint32_t> sampleEvery;
+
+  /**
+   * Serializes enable() and clear()
+   */
+  std::mutex latch;
+
+  /**
+   * The ring, allocated by the first enable() and kept from then on, and
+   * its size minus one
+   */
+  std::atomic<Slot*> ring;
+  std::size_t mask;
+
+  /**
+   * Number of slots claimed so far
+   */
+  std::atomic<std::uint64_t> head;
+
+  Totals totals[static_cast<int>(TraceEvent::NUM_EVENTS)];
+};
+
+}  // namespace badgerdb
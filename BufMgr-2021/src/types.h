@@ -27,6 +27,19 @@ typedef std::uint16_t SlotId;
  */
 typedef std::uint32_t FrameId;
 
+/**
+ * @brief Identifier for an open file.  Every File object referring to the same
+ * open file has the same identifier; identifiers are reused once the file is
+ * closed.
+ */
+typedef std::uint32_t FileId;
+
+/**
+ * @brief Log sequence number: the offset in the write-ahead log just past a
+ * record.  0 comes before every record.
+ */
+typedef std::uint64_t Lsn;
+
 /**
  * @brief Identifier for a record in a page.
  */
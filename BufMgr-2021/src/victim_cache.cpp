@@ -0,0 +1,144 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "victim_cache.h"
+
+#include <cstring>
+#include <utility>
+
+#include "lz.h"
+
+namespace badgerdb {
+
+const std::size_t VictimCache::ENTRY_OVERHEAD;
+const std::uint32_t VictimCache::NUM_SHARDS;
+
+VictimCache::VictimCache(const std::size_t capacity)
+    : shardCapacity(capacity / NUM_SHARDS) {}
+
+std::string VictimCache::compress(const Page& page) {
+  // A compressed page is always shorter than Page::SIZE, so that length
+  // marks a page kept as it is
+  std::string compressed(Page::SIZE - 1, '\0');
+  const std::size_t length =
+      lzCompress(page.image_, Page::SIZE, &compressed[0], compressed.size());
+  if (length == 0) {
+    return std::string(page.image_, Page::SIZE);
+  }
+  compressed.resize(length);
+  compressed.shrink_to_fit();
+  return compressed;
+}
+
+void VictimCache::insert(const FileId fileId, const std::string& filename,
+                         const PageId pageNo, std::string&& compressed) {
+  const std::uint64_t key = keyOf(fileId, pageNo);
+  Shard& shard = shardOf(key);
+  std::lock_guard<std::mutex> shardGuard(shard.latch);
+  std::unordered_map<std::uint64_t, std::list<Entry>::iterator>::iterator
+      existing = shard.index.find(key);
+  if (existing != shard.index.end()) {
+    shard.bytes -= existing->second->charge();
+    shard.entries.erase(existing->second);
+    shard.index.erase(existing);
+  }
+
+  shard.entries.push_front(Entry{key, filename, std::move(compressed)});
+  shard.index[key] = shard.entries.begin();
+  shard.bytes += shard.entries.front().charge();
+  while (shard.bytes > shardCapacity && !shard.entries.empty()) {
+    const Entry& oldest = shard.entries.back();
+    shard.bytes -= oldest.charge();
+    shard.index.erase(oldest.key);
+    shard.entries.pop_back();
+  }
+}
+
+bool VictimCache::take(const FileId fileId, const std::string& filename,
+                       const PageId pageNo, Page& page) {
+  const std::uint64_t key = keyOf(fileId, pageNo);
+  Shard& shard = shardOf(key);
+  std::list<Entry> taken;
+  {
+    std::lock_guard<std::mutex> shardGuard(shard.latch);
+    std::unordered_map<std::uint64_t, std::list<Entry>::iterator>::iterator
+        entry = shard.index.find(key);
+    if (entry == shard.index.end()) {
+      return false;
+    }
+    shard.bytes -= entry->second->charge();
+    taken.splice(taken.begin(), shard.entries, entry->second);
+    shard.index.erase(entry);
+  }
+
+  // Decompressed without the latch
+  const Entry& found = taken.front();
+  if (found.filename != filename) {
+    // The identifier belonged to another file
+    return false;
+  }
+  if (found.compressed.size() == Page::SIZE) {
+    std::memcpy(page.image_, found.compressed.data(), Page::SIZE);
+    return true;
+  }
+  return lzDecompress(found.compressed.data(), found.compressed.size(),
+                      page.image_, Page::SIZE);
+}
+
+void VictimCache::erase(const FileId fileId, const PageId pageNo) {
+  const std::uint64_t key = keyOf(fileId, pageNo);
+  Shard& shard = shardOf(key);
+  std::lock_guard<std::mutex> shardGuard(shard.latch);
+  std::unordered_map<std::uint64_t, std::list<Entry>::iterator>::iterator
+      entry = shard.index.find(key);
+  if (entry != shard.index.end()) {
+    shard.bytes -= entry->second->charge();
+    shard.entries.erase(entry->second);
+    shard.index.erase(entry);
+  }
+}
+
+void VictimCache::eraseFile(const FileId fileId) {
+  for (Shard& shard : shards) {
+    std::lock_guard<std::mutex> shardGuard(shard.latch);
+    for (std::list<Entry>::iterator entry = shard.entries.begin();
+         entry != shard.entries.end();) {
+      if (entry->key >> 32 != fileId) {
+        ++entry;
+        continue;
+      }
+      shard.bytes -= entry->charge();
+      shard.index.erase(entry->key);
+      entry = shard.entries.erase(entry);
+    }
+  }
+}
+
+std::size_t VictimCache::size() const {
+  std::size_t bytes = 0;
+  for (const Shard& shard : shards) {
+    std::lock_guard<std::mutex> shardGuard(shard.latch);
+    bytes += shard.bytes;
+  }
+  return bytes;
+}
+
+std::size_t VictimCache::pages() const {
+  std::size_t count = 0;
+  for (const Shard& shard : shards) {
+    std::lock_guard<std::mutex> shardGuard(shard.latch);
+    count += shard.entries.size();
+  }
+  return count;
+}
+
+VictimCache::Shard& VictimCache::shardOf(const std::uint64_t key) {
+  return shards[(key * 0x9E3779B97F4A7C15ull) >> 60];
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,185 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Second tier of the buffer pool that keeps evicted pages compressed
+ * in memory
+ *
+ * The buffer manager compresses a page as it evicts it and takes it back out
+ * on a later miss, which costs a decompression instead of a disk read.  A
+ * page is never in the buffer pool and the cache at once, and a page is only
+ * added once it is clean, so every entry matches the page on disk.  Entries
+ * are kept in least recently added order within a memory cap, split over
+ * shards that are latched separately.
+ *
+ * Entries are keyed by file identifier and page number and remember the file
+ * name, so that an identifier reused by another file does not match.  Pages
+ * changed in the file other than through the buffer manager must not be in
+ * the cache.
+ */
+class VictimCache {
+ public:
+  /**
+   * Constructor of VictimCache class
+   *
+   * @param capacity  Memory cap in bytes, counting the compressed pages and
+   *                  the bookkeeping of each entry
+   */
+  explicit VictimCache(const std::size_t capacity);
+
+  VictimCache(const VictimCache&) = delete;
+  VictimCache& operator=(const VictimCache&) = delete;
+
+  /**
+   * Compresses a page for insert().  Pages that do not compress are kept as
+   * they are.  Called without holding any latch.
+   *
+   * @param page  Page to compress
+   * @return  The compressed page
+   */
+  static std::string compress(const Page& page);
+
+  /**
+   * Adds a compressed page, replacing any entry for the same page, and drops
+   * the oldest entries of its shard until the shard is back within its cap.
+   *
+   * @param fileId      Identifier of the file of the page
+   * @param filename    Name of the file of the page
+   * @param pageNo      Number of the page
+   * @param compressed  Page as returned by compress()
+   */
+  void insert(const FileId fileId, const std::string& filename,
+              const PageId pageNo, std::string&& compressed);
+
+  /**
+   * Removes a page and decompresses it into the given page object.
+   *
+   * @param fileId    Identifier of the file of the page
+   * @param filename  Name of the file of the page
+   * @param pageNo    Number of the page
+   * @param page      Receives the page
+   * @return  True if the page was in the cache
+   */
+  bool take(const FileId fileId, const std::string& filename,
+            const PageId pageNo, Page& page);
+
+  /**
+   * Removes a page if it is in the cache.
+   *
+   * @param fileId  Identifier of the file of the page
+   * @param pageNo  Number of the page
+   */
+  void erase(const FileId fileId, const PageId pageNo);
+
+  /**
+   * Removes every page of a file.
+   *
+   * @param fileId  Identifier of the file
+   */
+  void eraseFile(const FileId fileId);
+
+  /**
+   * Returns the memory the cache takes up, in bytes.
+   */
+  std::size_t size() const;
+
+  /**
+   * Returns the number of pages in the cache.
+   */
+  std::size_t pages() const;
+
+ private:
+  /**
+   * Bytes each entry is charged for besides its compressed page and name
+   */
+  static const std::size_t ENTRY_OVERHEAD = 96;
+
+  /**
+   * Number of shards
+   */
+  static const std::uint32_t NUM_SHARDS = 16;
+
+  /**
+   * @brief A compressed page
+   */
+  struct Entry {
+    std::uint64_t key;
+    std::string filename;
+    std::string compressed;
+
+    /**
+     * Returns the bytes the entry is charged for.
+     */
+    std::size_t charge() const {
+      return ENTRY_OVERHEAD + filename.size() + compressed.size();
+    }
+  };
+
+  /**
+   * @brief Part of the cache with a latch of its own
+   */
+  struct Shard {
+    /**
+     * Protects the members below
+     */
+    mutable std::mutex latch;
+
+    /**
+     * Entries, most recently added first
+     */
+    std::list<Entry> entries;
+
+    /**
+     * Entries by key
+     */
+    std::unordered_map<std::uint64_t, std::list<Entry>::iterator> index;
+
+    /**
+     * Bytes charged for the entries
+     */
+    std::size_t bytes = 0;
+  };
+
+  /**
+   * Returns the key of a page.
+   */
+  static std::uint64_t keyOf(const FileId fileId, const PageId pageNo) {
+    return (std::uint64_t(fileId) << 32) | pageNo;
+  }
+
+  /**
+   * Returns the shard a key belongs to.
+   */
+  Shard& shardOf(const std::uint64_t key);
+
+  /**
+   * Memory cap of each shard in bytes
+   */
+  std::size_t shardCapacity;
+
+  /**
+   * The shards
+   */
+  Shard shards[NUM_SHARDS];
+};
+
+}  // namespace badgerdb
@@ -0,0 +1,404 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "wal.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <map>
+
+#include "buffer.h"
+#include "crc32c.h"
+#include "exceptions/file_io_exception.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/invalid_page_exception.h"
+#include "exceptions/redo_mismatch_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Header of a record in the log file.  The file name and the data of the
+ * record follow it.
+ */
+struct LogRecordHeader {
+  /**
+   * Length of the whole record in bytes
+   */
+  std::uint32_t length;
+
+  /**
+   * CRC-32C of the record with this field set to 0
+   */
+  std::uint32_t crc;
+
+  std::uint64_t txn;
+  std::uint32_t pageNo;
+  std::uint16_t slotNo;
+  std::uint8_t type;
+  std::uint8_t reserved;
+  std::uint32_t filenameLength;
+  std::uint32_t dataLength;
+};
+
+static_assert(sizeof(LogRecordHeader) == 32,
+              "Log record header must not contain padding");
+
+bool isLogRecordType(const std::uint8_t type) {
+  return type >= static_cast<std::uint8_t>(LogRecordType::INSERT) &&
+         type <= static_cast<std::uint8_t>(LogRecordType::CHECKPOINT);
+}
+
+}  // namespace
+
+LogManager::LogManager(const std::string &filename)
+    : filename(filename), syncing(false), syncs(0), nextTxn(1) {
+  fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0666);
+  if (fd < 0) {
+    throw FileIoException(filename, errno);
+  }
+
+  std::vector<LogRecord> records;
+  Lsn end;
+  try {
+    end = readLog(records);
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+      throw FileIoException(filename, errno);
+    }
+    if (static_cast<Lsn>(status.st_size) != end &&
+        (ftruncate(fd, end) != 0 || fdatasync(fd) != 0)) {
+      throw FileIoException(filename, errno);
+    }
+  } catch (...) {
+    close(fd);
+    throw;
+  }
+  for (const LogRecord &record : records) {
+    if (record.txn >= nextTxn) nextTxn = record.txn + 1;
+  }
+  writtenLsn = syncedLsn = appendedLsn = end;
+}
+
+LogManager::~LogManager() {
+  try {
+    flush(endLsn());
+  } catch (...) {
+    // Whatever is lost was never reported durable
+  }
+  close(fd);
+}
+
+RecordId LogManager::insertRecord(const TxnId txn, const File &file,
+                                  Page &page, const std::string &data) {
+  const RecordId recordId = page.insertRecord(data);
+  page.set_lsn(append(LogRecordType::INSERT, txn, file.filename(), recordId,
+                      data));
+  return recordId;
+}
+
+void LogManager::updateRecord(const TxnId txn, const File &file, Page &page,
+                              const RecordId &recordId,
+                              const std::string &data) {
+  page.updateRecord(recordId, data);
+  page.set_lsn(append(LogRecordType::UPDATE, txn, file.filename(), recordId,
+                      data));
+}
+
+void LogManager::deleteRecord(const TxnId txn, const File &file, Page &page,
+                              const RecordId &recordId) {
+  page.deleteRecord(recordId);
+  page.set_lsn(append(LogRecordType::DELETE, txn, file.filename(), recordId,
+                      std::string()));
+}
+
+Lsn LogManager::commit(const TxnId txn) {
+  syncHeaders();
+  const RecordId noRecord = {Page::INVALID_NUMBER, Page::INVALID_SLOT};
+  const Lsn lsn = append(LogRecordType::COMMIT, txn, std::string(), noRecord,
+                         std::string());
+  flush(lsn);
+  return lsn;
+}
+
+Lsn LogManager::checkpoint(const Lsn redoLsn) {
+  const RecordId noRecord = {Page::INVALID_NUMBER, Page::INVALID_SLOT};
+  const Lsn lsn =
+      append(LogRecordType::CHECKPOINT, 0, std::string(), noRecord,
+             std::string(reinterpret_cast<const char *>(&redoLsn),
+                         sizeof(redoLsn)));
+  flush(lsn);
+  return lsn;
+}
+
+void LogManager::flush(const Lsn lsn) {
+  std::unique_lock<std::mutex> guard(latch);
+  while (syncedLsn < lsn) {
+    if (syncing) {
+      // Someone else is syncing; our records may be in the next batch
+      synced.wait(guard);
+      continue;
+    }
+
+    // Write and sync everything appended so far, including the records of
+    // transactions that have not asked to commit yet
+    syncing = true;
+    std::string batch;
+    batch.swap(buffer);
+    const Lsn start = writtenLsn;
+    const Lsn end = appendedLsn;
+    guard.unlock();
+
+    int error = 0;
+    std::size_t done = 0;
+    while (done < batch.size()) {
+      const ssize_t written = pwrite(fd, batch.data() + done,
+                                     batch.size() - done, start + done);
+      if (written < 0) {
+        if (errno == EINTR) continue;
+        error = errno;
+        break;
+      }
+      done += written;
+    }
+    if (error == 0 && fdatasync(fd) != 0) {
+      error = errno;
+    }
+
+    guard.lock();
+    syncing = false;
+    if (error != 0) {
+      buffer.insert(0, batch);
+      synced.notify_all();
+      throw FileIoException(filename, error);
+    }
+    writtenLsn = syncedLsn = end;
+    syncs++;
+    synced.notify_all();
+  }
+}
+
+Lsn LogManager::durableLsn() const {
+  std::lock_guard<std::mutex> guard(latch);
+  return syncedLsn;
+}
+
+Lsn LogManager::endLsn() const {
+  std::lock_guard<std::mutex> guard(latch);
+  return appendedLsn;
+}
+
+std::uint64_t LogManager::syncCount() const {
+  std::lock_guard<std::mutex> guard(latch);
+  return syncs;
+}
+
+void LogManager::syncHeaders() {
+  std::lock_guard<std::mutex> headerGuard(headerLatch);
+  std::set<std::string> names;
+  {
+    std::lock_guard<std::mutex> guard(latch);
+    names.swap(changedFiles);
+  }
+  try {
+    for (const std::string &name : names) {
+      try {
+        File::open(name).syncHeader();
+      } catch (const FileNotFoundException &) {
+        // Removed since, so there is nothing left to recover into
+      }
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> guard(latch);
+    changedFiles.insert(names.begin(), names.end());
+    throw;
+  }
+}
+
+std::uint64_t LogManager::recover(BufMgr &bufMgr) {
+  std::vector<LogRecord> records;
+  readLog(records);
+
+  Lsn redoLsn = 0;
+  std::set<TxnId> committed;
+  for (const LogRecord &record : records) {
+    if (record.type == LogRecordType::CHECKPOINT &&
+        record.data.size() == sizeof(redoLsn)) {
+      std::memcpy(&redoLsn, record.data.data(), sizeof(redoLsn));
+    } else if (record.type == LogRecordType::COMMIT) {
+      committed.insert(record.txn);
+    }
+  }
+
+  std::map<std::string, File> files;
+  std::set<std::string> missing;
+  std::uint64_t replayed = 0;
+  for (const LogRecord &record : records) {
+    if (record.lsn <= redoLsn || record.type == LogRecordType::COMMIT ||
+        record.type == LogRecordType::CHECKPOINT ||
+        missing.count(record.filename) != 0) {
+      continue;
+    }
+    std::map<std::string, File>::iterator file = files.find(record.filename);
+    if (file == files.end()) {
+      try {
+        file = files.insert(std::make_pair(record.filename,
+                                           File::open(record.filename)))
+                   .first;
+      } catch (const FileNotFoundException &) {
+        missing.insert(record.filename);
+        continue;
+      }
+    }
+
+    PageGuard page;
+    try {
+      page = bufMgr.readPage(file->second, record.recordId.page_number);
+    } catch (const InvalidPageException &) {
+      if (record.recordId.page_number < file->second.num_pages()) {
+        // The page was deleted after the change
+        continue;
+      }
+      if (committed.count(record.txn) == 0) {
+        // The transaction allocated the page but never committed, so the
+        // header counting the page was not forced out
+        continue;
+      }
+      throw;
+    }
+    if (page->lsn() >= record.lsn) {
+      continue;
+    }
+    if (!redo(*page, record)) {
+      throw RedoMismatchException(record.recordId, record.filename);
+    }
+    page->set_lsn(record.lsn);
+    page.markDirty();
+    replayed++;
+  }
+
+  for (std::pair<const std::string, File> &file : files) {
+    bufMgr.flushFile(file.second, true /* sync */);
+  }
+  return replayed;
+}
+
+bool LogManager::redo(Page &page, const LogRecord &record) {
+  try {
+    switch (record.type) {
+      case LogRecordType::INSERT: {
+        const SlotId slot = record.recordId.slot_number;
+        if (!page.hasSpaceForRecord(record.data)) {
+          return false;
+        }
+        if (slot == page.header_->num_slots + 1 &&
+            page.header_->num_free_slots == 0) {
+          // The insert added the slot, and inserting adds it again
+          page.insertRecord(record.data);
+        } else {
+          page.insertRecordInSlot(slot, record.data);
+        }
+        break;
+      }
+      case LogRecordType::UPDATE:
+        page.updateRecord(record.recordId, record.data);
+        break;
+      case LogRecordType::DELETE:
+        page.deleteRecord(record.recordId);
+        break;
+      case LogRecordType::COMMIT:
+      case LogRecordType::CHECKPOINT:
+        break;
+    }
+  } catch (const BadgerDbException &) {
+    // Missing records and slots, slots in use and pages out of space
+    return false;
+  }
+  return true;
+}
+
+Lsn LogManager::append(const LogRecordType type, const TxnId txn,
+                       const std::string &filename, const RecordId &recordId,
+                       const std::string &data) {
+  LogRecordHeader header;
+  header.length = static_cast<std::uint32_t>(sizeof(LogRecordHeader) +
+                                             filename.size() + data.size());
+  header.crc = 0;
+  header.txn = txn;
+  header.pageNo = recordId.page_number;
+  header.slotNo = recordId.slot_number;
+  header.type = static_cast<std::uint8_t>(type);
+  header.reserved = 0;
+  header.filenameLength = static_cast<std::uint32_t>(filename.size());
+  header.dataLength = static_cast<std::uint32_t>(data.size());
+  std::uint32_t crc = crc32c(0, &header, sizeof(header));
+  crc = crc32c(crc, filename.data(), filename.size());
+  header.crc = crc32c(crc, data.data(), data.size());
+
+  std::lock_guard<std::mutex> guard(latch);
+  if (!filename.empty()) {
+    changedFiles.insert(filename);
+  }
+  buffer.append(reinterpret_cast<const char *>(&header), sizeof(header));
+  buffer.append(filename);
+  buffer.append(data);
+  appendedLsn += header.length;
+  return appendedLsn;
+}
+
+Lsn LogManager::readLog(std::vector<LogRecord> &records) const {
+  std::string log;
+  char chunk[65536];
+  for (;;) {
+    const ssize_t read = pread(fd, chunk, sizeof(chunk), log.size());
+    if (read < 0) {
+      if (errno == EINTR) continue;
+      throw FileIoException(filename, errno);
+    }
+    if (read == 0) break;
+    log.append(chunk, read);
+  }
+
+  std::size_t position = 0;
+  while (log.size() - position >= sizeof(LogRecordHeader)) {
+    LogRecordHeader header;
+    std::memcpy(&header, log.data() + position, sizeof(header));
+    const std::uint64_t length = std::uint64_t(sizeof(header)) +
+                                 header.filenameLength + header.dataLength;
+    if (header.length != length || length > log.size() - position ||
+        !isLogRecordType(header.type)) {
+      break;
+    }
+    const char *payload = log.data() + position + sizeof(header);
+    const std::uint32_t crc = header.crc;
+    header.crc = 0;
+    if (crc32c(crc32c(0, &header, sizeof(header)), payload,
+               length - sizeof(header)) != crc) {
+      break;
+    }
+
+    LogRecord record;
+    record.lsn = position + length;
+    record.type = static_cast<LogRecordType>(header.type);
+    record.txn = header.txn;
+    record.filename.assign(payload, header.filenameLength);
+    record.recordId.page_number = header.pageNo;
+    record.recordId.slot_number = header.slotNo;
+    record.data.assign(payload + header.filenameLength, header.dataLength);
+    records.push_back(record);
+    position += length;
+  }
+  return position;
+}
+
+}  // namespace badgerdb
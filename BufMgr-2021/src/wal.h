@@ -0,0 +1,345 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "file.h"
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+class BufMgr;
+
+/**
+ * @brief Identifier for a transaction that writes to the log.
+ */
+typedef std::uint64_t TxnId;
+
+/**
+ * @brief Kinds of records in the write-ahead log
+ */
+enum class LogRecordType : std::uint8_t {
+  /**
+   * A record was inserted into a page
+   */
+  INSERT = 1,
+
+  /**
+   * A record of a page was replaced
+   */
+  UPDATE = 2,
+
+  /**
+   * A record was deleted from a page
+   */
+  DELETE = 3,
+
+  /**
+   * A transaction committed
+   */
+  COMMIT = 4,
+
+  /**
+   * A checkpoint ended: every change up to the redo LSN in the data of the
+   * record is on disk
+   */
+  CHECKPOINT = 5
+};
+
+/**
+ * @brief A record of the write-ahead log, as read back from the log file
+ */
+struct LogRecord {
+  /**
+   * Log sequence number of the record: the offset in the log just past it
+   */
+  Lsn lsn;
+
+  /**
+   * Kind of record
+   */
+  LogRecordType type;
+
+  /**
+   * Transaction that wrote the record
+   */
+  TxnId txn;
+
+  /**
+   * Name of the file the changed page is in; empty for COMMIT and
+   * CHECKPOINT records
+   */
+  std::string filename;
+
+  /**
+   * Record that was changed; for INSERT, the one that was inserted
+   */
+  RecordId recordId;
+
+  /**
+   * New data of the record for INSERT and UPDATE; the redo LSN for
+   * CHECKPOINT; empty otherwise
+   */
+  std::string data;
+};
+
+/**
+ * @brief Write-ahead redo log of record level changes to pages
+ *
+ * Changes are made through insertRecord(), updateRecord() and deleteRecord()
+ * of the log, which change the page, append a redo record to the log and
+ * stamp the page with the record's log sequence number (LSN).  A BufMgr
+ * given the log in BufMgrOptions::log makes the log durable up to the LSN of
+ * a page before it writes the page back, so a page on disk never holds a
+ * change the log could lose.  recover() replays the log into the pages that
+ * missed changes after a crash.
+ *
+ * commit() waits until the log is durable up to the transaction's commit
+ * record.  Transactions that commit while the log is being synced are
+ * written and synced together by the next one of them to get there (group
+ * commit), so durability costs one sequential log sync for many
+ * transactions instead of page syncs for each.
+ *
+ * Redo repeats history: every logged change is replayed, committed or not.
+ * There are no undo records.  The caller must have the page pinned and keep
+ * other threads from changing it while it makes a change through the log.
+ */
+class LogManager {
+ public:
+  /**
+   * Opens the log, creating it if it does not exist.  A torn record at the
+   * end of the log, left by a crash while it was written, is cut off.
+   *
+   * @param filename  Name of the log file
+   * @throws  FileIoException If the log cannot be opened or read
+   */
+  explicit LogManager(const std::string& filename);
+
+  /**
+   * Makes the log durable and closes it.
+   */
+  ~LogManager();
+
+  LogManager(const LogManager&) = delete;
+  LogManager& operator=(const LogManager&) = delete;
+
+  /**
+   * Returns a new transaction identifier.
+   */
+  TxnId begin() { return nextTxn++; }
+
+  /**
+   * Inserts a record into a page and logs the insert.
+   *
+   * @param txn     Transaction making the change
+   * @param file    File the page is in
+   * @param page    Page to insert into; pinned by the caller
+   * @param data    Data of the new record
+   * @return  ID of the new record
+   * @throws  InsufficientSpaceException  If the record does not fit
+   */
+  RecordId insertRecord(const TxnId txn, const File& file, Page& page,
+                        const std::string& data);
+
+  /**
+   * Replaces a record of a page and logs the update.
+   *
+   * @param txn       Transaction making the change
+   * @param file      File the page is in
+   * @param page      Page of the record; pinned by the caller
+   * @param recordId  Record to replace
+   * @param data      New data of the record
+   */
+  void updateRecord(const TxnId txn, const File& file, Page& page,
+                    const RecordId& recordId, const std::string& data);
+
+  /**
+   * Deletes a record from a page and logs the delete.
+   *
+   * @param txn       Transaction making the change
+   * @param file      File the page is in
+   * @param page      Page of the record; pinned by the caller
+   * @param recordId  Record to delete
+   */
+  void deleteRecord(const TxnId txn, const File& file, Page& page,
+                    const RecordId& recordId);
+
+  /**
+   * Logs the commit of a transaction and waits until it is durable.  The
+   * headers of the files changed through the log since the last commit are
+   * made durable first, so that pages the transaction allocated are still
+   * part of their files after a crash.
+   *
+   * @param txn   Transaction to commit
+   * @return  LSN of the commit record
+   * @throws  FileIoException If the log or a file header cannot be written
+   *                           or synced
+   */
+  Lsn commit(const TxnId txn);
+
+  /**
+   * Logs the end of a checkpoint and waits until it is durable.  Called by
+   * BufMgr::checkpoint() once every page changed up to the redo LSN has been
+   * written back and synced.
+   *
+   * @param redoLsn   LSN recovery can start after
+   * @return  LSN of the checkpoint record
+   * @throws  FileIoException If the log cannot be written or synced
+   */
+  Lsn checkpoint(const Lsn redoLsn);
+
+  /**
+   * Waits until the log is durable up to an LSN, writing and syncing it if
+   * no other thread is doing so.
+   *
+   * @param lsn   LSN that must be durable
+   * @throws  FileIoException If the log cannot be written or synced
+   */
+  void flush(const Lsn lsn);
+
+  /**
+   * Returns the LSN the log is durable up to.
+   */
+  Lsn durableLsn() const;
+
+  /**
+   * Returns the LSN of the last record appended.
+   */
+  Lsn endLsn() const;
+
+  /**
+   * Returns the number of times the log was synced.
+   */
+  std::uint64_t syncCount() const;
+
+  /**
+   * Replays the log after the redo LSN of the last checkpoint into the
+   * pages of the buffer manager that missed changes, then writes those pages
+   * back.  Files the log names that no longer exist are skipped, as are
+   * changes to pages deleted since and uncommitted changes to pages whose
+   * allocation never reached the file header.  Replaying again changes
+   * nothing.
+   *
+   * @param bufMgr  Buffer manager to read the pages through
+   * @return  Number of changes replayed
+   * @throws  FileIoException If the log cannot be read
+   * @throws  InvalidPageException  If a committed change is to a page past
+   *                                the end of its file
+   * @throws  RedoMismatchException If a change does not apply to its page,
+   *                                e.g. an insert into a slot in use
+   */
+  std::uint64_t recover(BufMgr& bufMgr);
+
+ private:
+  /**
+   * Appends a record to the log buffer and returns its LSN.
+   */
+  Lsn append(const LogRecordType type, const TxnId txn,
+             const std::string& filename, const RecordId& recordId,
+             const std::string& data);
+
+  /**
+   * Reads the valid records of the log file, stopping at the first that is
+   * torn or corrupt.
+   *
+   * @param records   Receives the records
+   * @return  LSN just past the last valid record
+   */
+  Lsn readLog(std::vector<LogRecord>& records) const;
+
+  /**
+   * Applies a logged INSERT, UPDATE or DELETE to the page it was made to.
+   * An insert goes back into the slot it was logged with.
+   *
+   * @return  False if the page is not in a state the change applies to
+   */
+  static bool redo(Page& page, const LogRecord& record);
+
+  /**
+   * Makes the headers of the files in changedFiles durable.
+   */
+  void syncHeaders();
+
+  /**
+   * Name of the log file
+   */
+  std::string filename;
+
+  /**
+   * Descriptor of the log file
+   */
+  int fd;
+
+  /**
+   * Protects the members below
+   */
+  mutable std::mutex latch;
+
+  /**
+   * Signalled when a sync of the log ends
+   */
+  std::condition_variable synced;
+
+  /**
+   * Records appended but not written to the log file yet
+   */
+  std::string buffer;
+
+  /**
+   * LSN up to which the log has been written to the file; buffer starts here
+   */
+  Lsn writtenLsn;
+
+  /**
+   * LSN up to which the log file has been synced
+   */
+  Lsn syncedLsn;
+
+  /**
+   * LSN of the last record appended
+   */
+  Lsn appendedLsn;
+
+  /**
+   * True while a thread writes and syncs the log without holding the latch
+   */
+  bool syncing;
+
+  /**
+   * Number of syncs of the log file
+   */
+  std::uint64_t syncs;
+
+  /**
+   * Names of the files changed through the log since the last commit synced
+   * their headers
+   */
+  std::set<std::string> changedFiles;
+
+  /**
+   * Held while file headers are synced, so that a commit finding
+   * changedFiles empty cannot overtake the sync of a header it needs
+   */
+  std::mutex headerLatch;
+
+  /**
+   * Identifier of the next transaction
+   */
+  std::atomic<TxnId> nextTxn;
+};
+
+}  // namespace badgerdb